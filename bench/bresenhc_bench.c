@@ -0,0 +1,949 @@
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL3/SDL.h>
+#include "array.h"
+#include "math_utils.h"
+#include "brh_display.h"
+#include "brh_triangle.h"
+#include "brh_vector.h"
+#include "brh_matrix.h"
+#include "brh_light.h"
+#include "brh_light_tiles.h"
+#include "brh_shadow.h"
+#include "brh_visibility.h"
+#include "brh_camera.h"
+#include "brh_renderable.h"
+#include "brh_mesh_manager.h"
+#include "brh_profiler.h"
+#include "brh_pipeline.h"
+#include "brh_jobs.h"
+
+/*
+* Deterministic benchmark harness.
+*
+* Loads a scene description, replays a scripted camera path for a fixed number of frames
+* on a headless display with no frame cap, and reports frame time statistics as JSON.
+*
+* Scene file (one directive per line, '#' starts a comment):
+*   renderable <mesh.obj> <texture.png|-> <px> <py> <pz> [<rx> <ry> <rz> [<sx> <sy> <sz>]]
+*   occluder <mesh.obj> <texture.png|-> ...  (same as renderable, also hides what is behind it)
+*   instance <px> <py> <pz> [<rx> <ry> <rz> [<sx> <sy> <sz>]]  (adds an instance to the last renderable,
+*                                                              relative to its transform)
+*   instance_grid <nx> <ny> <nz> <dx> <dy> <dz>  (adds nx*ny*nz instances spaced dx, dy, dz apart)
+*   light <dx> <dy> <dz>
+*   point_light <px> <py> <pz> <radius> <r> <g> <b>  (color channels in [0, 1])
+*   spot_light <px> <py> <pz> <dx> <dy> <dz> <radius> <inner_degrees> <outer_degrees> <r> <g> <b>
+*   render wireframe|wireframe_vertex|fill|fill_wireframe|textured|textured_wireframe
+*   shading none|flat|gouraud|phong
+*   cull none|backface
+*
+* Camera path file (one keyframe per line, times increasing):
+*   <time_seconds> <px> <py> <pz> <yaw_degrees> <pitch_degrees>
+*
+* Frame i samples the path at i * BENCH_FIXED_DELTA_TIME (wrapping at the end of the path),
+* so every run renders exactly the same frames regardless of how fast they are produced.
+*
+* With --pipeline-depth N the geometry of later frames overlaps the rasterization of earlier
+* ones (see brh_pipeline.h); each measured iteration then presents the frame submitted N
+* iterations before it, and the report gains the pipeline's latency breakdown.
+*
+* With --microbench the report also times the vector and matrix operations in isolation,
+* and the geometry stage alone (update_renderables_to_slot() over the camera path, with no
+* rasterization). Build with -DBRH_ENABLE_SIMD_MATH=OFF to compare against scalar math.
+*/
+
+#define BENCH_MAX_CAMERA_KEYS 1024
+#define BENCH_FIXED_DELTA_TIME (1.0f / 60.0f)
+#define BENCH_LINE_LENGTH 512
+// Inputs each math microbenchmark cycles through (a power of two), and how many passes it makes over them
+#define BENCH_MICRO_INPUTS 1024
+#define BENCH_MICRO_PASSES 2048
+
+typedef struct {
+    float time;
+    brh_vector3 position;
+    float yaw;   // Radians
+    float pitch; // Radians
+} bench_camera_key;
+
+typedef struct {
+    brh_renderable_handle* renderables;   // Dynamic array (array.h)
+    int renderable_count;
+} bench_scene;
+
+typedef struct {
+    bench_camera_key keys[BENCH_MAX_CAMERA_KEYS];
+    int key_count;
+} bench_camera_path;
+
+typedef struct {
+    const char* scene_path;
+    const char* camera_path;
+    const char* output_path;   // NULL writes the JSON report to stdout
+    const char* dump_path;     // Optional PPM of the last frame
+    const char* trace_path;    // Optional Chrome trace of the measured frames
+    int width;
+    int height;
+    int frames;
+    int warmup_frames;
+    int pipeline_depth;        // 0 runs geometry and rasterization serially
+    brh_job_system_options jobs; // Worker threads and affinity
+    bool depth_epochs;         // Clear depth lazily per tile instead of every frame
+    bool occlusion;            // Skip renderables hidden behind the scene's occluders
+    bool level_of_detail;      // Draw simplified meshes for renderables small on screen
+    bool shadows;              // Shadow the global light with a shadow map
+    bool depth_prepass;        // Lay down depth before shading, so each pixel is shaded once
+    bool visibility_buffer;    // Write triangle ids, then shade each pixel once in a row-parallel pass
+    const char* lod_cache;     // Directory of cached mesh levels of detail
+    bool microbench;           // Also time the math operations and the geometry stage alone
+} bench_options;
+
+// Results of --microbench
+typedef struct {
+    double mat4_mul_vec4_ns;      // Per call
+    double mat4_mul_mat4_ns;
+    double vec3_unit_vector_ns;
+    double vec3_cross_ns;
+    double geometry_ms;           // update_renderables_to_slot() per frame
+} bench_micro_results;
+
+static const char* render_method_names[] = {
+    "wireframe", "wireframe_vertex", "fill", "fill_wireframe", "textured", "textured_wireframe"
+};
+
+static const char* shading_method_names[] = {
+    "none", "flat", "gouraud", "phong"
+};
+
+static const char* cull_method_names[] = {
+    "none", "backface"
+};
+
+static int find_name(const char* name, const char** names, int count)
+{
+    for (int i = 0; i < count; i++) {
+        if (strcmp(name, names[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* --------- Scene Loading --------- */
+static bool load_scene(const char* path, bench_scene* scene)
+{
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "Error: Could not open scene file %s\n", path);
+        return false;
+    }
+
+    char line[BENCH_LINE_LENGTH];
+    int line_number = 0;
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), file)) {
+        line_number++;
+        char keyword[32];
+        if (sscanf(line, " %31s", keyword) != 1 || keyword[0] == '#') {
+            continue;
+        }
+
+        if (strcmp(keyword, "renderable") == 0 || strcmp(keyword, "occluder") == 0) {
+            char mesh_file[256], texture_file[256];
+            brh_vector3 position = { 0 }, rotation = { 0 }, scale = { 1.0f, 1.0f, 1.0f };
+            int count = sscanf(line, " %*s %255s %255s %f %f %f %f %f %f %f %f %f",
+                mesh_file, texture_file,
+                &position.x, &position.y, &position.z,
+                &rotation.x, &rotation.y, &rotation.z,
+                &scale.x, &scale.y, &scale.z);
+            if (count != 5 && count != 8 && count != 11) {
+                fprintf(stderr, "Error: %s:%d: expected '%s <mesh> <texture|-> px py pz [rx ry rz [sx sy sz]]'\n", path, line_number, keyword);
+                ok = false;
+                break;
+            }
+            brh_renderable_handle renderable = create_renderable_from_files(mesh_file,
+                strcmp(texture_file, "-") == 0 ? NULL : texture_file);
+            if (!renderable) {
+                fprintf(stderr, "Error: %s:%d: failed to create renderable from %s\n", path, line_number, mesh_file);
+                ok = false;
+                break;
+            }
+            set_renderable_position(renderable, position);
+            set_renderable_rotation(renderable, rotation);
+            set_renderable_scale(renderable, scale);
+            set_renderable_occluder(renderable, strcmp(keyword, "occluder") == 0);
+            array_push(scene->renderables, renderable);
+            scene->renderable_count++;
+        }
+        else if (strcmp(keyword, "instance") == 0 || strcmp(keyword, "instance_grid") == 0) {
+            if (scene->renderable_count == 0) {
+                fprintf(stderr, "Error: %s:%d: '%s' needs a renderable before it\n", path, line_number, keyword);
+                ok = false;
+                break;
+            }
+            brh_renderable_handle renderable = scene->renderables[scene->renderable_count - 1];
+            const int first = get_renderable_instance_count(renderable);
+
+            if (strcmp(keyword, "instance") == 0) {
+                brh_vector3 position = { 0 }, rotation = { 0 }, scale = { 1.0f, 1.0f, 1.0f };
+                int count = sscanf(line, " %*s %f %f %f %f %f %f %f %f %f",
+                    &position.x, &position.y, &position.z,
+                    &rotation.x, &rotation.y, &rotation.z,
+                    &scale.x, &scale.y, &scale.z);
+                if (count != 3 && count != 6 && count != 9) {
+                    fprintf(stderr, "Error: %s:%d: expected 'instance px py pz [rx ry rz [sx sy sz]]'\n", path, line_number);
+                    ok = false;
+                    break;
+                }
+                if (!set_renderable_instance_count(renderable, first + 1)) {
+                    ok = false;
+                    break;
+                }
+                set_renderable_instance_transform(renderable, first, position, rotation, scale);
+            }
+            else {
+                int nx, ny, nz;
+                brh_vector3 spacing;
+                if (sscanf(line, " %*s %d %d %d %f %f %f", &nx, &ny, &nz, &spacing.x, &spacing.y, &spacing.z) != 6 ||
+                    nx <= 0 || ny <= 0 || nz <= 0) {
+                    fprintf(stderr, "Error: %s:%d: expected 'instance_grid nx ny nz dx dy dz'\n", path, line_number);
+                    ok = false;
+                    break;
+                }
+                if (!set_renderable_instance_count(renderable, first + nx * ny * nz)) {
+                    ok = false;
+                    break;
+                }
+                int index = first;
+                for (int z = 0; z < nz; z++) {
+                    for (int y = 0; y < ny; y++) {
+                        for (int x = 0; x < nx; x++) {
+                            const brh_vector3 position = { x * spacing.x, y * spacing.y, z * spacing.z };
+                            set_renderable_instance_transform(renderable, index++, position,
+                                (brh_vector3) { 0.0f, 0.0f, 0.0f }, (brh_vector3) { 1.0f, 1.0f, 1.0f });
+                        }
+                    }
+                }
+            }
+        }
+        else if (strcmp(keyword, "light") == 0) {
+            brh_vector3 direction;
+            if (sscanf(line, " %*s %f %f %f", &direction.x, &direction.y, &direction.z) != 3) {
+                fprintf(stderr, "Error: %s:%d: expected 'light dx dy dz'\n", path, line_number);
+                ok = false;
+                break;
+            }
+            set_global_light_direction(direction);
+        }
+        else if (strcmp(keyword, "point_light") == 0 || strcmp(keyword, "spot_light") == 0) {
+            brh_local_light light = { 0 };
+            bool parsed;
+            if (strcmp(keyword, "point_light") == 0) {
+                light.type = LIGHT_POINT;
+                parsed = sscanf(line, " %*s %f %f %f %f %f %f %f",
+                    &light.position.x, &light.position.y, &light.position.z, &light.radius,
+                    &light.color.x, &light.color.y, &light.color.z) == 7;
+            }
+            else {
+                light.type = LIGHT_SPOT;
+                parsed = sscanf(line, " %*s %f %f %f %f %f %f %f %f %f %f %f %f",
+                    &light.position.x, &light.position.y, &light.position.z,
+                    &light.direction.x, &light.direction.y, &light.direction.z, &light.radius,
+                    &light.inner_angle, &light.outer_angle,
+                    &light.color.x, &light.color.y, &light.color.z) == 12;
+                light.inner_angle = degrees_to_radians(light.inner_angle);
+                light.outer_angle = degrees_to_radians(light.outer_angle);
+            }
+            if (!parsed) {
+                fprintf(stderr, "Error: %s:%d: expected '%s' followed by %s\n", path, line_number, keyword,
+                    light.type == LIGHT_POINT ? "px py pz radius r g b" : "px py pz dx dy dz radius inner outer r g b");
+                ok = false;
+                break;
+            }
+            if (create_local_light(&light) == BRH_NULL_HANDLE) {
+                fprintf(stderr, "Error: %s:%d: invalid light\n", path, line_number);
+                ok = false;
+                break;
+            }
+        }
+        else {
+            char value[32];
+            int index = -1;
+            if (sscanf(line, " %*s %31s", value) == 1) {
+                if (strcmp(keyword, "render") == 0) {
+                    index = find_name(value, render_method_names, (int)(sizeof(render_method_names) / sizeof(render_method_names[0])));
+                    if (index >= 0) set_render_method((enum render_method)index);
+                }
+                else if (strcmp(keyword, "shading") == 0) {
+                    index = find_name(value, shading_method_names, (int)(sizeof(shading_method_names) / sizeof(shading_method_names[0])));
+                    if (index >= 0) set_shading_method((shading_method)index);
+                }
+                else if (strcmp(keyword, "cull") == 0) {
+                    index = find_name(value, cull_method_names, (int)(sizeof(cull_method_names) / sizeof(cull_method_names[0])));
+                    if (index >= 0) set_cull_method((enum cull_method)index);
+                }
+            }
+            if (index < 0) {
+                fprintf(stderr, "Error: %s:%d: unknown directive '%s'\n", path, line_number, line);
+                ok = false;
+            }
+        }
+    }
+
+    fclose(file);
+    if (ok && scene->renderable_count == 0) {
+        fprintf(stderr, "Error: Scene %s contains no renderables\n", path);
+        ok = false;
+    }
+    return ok;
+}
+
+static void free_scene(bench_scene* scene)
+{
+    for (int r = 0; r < scene->renderable_count; r++) {
+        destroy_renderable(scene->renderables[r]);
+    }
+    array_free(scene->renderables);
+    scene->renderables = NULL;
+    scene->renderable_count = 0;
+    cleanup_local_lights();
+    cleanup_light_tiles();
+    cleanup_shadow_map();
+    cleanup_visibility_buffer();
+}
+
+/* --------- Camera Path --------- */
+static bool load_camera_path(const char* path, bench_camera_path* camera_path)
+{
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "Error: Could not open camera path file %s\n", path);
+        return false;
+    }
+
+    char line[BENCH_LINE_LENGTH];
+    int line_number = 0;
+    bool ok = true;
+    while (fgets(line, sizeof(line), file)) {
+        line_number++;
+        char first[32];
+        if (sscanf(line, " %31s", first) != 1 || first[0] == '#') {
+            continue;
+        }
+
+        bench_camera_key key;
+        float yaw_degrees, pitch_degrees;
+        if (sscanf(line, " %f %f %f %f %f %f", &key.time,
+            &key.position.x, &key.position.y, &key.position.z,
+            &yaw_degrees, &pitch_degrees) != 6) {
+            fprintf(stderr, "Error: %s:%d: expected 'time px py pz yaw pitch'\n", path, line_number);
+            ok = false;
+            break;
+        }
+        if (camera_path->key_count > 0 && key.time <= camera_path->keys[camera_path->key_count - 1].time) {
+            fprintf(stderr, "Error: %s:%d: keyframe times must be increasing\n", path, line_number);
+            ok = false;
+            break;
+        }
+        if (camera_path->key_count >= BENCH_MAX_CAMERA_KEYS) {
+            fprintf(stderr, "Error: %s:%d: too many keyframes (max %d)\n", path, line_number, BENCH_MAX_CAMERA_KEYS);
+            ok = false;
+            break;
+        }
+
+        key.yaw = degrees_to_radians(yaw_degrees);
+        key.pitch = degrees_to_radians(pitch_degrees);
+        camera_path->keys[camera_path->key_count++] = key;
+    }
+
+    fclose(file);
+    if (ok && camera_path->key_count == 0) {
+        fprintf(stderr, "Error: Camera path %s contains no keyframes\n", path);
+        ok = false;
+    }
+    return ok;
+}
+
+static bench_camera_key sample_camera_path(const bench_camera_path* camera_path, float time)
+{
+    const bench_camera_key* first = &camera_path->keys[0];
+    const bench_camera_key* last = &camera_path->keys[camera_path->key_count - 1];
+    if (camera_path->key_count == 1) {
+        return *first;
+    }
+
+    // Wrap around so paths shorter than the run keep looping
+    const float duration = last->time - first->time;
+    float t = fmodf(time, duration) + first->time;
+
+    int k = 0;
+    while (k < camera_path->key_count - 2 && camera_path->keys[k + 1].time < t) {
+        k++;
+    }
+    const bench_camera_key* a = &camera_path->keys[k];
+    const bench_camera_key* b = &camera_path->keys[k + 1];
+    const float factor = MAX(0.0f, MIN(1.0f, (t - a->time) / (b->time - a->time)));
+
+    bench_camera_key result;
+    result.time = time;
+    result.position.x = interpolate_float(a->position.x, b->position.x, factor);
+    result.position.y = interpolate_float(a->position.y, b->position.y, factor);
+    result.position.z = interpolate_float(a->position.z, b->position.z, factor);
+    result.yaw = interpolate_float(a->yaw, b->yaw, factor);
+    result.pitch = interpolate_float(a->pitch, b->pitch, factor);
+    return result;
+}
+
+/* --------- Statistics --------- */
+static int compare_double(const void* a, const void* b)
+{
+    const double da = *(const double*)a;
+    const double db = *(const double*)b;
+    return (da > db) - (da < db);
+}
+
+// Nearest-rank percentile of an ascending array
+static double percentile(const double* sorted, int count, double p)
+{
+    int rank = (int)ceil(p / 100.0 * (double)count);
+    rank = MAX(1, MIN(count, rank));
+    return sorted[rank - 1];
+}
+
+// Writes a string as a quoted JSON string, escaping what JSON does not allow bare
+// (Windows paths are full of backslashes)
+static void write_json_string(FILE* out, const char* text)
+{
+    fputc('"', out);
+    for (const unsigned char* c = (const unsigned char*)(text ? text : ""); *c; c++) {
+        switch (*c) {
+        case '"':  fputs("\\\"", out); break;
+        case '\\': fputs("\\\\", out); break;
+        case '\n': fputs("\\n", out); break;
+        case '\r': fputs("\\r", out); break;
+        case '\t': fputs("\\t", out); break;
+        default:
+            if (*c < 0x20) {
+                fprintf(out, "\\u%04x", *c);
+            }
+            else {
+                fputc(*c, out);
+            }
+            break;
+        }
+    }
+    fputc('"', out);
+}
+
+static bool write_report(const bench_options* options, const double* frame_ms, const long long* frame_triangles,
+    const brh_cull_stats* cull_totals, const brh_shadow_stats* shadow_totals, uint64_t shaded_fragments,
+    const brh_visibility_stats* visibility_totals, const bench_micro_results* micro)
+{
+    FILE* out = options->output_path ? fopen(options->output_path, "w") : stdout;
+    if (!out) {
+        fprintf(stderr, "Error: Could not open %s for writing\n", options->output_path);
+        return false;
+    }
+
+    const int n = options->frames;
+    double* sorted = (double*)malloc(sizeof(double) * n);
+    if (!sorted) {
+        fprintf(stderr, "Error: Failed to allocate statistics buffer\n");
+        if (out != stdout) fclose(out);
+        return false;
+    }
+    memcpy(sorted, frame_ms, sizeof(double) * n);
+    qsort(sorted, n, sizeof(double), compare_double);
+
+    double total_ms = 0.0;
+    long long total_triangles = 0;
+    for (int i = 0; i < n; i++) {
+        total_ms += frame_ms[i];
+        total_triangles += frame_triangles[i];
+    }
+    const double total_seconds = total_ms / 1000.0;
+    const double total_pixels = (double)options->width * (double)options->height * (double)n;
+    // Light binning of the last frame built
+    const brh_light_tile_stats light_tiles = get_light_tile_stats();
+
+    fprintf(out, "{\n");
+    fprintf(out, "  \"scene\": ");
+    write_json_string(out, options->scene_path);
+    fprintf(out, ",\n  \"camera_path\": ");
+    write_json_string(out, options->camera_path);
+    fprintf(out, ",\n");
+    fprintf(out, "  \"width\": %d,\n", options->width);
+    fprintf(out, "  \"height\": %d,\n", options->height);
+    fprintf(out, "  \"frames\": %d,\n", n);
+    fprintf(out, "  \"warmup_frames\": %d,\n", options->warmup_frames);
+    fprintf(out, "  \"render_method\": \"%s\",\n", render_method_names[get_render_method()]);
+    fprintf(out, "  \"shading_method\": \"%s\",\n", shading_method_names[get_shading_method()]);
+    fprintf(out, "  \"cull_method\": \"%s\",\n", cull_method_names[get_cull_method()]);
+    fprintf(out, "  \"depth_clear\": \"%s\",\n", options->depth_epochs ? "tile_epoch" : "full");
+    const brh_pipeline_stats pipeline = get_frame_pipeline_stats();
+    fprintf(out, "  \"pipeline\": {\n");
+    fprintf(out, "    \"depth\": %d,\n", options->pipeline_depth);
+    fprintf(out, "    \"job_workers\": %d,\n", get_job_worker_count());
+    fprintf(out, "    \"window_frames\": %d,\n", pipeline.frames);
+    fprintf(out, "    \"geometry_ms\": %.4f,\n", pipeline.geometry_ms);
+    fprintf(out, "    \"queue_ms\": %.4f,\n", pipeline.queue_ms);
+    fprintf(out, "    \"raster_ms\": %.4f,\n", pipeline.raster_ms);
+    fprintf(out, "    \"latency_ms\": %.4f,\n", pipeline.latency_ms);
+    fprintf(out, "    \"latency_frames\": %.2f\n", pipeline.latency_frames);
+    fprintf(out, "  },\n");
+    fprintf(out, "  \"culling\": {\n");
+    fprintf(out, "    \"occlusion\": %s,\n", options->occlusion ? "true" : "false");
+    fprintf(out, "    \"renderables_per_frame\": %.1f,\n", (double)cull_totals->tested / n);
+    fprintf(out, "    \"frustum_culled_per_frame\": %.1f,\n", (double)cull_totals->frustum_culled / n);
+    fprintf(out, "    \"occlusion_culled_per_frame\": %.1f,\n", (double)cull_totals->occlusion_culled / n);
+    fprintf(out, "    \"clusters_per_frame\": %.1f,\n", (double)cull_totals->clusters_tested / n);
+    fprintf(out, "    \"clusters_culled_per_frame\": %.1f,\n", (double)cull_totals->clusters_culled / n);
+    fprintf(out, "    \"geometry_reused_per_frame\": %.1f\n", (double)cull_totals->geometry_reused / n);
+    fprintf(out, "  },\n");
+    fprintf(out, "  \"level_of_detail\": %s,\n", options->level_of_detail ? "true" : "false");
+    fprintf(out, "  \"shadows\": {\n");
+    fprintf(out, "    \"enabled\": %s,\n", options->shadows ? "true" : "false");
+    fprintf(out, "    \"map_size\": %d,\n", BRH_SHADOW_MAP_SIZE);
+    fprintf(out, "    \"casters_per_frame\": %.1f,\n", (double)shadow_totals->casters / n);
+    fprintf(out, "    \"depth_triangles_per_frame\": %.1f,\n", (double)shadow_totals->triangles / n);
+    fprintf(out, "    \"depth_ms_per_frame\": %.4f,\n", shadow_totals->depth_ms / n);
+    fprintf(out, "    \"depth_triangles_per_second\": %.0f\n",
+        shadow_totals->depth_ms > 0.0 ? (double)shadow_totals->triangles / (shadow_totals->depth_ms / 1000.0) : 0.0);
+    fprintf(out, "  },\n");
+    fprintf(out, "  \"depth_prepass\": {\n");
+    fprintf(out, "    \"enabled\": %s,\n", options->depth_prepass ? "true" : "false");
+    fprintf(out, "    \"shaded_fragments_per_frame\": %.1f,\n", (double)shaded_fragments / n);
+    fprintf(out, "    \"shaded_fragments_per_pixel\": %.3f\n", (double)shaded_fragments / n / ((double)options->width * options->height));
+    fprintf(out, "  },\n");
+    fprintf(out, "  \"visibility_buffer\": {\n");
+    fprintf(out, "    \"enabled\": %s,\n", options->visibility_buffer ? "true" : "false");
+    fprintf(out, "    \"raster_ms_per_frame\": %.4f,\n", visibility_totals->raster_ms / n);
+    fprintf(out, "    \"resolve_ms_per_frame\": %.4f\n", visibility_totals->resolve_ms / n);
+    fprintf(out, "  },\n");
+    fprintf(out, "  \"microbench\": {\n");
+    fprintf(out, "    \"enabled\": %s,\n", options->microbench ? "true" : "false");
+#ifdef BRH_MATH_SSE2
+    fprintf(out, "    \"simd_math\": true,\n");
+#else
+    fprintf(out, "    \"simd_math\": false,\n");
+#endif
+    fprintf(out, "    \"mat4_mul_vec4_ns\": %.3f,\n", micro->mat4_mul_vec4_ns);
+    fprintf(out, "    \"mat4_mul_mat4_ns\": %.3f,\n", micro->mat4_mul_mat4_ns);
+    fprintf(out, "    \"vec3_unit_vector_ns\": %.3f,\n", micro->vec3_unit_vector_ns);
+    fprintf(out, "    \"vec3_cross_ns\": %.3f,\n", micro->vec3_cross_ns);
+    fprintf(out, "    \"geometry_ms_per_frame\": %.4f\n", micro->geometry_ms);
+    fprintf(out, "  },\n");
+    fprintf(out, "  \"local_lights\": {\n");
+    fprintf(out, "    \"count\": %d,\n", light_tiles.light_count);
+    fprintf(out, "    \"tiles\": %d,\n", light_tiles.tile_count);
+    fprintf(out, "    \"lights_per_tile\": %.2f\n",
+        light_tiles.tile_count > 0 ? (double)light_tiles.tile_entries / light_tiles.tile_count : 0.0);
+    fprintf(out, "  },\n");
+    fprintf(out, "  \"frame_ms\": {\n");
+    fprintf(out, "    \"mean\": %.4f,\n", total_ms / n);
+    fprintf(out, "    \"min\": %.4f,\n", sorted[0]);
+    fprintf(out, "    \"p50\": %.4f,\n", percentile(sorted, n, 50.0));
+    fprintf(out, "    \"p90\": %.4f,\n", percentile(sorted, n, 90.0));
+    fprintf(out, "    \"p95\": %.4f,\n", percentile(sorted, n, 95.0));
+    fprintf(out, "    \"p99\": %.4f,\n", percentile(sorted, n, 99.0));
+    fprintf(out, "    \"max\": %.4f\n", sorted[n - 1]);
+    fprintf(out, "  },\n");
+    fprintf(out, "  \"fps_mean\": %.2f,\n", total_seconds > 0.0 ? n / total_seconds : 0.0);
+    fprintf(out, "  \"triangles_per_frame\": %.1f,\n", (double)total_triangles / n);
+    fprintf(out, "  \"triangles_per_second\": %.0f,\n", total_seconds > 0.0 ? (double)total_triangles / total_seconds : 0.0);
+    fprintf(out, "  \"pixels_per_second\": %.0f,\n", total_seconds > 0.0 ? total_pixels / total_seconds : 0.0);
+    fprintf(out, "  \"frame_times_ms\": [");
+    for (int i = 0; i < n; i++) {
+        fprintf(out, "%s%.4f", i == 0 ? "" : ", ", frame_ms[i]);
+    }
+    fprintf(out, "]\n}\n");
+
+    free(sorted);
+    if (out != stdout) fclose(out);
+    return true;
+}
+
+/* --------- Command Line --------- */
+static void print_usage(const char* program)
+{
+    fprintf(stderr,
+        "Usage: %s --scene FILE --path FILE [options]\n"
+        "  --frames N          Measured frames (default 300)\n"
+        "  --warmup N          Unmeasured frames rendered first (default 10)\n"
+        "  --size WIDTHxHEIGHT Render resolution (default 1280x720)\n"
+        "  --output FILE       Write the JSON report to FILE instead of stdout\n"
+        "  --dump FILE         Write the last frame as a PPM image\n"
+        "  --trace FILE        Write a Chrome trace of the measured frames (needs BRH_ENABLE_PROFILER)\n"
+        "  --pipeline-depth N  Frames geometry may run ahead of rasterization, 0-%d (default 0)\n"
+        "  --jobs N            Job worker threads (default: one per core minus one)\n"
+        "  --pin-workers       Pin each job worker to its own logical core\n"
+        "  --depth-epochs      Clear the z-buffer per tile on first use instead of every frame\n"
+        "  --occlusion         Skip renderables hidden behind the scene's occluders\n"
+        "  --lod               Draw simplified meshes for renderables small on screen\n"
+        "  --lod-cache DIR     Read and write generated levels of detail in DIR\n"
+        "  --shadows           Shadow the global light; the report times the depth-only pass on its own\n"
+        "  --depth-prepass     Write depth first, then shade only the visible fragment of each pixel\n"
+        "  --visibility-buffer Write triangle ids first, then shade each pixel once in parallel row bands\n"
+        "  --microbench        Also time vector/matrix operations and the geometry stage on their own\n",
+        program, BRH_PIPELINE_MAX_DEPTH);
+}
+
+static bool parse_options(int argc, char* argv[], bench_options* options)
+{
+    for (int i = 1; i < argc; i++) {
+        const bool has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--scene") == 0 && has_value) {
+            options->scene_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--path") == 0 && has_value) {
+            options->camera_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--frames") == 0 && has_value) {
+            options->frames = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--warmup") == 0 && has_value) {
+            options->warmup_frames = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--size") == 0 && has_value) {
+            if (sscanf(argv[++i], "%dx%d", &options->width, &options->height) != 2) {
+                fprintf(stderr, "Error: Invalid size '%s' (expected WIDTHxHEIGHT)\n", argv[i]);
+                return false;
+            }
+        }
+        else if (strcmp(argv[i], "--output") == 0 && has_value) {
+            options->output_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--dump") == 0 && has_value) {
+            options->dump_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--trace") == 0 && has_value) {
+            options->trace_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--pipeline-depth") == 0 && has_value) {
+            options->pipeline_depth = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--jobs") == 0 && has_value) {
+            options->jobs.worker_count = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--pin-workers") == 0) {
+            options->jobs.pin_workers = true;
+        }
+        else if (strcmp(argv[i], "--depth-epochs") == 0) {
+            options->depth_epochs = true;
+        }
+        else if (strcmp(argv[i], "--occlusion") == 0) {
+            options->occlusion = true;
+        }
+        else if (strcmp(argv[i], "--lod") == 0) {
+            options->level_of_detail = true;
+        }
+        else if (strcmp(argv[i], "--shadows") == 0) {
+            options->shadows = true;
+        }
+        else if (strcmp(argv[i], "--depth-prepass") == 0) {
+            options->depth_prepass = true;
+        }
+        else if (strcmp(argv[i], "--visibility-buffer") == 0) {
+            options->visibility_buffer = true;
+        }
+        else if (strcmp(argv[i], "--microbench") == 0) {
+            options->microbench = true;
+        }
+        else if (strcmp(argv[i], "--lod-cache") == 0 && has_value) {
+            options->lod_cache = argv[++i];
+        }
+        else {
+            return false;
+        }
+    }
+
+    if (!options->scene_path || !options->camera_path) {
+        return false;
+    }
+    if (options->frames <= 0 || options->warmup_frames < 0 || options->width <= 0 || options->height <= 0) {
+        fprintf(stderr, "Error: Frames and size must be positive\n");
+        return false;
+    }
+    if (options->pipeline_depth < 0 || options->pipeline_depth > BRH_PIPELINE_MAX_DEPTH) {
+        fprintf(stderr, "Error: Pipeline depth must be between 0 and %d\n", BRH_PIPELINE_MAX_DEPTH);
+        return false;
+    }
+    // The pipeline must be full before the first measured frame
+    options->warmup_frames = MAX(options->warmup_frames, options->pipeline_depth);
+    return true;
+}
+
+/* --------- Frame --------- */
+// Places the camera at a frame's point on the path and captures the frame's view
+static brh_frame_view build_frame_view(brh_mouse_camera* camera, const brh_mat4* projection_matrix,
+    const bench_camera_path* camera_path, const bench_options* options, int frame)
+{
+    bench_camera_key key = sample_camera_path(camera_path, (float)frame * BENCH_FIXED_DELTA_TIME);
+    set_mouse_camera_position(camera, key.position);
+    set_mouse_camera_rotation(camera, key.yaw, key.pitch);
+
+    const brh_frame_view view = {
+        .camera_matrix = get_mouse_camera_view_matrix(camera),
+        .projection_matrix = *projection_matrix,
+        .camera_position = get_mouse_camera_position(camera),
+        .render_method = get_render_method(),
+        .shading_method = get_shading_method(),
+        .cull_method = get_cull_method(),
+        .viewport_width = get_render_width(),
+        .viewport_height = get_render_height(),
+        .occlusion_culling = options->occlusion,
+        .level_of_detail = options->level_of_detail,
+        .shadows = options->shadows,
+        .depth_prepass = options->depth_prepass,
+        .visibility_buffer = options->visibility_buffer,
+    };
+    return view;
+}
+
+static long long render_frame(brh_mouse_camera* camera, const brh_mat4* projection_matrix,
+    const bench_camera_path* camera_path, const bench_options* options, int frame, brh_cull_stats* cull_totals,
+    brh_shadow_stats* shadow_totals)
+{
+    profiler_begin_frame();
+
+    const brh_frame_view view = build_frame_view(camera, projection_matrix, camera_path, options, frame);
+    submit_frame(&view);
+
+    // Present the oldest finished frame; while the pipeline fills there is none
+    long long triangles = 0;
+    brh_frame_commands* presented = acquire_frame();
+    if (presented) {
+        // Like the application, an unchanged frame is presented again without redrawing
+        if (!is_frame_unchanged(presented) || !is_presented_frame_retained()) {
+            clear_color_buffer(0xFF111111);
+            clear_z_buffer();
+            draw_frame_commands(presented);
+        }
+        render_color_buffer();
+        triangles = presented->triangle_count;
+        if (cull_totals) {
+            cull_totals->tested += presented->cull_stats.tested;
+            cull_totals->frustum_culled += presented->cull_stats.frustum_culled;
+            cull_totals->occlusion_culled += presented->cull_stats.occlusion_culled;
+            cull_totals->clusters_tested += presented->cull_stats.clusters_tested;
+            cull_totals->clusters_culled += presented->cull_stats.clusters_culled;
+            cull_totals->geometry_reused += presented->cull_stats.geometry_reused;
+        }
+        if (shadow_totals) {
+            shadow_totals->casters += presented->shadow_stats.casters;
+            shadow_totals->triangles += presented->shadow_stats.triangles;
+            shadow_totals->depth_ms += presented->shadow_stats.depth_ms;
+        }
+        release_frame(presented);
+    }
+
+    profiler_end_frame();
+    return triangles;
+}
+
+/* --------- Microbenchmarks --------- */
+static brh_mat4 micro_matrices[BENCH_MICRO_INPUTS];
+static brh_mat4 micro_matrix_results[BENCH_MICRO_INPUTS];
+static brh_vector4 micro_vectors4[BENCH_MICRO_INPUTS];
+static brh_vector4 micro_vector4_results[BENCH_MICRO_INPUTS];
+static brh_vector3 micro_vectors3[BENCH_MICRO_INPUTS];
+static brh_vector3 micro_vector3_results[BENCH_MICRO_INPUTS];
+// Keeps the compiler from discarding the timed work
+static volatile float micro_sink;
+
+static double micro_ns_per_call(uint64_t start, uint64_t end)
+{
+    const double calls = (double)BENCH_MICRO_INPUTS * BENCH_MICRO_PASSES;
+    return (double)(end - start) * 1.0e9 / (double)SDL_GetPerformanceFrequency() / calls;
+}
+
+// Times the vector and matrix operations the geometry stage leans on, then the stage itself
+static bench_micro_results run_microbenchmarks(brh_mouse_camera* camera, const brh_mat4* projection_matrix,
+    const bench_camera_path* camera_path, const bench_options* options)
+{
+    bench_micro_results results = { 0 };
+
+    // Deterministic inputs: world matrices and vectors of mixed magnitudes
+    srand(1);
+    for (int i = 0; i < BENCH_MICRO_INPUTS; i++) {
+        const float a = (float)rand() / (float)RAND_MAX * 2.0f - 1.0f;
+        const float b = (float)rand() / (float)RAND_MAX * 2.0f - 1.0f;
+        const float c = (float)rand() / (float)RAND_MAX * 2.0f - 1.0f;
+        micro_matrices[i] = mat4_create_world_matrix((brh_vector3) { c * 10.0f, a * 10.0f, b * 10.0f },
+            (brh_vector3) { a * 3.0f, b * 3.0f, c * 3.0f }, (brh_vector3) { 1.0f + a, 1.0f + b, 1.0f + c });
+        micro_vectors4[i] = (brh_vector4) { a * 10.0f, b * 10.0f, c * 10.0f, 1.0f };
+        micro_vectors3[i] = (brh_vector3) { a + 0.1f, b - 0.1f, c + 0.2f };
+    }
+
+    // Pass p pairs input i with input i + p, so no pass repeats the previous one's work
+    uint64_t start = SDL_GetPerformanceCounter();
+    for (int pass = 0; pass < BENCH_MICRO_PASSES; pass++) {
+        for (int i = 0; i < BENCH_MICRO_INPUTS; i++) {
+            const int j = (i + pass) & (BENCH_MICRO_INPUTS - 1);
+            micro_vector4_results[i] = mat4_mul_vec4(&micro_matrices[i], micro_vectors4[j]);
+        }
+        micro_sink = micro_vector4_results[pass & (BENCH_MICRO_INPUTS - 1)].x;
+    }
+    results.mat4_mul_vec4_ns = micro_ns_per_call(start, SDL_GetPerformanceCounter());
+
+    start = SDL_GetPerformanceCounter();
+    for (int pass = 0; pass < BENCH_MICRO_PASSES; pass++) {
+        for (int i = 0; i < BENCH_MICRO_INPUTS; i++) {
+            const int j = (i + pass) & (BENCH_MICRO_INPUTS - 1);
+            mat4_mul_mat4_ref(&micro_matrices[i], &micro_matrices[j], &micro_matrix_results[i]);
+        }
+        micro_sink = micro_matrix_results[pass & (BENCH_MICRO_INPUTS - 1)].m[0][0];
+    }
+    results.mat4_mul_mat4_ns = micro_ns_per_call(start, SDL_GetPerformanceCounter());
+
+    start = SDL_GetPerformanceCounter();
+    for (int pass = 0; pass < BENCH_MICRO_PASSES; pass++) {
+        for (int i = 0; i < BENCH_MICRO_INPUTS; i++) {
+            const int j = (i + pass) & (BENCH_MICRO_INPUTS - 1);
+            micro_vector3_results[i] = vec3_unit_vector(vec3_add(micro_vectors3[i], micro_vectors3[j]));
+        }
+        micro_sink = micro_vector3_results[pass & (BENCH_MICRO_INPUTS - 1)].x;
+    }
+    results.vec3_unit_vector_ns = micro_ns_per_call(start, SDL_GetPerformanceCounter());
+
+    start = SDL_GetPerformanceCounter();
+    for (int pass = 0; pass < BENCH_MICRO_PASSES; pass++) {
+        for (int i = 0; i < BENCH_MICRO_INPUTS; i++) {
+            const int j = (i + pass) & (BENCH_MICRO_INPUTS - 1);
+            micro_vector3_results[i] = vec3_cross(micro_vectors3[i], micro_vectors3[j]);
+        }
+        micro_sink = micro_vector3_results[pass & (BENCH_MICRO_INPUTS - 1)].x;
+    }
+    results.vec3_cross_ns = micro_ns_per_call(start, SDL_GetPerformanceCounter());
+
+    // The geometry stage over the camera path, into frame slot 0 without building commands
+    const int frames = MAX(1, options->frames);
+    start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < frames; i++) {
+        const brh_frame_view view = build_frame_view(camera, projection_matrix, camera_path, options, i);
+        update_renderables_to_slot(0, &view, NULL, 0);
+    }
+    results.geometry_ms = (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / (double)SDL_GetPerformanceFrequency() / frames;
+
+    return results;
+}
+
+/* --------- Main Function --------- */
+int main(int argc, char* argv[])
+{
+    bench_options options = { 0 };
+    options.width = 1280;
+    options.height = 720;
+    options.frames = 300;
+    options.warmup_frames = 10;
+    options.jobs.worker_count = -1;
+    if (!parse_options(argc, argv, &options)) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    if (!initialize_headless_display(options.width, options.height)) {
+        fprintf(stderr, "Failed to initialize headless display\n");
+        return 1;
+    }
+    if (!initialize_job_system(&options.jobs)) {
+        cleanup_display_resources();
+        return 1;
+    }
+    set_depth_clear_method(options.depth_epochs ? DEPTH_CLEAR_TILE_EPOCH : DEPTH_CLEAR_FULL);
+
+    // Defaults match the interactive application; the scene file may override them
+    set_render_method(RENDER_TEXTURED);
+    set_shading_method(SHADING_GOURAUD);
+    set_cull_method(CULL_BACKFACE);
+    set_global_light_direction((brh_vector3) { 0.0f, -1.0f, 1.0f });
+
+    if (options.lod_cache) {
+        set_mesh_lod_cache_directory(options.lod_cache);
+    }
+
+    static bench_scene scene;
+    static bench_camera_path camera_path;
+    if (!load_scene(options.scene_path, &scene) || !load_camera_path(options.camera_path, &camera_path)) {
+        free_scene(&scene);
+        cleanup_job_system();
+        cleanup_display_resources();
+        return 1;
+    }
+
+    brh_mat4 projection_matrix = mat4_create_perspective_projection(
+        degrees_to_radians(get_frustum_fov_y()),
+        get_aspect_ratio(),
+        get_frustum_near_plane(),
+        get_frustum_far_plane()
+    );
+    brh_mouse_camera* camera = create_mouse_camera((brh_vector3) { 0.0f, 0.0f, 0.0f }, (brh_vector3) { 0.0f, 0.0f, 1.0f }, 5.0f, 0.001f);
+
+    // Timed before the pipeline starts, so no geometry thread competes for frame slot 0
+    bench_micro_results micro = { 0 };
+    if (options.microbench && camera) {
+        micro = run_microbenchmarks(camera, &projection_matrix, &camera_path, &options);
+    }
+
+    // Geometry runs on its own thread when the pipeline depth is non-zero
+    if (!initialize_frame_pipeline(options.pipeline_depth)) {
+        cleanup_job_system();
+        destroy_mouse_camera(camera);
+        free_scene(&scene);
+        cleanup_display_resources();
+        return 1;
+    }
+
+    double* frame_ms = (double*)malloc(sizeof(double) * options.frames);
+    long long* frame_triangles = (long long*)malloc(sizeof(long long) * options.frames);
+    bool ok = camera && frame_ms && frame_triangles;
+    if (!ok) {
+        fprintf(stderr, "Error: Failed to allocate benchmark state\n");
+    }
+
+    if (ok) {
+        // Warm caches and allocators; the camera path restarts at frame 0 for the measured run
+        for (int i = 0; i < options.warmup_frames; i++) {
+            render_frame(camera, &projection_matrix, &camera_path, &options, i, NULL, NULL);
+        }
+
+        if (options.trace_path) {
+            start_profiler_trace(options.trace_path);
+        }
+
+        brh_cull_stats cull_totals = { 0 };
+        brh_shadow_stats shadow_totals = { 0 };
+        const double ticks_to_ms = 1000.0 / (double)SDL_GetPerformanceFrequency();
+        const uint64_t shaded_before = get_shaded_fragment_count();
+        const brh_visibility_stats visibility_before = get_visibility_stats();
+        for (int i = 0; i < options.frames; i++) {
+            const uint64_t start = SDL_GetPerformanceCounter();
+            frame_triangles[i] = render_frame(camera, &projection_matrix, &camera_path, &options, i, &cull_totals, &shadow_totals);
+            frame_ms[i] = (double)(SDL_GetPerformanceCounter() - start) * ticks_to_ms;
+        }
+
+        stop_profiler_trace();
+        const uint64_t shaded_fragments = get_shaded_fragment_count() - shaded_before;
+        brh_visibility_stats visibility_totals = get_visibility_stats();
+        visibility_totals.frames -= visibility_before.frames;
+        visibility_totals.raster_ms -= visibility_before.raster_ms;
+        visibility_totals.resolve_ms -= visibility_before.resolve_ms;
+
+        if (options.dump_path) {
+            ok = write_ppm(options.dump_path, get_color_buffer_ptr(), get_window_width(), get_window_height());
+        }
+        ok = write_report(&options, frame_ms, frame_triangles, &cull_totals, &shadow_totals, shaded_fragments, &visibility_totals, &micro) && ok;
+    }
+
+    cleanup_frame_pipeline();
+    cleanup_job_system();
+    free(frame_ms);
+    free(frame_triangles);
+    destroy_mouse_camera(camera);
+    free_scene(&scene);
+    cleanup_display_resources();
+    return ok ? 0 : 1;
+}
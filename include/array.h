@@ -1,5 +1,7 @@
 #pragma once
 
+#include <stdbool.h>
+
 #define array_push(array, value)                                              \
     do {                                                                      \
         (array) = array_hold((array), 1, sizeof(*(array)));                   \
@@ -9,3 +11,8 @@
 void* array_hold(void* array, int count, int item_size);
 int array_length(void* array);
 void array_free(void* array);
+
+// Grows a plain heap buffer (not one of the arrays above) with its capacity kept by the
+// caller, to hold at least count items, at least doubling it. On failure prints an error
+// naming the items, leaves the buffer and capacity alone and returns false.
+bool reserve_buffer(void** buffer, int* capacity, int count, int item_size, const char* what);
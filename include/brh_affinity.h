@@ -0,0 +1,17 @@
+#pragma once
+
+/*
+* Thread affinity.
+*
+* Kept apart from the job system because pinning a thread on Linux needs _GNU_SOURCE,
+* which also changes what the C headers declare for the rest of a translation unit.
+*/
+
+/**
+ * @brief Restricts the calling thread to one logical core.
+ *
+ * Does nothing on platforms without affinity control.
+ *
+ * @param core Index of the logical core, from 0.
+ */
+void pin_current_thread(int core);
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <stdbool.h>
+#include "brh_matrix.h"
+#include "brh_mesh.h"
+#include "brh_vector.h"
+
+/*
+* Mesh clusters (meshlets).
+*
+* At load time a mesh's faces are grouped into clusters of BRH_CLUSTER_MIN_FACES to
+* BRH_CLUSTER_MAX_FACES connected faces with similar normals, and the face array is reordered
+* so every cluster is a contiguous run. Each cluster keeps a bounding sphere and a normal cone.
+*
+* The geometry stage tests each cluster before transforming any of its vertices. A cluster is
+* rejected when its sphere lies outside a frustum plane, or when, with backface culling on,
+* the camera sees every face in it from behind. For a sphere (c, r) and a cone with axis a and
+* half angle alpha, every face is back-facing from a camera at the origin when
+*
+*     dot(c, a) * cos(alpha) - |cross(c, a)| * sin(alpha) >= r
+*
+* Both tests are conservative: they only reject clusters whose faces the per-face backface
+* test or the clipper would have discarded anyway.
+*/
+
+/** Clusters stop growing at this many faces. */
+#define BRH_CLUSTER_MAX_FACES 128
+/** Clusters keep growing past a sharp normal change until they reach this many faces. */
+#define BRH_CLUSTER_MIN_FACES 64
+
+/*
+* Per-renderable state for cluster tests, computed once per frame.
+*/
+typedef struct {
+    brh_mat4 model_view;     // Model to camera space
+    brh_vector4 planes[6];   // Camera-space frustum planes, normals pointing inward, unit length
+    float radius_scale;      // Largest scale factor of model_view
+    float cone_sign;         // -1 if model_view mirrors, flipping the winding of faces
+    bool test_cones;         // Backface culling is on and model_view scales uniformly
+} brh_cluster_culler;
+
+/**
+ * @brief Partitions a mesh's faces into clusters and reorders the faces to match.
+ *
+ * Replaces any existing clusters. The faces keep their contents; only their order changes.
+ *
+ * @param mesh_data The mesh to partition.
+ *
+ * @return true on success; on failure the mesh is left without clusters.
+ */
+bool build_mesh_clusters(brh_mesh* mesh_data);
+
+/**
+ * @brief Prepares the cluster tests of one renderable for a frame.
+ *
+ * @param culler Receives the prepared state.
+ * @param world_matrix The renderable's world matrix.
+ * @param camera_matrix The frame's view matrix.
+ * @param projection_matrix The frame's projection matrix.
+ * @param cull_backfaces Whether to reject clusters that face away from the camera.
+ */
+void begin_cluster_culling(brh_cluster_culler* culler, const brh_mat4* world_matrix,
+    const brh_mat4* camera_matrix, const brh_mat4* projection_matrix, bool cull_backfaces);
+
+/**
+ * @brief Tests whether any face of a cluster may be visible.
+ *
+ * @param culler State from begin_cluster_culling().
+ * @param cluster The cluster to test.
+ *
+ * @return false if the whole cluster is outside the frustum or back-facing.
+ */
+bool is_cluster_visible(const brh_cluster_culler* culler, const brh_mesh_cluster* cluster);
+
+/**
+ * @brief Maps every vertex of a mesh to the lowest index with the same position.
+ *
+ * OBJ exporters often split vertices along UV and smoothing seams; welding reconnects the
+ * faces on either side for algorithms that walk the surface.
+ *
+ * @param mesh_data The mesh.
+ * @param weld Receives one index per vertex.
+ *
+ * @return false if a temporary buffer could not be allocated.
+ */
+bool weld_mesh_vertices(const brh_mesh* mesh_data, int* weld);
+
+/**
+ * @brief Finds the cluster that contains a face.
+ *
+ * @param mesh_data The mesh.
+ * @param face Index of the face.
+ *
+ * @return Index into mesh_data->clusters, or -1 if the mesh has no clusters.
+ */
+int find_face_cluster(const brh_mesh* mesh_data, int face);
@@ -5,8 +5,11 @@
 #include <stdint.h>
 #include "brh_triangle.h"
 
+/** Default frame rate of FRAME_PACING_FIXED (see brh_pacing.h). */
 #define FPS 60
-#define FRAME_TARGET_TIME (1000 / FPS)
+
+/** Side of the square depth tiles tracked by DEPTH_CLEAR_TILE_EPOCH. */
+#define BRH_DEPTH_TILE_SIZE 32
 
 enum cull_method 
 {
@@ -14,6 +17,45 @@ enum cull_method
     CULL_BACKFACE
 };
 
+/*
+* How clear_z_buffer() resets depth between frames.
+*
+* DEPTH_CLEAR_TILE_EPOCH never clears the whole buffer: clear_z_buffer() only advances a
+* frame epoch, and each BRH_DEPTH_TILE_SIZE tile is cleared the first time the frame
+* touches it (see validate_depth_tiles()). Tiles no triangle reaches are never written.
+*/
+enum depth_clear_method
+{
+    DEPTH_CLEAR_FULL,
+    DEPTH_CLEAR_TILE_EPOCH
+};
+
+/*
+* How render_color_buffer() gets the color buffer into the streaming texture.
+*
+* PRESENT_UPDATE_TEXTURE rasterizes into a CPU buffer and copies it with SDL_UpdateTexture()
+* every frame. PRESENT_LOCKED_TEXTURE keeps the texture locked between presents and
+* rasterizes straight into the locked memory, removing the full-screen copy; its rows may
+* be padded, so code addressing the buffer must use get_color_buffer_pitch(). Headless
+* displays have no texture and always use a CPU buffer.
+*/
+enum present_method
+{
+    PRESENT_UPDATE_TEXTURE,
+    PRESENT_LOCKED_TEXTURE
+};
+
+/**
+ * @brief Callback that receives each finished frame from render_color_buffer().
+ *
+ * @param pixels The ARGB8888 color buffer, tightly packed (width pixels per row).
+ * @param width Width of the frame in pixels.
+ * @param height Height of the frame in pixels.
+ * @param frame Index of the frame, counting from 0 since the display was initialized.
+ * @param user_data The pointer passed to set_frame_sink().
+ */
+typedef void (*brh_frame_sink)(const uint32_t* pixels, int width, int height, int frame, void* user_data);
+
 enum render_method
 {
     RENDER_WIREFRAME,              // Draw only lines
@@ -42,6 +84,36 @@ int get_window_width(void);
 */
 int get_window_height(void);
 
+/**
+ * @brief Gets the width of the internal render resolution.
+ *
+ * The color and z-buffers are drawn only in their top-left get_render_width() x
+ * get_render_height() region, which render_color_buffer() stretches over the window.
+ *
+ * @return The render width in pixels (the window width unless scaled down).
+ */
+int get_render_width(void);
+
+/**
+ * @brief Gets the height of the internal render resolution.
+ *
+ * @return The render height in pixels (the window height unless scaled down).
+ */
+int get_render_height(void);
+
+/**
+ * @brief Sets the internal render resolution, independently of the window size.
+ *
+ * The buffers are not reallocated; only the region drawn and presented changes, so this
+ * is cheap enough to call every frame. Buffer contents are undefined until the next clear.
+ * The projection should keep using get_aspect_ratio(), since the image is stretched back
+ * to the window's shape.
+ *
+ * @param width Render width in pixels, clamped to [1, window width].
+ * @param height Render height in pixels, clamped to [1, window height].
+ */
+void set_render_resolution(int width, int height);
+
 /*
 * @brief Gets the aspect ratio of the SDL window.
 * 
@@ -54,7 +126,9 @@ float get_aspect_ratio(void);
 /*
 * @brief Sets the size of the SDL window.
 *
-* This function sets the size of the SDL window to the specified width and height.
+* This function sets the render resolution. It works with or without an SDL window:
+* the window is resized if it exists, and the color and z-buffers are reallocated if
+* they have already been created.
 *
 * @param width The desired width of the window in pixels.
 * @param height The desired height of the window in pixels.
@@ -83,6 +157,28 @@ bool initialize_window(void);
  */
 bool initialize_display_resources(void);
 
+/**
+ * @brief Initializes a headless display with no SDL window or renderer.
+ *
+ * Only the color buffer and z-buffer are allocated, at the requested resolution.
+ * render_color_buffer() then hands each frame to the frame sink (if any) instead of
+ * presenting it. Use this on machines without a display, e.g. for batch rendering
+ * and benchmarks.
+ *
+ * @param width The render width in pixels.
+ * @param height The render height in pixels.
+ *
+ * @return true if the buffers were successfully allocated, false otherwise.
+ */
+bool initialize_headless_display(int width, int height);
+
+/**
+ * @brief Checks whether the display was initialized in headless mode.
+ *
+ * @return true if running headless, false otherwise.
+ */
+bool is_headless_display(void);
+
 /**
  * @brief Gets the SDL window.
  *
@@ -132,10 +228,41 @@ uint32_t get_color_buffer_at(int x, int y);
 
 /**
  * @brief Gets a direct pointer to the color buffer. Use with caution.
+ *
+ * Rows are get_color_buffer_pitch() pixels apart. The pointer changes after every
+ * render_color_buffer() with PRESENT_LOCKED_TEXTURE, so fetch it again each frame.
+ *
  * @return Pointer to the start of the color buffer, or NULL if not initialized.
 */
 uint32_t* get_color_buffer_ptr(void);
 
+/**
+ * @brief Gets the row stride of the color buffer.
+ *
+ * @return Pixels between the starts of consecutive rows (the window width unless the
+ *         buffer is a locked texture with padded rows). The z-buffer's rows are
+ *         get_render_width() floats apart.
+ */
+int get_color_buffer_pitch(void);
+
+/**
+ * @brief Sets how the color buffer is presented.
+ *
+ * Best called before the display is initialized; switching later discards the contents
+ * of the current color buffer. Falls back to PRESENT_UPDATE_TEXTURE if the texture cannot
+ * be locked.
+ *
+ * @param method PRESENT_UPDATE_TEXTURE (default) or PRESENT_LOCKED_TEXTURE.
+ */
+void set_present_method(enum present_method method);
+
+/**
+ * @brief Gets how the color buffer is presented.
+ *
+ * @return The current present method.
+ */
+enum present_method get_present_method(void);
+
 /**
  * @brief Sets the color buffer at the specified coordinates.
  *
@@ -297,13 +424,55 @@ void draw_grid(int cell_size, uint32_t color);
 /**
  * @brief Renders the color buffer to the screen.
  *
- * This function updates the SDL texture with the contents of the color buffer and
- * renders it to the screen.
+ * This function passes the color buffer to the frame sink (if one is set), then
+ * updates the SDL texture with its contents (or unlocks it, with PRESENT_LOCKED_TEXTURE)
+ * and renders it to the screen. In headless mode only the sink is invoked.
  *
  * @return void
  */
 void render_color_buffer(void);
 
+/**
+ * @brief Whether the color buffer still holds the frame last passed to render_color_buffer().
+ *
+ * True with a CPU color buffer until it is cleared or reallocated; drawing into it without
+ * clearing first is not tracked. Always false with PRESENT_LOCKED_TEXTURE, whose buffer is
+ * relocked after every present. When true, an unchanged frame can be presented again
+ * without being redrawn.
+ *
+ * @return true if the previous frame's pixels are intact.
+ */
+bool is_presented_frame_retained(void);
+
+/**
+ * @brief Sets the callback that receives every finished frame.
+ *
+ * @param sink The callback, or NULL to disable.
+ * @param user_data Pointer passed back to the callback unchanged.
+ *
+ * @return void
+ */
+void set_frame_sink(brh_frame_sink sink, void* user_data);
+
+/**
+ * @brief Writes an ARGB8888 image to disk as a binary PPM (P6) file.
+ *
+ * @param path Destination file path.
+ * @param pixels The tightly packed ARGB8888 pixels.
+ * @param width Width of the image in pixels.
+ * @param height Height of the image in pixels.
+ *
+ * @return true if the file was written, false otherwise.
+ */
+bool write_ppm(const char* path, const uint32_t* pixels, int width, int height);
+
+/**
+ * @brief Frame sink that writes every frame to a numbered PPM file.
+ *
+ * @param user_data A printf-style path pattern taking the frame index, e.g. "frame_%04d.ppm".
+ */
+void ppm_frame_sink(const uint32_t* pixels, int width, int height, int frame, void* user_data);
+
 /**
  * @brief Clears the color buffer with the specified color.
  *
@@ -324,4 +493,33 @@ void clear_color_buffer(uint32_t color);
  *
  * @return void
 */
-void clear_z_buffer(void);
\ No newline at end of file
+void clear_z_buffer(void);
+
+/**
+ * @brief Sets how clear_z_buffer() resets depth between frames.
+ *
+ * @param method DEPTH_CLEAR_FULL (default) or DEPTH_CLEAR_TILE_EPOCH.
+ */
+void set_depth_clear_method(enum depth_clear_method method);
+
+/**
+ * @brief Gets how clear_z_buffer() resets depth between frames.
+ *
+ * @return The current depth clear method.
+ */
+enum depth_clear_method get_depth_clear_method(void);
+
+/**
+ * @brief Makes the depth of a screen rectangle valid for the current frame.
+ *
+ * With DEPTH_CLEAR_TILE_EPOCH, clears every tile overlapping [x0, x1) x [y0, y1) that has
+ * not been touched since the last clear_z_buffer(). Anything that reads or writes the
+ * z-buffer through get_z_buffer_ptr() must call this for the region first. Does nothing
+ * with DEPTH_CLEAR_FULL.
+ *
+ * @param x0 Left edge (inclusive).
+ * @param y0 Top edge (inclusive).
+ * @param x1 Right edge (exclusive).
+ * @param y1 Bottom edge (exclusive).
+ */
+void validate_depth_tiles(int x0, int y0, int x1, int y1);
\ No newline at end of file
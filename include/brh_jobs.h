@@ -0,0 +1,119 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+#include <stdbool.h>
+
+/*
+* Work-stealing job system shared by every stage of the renderer.
+*
+* Each worker thread owns a deque of jobs: it pushes and pops at the bottom (newest first,
+* which keeps its caches warm) and, when its deque is empty, steals from the top of another
+* worker's deque (oldest first, which tends to take the largest remaining pieces of work).
+* Threads that are not workers (the main thread, the pipelined geometry thread) submit to a
+* shared injection deque that every worker steals from.
+*
+* Completion is tracked with job counters, which act as wait-groups: submit_jobs() adds the
+* number of jobs to a counter, each finished job subtracts one, and wait_for_jobs() returns
+* once the counter reaches zero. A thread waiting on a counter executes other jobs instead
+* of sleeping, so nested waits from inside jobs cannot deadlock the pool.
+*
+* Jobs must not depend on the order in which they run. Callers that need deterministic
+* output give each job its own output and combine the results after the wait returns.
+*/
+
+/** Capacity of each deque; jobs submitted to a full deque run on the submitting thread. */
+#define BRH_JOB_DEQUE_SIZE 1024
+/** Maximum number of worker threads. */
+#define BRH_MAX_JOB_WORKERS 64
+/** Maximum number of jobs a single parallel_for() splits its range into. */
+#define BRH_PARALLEL_FOR_MAX_JOBS 256
+
+typedef void (*brh_job_func)(void* data);
+
+/** Function run by parallel_for() on the index range [begin, end). */
+typedef void (*brh_range_func)(void* data, int begin, int end);
+
+typedef struct {
+    brh_job_func func;   // Function to run
+    void* data;          // Argument passed to func
+} brh_job;
+
+/*
+* Number of unfinished jobs of one or more submissions (a wait-group). Zero-initialize
+* before first use; may be reused once wait_for_jobs() has returned.
+*/
+typedef struct {
+    SDL_AtomicInt pending;
+} brh_job_counter;
+
+typedef struct {
+    int worker_count;    // Worker threads, or -1 for one per logical core minus the main thread
+    bool pin_workers;    // Pin worker i to logical core i (core 0 is left to the main thread)
+    bool low_priority;   // Run workers at low thread priority so input and presentation stay responsive
+} brh_job_system_options;
+
+/**
+ * @brief Starts the worker threads.
+ *
+ * @param options Worker count and affinity options, or NULL for defaults
+ *                (one worker per core minus one, not pinned, normal priority).
+ *
+ * @return true if the workers were started, false otherwise.
+ */
+bool initialize_job_system(const brh_job_system_options* options);
+
+/**
+ * @brief Stops and joins the worker threads. No jobs may be in flight.
+ */
+void cleanup_job_system(void);
+
+/**
+ * @brief Gets the number of worker threads.
+ *
+ * @return The number of workers (0 if the job system is not running).
+ */
+int get_job_worker_count(void);
+
+/**
+ * @brief Identifies the calling thread within the pool.
+ *
+ * Useful to index per-thread scratch arrays of get_job_worker_count() + 1 entries.
+ *
+ * @return 1 to get_job_worker_count() on a worker thread, 0 on any other thread.
+ */
+int get_current_job_worker_index(void);
+
+/**
+ * @brief Submits jobs without waiting for them.
+ *
+ * @param jobs The jobs to run. The array is copied; the data the jobs point to must stay
+ *             valid until the counter reaches zero.
+ * @param count Number of jobs.
+ * @param counter Counter incremented by count and decremented as each job finishes (can be NULL).
+ */
+void submit_jobs(const brh_job* jobs, int count, brh_job_counter* counter);
+
+/**
+ * @brief Waits until a counter reaches zero, executing other jobs meanwhile.
+ *
+ * @param counter The counter to wait on.
+ */
+void wait_for_jobs(brh_job_counter* counter);
+
+/**
+ * @brief Runs a batch of jobs and waits for all of them to finish.
+ *
+ * @param jobs The jobs to run.
+ * @param count Number of jobs.
+ */
+void run_jobs(const brh_job* jobs, int count);
+
+/**
+ * @brief Calls func over [0, count) split into ranges of at least grain indices, in parallel.
+ *
+ * @param count Number of indices.
+ * @param grain Minimum number of indices per job.
+ * @param func Function run once per range.
+ * @param data Argument passed to func.
+ */
+void parallel_for(int count, int grain, brh_range_func func, void* data);
@@ -1,6 +1,21 @@
 #pragma once
 
+#include <stdbool.h>
+#include <stdint.h>
 #include "brh_vector.h"
+#include "brh_slot_map.h"
+
+/*
+* Lighting.
+*
+* One directional global light, plus up to BRH_MAX_LOCAL_LIGHTS point and spot lights.
+* Local lights reach only as far as their radius, so each shaded point evaluates a short
+* list of them: brh_light_tiles.h bins the lights into screen tiles every frame, and the
+* shading functions take the list of the tile the point falls in.
+*/
+
+/** Most point and spot lights that can exist at once. */
+#define BRH_MAX_LOCAL_LIGHTS 256
 
 typedef enum shading_method {
     SHADING_NONE,    // No lighting, just use original color/texture (useful debug state)
@@ -18,6 +33,49 @@ typedef struct brh_light {
     int specular_power;     // Shininess factor for specular highlights (higher means sharper)
 } brh_global_light;
 
+typedef enum brh_local_light_type {
+    LIGHT_POINT,    // Shines in all directions
+    LIGHT_SPOT,     // Shines in a cone around its direction
+} brh_local_light_type;
+
+/*
+* A point or spot light. Its contribution falls off smoothly to zero at its radius; a spot
+* light also fades from full strength at inner_angle off its axis to nothing at outer_angle.
+*/
+typedef struct {
+    brh_local_light_type type;
+    brh_vector3 position;   // World-space position
+    brh_vector3 direction;  // Spot lights: direction the cone points in
+    brh_vector3 color;      // RGB intensity (1.0 is as bright as a fully diffuse global light)
+    float radius;           // Distance at which the light fades out completely
+    float inner_angle;      // Spot lights: half angle of full intensity (radians)
+    float outer_angle;      // Spot lights: half angle of the cone (radians)
+} brh_local_light;
+
+// Generational handle to a local light (BRH_NULL_HANDLE for none)
+typedef brh_slot_handle brh_light_handle;
+
+/*
+* A local light prepared for shading, with its derived terms precomputed.
+*/
+typedef struct {
+    brh_vector3 position;
+    brh_vector3 direction;  // Unit cone axis (spot lights)
+    brh_vector3 color;
+    float radius_squared;
+    float cos_inner;        // Spot lights: cosine of inner_angle
+    float cos_outer;        // Spot lights: cosine of outer_angle; -1 for point lights
+} brh_shading_light;
+
+/*
+* The local lights that may reach a point: indices into an array of prepared lights.
+*/
+typedef struct {
+    const brh_shading_light* lights;
+    const uint16_t* indices;
+    int count;
+} brh_light_list;
+
 /*
 * @brief Gets the current shading method.
 *
@@ -65,14 +123,73 @@ void set_global_light_direction(brh_vector3 direction);
 */
 void set_light_parameters(float ambient, float diffuse, float specular, int specular_power);
 
+/**
+ * @brief Adds a point or spot light.
+ *
+ * @param light The light's parameters. Copied; the direction is normalized.
+ * @return A handle to the light, or BRH_NULL_HANDLE if the parameters are invalid or
+ *         BRH_MAX_LOCAL_LIGHTS lights already exist.
+ */
+brh_light_handle create_local_light(const brh_local_light* light);
+
+/**
+ * @brief Replaces the parameters of a local light.
+ *
+ * @param light_handle Handle to the light.
+ * @param light The new parameters.
+ * @return false if the handle is stale or the parameters are invalid.
+ */
+bool set_local_light(brh_light_handle light_handle, const brh_local_light* light);
+
+/**
+ * @brief Removes a local light.
+ *
+ * @param light_handle Handle to the light.
+ */
+void destroy_local_light(brh_light_handle light_handle);
+
+/**
+ * @brief Removes every local light.
+ */
+void cleanup_local_lights(void);
+
+/**
+ * @brief Gets the live local lights, packed.
+ *
+ * The array moves when lights are created or destroyed.
+ *
+ * @param count Receives the number of lights.
+ * @return The lights, or NULL if there are none.
+ */
+const brh_local_light* get_local_lights(int* count);
+
+/**
+ * @brief Gets a number that changes whenever any light changes.
+ *
+ * @return The light version.
+ */
+uint32_t get_light_version(void);
+
+/**
+ * @brief Prepares a local light for the shading functions.
+ *
+ * @param light The light.
+ * @return The light with its derived terms computed.
+ */
+brh_shading_light prepare_shading_light(const brh_local_light* light);
+
 /**
  * @brief Calculates the final color for a face using flat shading.
  *
  * @param face_normal_world The normal vector of the triangle face in world space (normalized).
+ * @param face_pos_world A point of the face in world space (its centroid), for local lights.
  * @param baseColor The original color of the face (e.g., from material or default).
+ * @param local_lights Local lights that may reach the face, or NULL for none.
+ * @param light_visibility Fraction of the global light reaching the face (1 unshadowed, see brh_shadow.h).
  * @return The calculated 32-bit ARGB color.
  */
-uint32_t calculate_flat_shading_color(brh_vector3 face_normal_world, uint32_t baseColor);
+uint32_t calculate_flat_shading_color(brh_vector3 face_normal_world, brh_vector3 face_pos_world, uint32_t baseColor,
+    const brh_light_list* local_lights, float light_visibility);
 
 /**
  * @brief Calculates the final color for a vertex using Gouraud shading components.
@@ -81,9 +198,44 @@ uint32_t calculate_flat_shading_color(brh_vector3 face_normal_world, uint32_t ba
  * @param vertex_pos_world The position of the vertex in world space.
  * @param camera_pos_world The position of the camera (viewer) in world space.
  * @param baseColor The original color of the vertex/face.
+ * @param local_lights Local lights that may reach the vertex, or NULL for none.
+ * @param light_visibility Fraction of the global light reaching the vertex (1 unshadowed).
  * @return The calculated 32-bit ARGB color for this vertex.
  */
-uint32_t calculate_vertex_shading_color(brh_vector3 vertex_normal_world, brh_vector3 vertex_pos_world, brh_vector3 camera_pos_world, uint32_t baseColor);
+uint32_t calculate_vertex_shading_color(brh_vector3 vertex_normal_world, brh_vector3 vertex_pos_world, brh_vector3 camera_pos_world, uint32_t baseColor,
+    const brh_light_list* local_lights, float light_visibility);
+
+/*
+* Vertices to light with calculate_vertex_shading_colors(), as a structure of arrays:
+* vertex i is element i of every array. Four vertices are lit at once with SSE2 where
+* available; the global light's terms are computed for all lanes together and only the
+* local lights, whose lists differ per vertex, are accumulated one vertex at a time.
+*/
+typedef struct {
+    const float* position_x;              // World-space positions
+    const float* position_y;
+    const float* position_z;
+    const float* normal_x;                // World-space normals (normalized again, like calculate_vertex_shading_color())
+    const float* normal_y;
+    const float* normal_z;
+    const uint32_t* base_colors;          // Base ARGB colors
+    const float* light_visibility;        // Fraction of the global light reaching each vertex, or NULL if all are lit
+    const brh_light_list* local_lights;   // Local lights that may reach each vertex, or NULL for none
+    int count;                            // Number of vertices
+} brh_vertex_batch;
+
+/**
+ * @brief Calculates the Gouraud colors of a batch of vertices.
+ *
+ * Gives the same colors as calling calculate_vertex_shading_color() on each vertex, except
+ * that the specular power is raised by repeated squaring instead of powf(), which can move
+ * a highlight's channels by one level.
+ *
+ * @param batch The vertices.
+ * @param camera_pos_world The position of the camera (viewer) in world space.
+ * @param out_colors Receives batch->count ARGB colors.
+ */
+void calculate_vertex_shading_colors(const brh_vertex_batch* batch, brh_vector3 camera_pos_world, uint32_t* out_colors);
 
 /**
  * @brief Calculates the final color for a pixel using Phong shading components.
@@ -92,9 +244,12 @@ uint32_t calculate_vertex_shading_color(brh_vector3 vertex_normal_world, brh_vec
  * @param pixel_pos_world The position of the pixel in world space (can be estimated or interpolated).
  * @param camera_pos_world The position of the camera (viewer) in world space.
  * @param baseColor The base color for the pixel (from texture lookup or face color).
+ * @param local_lights Local lights of the pixel's tile, or NULL for none.
+ * @param light_visibility Fraction of the global light reaching the pixel (1 unshadowed).
  * @return The calculated 32-bit ARGB color for this pixel.
  */
-uint32_t calculate_phong_shading_color(brh_vector3 interpolated_normal_world, brh_vector3 pixel_pos_world, brh_vector3 camera_pos_world, uint32_t baseColor);
+uint32_t calculate_phong_shading_color(brh_vector3 interpolated_normal_world, brh_vector3 pixel_pos_world, brh_vector3 camera_pos_world, uint32_t baseColor,
+    const brh_light_list* local_lights, float light_visibility);
 
 
 /**
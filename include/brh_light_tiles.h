@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stdbool.h>
+#include "brh_light.h"
+#include "brh_matrix.h"
+
+/*
+* Screen-tile light lists.
+*
+* Once per frame the local lights are prepared for shading and binned into a coarse grid of
+* BRH_LIGHT_TILE_SIZE pixel tiles. A light goes into every tile its bounding sphere may
+* cover on screen: the projected bounds of the sphere's bounding box, or every tile if that
+* box reaches behind the near plane. Lights whose bounds miss the screen go nowhere.
+*
+* Every world-space point inside a light's sphere projects into one of the light's tiles,
+* so shading a point with the list of the tile it projects to sees every light that can
+* reach it. Points that project outside the screen (vertices of triangles the clipper will
+* cut) get the list of all lights instead.
+*
+* The lists are rebuilt by build_light_tiles() and read, without locking, by the geometry
+* jobs of the same frame.
+*/
+
+/** Edge length of a light tile in pixels. */
+#define BRH_LIGHT_TILE_SIZE 32
+
+/*
+* How the last build distributed the lights.
+*/
+typedef struct {
+    int light_count;     // Local lights prepared
+    int tile_count;      // Tiles in the grid
+    int tile_entries;    // Sum of the list lengths of all tiles
+} brh_light_tile_stats;
+
+/**
+ * @brief Prepares the local lights and rebuilds the tile lists for a frame.
+ *
+ * @param camera_matrix The frame's view matrix.
+ * @param projection_matrix The frame's projection matrix.
+ * @param viewport_width Width in pixels of the screen the tiles cover.
+ * @param viewport_height Height in pixels.
+ */
+void build_light_tiles(const brh_mat4* camera_matrix, const brh_mat4* projection_matrix,
+    int viewport_width, int viewport_height);
+
+/**
+ * @brief Gets the local lights that may reach a clip-space point.
+ *
+ * @param clip_position The point after the view and projection transforms.
+ * @return The list of the tile the point projects to, the list of all lights if it projects
+ *         outside the screen, or an empty list if there are no local lights.
+ */
+brh_light_list get_light_list_at(brh_vector4 clip_position);
+
+/**
+ * @brief Gets the local lights binned into one tile.
+ *
+ * @param tile_x Column of the tile.
+ * @param tile_y Row of the tile.
+ * @return The tile's list, or an empty list for a tile outside the grid.
+ */
+brh_light_list get_light_tile_list(int tile_x, int tile_y);
+
+/**
+ * @brief Gets the counts of the last build_light_tiles().
+ *
+ * @return The counts.
+ */
+brh_light_tile_stats get_light_tile_stats(void);
+
+/**
+ * @brief Frees the tile lists.
+ */
+void cleanup_light_tiles(void);
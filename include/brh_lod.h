@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdbool.h>
+#include "brh_mesh.h"
+
+/*
+* Level-of-detail generation.
+*
+* Each coarser level halves the face count of the one before it by quadric error metric edge
+* collapse: every vertex accumulates the planes of its faces, and the edge whose collapse onto
+* one of its endpoints moves the surface least is collapsed first. Collapses that would flip
+* a face are skipped, and open edges carry extra planes so silhouettes of open meshes hold.
+*
+* A level only replaces the face list. Its brh_mesh shares the vertex, texcoord and normal
+* arrays of level 0, and each face corner keeps its own texcoord and normal, so levels need
+* no extra vertex memory.
+*
+* Levels can be cached in a binary file keyed by a hash of the source mesh, so later loads of
+* an unchanged mesh skip the simplification.
+*/
+
+/** Levels per mesh, including the full-detail level 0. */
+#define BRH_MAX_LOD_LEVELS 4
+/** No level is generated below this many faces. */
+#define BRH_LOD_MIN_FACES 64
+
+/**
+ * @brief Simplifies a mesh to about a target number of faces.
+ *
+ * @param mesh_data The mesh to simplify.
+ * @param target_faces Desired face count; fewer collapses happen if they would flip faces.
+ *
+ * @return A new dynamic array of faces indexing the mesh's own vertex arrays, or NULL on failure.
+ */
+brh_face* simplify_mesh_faces(const brh_mesh* mesh_data, int target_faces);
+
+/**
+ * @brief Generates (or loads from cache) the coarser levels of a mesh.
+ *
+ * @param mesh_data The full-detail mesh, with its clusters already built.
+ * @param cache_path Cache file to read and update, or NULL to always generate.
+ * @param lods Receives up to BRH_MAX_LOD_LEVELS - 1 levels, finest first.
+ *
+ * @return The number of levels written to lods.
+ */
+int generate_mesh_lods(const brh_mesh* mesh_data, const char* cache_path, brh_mesh* lods[]);
+
+/**
+ * @brief Frees a level returned by generate_mesh_lods(), leaving the shared arrays alone.
+ *
+ * @param lod The level to free.
+ */
+void free_mesh_lod(brh_mesh* lod);
@@ -9,6 +9,11 @@ typedef struct {
     float m[4][4];
 } brh_mat4;
 
+/*
+* The constructors that need trigonometry, and mat4_create_world_matrix(), live in
+* brh_matrix.c; the rest is inline. See brh_vector.h for the SSE2 option.
+*/
+
 /**
  * @brief Creates an identity matrix.
  * 
@@ -23,7 +28,15 @@ typedef struct {
  * 0 0 0 1
  * @endcode
  */
-brh_mat4 mat4_identity(void);
+static inline brh_mat4 mat4_identity(void)
+{
+    brh_mat4 result = { 0 };
+    result.m[0][0] = 1.0f;
+    result.m[1][1] = 1.0f;
+    result.m[2][2] = 1.0f;
+    result.m[3][3] = 1.0f;
+    return result;
+}
 
 /**
  * @brief Creates a scaling matrix.
@@ -42,7 +55,14 @@ brh_mat4 mat4_identity(void);
  *  0  0  0  1
  * @endcode
  */
-brh_mat4 mat4_create_scale(float sx, float sy, float sz);
+static inline brh_mat4 mat4_create_scale(float sx, float sy, float sz)
+{
+    brh_mat4 result = mat4_identity();
+    result.m[0][0] = sx;
+    result.m[1][1] = sy;
+    result.m[2][2] = sz;
+    return result;
+}
 
 /**
  * @brief Creates a translation matrix.
@@ -61,7 +81,14 @@ brh_mat4 mat4_create_scale(float sx, float sy, float sz);
  * 0  0  0  1
  * @endcode
  */
-brh_mat4 mat4_create_translation(float tx, float ty, float tz);
+static inline brh_mat4 mat4_create_translation(float tx, float ty, float tz)
+{
+    brh_mat4 result = mat4_identity();
+    result.m[0][3] = tx;
+    result.m[1][3] = ty;
+    result.m[2][3] = tz;
+    return result;
+}
 
 /**
  * @brief Creates a rotation matrix around the x-axis.
@@ -145,7 +172,27 @@ brh_mat4 mat4_create_perspective_projection(float fov, float aspect_ratio, float
  * @param v The 4D vector.
  * @return The resulting 4D vector.
  */
-brh_vector4 mat4_mul_vec4(const brh_mat4* m, brh_vector4 v);
+static inline brh_vector4 mat4_mul_vec4(const brh_mat4* m, brh_vector4 v)
+{
+    brh_vector4 result;
+#ifdef BRH_MATH_SSE2
+    // Multiply every row by the vector, then transpose the products so each register holds
+    // one term of all four rows; adding the registers in order sums each row left to right
+    const __m128 vector = vec4_load_sse(&v);
+    __m128 term0 = _mm_mul_ps(_mm_loadu_ps(m->m[0]), vector);
+    __m128 term1 = _mm_mul_ps(_mm_loadu_ps(m->m[1]), vector);
+    __m128 term2 = _mm_mul_ps(_mm_loadu_ps(m->m[2]), vector);
+    __m128 term3 = _mm_mul_ps(_mm_loadu_ps(m->m[3]), vector);
+    _MM_TRANSPOSE4_PS(term0, term1, term2, term3);
+    vec4_store_sse(&result, _mm_add_ps(_mm_add_ps(_mm_add_ps(term0, term1), term2), term3));
+#else
+    result.x = m->m[0][0] * v.x + m->m[0][1] * v.y + m->m[0][2] * v.z + m->m[0][3] * v.w;
+    result.y = m->m[1][0] * v.x + m->m[1][1] * v.y + m->m[1][2] * v.z + m->m[1][3] * v.w;
+    result.z = m->m[2][0] * v.x + m->m[2][1] * v.y + m->m[2][2] * v.z + m->m[2][3] * v.w;
+    result.w = m->m[3][0] * v.x + m->m[3][1] * v.y + m->m[3][2] * v.z + m->m[3][3] * v.w;
+#endif
+    return result;
+}
 
 /**
  * @brief Multiplies a 4D vector by a 4x4 matrix and stores the result in the passed in vector.
@@ -153,7 +200,10 @@ brh_vector4 mat4_mul_vec4(const brh_mat4* m, brh_vector4 v);
  * @param m Pointer to the 4x4 matrix.
  * @param v Pointer to the 4D vector.
  */
-void mat4_mul_vec4_ref(const brh_mat4* m, brh_vector4* v);
+static inline void mat4_mul_vec4_ref(const brh_mat4* m, brh_vector4* v)
+{
+    *v = mat4_mul_vec4(m, *v);
+}
 
 /**
  * @brief Multiplies two 4x4 matrices and stores the result in a third matrix.
@@ -163,4 +213,33 @@ void mat4_mul_vec4_ref(const brh_mat4* m, brh_vector4* v);
  * @param b Pointer to the second 4x4 matrix.
  * @param result Pointer to the resulting 4x4 matrix.
  */
-void mat4_mul_mat4_ref(const brh_mat4* a, const brh_mat4* b, brh_mat4* result);
\ No newline at end of file
+static inline void mat4_mul_mat4_ref(const brh_mat4* a, const brh_mat4* b, brh_mat4* result)
+{
+    // Every row of the result is read before any is written, so result may alias a or b
+#ifdef BRH_MATH_SSE2
+    // Row i of B * A is the rows of A weighted by row i of B
+    const __m128 a0 = _mm_loadu_ps(a->m[0]);
+    const __m128 a1 = _mm_loadu_ps(a->m[1]);
+    const __m128 a2 = _mm_loadu_ps(a->m[2]);
+    const __m128 a3 = _mm_loadu_ps(a->m[3]);
+    __m128 rows[4];
+    for (int i = 0; i < 4; i++) {
+        rows[i] = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+            _mm_mul_ps(_mm_set1_ps(b->m[i][0]), a0),
+            _mm_mul_ps(_mm_set1_ps(b->m[i][1]), a1)),
+            _mm_mul_ps(_mm_set1_ps(b->m[i][2]), a2)),
+            _mm_mul_ps(_mm_set1_ps(b->m[i][3]), a3));
+    }
+    for (int i = 0; i < 4; i++) {
+        _mm_storeu_ps(result->m[i], rows[i]);
+    }
+#else
+    brh_mat4 product;
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++) {
+            product.m[i][j] = b->m[i][0] * a->m[0][j] + b->m[i][1] * a->m[1][j] + b->m[i][2] * a->m[2][j] + b->m[i][3] * a->m[3][j];
+        }
+    }
+    *result = product;
+#endif
+}
\ No newline at end of file
@@ -4,6 +4,27 @@
 #include "brh_triangle.h"
 #include "brh_face.h"
 
+/**
+ * @struct brh_mesh_cluster
+ * @brief A contiguous run of a mesh's faces with bounds for culling it as a whole.
+ *
+ * @var brh_mesh_cluster::center, brh_mesh_cluster::radius
+ * Model-space bounding sphere of the cluster's vertices.
+ *
+ * @var brh_mesh_cluster::cone_axis, brh_mesh_cluster::cone_cos, brh_mesh_cluster::cone_sin
+ * Normal cone: every non-degenerate face normal lies within the cone's half angle of the
+ * axis. cone_cos <= 0 means the cone is too wide to ever cull the cluster.
+ */
+typedef struct {
+	int first_face;
+	int face_count;
+	brh_vector3 center;
+	float radius;
+	brh_vector3 cone_axis;
+	float cone_cos;
+	float cone_sin;
+} brh_mesh_cluster;
+
 /**
  * @struct brh_mesh
  * @brief Represents a 3D mesh composed of vertices, texture coordinates, and faces.
@@ -23,6 +44,9 @@
  * @var brh_mesh::faces
  * Dynamic array of `brh_face` structures defining triangles and linking vertex/texcoord indices.
  * 
+ * @var brh_mesh::clusters
+ * Dynamic array of `brh_mesh_cluster` structures partitioning `faces`, in face order (see brh_cluster.h).
+ * 
  * @var brh_mesh::rotation
  * Mesh rotation (Euler angles).
  * 
@@ -37,6 +61,7 @@ typedef struct {
 	brh_texel* texcoords;
 	brh_vector3* normals;
 	brh_face* faces;
+	brh_mesh_cluster* clusters;
 	brh_vector3 scale;
 	brh_vector3 rotation;
 	brh_vector3 translation;
@@ -2,9 +2,10 @@
 
 #include <stdbool.h>
 #include "brh_mesh.h"
+#include "brh_slot_map.h"
 
-// Opaque handle to a mesh (hides implementation details)
-typedef struct brh_mesh_handle_t* brh_mesh_handle;
+// Generational handle to a mesh (BRH_NULL_HANDLE for none); stale handles resolve to nothing
+typedef brh_slot_handle brh_mesh_handle;
 
 /**
  * @brief Initialize the mesh management system
@@ -21,14 +22,21 @@ void cleanup_mesh_system(void);
 /**
  * @brief Load a mesh from an OBJ file
  *
+ * Meshes are cached by path and handedness: loading one that is already loaded returns the
+ * same handle and adds a reference instead of parsing it again. Paths are compared as
+ * given. Shared meshes share their data, including the transform set by set_mesh_position()
+ * and friends.
+ *
  * @param file_path Path to the OBJ file
  * @param is_right_handed Whether the mesh uses right-handed coordinates
- * @return A handle to the loaded mesh, or NULL if loading failed
+ * @return A handle to the loaded mesh, or BRH_NULL_HANDLE if loading failed
  */
 brh_mesh_handle load_mesh(const char* file_path, bool is_right_handed);
 
 /**
- * @brief Unload a mesh and free its resources
+ * @brief Drop one reference to a mesh, freeing it when the last one is dropped
+ *
+ * Call once per successful load_mesh().
  *
  * @param mesh_handle Handle to the mesh to unload
  */
@@ -96,4 +104,36 @@ brh_vector3 get_mesh_scale(brh_mesh_handle mesh_handle);
  * @param mesh_handle Handle to the mesh
  * @return The number of faces, or 0 if invalid handle
  */
-int get_mesh_face_count(brh_mesh_handle mesh_handle);
\ No newline at end of file
+int get_mesh_face_count(brh_mesh_handle mesh_handle);
+
+/**
+ * @brief Set the directory where simplified levels of detail are cached
+ *
+ * Meshes loaded afterwards read their levels from DIRECTORY/<obj file name>-<hash>.lod when
+ * the file matches the mesh, and write it otherwise. The hash is of the full path, so meshes
+ * with the same file name in different directories keep separate files. The directory must
+ * exist.
+ *
+ * @param directory Cache directory, or NULL to simplify every mesh at load time
+ */
+void set_mesh_lod_cache_directory(const char* directory);
+
+/**
+ * @brief Get the number of levels of detail of a mesh
+ *
+ * @param mesh_handle Handle to the mesh
+ * @return The number of levels including the full-detail level 0, or 0 if invalid handle
+ */
+int get_mesh_lod_count(brh_mesh_handle mesh_handle);
+
+/**
+ * @brief Get the mesh structure of one level of detail
+ *
+ * Coarser levels share the vertex, texcoord and normal arrays of level 0 and only have
+ * faces (and clusters) of their own. See brh_lod.h.
+ *
+ * @param mesh_handle Handle to the mesh
+ * @param level Level of detail, 0 for full detail; clamped to the coarsest level
+ * @return Pointer to the mesh structure, or NULL if invalid handle
+ */
+brh_mesh* get_mesh_lod_data(brh_mesh_handle mesh_handle, int level);
\ No newline at end of file
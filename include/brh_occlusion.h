@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdbool.h>
+#include "brh_matrix.h"
+#include "brh_mesh.h"
+#include "brh_vector.h"
+
+/*
+* Software occlusion culling.
+*
+* Each frame, designated occluders are rasterized into a small depth-only buffer with a
+* dedicated kernel that writes no color and interpolates nothing but 1/w. The world-space
+* bounding box of every other renderable is then tested against that buffer, before any of
+* its faces are transformed, so objects hidden behind nearer geometry cost almost nothing.
+*
+* Both sides are conservative. Occluders only cover pixels whose whole area lies inside a
+* triangle, and they store the farthest depth over that area. A box is occluded only if
+* every pixel its screen rectangle touches is covered by something at least as close as
+* the box's nearest corner. Occluder triangles that cross the near plane are skipped, and
+* boxes that cross it are always visible.
+*
+* Depth follows the main z-buffer convention: 1/w, larger is closer, 0 is empty.
+*/
+
+/** Width of the occlusion depth buffer in pixels. */
+#define BRH_OCCLUSION_WIDTH 256
+/** Height of the occlusion depth buffer in pixels. */
+#define BRH_OCCLUSION_HEIGHT 128
+
+enum box_visibility
+{
+    BOX_VISIBLE,            // Possibly visible: process the object
+    BOX_OUTSIDE_FRUSTUM,    // Entirely outside one of the frustum planes
+    BOX_OCCLUDED            // Inside the frustum but hidden behind the occluders
+};
+
+/**
+ * @brief Clears the occlusion buffer and sets the camera of the frame.
+ *
+ * @param view_projection Projection * view matrix of the frame.
+ */
+void begin_occlusion_frame(const brh_mat4* view_projection);
+
+/**
+ * @brief Rasterizes every face of a mesh into the occlusion buffer.
+ *
+ * @param mesh_data The occluder's mesh.
+ * @param world_matrix The occluder's world matrix.
+ */
+void rasterize_occluder(const brh_mesh* mesh_data, const brh_mat4* world_matrix);
+
+/**
+ * @brief Tests a model-space bounding box against the frustum and, optionally, the occluders.
+ *
+ * @param bounds_min Minimum corner of the box in model space.
+ * @param bounds_max Maximum corner of the box in model space.
+ * @param world_matrix Transform from model to world space.
+ * @param test_occlusion Whether to test against the occlusion buffer after the frustum.
+ *
+ * @return Whether the box may be visible, and if not, why.
+ */
+enum box_visibility test_box_visibility(brh_vector3 bounds_min, brh_vector3 bounds_max, const brh_mat4* world_matrix, bool test_occlusion);
+
+/**
+ * @brief Gets the occlusion buffer (for debugging and visualization).
+ *
+ * @return BRH_OCCLUSION_WIDTH * BRH_OCCLUSION_HEIGHT depth values, row by row.
+ */
+const float* get_occlusion_buffer(void);
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+* Frame pacing.
+*
+* All timing uses the nanosecond clock (SDL_GetTicksNS), so a 60 Hz target paces at 60 Hz
+* rather than the 62.5 Hz that whole-millisecond waits produce, and frame deltas are not
+* quantized to milliseconds.
+*
+* FRAME_PACING_FIXED waits with SDL_DelayPrecise() until a deadline that advances by one
+* period per frame, so waits absorb the variation in frame work. A frame that overruns by
+* more than a period restarts the schedule instead of rushing the following frames to catch up.
+* FRAME_PACING_VSYNC enables renderer vsync and lets presentation block; headless displays have
+* nothing to sync to and fall back to FRAME_PACING_FIXED. FRAME_PACING_UNCAPPED never waits.
+*
+* Typical loop:
+*
+*     float delta_seconds = wait_for_next_frame();
+*     ... input, update, render ...
+*/
+
+enum frame_pacing_mode
+{
+    FRAME_PACING_FIXED,      // Sleep until the next multiple of the target period
+    FRAME_PACING_VSYNC,      // Let the renderer block on vertical sync
+    FRAME_PACING_UNCAPPED    // Run as fast as possible
+};
+
+/**
+ * @brief Sets the pacing mode and target rate, and restarts the frame schedule.
+ *
+ * Must be called after the display is initialized, since vsync is a renderer setting.
+ *
+ * @param mode The pacing mode.
+ * @param target_fps Frames per second for FRAME_PACING_FIXED (ignored otherwise).
+ */
+void set_frame_pacing(enum frame_pacing_mode mode, double target_fps);
+
+/**
+ * @brief Gets the pacing mode in effect.
+ *
+ * @return The pacing mode (FRAME_PACING_FIXED when vsync was requested headless).
+ */
+enum frame_pacing_mode get_frame_pacing_mode(void);
+
+/**
+ * @brief Gets the target rate of FRAME_PACING_FIXED.
+ *
+ * @return The target frames per second.
+ */
+double get_frame_pacing_target_fps(void);
+
+/**
+ * @brief Waits until the next frame should start, according to the pacing mode.
+ *
+ * @return Seconds since the previous call returned (0 on the first call).
+ */
+float wait_for_next_frame(void);
+
+/**
+ * @brief Gets the work time of the last frame.
+ *
+ * @return Milliseconds between the previous two waits, excluding the time spent waiting.
+ *         With vsync this includes any time presentation blocked.
+ */
+double get_frame_work_ms(void);
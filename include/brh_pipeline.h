@@ -0,0 +1,163 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "brh_renderable.h"
+
+/*
+* Frame pipeline.
+*
+* A frame is submitted with a snapshot of its camera and render state. The geometry stage
+* (transform, light, clip and pack of every renderable) writes the frame's screen
+* triangles into one of the renderables' frame slots and builds a command list for it;
+* the raster stage later draws that command list and presents it.
+*
+* With a depth of 0 both stages run back to back on the calling thread. With a depth of
+* N > 0 geometry runs on a dedicated thread and may work up to N frames ahead of the frame
+* being rasterized, so the geometry of frame N+1 overlaps the rasterization of frame N.
+* Each extra frame of depth adds one frame of input-to-present latency, so the depth is
+* capped at one frame unless asked otherwise.
+*
+* Only the frame view is captured at submission. The geometry stage reads the scene itself
+* (renderables and their instances, meshes, textures, the global and local lights) while it
+* runs, without locking, and the command lists of queued frames point into the renderables'
+* triangle buffers. So with a depth above 0 the scene may only change while no frame is in
+* flight: call flush_frame_pipeline() first, change the scene, then submit again. This
+* includes setting transforms and lights as well as creating and destroying anything.
+*
+* Typical loop:
+*
+*     submit_frame(&view);
+*     brh_frame_commands* frame = acquire_frame();
+*     if (frame) {
+*         ... clear, draw_frame_commands(frame), present ...
+*         release_frame(frame);
+*     }
+*/
+
+/** Maximum number of frames geometry may run ahead of rasterization. */
+#define BRH_PIPELINE_MAX_DEPTH (BRH_RENDERABLE_FRAME_SLOTS - 1)
+/** Number of frames in the rolling latency window. */
+#define BRH_PIPELINE_HISTORY 60
+
+/*
+* A frame travelling through the pipeline. The command list is written by the geometry
+* stage and only read between acquire_frame() and release_frame().
+*/
+typedef struct {
+    int frame_index;                              // Sequential frame number, from 0
+    int slot;                                     // Renderable frame slot holding the triangles
+    brh_frame_view view;                          // Camera and render state captured at submission
+    brh_draw_command* commands;                   // One entry per renderable with triangles
+    int command_count;
+    int command_capacity;                         // Entries allocated, grown with the renderable count
+    int triangle_count;                           // Total triangles in the command list
+    brh_cull_stats cull_stats;                    // Renderables skipped by frustum and occlusion culling
+    brh_shadow_stats shadow_stats;                // Shadow map work of the frame (zero if not rebuilt)
+    uint32_t scene_version;                       // Equal versions render equal images (see brh_renderable.h)
+    // Latency accounting, in performance-counter ticks
+    uint64_t submit_ticks;                        // Input sampled and frame submitted
+    uint64_t geometry_start_ticks;                // Geometry stage started
+    uint64_t geometry_end_ticks;                  // Command list complete
+    uint64_t raster_start_ticks;                  // Acquired by the raster stage
+    bool geometry_done;
+} brh_frame_commands;
+
+/*
+* Rolling averages over the last BRH_PIPELINE_HISTORY released frames, in milliseconds.
+*/
+typedef struct {
+    double geometry_ms;      // Geometry stage duration
+    double queue_ms;         // Time a finished command list waited for the raster stage
+    double raster_ms;        // Acquire to release (rasterization and presentation)
+    double latency_ms;       // Submission to release: input-to-present latency
+    double latency_frames;   // Frames submitted after this one by the time it was released
+    int frames;              // Number of frames in the window
+} brh_pipeline_stats;
+
+/**
+ * @brief Initializes the frame pipeline.
+ *
+ * @param depth Number of frames geometry may run ahead of rasterization, in [0, BRH_PIPELINE_MAX_DEPTH].
+ *              0 runs both stages serially on the calling thread.
+ *
+ * @return true if the pipeline (and its geometry thread, if any) was started, false otherwise.
+ */
+bool initialize_frame_pipeline(int depth);
+
+/**
+ * @brief Stops the geometry thread and discards frames still in flight.
+ */
+void cleanup_frame_pipeline(void);
+
+/**
+ * @brief Gets the depth the pipeline was initialized with.
+ *
+ * @return The pipeline depth.
+ */
+int get_frame_pipeline_depth(void);
+
+/**
+ * @brief Submits a frame to the geometry stage.
+ *
+ * Runs geometry immediately when the depth is 0, otherwise hands it to the geometry thread
+ * and returns. Blocks only if every frame slot is still in use.
+ *
+ * @param view Camera and render state of the frame. Copied.
+ */
+void submit_frame(const brh_frame_view* view);
+
+/**
+ * @brief Waits for the geometry stage to finish and discards every frame not yet acquired.
+ *
+ * Afterwards no frame is in flight, so the scene may change (see the top of this file).
+ * The pipeline refills over the next submissions, during which acquire_frame() returns
+ * NULL again. Must not be called between acquire_frame() and release_frame().
+ */
+void flush_frame_pipeline(void);
+
+/**
+ * @brief Takes the oldest submitted frame for rasterization.
+ *
+ * Returns NULL while the pipeline is still filling (fewer than depth + 1 frames in flight),
+ * otherwise waits for the frame's geometry to finish.
+ *
+ * @return The frame to rasterize, or NULL if no frame should be presented yet.
+ */
+brh_frame_commands* acquire_frame(void);
+
+/**
+ * @brief Draws every command of a frame into the color and z buffers.
+ *
+ * With the frame's depth_prepass set, drawing takes two passes: the first writes only the
+ * depth of every triangle (see draw_renderable_depth_command()), the second shades with
+ * DEPTH_TEST_EQUAL so each pixel is shaded once, by its visible triangle.
+ *
+ * @param frame A frame returned by acquire_frame().
+ */
+void draw_frame_commands(const brh_frame_commands* frame);
+
+/**
+ * @brief Whether a frame renders the same image as the last released one.
+ *
+ * When it does and the display still holds that image (is_presented_frame_retained()),
+ * the raster stage can present it again instead of clearing and drawing.
+ *
+ * @param frame A frame returned by acquire_frame().
+ * @return true if nothing visible changed since the last released frame.
+ */
+bool is_frame_unchanged(const brh_frame_commands* frame);
+
+/**
+ * @brief Returns a presented frame's slot to the geometry stage and records its latency.
+ *
+ * @param frame The frame returned by acquire_frame().
+ */
+void release_frame(brh_frame_commands* frame);
+
+/**
+ * @brief Gets the rolling pipeline timings.
+ *
+ * @return Averages over the last BRH_PIPELINE_HISTORY released frames.
+ */
+brh_pipeline_stats get_frame_pipeline_stats(void);
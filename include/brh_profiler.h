@@ -0,0 +1,141 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+* Lightweight scoped frame profiler.
+*
+* Zones are recorded with a pair of macros around the code to measure:
+*
+*     BRH_PROFILE_BEGIN(clear_z_buffer);
+*     ...
+*     BRH_PROFILE_END(clear_z_buffer);
+*
+* Recording a zone costs two performance-counter reads and a briefly held spinlock, and is
+* safe from any thread. Completed frames feed per-zone rolling averages (shown by the
+* optional overlay) and, while a trace is active, are streamed to a Chrome trace_event
+* JSON file that can be opened in chrome://tracing or Perfetto.
+*
+* All instrumentation compiles to nothing unless BRH_ENABLE_PROFILER is defined.
+*/
+
+/** Maximum number of zone events recorded per frame; further events are dropped. */
+#define BRH_PROFILER_MAX_EVENTS 4096
+/** Maximum number of distinct zone names tracked for rolling averages. */
+#define BRH_PROFILER_MAX_ZONES 64
+/** Number of frames in the rolling average window. */
+#define BRH_PROFILER_HISTORY 60
+
+#ifdef BRH_ENABLE_PROFILER
+
+/** Starts timing the zone `zone` (an identifier, also used as the zone name). */
+#define BRH_PROFILE_BEGIN(zone) const uint64_t brh_profile_start_##zone = get_profiler_ticks()
+/** Ends the zone started by BRH_PROFILE_BEGIN(zone) and records it. */
+#define BRH_PROFILE_END(zone) record_profiler_zone(#zone, -1, brh_profile_start_##zone, get_profiler_ticks())
+/** Ends the zone started by BRH_PROFILE_BEGIN(zone), tagging it with an integer id (e.g. a renderable id). */
+#define BRH_PROFILE_END_ID(zone, id) record_profiler_zone(#zone, (id), brh_profile_start_##zone, get_profiler_ticks())
+
+#else
+
+#define BRH_PROFILE_BEGIN(zone) ((void)0)
+#define BRH_PROFILE_END(zone) ((void)0)
+#define BRH_PROFILE_END_ID(zone, id) ((void)0)
+
+#endif
+
+/**
+ * @brief Reads the high-resolution performance counter used for zone timestamps.
+ *
+ * @return The current counter value in ticks.
+ */
+static inline uint64_t get_profiler_ticks(void)
+{
+    return SDL_GetPerformanceCounter();
+}
+
+/**
+ * @brief Enables or disables recording at runtime.
+ *
+ * When disabled, recording a zone is a single branch. Recording is enabled by default.
+ *
+ * @param enabled true to record zones, false to ignore them.
+ */
+void set_profiler_enabled(bool enabled);
+
+/**
+ * @brief Checks whether zones are currently being recorded.
+ *
+ * @return true if recording is enabled (and the profiler is compiled in), false otherwise.
+ */
+bool is_profiler_enabled(void);
+
+/**
+ * @brief Records a completed zone.
+ *
+ * Normally called through BRH_PROFILE_END / BRH_PROFILE_END_ID. Thread-safe.
+ *
+ * @param name Zone name. Must stay valid for the life of the program (e.g. a string literal).
+ * @param id Optional integer tag written to the trace, or -1 for none.
+ * @param start_ticks Counter value at the start of the zone.
+ * @param end_ticks Counter value at the end of the zone.
+ */
+void record_profiler_zone(const char* name, int id, uint64_t start_ticks, uint64_t end_ticks);
+
+/**
+ * @brief Marks the start of a frame.
+ */
+void profiler_begin_frame(void);
+
+/**
+ * @brief Marks the end of a frame.
+ *
+ * Folds the frame's zones into the rolling averages and appends them to the trace file
+ * if a trace is active. Must be called on the thread that called profiler_begin_frame().
+ */
+void profiler_end_frame(void);
+
+/**
+ * @brief Starts streaming frames to a Chrome trace_event JSON file.
+ *
+ * @param file_path Path of the trace file to create.
+ *
+ * @return true if the file was opened, false otherwise.
+ */
+bool start_profiler_trace(const char* file_path);
+
+/**
+ * @brief Finishes and closes the trace file, if one is active.
+ */
+void stop_profiler_trace(void);
+
+/**
+ * @brief Gets the rolling average duration of a zone.
+ *
+ * @param name The zone name.
+ *
+ * @return Average time per frame spent in the zone over the last BRH_PROFILER_HISTORY frames, in milliseconds.
+ */
+double get_profiler_zone_average_ms(const char* name);
+
+/**
+ * @brief Shows or hides the on-screen overlay with per-zone rolling averages.
+ *
+ * @param enabled true to show the overlay, false to hide it.
+ */
+void set_profiler_overlay_enabled(bool enabled);
+
+/**
+ * @brief Checks whether the on-screen overlay is shown.
+ *
+ * @return true if the overlay is enabled, false otherwise.
+ */
+bool is_profiler_overlay_enabled(void);
+
+/**
+ * @brief Draws the overlay with SDL debug text. Call after the frame texture is rendered and before presenting.
+ *
+ * @param renderer The SDL renderer to draw with.
+ */
+void draw_profiler_overlay(SDL_Renderer* renderer);
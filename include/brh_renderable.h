@@ -4,9 +4,85 @@
 #include "brh_texture_manager.h"
 #include "brh_matrix.h"
 #include "brh_camera.h"
+#include "brh_display.h"
+#include "brh_light.h"
+#include "brh_shadow.h"
 
-// Opaque handle to a renderable object (hides implementation details)
-typedef struct brh_renderable_handle_t* brh_renderable_handle;
+#define MAX_RENDERABLE_INSTANCES 1024  // Maximum number of instances of one renderable
+
+/*
+* Each renderable keeps one screen-triangle buffer per frame slot, so the geometry for one
+* frame can be written while the triangles of an earlier frame are still being rasterized
+* (see brh_pipeline.h). Slots other than 0 are allocated the first time they are written.
+*
+* A slot remembers the renderable version and view version its triangles were built for.
+* When neither the renderable (transform, instances, occluder flag) nor anything shared by
+* all of them (frame view, global light, occluders under occlusion culling) changed since,
+* the update keeps the slot's triangles and skips the renderable's geometry entirely.
+*/
+#define BRH_RENDERABLE_FRAME_SLOTS 3
+
+/*
+* A renderable can be instanced: it then draws its mesh once per instance, each instance
+* placed relative to the renderable's own transform. Instances share the mesh, bounds,
+* clusters and texture. Their matrices are rebuilt in one pass when they change; each is
+* culled and picks its level of detail on its own, and all of them write into one triangle
+* buffer, so the whole set is a single draw command.
+*/
+
+/*
+* Renderables live packed in a slot map (see brh_slot_map.h), so there is no fixed limit on
+* how many exist and the per-frame pass walks them without gaps. A handle is a generational
+* id: it stops resolving once its renderable is destroyed, and every function given a stale
+* or BRH_NULL_HANDLE handle ignores it.
+*/
+typedef brh_slot_handle brh_renderable_handle;
+
+/*
+* Everything the geometry stage needs to know about a frame. Captured once when the frame
+* is submitted so geometry never reads state that input handling may be changing.
+*/
+typedef struct {
+    brh_mat4 camera_matrix;              // View matrix
+    brh_mat4 projection_matrix;          // Projection matrix
+    brh_vector3 camera_position;         // Camera position in world space (for specular lighting)
+    enum render_method render_method;    // Decides whether texcoords are produced
+    shading_method shading_method;       // Decides how vertex colors are lit
+    enum cull_method cull_method;        // Backface culling on or off
+    int viewport_width;                  // Render resolution the triangles are mapped to
+    int viewport_height;
+    bool occlusion_culling;              // Skip renderables hidden behind occluders
+    bool level_of_detail;                // Draw simplified meshes for renderables small on screen
+    bool shadows;                        // Shadow the global light with a shadow map (brh_shadow.h)
+    bool depth_prepass;                  // Raster only: lay down depth before shading (see draw_frame_commands())
+    bool visibility_buffer;              // Raster only: shade once per pixel from triangle ids (brh_visibility.h)
+} brh_frame_view;
+
+/*
+* How many renderables the geometry stage of a frame skipped before processing any face.
+*/
+typedef struct {
+    int tested;               // Renderables (or instances) whose bounds were tested
+    int frustum_culled;       // Bounds entirely outside the view frustum
+    int occlusion_culled;     // Bounds hidden behind the frame's occluders
+    int clusters_tested;      // Face clusters of the remaining renderables
+    int clusters_culled;      // Clusters outside the frustum or facing away (see brh_cluster.h)
+    int geometry_reused;      // Renderables that kept the triangles of an earlier frame
+} brh_cull_stats;
+
+/*
+* One entry of a frame's command list: the screen triangles one renderable produced for
+* a frame slot. The pointers stay valid until the same slot is written again. The raster
+* stage shades them with the shading method they were built with, not the current one.
+*/
+typedef struct {
+    const brh_screen_triangle* triangles;    // Compact screen-space triangles
+    const brh_screen_texcoords* texcoords;   // Parallel texcoord stream, or NULL if not produced
+    brh_texture_handle texture;              // Texture to sample (can be BRH_NULL_HANDLE)
+    int triangle_count;                      // Number of triangles
+    int renderable_id;                       // Id of the renderable that produced them (for profiling)
+    enum shading_method shading_method;      // Shading method the triangles were built with
+} brh_draw_command;
 
 /**
  * @brief Initialize the renderable object system
@@ -24,8 +100,8 @@ void cleanup_renderable_system(void);
  * @brief Create a renderable object from a mesh and texture
  *
  * @param mesh_handle Handle to the mesh
- * @param texture_handle Handle to the texture (can be NULL for untextured objects)
- * @return A handle to the renderable object, or NULL if creation failed
+ * @param texture_handle Handle to the texture (can be BRH_NULL_HANDLE for untextured objects)
+ * @return A handle to the renderable object, or BRH_NULL_HANDLE if creation failed
  */
 brh_renderable_handle create_renderable(brh_mesh_handle mesh_handle, brh_texture_handle texture_handle); \
 
@@ -34,7 +110,7 @@ brh_renderable_handle create_renderable(brh_mesh_handle mesh_handle, brh_texture
 *
 * @param mesh_file Path to the mesh file
 * @param texture_file Path to the texture file (can be NULL for untextured objects)
-* @return A handle to the renderable object, or NULL if creation failed
+* @return A handle to the renderable object, or BRH_NULL_HANDLE if creation failed
 */
 brh_renderable_handle create_renderable_from_files(const char* mesh_file, const char* texture_file);
 
@@ -45,6 +121,13 @@ brh_renderable_handle create_renderable_from_files(const char* mesh_file, const
  */
 void destroy_renderable(brh_renderable_handle renderable_handle);
 
+/**
+ * @brief Get the number of live renderables
+ *
+ * @return The number of renderables created and not yet destroyed
+ */
+int get_renderable_count(void);
+
 /**
  * @brief Set the position of a renderable object
  *
@@ -69,6 +152,69 @@ void set_renderable_rotation(brh_renderable_handle renderable_handle, brh_vector
  */
 void set_renderable_scale(brh_renderable_handle renderable_handle, brh_vector3 scale);
 
+/**
+ * @brief Mark a renderable as an occluder
+ *
+ * Occluders are rasterized into the occlusion buffer at the start of every frame that has
+ * occlusion culling enabled, and other renderables hidden behind them are skipped.
+ * Occluders themselves are only frustum culled. Large, simple, closed meshes (walls,
+ * floors, buildings) make the best occluders.
+ *
+ * @param renderable_handle Handle to the renderable object
+ * @param is_occluder Whether the renderable hides what is behind it
+ */
+void set_renderable_occluder(brh_renderable_handle renderable_handle, bool is_occluder);
+
+/**
+ * @brief Check whether a renderable is an occluder
+ *
+ * @param renderable_handle Handle to the renderable object
+ * @return true if the renderable is rasterized into the occlusion buffer
+ */
+bool is_renderable_occluder(brh_renderable_handle renderable_handle);
+
+/**
+ * @brief Get the level of detail a renderable was last drawn at
+ *
+ * @param renderable_handle Handle to the renderable object
+ * @return 0 for full detail, higher for coarser levels (see brh_lod.h); the level of the
+ *         first instance for instanced renderables
+ */
+int get_renderable_lod_level(brh_renderable_handle renderable_handle);
+
+/**
+ * @brief Set the number of instances of a renderable
+ *
+ * New instances start at the renderable's own transform. With 0 instances the renderable
+ * draws its mesh once, as if it were not instanced. Triangle buffers grow the next time
+ * each frame slot is written.
+ *
+ * @param renderable_handle Handle to the renderable object
+ * @param instance_count Number of instances, in [0, MAX_RENDERABLE_INSTANCES]
+ * @return true on success, false if the count is out of range or allocation failed
+ */
+bool set_renderable_instance_count(brh_renderable_handle renderable_handle, int instance_count);
+
+/**
+ * @brief Get the number of instances of a renderable
+ *
+ * @param renderable_handle Handle to the renderable object
+ * @return The number of instances, or 0 if the renderable is not instanced
+ */
+int get_renderable_instance_count(brh_renderable_handle renderable_handle);
+
+/**
+ * @brief Set the transform of one instance, relative to the renderable's transform
+ *
+ * @param renderable_handle Handle to the renderable object
+ * @param index Index of the instance
+ * @param position The new position
+ * @param rotation The new rotation (in radians)
+ * @param scale The new scale
+ */
+void set_renderable_instance_transform(brh_renderable_handle renderable_handle, int index,
+    brh_vector3 position, brh_vector3 rotation, brh_vector3 scale);
+
 /**
  * @brief Get the world matrix for a renderable object
  *
@@ -89,17 +235,30 @@ brh_mesh_handle get_renderable_mesh(brh_renderable_handle renderable_handle);
  * @brief Get the texture handle for a renderable object
  *
  * @param renderable_handle Handle to the renderable object
- * @return The texture handle, or NULL if untextured
+ * @return The texture handle, or BRH_NULL_HANDLE if untextured
  */
 brh_texture_handle get_renderable_texture(brh_renderable_handle renderable_handle);
 
 /*
 * * @brief Get the triangles to render for a renderable object
 * 
+* Returns the most recently written frame slot.
+*
+* @param renderable_handle Handle to the renderable object
+* @return Pointer to the array of compact screen-space triangles
+*/
+brh_screen_triangle* get_renderable_triangles(brh_renderable_handle renderable_handle);
+
+/*
+* * @brief Get the texture coordinate stream for the triangles of a renderable object
+*
+* The stream is parallel to the array returned by get_renderable_triangles() and is only
+* produced when the current render method samples a texture.
+*
 * @param renderable_handle Handle to the renderable object
-* @return Pointer to the array of triangles
+* @return Pointer to the texcoord stream, or NULL if no texcoords were produced this frame
 */
-brh_triangle* get_renderable_triangles(brh_renderable_handle renderable_handle);
+brh_screen_texcoords* get_renderable_texcoords(brh_renderable_handle renderable_handle);
 
 /*
 * * @brief Get the number of triangles to render for a renderable object
@@ -110,11 +269,102 @@ brh_triangle* get_renderable_triangles(brh_renderable_handle renderable_handle);
 */
 int get_renderable_triangle_count(brh_renderable_handle renderable_handle);
 
+/**
+ * @brief Draw the triangles produced for a renderable by the last update_renderables() call
+ *
+ * Uses the current render method to choose between filled, textured, wireframe
+ * and vertex-marker output.
+ *
+ * @param renderable_handle Handle to the renderable object
+ */
+void draw_renderable(brh_renderable_handle renderable_handle);
+
+/**
+ * @brief Draw one entry of a frame's command list
+ *
+ * @param command The draw command
+ * @param render_method The render method the frame was built with
+ */
+void draw_renderable_command(const brh_draw_command* command, enum render_method render_method);
+
+/**
+ * @brief Write the depth of a draw command's filled triangles into the z-buffer, with no color
+ *
+ * The first pass of a depth prepass (see draw_prepass_triangle()). Textured draws whose
+ * texture has transparent texels are alpha tested; the rest write depth only. Does nothing
+ * for wireframe render methods.
+ *
+ * @param command The draw command
+ * @param render_method The render method the frame was built with
+ */
+void draw_renderable_depth_command(const brh_draw_command* command, enum render_method render_method);
+
+/**
+ * @brief Write the depth and triangle ids of a draw command into the z-buffer and a visibility buffer
+ *
+ * The first pass of visibility-buffer rendering (see brh_visibility.h). Skips the same
+ * triangles and alpha tests the same textures as draw_renderable_depth_command().
+ *
+ * @param command The draw command
+ * @param render_method The render method the frame was built with
+ * @param id_buffer One id per pixel of the z-buffer
+ * @param first_id Id of the command's first triangle; triangle i gets first_id + i
+ */
+void draw_renderable_visibility_command(const brh_draw_command* command, enum render_method render_method,
+    uint32_t* id_buffer, uint32_t first_id);
+
 /**
  * @brief Update all renderable objects (called once per frame)
  *
+ * Writes frame slot 0 using the current render, shading and cull methods.
+ *
  * @param delta_time Time elapsed since last frame
  * @param camera_matrix The camera view matrix
  * @param projection_matrix The projection matrix
  */
-void update_renderables(float delta_time, brh_mat4 camera_matrix, brh_mat4 projection_matrix,  brh_mouse_camera* camera);
\ No newline at end of file
+void update_renderables(float delta_time, brh_mat4 camera_matrix, brh_mat4 projection_matrix,  brh_mouse_camera* camera);
+
+/**
+ * @brief Run the geometry stage of all renderables into one frame slot and build its command list
+ *
+ * Touches only renderable state and the given slot, so it may run on a worker thread while
+ * other slots are being drawn. Renderables must not be created, destroyed or moved while it runs.
+ *
+ * @param slot Frame slot to write, in [0, BRH_RENDERABLE_FRAME_SLOTS)
+ * @param view Camera and render state of the frame
+ * @param commands Receives one draw command per renderable with triangles (can be NULL)
+ * @param max_commands Capacity of commands
+ * @return The number of draw commands written
+ */
+int update_renderables_to_slot(int slot, const brh_frame_view* view, brh_draw_command* commands, int max_commands);
+
+/**
+ * @brief Get the culling counts of the last update_renderables_to_slot() call
+ *
+ * Only meaningful on the thread that ran the update.
+ *
+ * @return The counts of the last update
+ */
+brh_cull_stats get_renderable_cull_stats(void);
+
+/**
+ * @brief Get the shadow map work of the last update_renderables_to_slot() call
+ *
+ * Only meaningful on the thread that ran the update. All zero if the map was not rebuilt.
+ *
+ * @return The counts and depth pass time of the last update
+ */
+brh_shadow_stats get_renderable_shadow_stats(void);
+
+/**
+ * @brief Get the scene version seen by the last update_renderables_to_slot() call
+ *
+ * The version changes whenever the frame view, the global light, or any renderable's
+ * transform, instances, occluder flag or existence changed since the update before. Two
+ * updates with the same version produce the same image.
+ *
+ * Only meaningful on the thread that ran the update.
+ *
+ * @return The scene version of the last update
+ */
+uint32_t get_renderable_scene_version(void);
\ No newline at end of file
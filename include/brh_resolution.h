@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stdbool.h>
+
+/*
+* Dynamic resolution controller.
+*
+* Software fill cost is proportional to the number of pixels drawn, so the internal render
+* resolution (see set_render_resolution()) is the main lever for holding a frame-time
+* budget. Each frame the controller is fed the time the previous frame's work took,
+* excluding any pacing delay. When the smoothed time leaves the budget it rescales the
+* render size by the square root of the ratio, since the pixel count follows the square
+* of the scale. Steps are limited in size and spaced by a cooldown so the resolution
+* settles instead of oscillating around the target.
+*
+* Typical loop:
+*
+*     update_resolution_controller(last_frame_work_ms);
+*     get_scaled_render_size(&view.viewport_width, &view.viewport_height);
+*     ... geometry for the view ...
+*     set_render_resolution(view.viewport_width, view.viewport_height);
+*     ... clear, rasterize, present ...
+*/
+
+/** Frames to wait after a resolution change before measuring for the next one. */
+#define BRH_RESOLUTION_COOLDOWN_FRAMES 15
+/** Largest change of the scale in a single adjustment. */
+#define BRH_RESOLUTION_MAX_STEP 0.1f
+
+typedef struct {
+    double target_frame_ms;  // Frame-time budget in milliseconds, or 0 to keep the scale fixed
+    float min_scale;         // Smallest fraction of the window size to render at, e.g. 0.5
+    float max_scale;         // Largest fraction (at most 1: the buffers are window-sized)
+} brh_resolution_options;
+
+/**
+ * @brief Configures the controller and resets the scale to max_scale.
+ *
+ * @param options Budget and scale limits, or NULL to disable the controller (scale 1).
+ */
+void initialize_resolution_controller(const brh_resolution_options* options);
+
+/**
+ * @brief Checks whether the controller adjusts the scale automatically.
+ *
+ * @return true if a frame-time budget is set, false otherwise.
+ */
+bool is_resolution_controller_enabled(void);
+
+/**
+ * @brief Feeds the controller the work time of the last frame.
+ *
+ * Does nothing when the controller is disabled.
+ *
+ * @param frame_ms Time spent on the frame's input, geometry, rasterization and
+ *                 presentation, in milliseconds, without pacing delays.
+ */
+void update_resolution_controller(double frame_ms);
+
+/**
+ * @brief Gets the current render scale.
+ *
+ * @return Fraction of the window size to render at, in [min_scale, max_scale].
+ */
+float get_render_scale(void);
+
+/**
+ * @brief Sets the render scale directly (the controller continues from it when enabled).
+ *
+ * @param scale Fraction of the window size, clamped to the configured limits.
+ */
+void set_render_scale(float scale);
+
+/**
+ * @brief Gets the render resolution for the current scale and window size.
+ *
+ * @param width Receives the render width in pixels (at least 1).
+ * @param height Receives the render height in pixels (at least 1).
+ */
+void get_scaled_render_size(int* width, int* height);
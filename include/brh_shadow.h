@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stdbool.h>
+#include "brh_matrix.h"
+#include "brh_mesh.h"
+#include "brh_vector.h"
+
+/*
+* Shadow mapping for the global directional light.
+*
+* Each frame with shadows enabled, every renderable is registered as a caster with its
+* world bounds. The light's view is an orthographic box aligned with the light direction
+* and fitted around all casters, so no caster triangle ever needs clipping. The casters'
+* vertices are transformed into that box in parallel, then the shadow map is filled in
+* parallel horizontal bands by the depth-only triangle kernel (draw_depth_triangle()),
+* which writes no color and interpolates no attributes.
+*
+* The map stores a depth key that grows towards the light: 0 is empty, 1 is the side of
+* the box facing the light. Shading looks points up with percentage-closer filtering: the
+* point is compared against a (2 * BRH_SHADOW_PCF_RADIUS + 1)^2 block of texels and the
+* fraction it is not behind is how much of the global light reaches it. Points are pushed
+* along their normal by about a texel first, so surfaces do not shadow themselves.
+*/
+
+/** Width and height of the shadow map in texels. */
+#define BRH_SHADOW_MAP_SIZE 1024
+/** Texels on each side of the center texel that a lookup compares against. */
+#define BRH_SHADOW_PCF_RADIUS 1
+
+/*
+* Work done by the last build_shadow_map().
+*/
+typedef struct {
+    int casters;              // Draws rasterized into the map
+    int triangles;            // Caster triangles sent to the depth kernel
+    double depth_ms;          // Time spent transforming and rasterizing them
+} brh_shadow_stats;
+
+/**
+ * @brief Starts a new shadow map: forgets the casters and sets the light.
+ *
+ * @param light_direction Direction the global light travels in.
+ */
+void begin_shadow_frame(brh_vector3 light_direction);
+
+/**
+ * @brief Registers a draw that casts shadows.
+ *
+ * @param mesh_data The caster's mesh. Must stay alive until build_shadow_map() returns.
+ * @param world_matrix The caster's world matrix (copied).
+ * @param bounds_min Minimum corner of the mesh's model-space bounding box.
+ * @param bounds_max Maximum corner.
+ */
+void add_shadow_caster(const brh_mesh* mesh_data, const brh_mat4* world_matrix, brh_vector3 bounds_min, brh_vector3 bounds_max);
+
+/**
+ * @brief Fits the light's view around the casters and renders their depth into the shadow map.
+ *
+ * Runs on the job system. With no casters the map is left empty and lights everything.
+ */
+void build_shadow_map(void);
+
+/**
+ * @brief Gets how much of the global light reaches a point, with percentage-closer filtering.
+ *
+ * @param position World-space position of the point.
+ * @param normal Unit world-space normal at the point.
+ *
+ * @return 1 if the point is fully lit, 0 if fully in shadow. Points outside the light's
+ *         view are lit.
+ */
+float sample_shadow_map(brh_vector3 position, brh_vector3 normal);
+
+/**
+ * @brief Gets the counts and timing of the last build_shadow_map().
+ *
+ * @return The counts.
+ */
+brh_shadow_stats get_shadow_stats(void);
+
+/**
+ * @brief Gets the shadow map (for debugging and visualization).
+ *
+ * @return BRH_SHADOW_MAP_SIZE * BRH_SHADOW_MAP_SIZE depth keys, row by row, or NULL
+ *         before the first build.
+ */
+const float* get_shadow_map(void);
+
+/**
+ * @brief Frees the shadow map and the caster lists.
+ */
+void cleanup_shadow_map(void);
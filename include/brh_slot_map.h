@@ -0,0 +1,104 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+* Generational slot map.
+*
+* Stores items of one type in a dense, growable array and hands out 32-bit handles. A handle
+* packs a slot index (low BRH_SLOT_INDEX_BITS bits) and a generation (the high bits). Each
+* slot records where its item currently sits in the dense array and the generation of that
+* item. Removing an item bumps its slot's generation, so handles to removed items no longer
+* resolve, even after the slot is reused. Generations skip 0, so BRH_NULL_HANDLE never
+* resolves. After 2^BRH_SLOT_GENERATION_BITS - 1 reuses of one slot a generation repeats.
+*
+* Free slots form a list threaded through the slot table, so insertion is O(1). Removal moves
+* the last item into the hole, so live items stay contiguous and iterating over them touches
+* no gaps. Item addresses change when other items are inserted or removed: keep handles, not
+* pointers, across those calls.
+*
+* A zero-initialized map is unusable; initialize it with BRH_SLOT_MAP_INIT() or
+* initialize_slot_map().
+*/
+
+typedef uint32_t brh_slot_handle;
+
+/** The handle that never refers to an item. */
+#define BRH_NULL_HANDLE 0u
+/** Bits of a handle that hold the slot index. */
+#define BRH_SLOT_INDEX_BITS 20
+/** Bits of a handle that hold the generation. */
+#define BRH_SLOT_GENERATION_BITS 12
+/** Most items one map can hold. */
+#define BRH_SLOT_MAP_MAX_ITEMS (1 << BRH_SLOT_INDEX_BITS)
+
+typedef struct {
+    unsigned char* items;     // Dense array of live items, item_size bytes each
+    uint32_t* item_slots;     // Slot of each dense item
+    uint32_t* slot_entries;   // Per slot: dense index of its item, or the next free slot
+    uint16_t* generations;    // Per slot: generation of its current (or next) item
+    int item_size;
+    int count;                // Live items
+    int slot_count;           // Slots created so far
+    int capacity;             // Items and slots allocated
+    int free_slot;            // Head of the free slot list, or -1
+} brh_slot_map;
+
+/** Static initializer for an empty map of items of item_size bytes. */
+#define BRH_SLOT_MAP_INIT(size) { NULL, NULL, NULL, NULL, (int)(size), 0, 0, 0, -1 }
+
+/**
+ * @brief Initializes an empty map.
+ *
+ * @param map The map.
+ * @param item_size Size of one item in bytes.
+ */
+void initialize_slot_map(brh_slot_map* map, int item_size);
+
+/**
+ * @brief Frees the map's arrays. Items are not visited; remove them first if they own resources.
+ *
+ * @param map The map, left empty and ready for reuse.
+ */
+void cleanup_slot_map(brh_slot_map* map);
+
+/**
+ * @brief Adds a zero-filled item.
+ *
+ * @param map The map.
+ * @param handle Receives the item's handle.
+ *
+ * @return The new item, or NULL if the map is full or could not grow.
+ */
+void* insert_slot_map_item(brh_slot_map* map, brh_slot_handle* handle);
+
+/**
+ * @brief Removes an item, moving the last item into its place.
+ *
+ * @param map The map.
+ * @param handle Handle of the item.
+ *
+ * @return false if the handle does not refer to a live item.
+ */
+bool remove_slot_map_item(brh_slot_map* map, brh_slot_handle handle);
+
+/**
+ * @brief Resolves a handle.
+ *
+ * @param map The map.
+ * @param handle Handle of the item.
+ *
+ * @return The item, or NULL if the handle is stale, null or from another map's range.
+ */
+void* get_slot_map_item(const brh_slot_map* map, brh_slot_handle handle);
+
+/**
+ * @brief Gets the handle of the item at a position of the dense array.
+ *
+ * @param map The map.
+ * @param index Position in [0, map->count).
+ *
+ * @return The item's handle.
+ */
+brh_slot_handle get_slot_map_handle_at(const brh_slot_map* map, int index);
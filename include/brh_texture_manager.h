@@ -2,9 +2,10 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include "brh_slot_map.h"
 
-// Opaque handle to a texture (hides implementation details)
-typedef struct brh_texture_handle_t* brh_texture_handle;
+// Generational handle to a texture (BRH_NULL_HANDLE for none); stale handles resolve to nothing
+typedef brh_slot_handle brh_texture_handle;
 
 /**
  * @brief Initialize the texture management system
@@ -30,13 +31,19 @@ void cleanup_texture_system(void);
 /**
  * @brief Load a texture from a PNG file
  *
+ * Textures are cached by path: loading a file that is already loaded returns the same
+ * handle and adds a reference instead of decoding it again. Paths are compared as given,
+ * so two spellings of one file load it twice.
+ *
  * @param file_path Path to the PNG file
- * @return A handle to the loaded texture, or NULL if loading failed
+ * @return A handle to the loaded texture, or BRH_NULL_HANDLE if loading failed
  */
 brh_texture_handle load_texture(const char* file_path);
 
 /**
- * @brief Unload a texture and free its resources
+ * @brief Drop one reference to a texture, freeing it when the last one is dropped
+ *
+ * Call once per successful load_texture().
  *
  * @param texture_handle Handle to the texture to unload
  */
@@ -64,4 +71,14 @@ int get_texture_width(brh_texture_handle texture_handle);
  * @param texture_handle Handle to the texture
  * @return The height of the texture, or 0 if invalid handle
  */
-int get_texture_height(brh_texture_handle texture_handle);
\ No newline at end of file
+int get_texture_height(brh_texture_handle texture_handle);
+
+/**
+ * @brief Check whether every texel of a texture is opaque
+ *
+ * The texture kernels leave pixels under texels with zero alpha untouched.
+ *
+ * @param texture_handle Handle to the texture
+ * @return true if no texel has zero alpha, false if some do or the handle is invalid
+ */
+bool is_texture_opaque(brh_texture_handle texture_handle);
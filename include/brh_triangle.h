@@ -1,8 +1,10 @@
 #pragma once
 
+#include <stdbool.h>
 #include <stdint.h>
 #include "brh_vector.h" 
 #include "brh_texture_manager.h"
+#include "brh_light.h"
 
 /*
 * @struct brh_texel
@@ -93,6 +95,78 @@ typedef struct {
     uint32_t color;
 } brh_triangle;
 
+/*
+* Depth test of the color kernels.
+*
+* DEPTH_TEST_GREATER shades a fragment that is closer than the z-buffer (a larger inv_w) and
+* stores its depth. DEPTH_TEST_EQUAL shades only fragments whose depth equals the z-buffer:
+* after draw_prepass_triangle() has written the depth of every triangle, exactly the visible
+* surface of each pixel passes, so no pixel is shaded and then overwritten.
+*/
+enum depth_test
+{
+    DEPTH_TEST_GREATER,
+    DEPTH_TEST_EQUAL,
+    DEPTH_TEST_ALWAYS        // Shade every fragment (the visibility resolve already knows the winner)
+};
+
+/** Number of fractional bits used for snapped screen-space coordinates (28.4 fixed point). */
+#define BRH_SUBPIXEL_BITS 4
+/** One pixel expressed in subpixel units. */
+#define BRH_SUBPIXEL_ONE (1 << BRH_SUBPIXEL_BITS)
+
+/**
+ * @struct brh_screen_vertex
+ * @brief A single post-setup vertex as consumed by the raster stage.
+ *
+ * Exactly 16 bytes so that a vertex fills one SSE register / one quarter of a cache line.
+ *
+ * @var brh_screen_vertex::x
+ * Screen-space X in 28.4 fixed point (BRH_SUBPIXEL_BITS fractional bits).
+ * @var brh_screen_vertex::y
+ * Screen-space Y in 28.4 fixed point (BRH_SUBPIXEL_BITS fractional bits).
+ * @var brh_screen_vertex::inv_w
+ * 1/w from clip space, used for depth testing and perspective-correct interpolation.
+ * @var brh_screen_vertex::color
+ * ARGB vertex color. Holds the lit vertex color for Gouraud shading, the flat-shaded
+ * face color for flat shading, and the unlit base color otherwise.
+ */
+typedef struct {
+    int32_t x;
+    int32_t y;
+    float inv_w;
+    uint32_t color;
+} brh_screen_vertex;
+
+/**
+ * @struct brh_screen_triangle
+ * @brief Compact screen-space triangle produced at the end of the geometry stage.
+ *
+ * This replaces the full `brh_triangle` (~136 bytes) between geometry and raster with a
+ * 48-byte record holding only what every raster mode needs. Attributes that only some
+ * modes need are stored in parallel streams indexed by the same triangle index
+ * (see `brh_screen_texcoords`), and are only written when the active mode reads them.
+ *
+ * @var brh_screen_triangle::vertices
+ * The three screen-space vertices, in the winding order produced by clipping.
+ */
+typedef struct {
+    brh_screen_vertex vertices[3];
+} brh_screen_triangle;
+
+/**
+ * @struct brh_screen_texcoords
+ * @brief Per-triangle texture coordinate stream, parallel to an array of `brh_screen_triangle`.
+ *
+ * Only produced when the active render method samples a texture.
+ *
+ * @var brh_screen_texcoords::texels
+ * The (u, v) texture coordinates of each of the three vertices.
+ */
+typedef struct {
+    brh_texel texels[3];
+} brh_screen_texcoords;
+
 /* Function Prototypes */
 
 /**
@@ -101,33 +175,136 @@ typedef struct {
  * Uses the DDA line algorithm (or potentially Bresenham) to draw the three
  * edges connecting the triangle's vertices.
  *
- * @param triangle Pointer to the constant triangle data to draw. Using a pointer
- *                 is more efficient than passing the struct by value.
+ * @param triangle Pointer to the constant screen-space triangle to draw.
  * @param color The 32-bit color (e.g., ARGB) for the outline.
  */
-void draw_triangle_outline(const brh_triangle* triangle, uint32_t color);
+void draw_triangle_outline(const brh_screen_triangle* triangle, uint32_t color);
 
 /**
  * @brief Draws a solid-colored filled triangle.
  *
- * Uses a scanline rasterization algorithm (flat-top/flat-bottom decomposition)
- * to fill the triangle's area with a single color.
+ * Uses a fixed-point (28.4) scanline edge walker with a top-left fill rule, so
+ * pixels on edges shared with adjacent triangles are filled exactly once. The fill
+ * color comes from the vertex colors, which the geometry stage sets according to
+ * the shading method the triangle was built with.
  *
- * @param triangle Pointer to the triangle data. Coordinates might be modified
- *                 internally for sorting, hence not const.
- * @param color The 32-bit color (e.g., ARGB) to fill the triangle with.
+ * @param triangle Pointer to the constant screen-space triangle to draw.
+ * @param shading The shading method the triangle was built with (see brh_draw_command).
  */
-void draw_filled_triangle(brh_triangle* triangle, uint32_t color);
+void draw_filled_triangle(const brh_screen_triangle* triangle, enum shading_method shading);
 
 /**
  * @brief Draws a textured triangle.
  *
- * Uses scanline rasterization with barycentric interpolation of texture
- * coordinates to map a texture onto the triangle's area.
- * Note: Basic implementation uses linear interpolation, not perspective-correct.
+ * Uses the same fixed-point edge walker as draw_filled_triangle(), with
+ * perspective-correct interpolation of texture coordinates from per-triangle
+ * plane-equation gradients.
+ *
+ * @param triangle Pointer to the constant screen-space triangle to draw.
+ * @param texcoords Texture coordinates for this triangle (from the parallel texcoord stream).
+ * @param texture Handle of the texture to sample.
+ * @param shading The shading method the triangle was built with.
+ */
+void draw_textured_triangle(const brh_screen_triangle* triangle, const brh_screen_texcoords* texcoords, brh_texture_handle texture,
+    enum shading_method shading);
+
+/**
+ * @brief Writes the depth of a triangle into a depth buffer, with no color and no other attributes.
+ *
+ * Walks the same edges with the same fill rule as the color kernels, but interpolates only
+ * the vertex inv_w values and keeps, per pixel, the larger (closer) of the buffer and the
+ * triangle. For a perspective camera the written values match the color kernels' bit for
+ * bit. Any depth that is affine in screen space can be passed in inv_w instead, such as
+ * the depth of an orthographic view.
+ *
+ * @param triangle Pointer to the constant screen-space triangle to draw.
+ * @param depth_buffer width * height depth values, row by row; 0 is empty.
+ * @param width Width of the buffer in pixels.
+ * @param height Height of the buffer in pixels.
+ * @param row_begin First row to write, so a buffer can be split into bands filled in parallel.
+ * @param row_end One past the last row to write.
+ */
+void draw_depth_triangle(const brh_screen_triangle* triangle, float* depth_buffer, int width, int height, int row_begin, int row_end);
+
+/**
+ * @brief Writes the depth of a triangle into the display's z-buffer, with no color.
+ *
+ * The depth prepass of a frame: the z-buffer ends up holding the depth the color kernels
+ * compute for the closest triangle of each pixel, bit for bit, so a second pass with
+ * DEPTH_TEST_EQUAL shades each pixel once. Opaque triangles interpolate nothing but depth.
+ * Triangles whose texture has transparent texels also sample the texture and skip the
+ * texels the texture kernels skip, so what shows through them keeps its depth.
+ *
+ * @param triangle Pointer to the constant screen-space triangle to draw.
+ * @param texcoords Texture coordinates of an alpha-tested triangle, or NULL if it is opaque.
+ * @param texture Texture of an alpha-tested triangle, or BRH_NULL_HANDLE if it is opaque.
+ */
+void draw_prepass_triangle(const brh_screen_triangle* triangle, const brh_screen_texcoords* texcoords, brh_texture_handle texture);
+
+/**
+ * @brief Writes the depth and id of a triangle into the z-buffer and a visibility buffer.
+ *
+ * The first pass of visibility-buffer rendering. Works like draw_prepass_triangle(), and
+ * wherever the triangle ends up closest also stores its id, so after every triangle is
+ * drawn each pixel names the triangle visible in it.
+ *
+ * @param triangle Pointer to the constant screen-space triangle to draw.
+ * @param texcoords Texture coordinates of an alpha-tested triangle, or NULL if it is opaque.
+ * @param texture Texture of an alpha-tested triangle, or BRH_NULL_HANDLE if it is opaque.
+ * @param id_buffer One id per pixel of the z-buffer, row by row.
+ * @param id The id to store; 0 is best kept for "no triangle".
+ */
+void draw_visibility_triangle(const brh_screen_triangle* triangle, const brh_screen_texcoords* texcoords, brh_texture_handle texture,
+    uint32_t* id_buffer, uint32_t id);
+
+/**
+ * @brief Shades pixels [x_start, x_end) of row y with a triangle's attributes, with no depth test.
+ *
+ * The second pass of visibility-buffer rendering. The attributes are interpolated from the
+ * triangle's plane equations at the first pixel, then stepped exactly as the color kernels
+ * step them, with the shading method the triangle was built with. Safe to call from several threads at once for
+ * different rows.
+ *
+ * @param triangle Pointer to the constant screen-space triangle visible in the pixels.
+ * @param texcoords Texture coordinates for this triangle, or NULL to fill it.
+ * @param texture Texture to sample, or BRH_NULL_HANDLE to fill it.
+ * @param shading The shading method the triangle was built with.
+ * @param y Row of the pixels.
+ * @param x_start First pixel.
+ * @param x_end One past the last pixel.
+ * @param shaded_fragments Counter the shaded pixels are added to (not the global one, which
+ *        is not thread safe; see record_shaded_fragments()).
+ */
+void shade_visibility_span(const brh_screen_triangle* triangle, const brh_screen_texcoords* texcoords, brh_texture_handle texture,
+    enum shading_method shading, int y, int x_start, int x_end, uint64_t* shaded_fragments);
+
+/**
+ * @brief Sets the depth test of draw_filled_triangle() and draw_textured_triangle().
+ *
+ * @param test The depth test to use. Defaults to DEPTH_TEST_GREATER.
+ */
+void set_depth_test(enum depth_test test);
+
+/**
+ * @brief Gets the depth test of the color kernels.
+ *
+ * @return The current depth test.
+ */
+enum depth_test get_depth_test(void);
+
+/**
+ * @brief Gets how many fragments the color kernels have shaded since startup.
+ *
+ * A fragment is shaded when it passes the depth test and its color is computed, whether or
+ * not a later triangle overwrites it. Subtract two readings to count the fragments of a frame.
+ *
+ * @return The running count.
+ */
+uint64_t get_shaded_fragment_count(void);
+
+/**
+ * @brief Adds fragments shaded outside the color kernels' own counting to the running count.
  *
- * @param triangle Pointer to the triangle data. Coordinates might be modified
- *                 internally for sorting, hence not const.
- * @param texture Pointer to the loaded texture data (array of uint32_t colors).
+ * @param count Fragments shaded, such as the total of a parallel visibility resolve.
  */
-void draw_textured_triangle(brh_triangle* triangle, brh_texture_handle texture);
\ No newline at end of file
+void record_shaded_fragments(uint64_t count);
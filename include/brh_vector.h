@@ -1,5 +1,26 @@
 #pragma once
 
+#include <math.h>
+
+/*
+* Vectors.
+*
+* The small operations are defined here as static inline functions, so hot loops in any
+* translation unit can inline them instead of calling out to pass structs by value. Only
+* the trigonometric ones (rotations and angles) live in brh_vector.c.
+*
+* With BRH_ENABLE_SIMD_MATH defined (the CMake option of the same name, on by default) and
+* SSE2 available, brh_vector4 and brh_mat4 operations run on SSE registers. The structs
+* keep their layout and alignment, so matrix rows are read with unaligned loads, and every
+* lane adds its terms in the same order as the scalar code: both builds give bit-identical
+* results.
+*/
+
+#if defined(BRH_ENABLE_SIMD_MATH) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define BRH_MATH_SSE2
+#include <emmintrin.h>
+#endif
+
 // ============================================================================
 // Vector2 Structure and Functions
 // ============================================================================
@@ -31,6 +52,24 @@ typedef struct {
     float w;
 } brh_vector4;
 
+#ifdef BRH_MATH_SSE2
+/**
+ * Loads a brh_vector4 into an SSE register. Built from the fields rather than with one
+ * 16-byte load, since vectors are usually just written field by field and a wide load of
+ * them would stall on store forwarding.
+ */
+static inline __m128 vec4_load_sse(const brh_vector4* v)
+{
+    return _mm_set_ps(v->w, v->z, v->y, v->x);
+}
+
+/** Stores an SSE register into a brh_vector4. */
+static inline void vec4_store_sse(brh_vector4* v, __m128 value)
+{
+    _mm_storeu_ps(&v->x, value);
+}
+#endif
+
 /**
  * @brief Creates a `brh_vector2` instance with the specified x and y components.
  *
@@ -39,14 +78,21 @@ typedef struct {
  *
  * @return A `brh_vector2` instance with the specified components.
  */
-brh_vector2 vec2_create(float x, float y);
+static inline brh_vector2 vec2_create(float x, float y)
+{
+    brh_vector2 v = { .x = x, .y = y };
+    return v;
+}
 
 /**
  * @brief Calculate the magnitude of a 2D vector.
  * @param v The vector.
  * @return The magnitude of the vector.
  */
-float vec2_magnitude(brh_vector2 v);
+static inline float vec2_magnitude(brh_vector2 v)
+{
+    return sqrtf(v.x * v.x + v.y * v.y);
+}
 
 /**
  * @brief Add two 2D vectors.
@@ -54,7 +100,11 @@ float vec2_magnitude(brh_vector2 v);
  * @param b The second vector.
  * @return The result of the addition.
  */
-brh_vector2 vec2_add(brh_vector2 a, brh_vector2 b);
+static inline brh_vector2 vec2_add(brh_vector2 a, brh_vector2 b)
+{
+    brh_vector2 sum = { .x = a.x + b.x, .y = a.y + b.y };
+    return sum;
+}
 
 /**
  * @brief Subtract one 2D vector from another.
@@ -62,7 +112,11 @@ brh_vector2 vec2_add(brh_vector2 a, brh_vector2 b);
  * @param b The second vector.
  * @return The result of the subtraction.
  */
-brh_vector2 vec2_subtract(brh_vector2 a, brh_vector2 b);
+static inline brh_vector2 vec2_subtract(brh_vector2 a, brh_vector2 b)
+{
+    brh_vector2 difference = { .x = a.x - b.x, .y = a.y - b.y };
+    return difference;
+}
 
 /**
  * @brief Scale a 2D vector by a scalar.
@@ -70,20 +124,34 @@ brh_vector2 vec2_subtract(brh_vector2 a, brh_vector2 b);
  * @param scalar The scalar value.
  * @return The scaled vector.
  */
-brh_vector2 vec2_scale(brh_vector2 v, float scalar);
+static inline brh_vector2 vec2_scale(brh_vector2 v, float scalar)
+{
+    brh_vector2 scaled_vector = { .x = v.x * scalar, .y = v.y * scalar };
+    return scaled_vector;
+}
 
 /**
  * @brief Calculate the normal of a 2D vector.
  * @param v The vector.
  * @return The normal vector.
  */
-brh_vector2 vec2_normal(brh_vector2 v);
+static inline brh_vector2 vec2_normal(brh_vector2 v)
+{
+    float magnitude = vec2_magnitude(v);
+    brh_vector2 normalized_vector = { .x = v.x / magnitude, .y = v.y / magnitude };
+    return normalized_vector;
+}
 
 /**
  * @brief Normalize a 2D vector.
  * @param v A pointer to the vector to normalize.
  */
-void vec2_normalize(brh_vector2* v);
+static inline void vec2_normalize(brh_vector2* v)
+{
+    float magnitude = vec2_magnitude(*v);
+    v->x /= magnitude;
+    v->y /= magnitude;
+}
 
 /**
  * @brief Calculate the dot product of two 2D vectors.
@@ -91,7 +159,10 @@ void vec2_normalize(brh_vector2* v);
  * @param b The second vector.
  * @return The dot product.
  */
-float vec2_dot(brh_vector2 a, brh_vector2 b);
+static inline float vec2_dot(brh_vector2 a, brh_vector2 b)
+{
+    return a.x * b.x + a.y * b.y;
+}
 
 /**
  * @brief Calculate the cross product of two 2D vectors.
@@ -99,7 +170,10 @@ float vec2_dot(brh_vector2 a, brh_vector2 b);
  * @param b The second vector.
  * @return The cross product.
  */
-float vec2_cross(brh_vector2 a, brh_vector2 b);
+static inline float vec2_cross(brh_vector2 a, brh_vector2 b)
+{
+    return a.x * b.y - a.y * b.x;
+}
 
 /**
  * @brief Calculate the angle between two 2D vectors.
@@ -114,21 +188,33 @@ float vec2_angle(brh_vector2 a, brh_vector2 b);
  * @param a A pointer to the first vector.
  * @param b The second vector.
  */
-void vec2_add_ref(brh_vector2* a, brh_vector2 b);
+static inline void vec2_add_ref(brh_vector2* a, brh_vector2 b)
+{
+    a->x += b.x;
+    a->y += b.y;
+}
 
 /**
  * @brief Subtract a 2D vector from another by reference.
  * @param a A pointer to the first vector.
  * @param b The second vector.
  */
-void vec2_subtract_ref(brh_vector2* a, brh_vector2 b);
+static inline void vec2_subtract_ref(brh_vector2* a, brh_vector2 b)
+{
+    a->x -= b.x;
+    a->y -= b.y;
+}
 
 /**
  * @brief Scale a 2D vector by a scalar by reference.
  * @param v A pointer to the vector.
  * @param scalar The scalar value.
  */
-void vec2_scale_ref(brh_vector2* v, float scalar);
+static inline void vec2_scale_ref(brh_vector2* v, float scalar)
+{
+    v->x *= scalar;
+    v->y *= scalar;
+}
 
 /**
  * @brief Rotate a 2D vector by an angle.
@@ -158,14 +244,21 @@ brh_vector2 vec2_rotate_ref(brh_vector2* v, float angle);
 *
 * @return A `brh_vector3` instance with the specified components.
 */
-brh_vector3 vec3_create(float x, float y, float z);
+static inline brh_vector3 vec3_create(float x, float y, float z)
+{
+    brh_vector3 v = { .x = x, .y = y, .z = z };
+    return v;
+}
 
 /**
  * @brief Calculate the magnitude of a 3D vector.
  * @param v The vector.
  * @return The magnitude of the vector.
  */
-float vec3_magnitude(brh_vector3 v);
+static inline float vec3_magnitude(brh_vector3 v)
+{
+    return sqrtf(v.x * v.x + v.y * v.y + v.z * v.z);
+}
 
 /**
  * @brief Add two 3D vectors.
@@ -173,7 +266,11 @@ float vec3_magnitude(brh_vector3 v);
  * @param b The second vector.
  * @return The result of the addition.
  */
-brh_vector3 vec3_add(brh_vector3 a, brh_vector3 b);
+static inline brh_vector3 vec3_add(brh_vector3 a, brh_vector3 b)
+{
+    brh_vector3 sum = { .x = a.x + b.x, .y = a.y + b.y, .z = a.z + b.z };
+    return sum;
+}
 
 /**
  * @brief Subtract one 3D vector from another.
@@ -181,7 +278,11 @@ brh_vector3 vec3_add(brh_vector3 a, brh_vector3 b);
  * @param b The second vector.
  * @return The result of the subtraction.
  */
-brh_vector3 vec3_subtract(brh_vector3 a, brh_vector3 b);
+static inline brh_vector3 vec3_subtract(brh_vector3 a, brh_vector3 b)
+{
+    brh_vector3 difference = { .x = a.x - b.x, .y = a.y - b.y, .z = a.z - b.z };
+    return difference;
+}
 
 /**
  * @brief Scale a 3D vector by a scalar.
@@ -189,41 +290,71 @@ brh_vector3 vec3_subtract(brh_vector3 a, brh_vector3 b);
  * @param scalar The scalar value.
  * @return The scaled vector.
  */
-brh_vector3 vec3_scale(brh_vector3 v, float scalar);
+static inline brh_vector3 vec3_scale(brh_vector3 v, float scalar)
+{
+    brh_vector3 scaled_vector = { .x = v.x * scalar, .y = v.y * scalar, .z = v.z * scalar };
+    return scaled_vector;
+}
 
 /**
  * @brief Converts the 3D vector to a unit vector.
  * @param v The vector.
  * @return The normalized vector.
  */
-brh_vector3 vec3_unit_vector(brh_vector3 v);
+static inline brh_vector3 vec3_unit_vector(brh_vector3 v)
+{
+    float magnitude = vec3_magnitude(v);
+    brh_vector3 normalized_vector = { .x = v.x / magnitude, .y = v.y / magnitude, .z = v.z / magnitude };
+    return normalized_vector;
+}
 
 /**
  * @brief Normalize a 3D vector.
  * @param v A pointer to the vector to normalize.
  */
-void vec3_normalize(brh_vector3* v);
+static inline void vec3_normalize(brh_vector3* v)
+{
+    float magnitude = vec3_magnitude(*v);
+    v->x /= magnitude;
+    v->y /= magnitude;
+    v->z /= magnitude;
+}
 
 /**
  * @brief Add a 3D vector to another by reference.
  * @param a A pointer to the first vector.
  * @param b The second vector.
  */
-void vec3_add_ref(brh_vector3* a, brh_vector3 b);
+static inline void vec3_add_ref(brh_vector3* a, brh_vector3 b)
+{
+    a->x += b.x;
+    a->y += b.y;
+    a->z += b.z;
+}
 
 /**
  * @brief Subtract a 3D vector from another by reference.
  * @param a A pointer to the first vector.
  * @param b The second vector.
  */
-void vec3_subtract_ref(brh_vector3* a, brh_vector3 b);
+static inline void vec3_subtract_ref(brh_vector3* a, brh_vector3 b)
+{
+    a->x -= b.x;
+    a->y -= b.y;
+    a->z -= b.z;
+}
 
 /**
  * @brief Scale a 3D vector by a scalar by reference.
  * @param v A pointer to the vector.
  * @param scalar The scalar value.
  */
-void vec3_scale_ref(brh_vector3* v, float scalar);
+static inline void vec3_scale_ref(brh_vector3* v, float scalar)
+{
+    v->x *= scalar;
+    v->y *= scalar;
+    v->z *= scalar;
+}
 
 /**
  * @brief Calculate the dot product of two 3D vectors.
@@ -231,7 +362,10 @@ void vec3_scale_ref(brh_vector3* v, float scalar);
  * @param b The second vector.
  * @return The dot product.
  */
-float vec3_dot(brh_vector3 a, brh_vector3 b);
+static inline float vec3_dot(brh_vector3 a, brh_vector3 b)
+{
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
 
 /**
  * @brief Calculate the cross product of two 3D vectors.
@@ -239,7 +373,15 @@ float vec3_dot(brh_vector3 a, brh_vector3 b);
  * @param b The second vector.
  * @return The cross product.
  */
-brh_vector3 vec3_cross(brh_vector3 a, brh_vector3 b);
+static inline brh_vector3 vec3_cross(brh_vector3 a, brh_vector3 b)
+{
+    brh_vector3 cross_product = {
+        .x = a.y * b.z - a.z * b.y,
+        .y = a.z * b.x - a.x * b.z,
+        .z = a.x * b.y - a.y * b.x,
+    };
+    return cross_product;
+}
 
 /**
  * @brief Calculate the angle between two 3D vectors.
@@ -302,7 +444,15 @@ brh_vector3 vec3_rotate_z_ref(brh_vector3* v, float angle);
  * @param t The interpolation factor (0.0 = a, 1.0 = b).
  * @return The interpolated vector.
  */
-brh_vector3 vec3_lerp(brh_vector3 a, brh_vector3 b, float t);
+static inline brh_vector3 vec3_lerp(brh_vector3 a, brh_vector3 b, float t)
+{
+    brh_vector3 result = {
+        .x = a.x + t * (b.x - a.x),
+        .y = a.y + t * (b.y - a.y),
+        .z = a.z + t * (b.z - a.z),
+    };
+    return result;
+}
 
 /**
  * @brief Linearly interpolate between two 4D vectors.
@@ -312,7 +462,20 @@ brh_vector3 vec3_lerp(brh_vector3 a, brh_vector3 b, float t);
  * @param t The interpolation factor (0.0 = a, 1.0 = b).
  * @return The interpolated vector.
  */
-brh_vector4 vec4_lerp(brh_vector4 a, brh_vector4 b, float t);
+static inline brh_vector4 vec4_lerp(brh_vector4 a, brh_vector4 b, float t)
+{
+    brh_vector4 result;
+#ifdef BRH_MATH_SSE2
+    const __m128 start = vec4_load_sse(&a);
+    vec4_store_sse(&result, _mm_add_ps(start, _mm_mul_ps(_mm_set1_ps(t), _mm_sub_ps(vec4_load_sse(&b), start))));
+#else
+    result.x = a.x + t * (b.x - a.x);
+    result.y = a.y + t * (b.y - a.y);
+    result.z = a.z + t * (b.z - a.z);
+    result.w = a.w + t * (b.w - a.w);
+#endif
+    return result;
+}
 
 
 /**
@@ -320,7 +483,11 @@ brh_vector4 vec4_lerp(brh_vector4 a, brh_vector4 b, float t);
  * @param v The 4D vector.
  * @return The converted 3D vector.
  */
-brh_vector3 vec3_from_vec4(brh_vector4 v);
+static inline brh_vector3 vec3_from_vec4(brh_vector4 v)
+{
+    brh_vector3 result = { .x = v.x, .y = v.y, .z = v.z };
+    return result;
+}
 
 // ============================================================================
 // Vector4 Functions
@@ -331,4 +498,8 @@ brh_vector3 vec3_from_vec4(brh_vector4 v);
  * @param v The 3D vector.
  * @return The converted 4D vector.
  */
-brh_vector4 vec4_from_vec3(brh_vector3 v);
+static inline brh_vector4 vec4_from_vec3(brh_vector3 v)
+{
+    brh_vector4 result = { .x = v.x, .y = v.y, .z = v.z, .w = 1.0f };
+    return result;
+}
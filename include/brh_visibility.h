@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "brh_renderable.h"
+
+/*
+* Visibility-buffer rendering.
+*
+* Draws a frame's command list in two passes instead of shading every fragment that passes
+* the depth test. The first pass rasterizes every triangle with the depth-only kernel and
+* writes, next to the depth, a 32-bit id naming the triangle: the triangles of the frame are
+* numbered from 1 in command order, so an id packs the draw and the triangle within it. No
+* attribute is interpolated and nothing is shaded. The second pass walks the screen in
+* bands of BRH_VISIBILITY_BAND_ROWS rows on the job system. Each run of pixels naming the
+* same triangle is shaded once with shade_visibility_span(), which rebuilds the triangle's
+* interpolants from its screen vertices. Shading cost then depends on the pixels covered,
+* not on how many triangles were drawn over them.
+*
+* Triangles whose texture has transparent texels are alpha tested in the first pass, as in
+* the depth prepass, so pixels seen through them name what is behind. The resolve clears
+* the ids it reads, so the buffer is empty again for the next frame without a full clear.
+*/
+
+/** Rows of the screen each resolve job shades. */
+#define BRH_VISIBILITY_BAND_ROWS 16
+
+/*
+* Running totals of the visibility passes since startup. Subtract two readings to time a
+* range of frames.
+*/
+typedef struct {
+    uint64_t frames;        // Frames drawn through the visibility buffer
+    double raster_ms;       // Time spent writing depth and ids
+    double resolve_ms;      // Time spent shading the visible pixels
+} brh_visibility_stats;
+
+/**
+ * @brief Draws a frame's command list through the visibility buffer.
+ *
+ * Only filled and textured render methods are supported; for the others the commands are
+ * drawn with draw_renderable_command() as usual.
+ *
+ * @param commands The frame's draw commands.
+ * @param command_count Number of commands.
+ * @param render_method The render method the frame was built with.
+ */
+void draw_visibility_commands(const brh_draw_command* commands, int command_count, enum render_method render_method);
+
+/**
+ * @brief Gets the running totals of the visibility passes.
+ *
+ * @return The totals.
+ */
+brh_visibility_stats get_visibility_stats(void);
+
+/**
+ * @brief Frees the visibility buffer and its tables.
+ */
+void cleanup_visibility_buffer(void);
@@ -44,4 +44,19 @@ void array_free(void* array) {
     if (array != NULL) {
         free(ARRAY_RAW_DATA(array));
     }
-}
\ No newline at end of file
+}
+
+bool reserve_buffer(void** buffer, int* capacity, int count, int item_size, const char* what) {
+    if (count <= *capacity) {
+        return true;
+    }
+    int new_capacity = count > *capacity * 2 ? count : *capacity * 2;
+    void* grown = realloc(*buffer, (size_t)item_size * new_capacity);
+    if (grown == NULL) {
+        fprintf(stderr, "Error: Failed to allocate %d %s\n", new_capacity, what);
+        return false;
+    }
+    *buffer = grown;
+    *capacity = new_capacity;
+    return true;
+}
@@ -0,0 +1,456 @@
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "brh_cluster.h"
+#include "array.h"
+#include "math_utils.h"
+
+// Past BRH_CLUSTER_MIN_FACES, a cluster stops at a face whose normal is further than this
+// (cosine) from the cluster's average normal
+#define BRH_CLUSTER_CONE_LIMIT 0.85f
+// How strongly candidate faces far from the cluster's centroid are penalized
+#define BRH_CLUSTER_DISTANCE_WEIGHT 0.5f
+// Unassigned faces searched for the nearest one when a small cluster runs out of neighbors
+#define BRH_CLUSTER_SEARCH_WINDOW 1024
+
+// Load-time data of one face
+typedef struct {
+    brh_vector3 normal;     // Unit normal, wound like get_face_normal()
+    brh_vector3 centroid;
+    bool is_degenerate;     // Zero area (or invalid indices): covers no pixels, has no normal
+} brh_cluster_face;
+
+// A vertex position with its index, for sorting duplicates next to each other
+typedef struct {
+    brh_vector3 position;
+    int index;
+} brh_cluster_vertex;
+
+static bool is_face_valid(const brh_face* face, int num_vertices)
+{
+    return face->a >= 0 && face->a < num_vertices &&
+        face->b >= 0 && face->b < num_vertices &&
+        face->c >= 0 && face->c < num_vertices;
+}
+
+// Higher for faces that keep the cluster's normal cone narrow and its sphere small
+static float score_candidate(const brh_cluster_face* face, brh_vector3 axis, brh_vector3 center, float expected_radius)
+{
+    const float dot = face->is_degenerate ? 1.0f : vec3_dot(face->normal, axis);
+    const float distance = vec3_magnitude(vec3_subtract(face->centroid, center));
+    return dot - BRH_CLUSTER_DISTANCE_WEIGHT * distance / expected_radius;
+}
+
+static int compare_cluster_vertices(const void* a, const void* b)
+{
+    const brh_vector3 pa = ((const brh_cluster_vertex*)a)->position;
+    const brh_vector3 pb = ((const brh_cluster_vertex*)b)->position;
+    if (pa.x != pb.x) return pa.x < pb.x ? -1 : 1;
+    if (pa.y != pb.y) return pa.y < pb.y ? -1 : 1;
+    if (pa.z != pb.z) return pa.z < pb.z ? -1 : 1;
+    return ((const brh_cluster_vertex*)a)->index - ((const brh_cluster_vertex*)b)->index;
+}
+
+bool weld_mesh_vertices(const brh_mesh* mesh_data, int* weld)
+{
+    const int num_vertices = array_length(mesh_data->vertices);
+    brh_cluster_vertex* sorted = (brh_cluster_vertex*)malloc(sizeof(brh_cluster_vertex) * ((size_t)num_vertices + 1));
+    if (!sorted) return false;
+
+    for (int v = 0; v < num_vertices; v++) {
+        sorted[v].position = mesh_data->vertices[v];
+        sorted[v].index = v;
+    }
+    qsort(sorted, num_vertices, sizeof(brh_cluster_vertex), compare_cluster_vertices);
+
+    int canonical = 0;
+    for (int i = 0; i < num_vertices; i++) {
+        if (i == 0 || compare_cluster_vertices(&(brh_cluster_vertex){ sorted[i].position, 0 },
+            &(brh_cluster_vertex){ sorted[i - 1].position, 0 }) != 0) {
+            canonical = sorted[i].index;
+        }
+        weld[sorted[i].index] = canonical;
+    }
+    free(sorted);
+    return true;
+}
+
+static void compute_cluster_bounds(const brh_mesh* mesh_data, const brh_cluster_face* face_info,
+    const int* order, brh_mesh_cluster* cluster)
+{
+    const int num_vertices = array_length(mesh_data->vertices);
+
+    // Bounding sphere around the center of the cluster's bounding box
+    brh_vector3 bounds_min = { FLT_MAX, FLT_MAX, FLT_MAX };
+    brh_vector3 bounds_max = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    brh_vector3 normal_sum = { 0.0f, 0.0f, 0.0f };
+    for (int i = 0; i < cluster->face_count; i++) {
+        const int f = order[cluster->first_face + i];
+        const brh_face* face = &mesh_data->faces[f];
+        if (is_face_valid(face, num_vertices)) {
+            const int corners[3] = { face->a, face->b, face->c };
+            for (int k = 0; k < 3; k++) {
+                const brh_vector3 v = mesh_data->vertices[corners[k]];
+                bounds_min.x = MIN(bounds_min.x, v.x);
+                bounds_min.y = MIN(bounds_min.y, v.y);
+                bounds_min.z = MIN(bounds_min.z, v.z);
+                bounds_max.x = MAX(bounds_max.x, v.x);
+                bounds_max.y = MAX(bounds_max.y, v.y);
+                bounds_max.z = MAX(bounds_max.z, v.z);
+            }
+        }
+        if (!face_info[f].is_degenerate) {
+            normal_sum = vec3_add(normal_sum, face_info[f].normal);
+        }
+    }
+
+    cluster->center = (brh_vector3){ 0.0f, 0.0f, 0.0f };
+    cluster->radius = 0.0f;
+    if (bounds_min.x <= bounds_max.x) {
+        cluster->center = vec3_scale(vec3_add(bounds_min, bounds_max), 0.5f);
+        for (int i = 0; i < cluster->face_count; i++) {
+            const brh_face* face = &mesh_data->faces[order[cluster->first_face + i]];
+            if (!is_face_valid(face, num_vertices)) continue;
+            const int corners[3] = { face->a, face->b, face->c };
+            for (int k = 0; k < 3; k++) {
+                cluster->radius = MAX(cluster->radius, vec3_magnitude(vec3_subtract(mesh_data->vertices[corners[k]], cluster->center)));
+            }
+        }
+    }
+
+    // Normal cone: the widest angle between the average normal and any face normal
+    cluster->cone_axis = (brh_vector3){ 0.0f, 0.0f, 0.0f };
+    cluster->cone_cos = -1.0f;
+    const float axis_length = vec3_magnitude(normal_sum);
+    if (axis_length > EPSILON) {
+        cluster->cone_axis = vec3_scale(normal_sum, 1.0f / axis_length);
+        cluster->cone_cos = 1.0f;
+        for (int i = 0; i < cluster->face_count; i++) {
+            const int f = order[cluster->first_face + i];
+            if (!face_info[f].is_degenerate) {
+                cluster->cone_cos = MIN(cluster->cone_cos, vec3_dot(face_info[f].normal, cluster->cone_axis));
+            }
+        }
+    }
+    cluster->cone_sin = sqrtf(MAX(0.0f, 1.0f - cluster->cone_cos * cluster->cone_cos));
+}
+
+bool build_mesh_clusters(brh_mesh* mesh_data)
+{
+    if (!mesh_data) return false;
+    if (mesh_data->clusters) {
+        array_free(mesh_data->clusters);
+        mesh_data->clusters = NULL;
+    }
+
+    const int num_faces = array_length(mesh_data->faces);
+    const int num_vertices = array_length(mesh_data->vertices);
+    if (num_faces == 0) return true;
+
+    brh_cluster_face* face_info = (brh_cluster_face*)malloc(sizeof(brh_cluster_face) * num_faces);
+    int* cluster_of = (int*)malloc(sizeof(int) * num_faces);
+    int* order = (int*)malloc(sizeof(int) * num_faces);
+    int* frontier = (int*)malloc(sizeof(int) * num_faces);
+    int* frontier_mark = (int*)malloc(sizeof(int) * num_faces);
+    int* vertex_face_start = (int*)calloc((size_t)num_vertices + 1, sizeof(int));
+    int* vertex_faces = (int*)malloc(sizeof(int) * 3 * (size_t)num_faces);
+    int* weld = (int*)malloc(sizeof(int) * ((size_t)num_vertices + 1));
+    brh_mesh_cluster* clusters = NULL;
+    brh_face* reordered = NULL;
+    bool ok = face_info && cluster_of && order && frontier && frontier_mark && vertex_face_start && vertex_faces &&
+        weld && weld_mesh_vertices(mesh_data, weld);
+    if (!ok) {
+        fprintf(stderr, "Error: Failed to allocate cluster build buffers\n");
+    }
+
+    float expected_radius = 1.0f;   // Typical radius of a full cluster
+    if (ok) {
+        // Face normals and centroids, plus the mean edge length to scale distances by
+        double edge_sum = 0.0;
+        int edge_count = 0;
+        for (int f = 0; f < num_faces; f++) {
+            const brh_face* face = &mesh_data->faces[f];
+            face_info[f].is_degenerate = true;
+            face_info[f].normal = (brh_vector3){ 0.0f, 0.0f, 0.0f };
+            face_info[f].centroid = (brh_vector3){ 0.0f, 0.0f, 0.0f };
+            cluster_of[f] = -1;
+            frontier_mark[f] = -1;
+            if (!is_face_valid(face, num_vertices)) continue;
+
+            const brh_vector3 a = mesh_data->vertices[face->a];
+            const brh_vector3 b = mesh_data->vertices[face->b];
+            const brh_vector3 c = mesh_data->vertices[face->c];
+            const brh_vector3 normal = vec3_cross(vec3_subtract(b, a), vec3_subtract(c, a));
+            const float length = vec3_magnitude(normal);
+            face_info[f].centroid = vec3_scale(vec3_add(vec3_add(a, b), c), 1.0f / 3.0f);
+            if (length > 0.0f) {
+                face_info[f].normal = vec3_scale(normal, 1.0f / length);
+                face_info[f].is_degenerate = false;
+            }
+            edge_sum += vec3_magnitude(vec3_subtract(b, a)) + vec3_magnitude(vec3_subtract(c, b)) + vec3_magnitude(vec3_subtract(a, c));
+            edge_count += 3;
+
+            vertex_face_start[weld[face->a] + 1]++;
+            vertex_face_start[weld[face->b] + 1]++;
+            vertex_face_start[weld[face->c] + 1]++;
+        }
+        const float mean_edge = edge_count > 0 ? (float)(edge_sum / edge_count) : 1.0f;
+        expected_radius = MAX(EPSILON, mean_edge * sqrtf((float)BRH_CLUSTER_MAX_FACES) * 0.5f);
+
+        // Faces around each vertex, so clusters grow through shared vertices
+        for (int v = 0; v < num_vertices; v++) {
+            vertex_face_start[v + 1] += vertex_face_start[v];
+        }
+        int* cursor = (int*)malloc(sizeof(int) * ((size_t)num_vertices + 1));
+        if (!cursor) {
+            fprintf(stderr, "Error: Failed to allocate cluster build buffers\n");
+            ok = false;
+        }
+        else {
+            memcpy(cursor, vertex_face_start, sizeof(int) * ((size_t)num_vertices + 1));
+            for (int f = 0; f < num_faces; f++) {
+                const brh_face* face = &mesh_data->faces[f];
+                if (!is_face_valid(face, num_vertices)) continue;
+                vertex_faces[cursor[weld[face->a]]++] = f;
+                vertex_faces[cursor[weld[face->b]]++] = f;
+                vertex_faces[cursor[weld[face->c]]++] = f;
+            }
+            free(cursor);
+        }
+    }
+
+    int cluster_count = 0;
+    if (ok) {
+        // Grow each cluster from the first unassigned face, always adding the neighboring
+        // face that best matches the cluster's average normal and stays close to its centroid
+        int assigned = 0;
+        int seed = 0;
+        while (assigned < num_faces) {
+            while (cluster_of[seed] != -1) seed++;
+
+            const int first = assigned;
+            int frontier_count = 0;
+            brh_vector3 normal_sum = { 0.0f, 0.0f, 0.0f };
+            brh_vector3 centroid_sum = { 0.0f, 0.0f, 0.0f };
+            int next = seed;
+            for (;;) {
+                // Add the face and queue its unassigned neighbors
+                cluster_of[next] = cluster_count;
+                order[assigned++] = next;
+                if (!face_info[next].is_degenerate) {
+                    normal_sum = vec3_add(normal_sum, face_info[next].normal);
+                }
+                centroid_sum = vec3_add(centroid_sum, face_info[next].centroid);
+                const brh_face* face = &mesh_data->faces[next];
+                if (is_face_valid(face, num_vertices)) {
+                    const int corners[3] = { weld[face->a], weld[face->b], weld[face->c] };
+                    for (int k = 0; k < 3; k++) {
+                        for (int n = vertex_face_start[corners[k]]; n < vertex_face_start[corners[k] + 1]; n++) {
+                            const int g = vertex_faces[n];
+                            if (cluster_of[g] == -1 && frontier_mark[g] != cluster_count) {
+                                frontier_mark[g] = cluster_count;
+                                frontier[frontier_count++] = g;
+                            }
+                        }
+                    }
+                }
+
+                const int size = assigned - first;
+                if (size >= BRH_CLUSTER_MAX_FACES) break;
+
+                const float axis_length = vec3_magnitude(normal_sum);
+                const brh_vector3 axis = axis_length > EPSILON ? vec3_scale(normal_sum, 1.0f / axis_length) : normal_sum;
+                const brh_vector3 center = vec3_scale(centroid_sum, 1.0f / (float)size);
+
+                int best = -1;
+                float best_score = -FLT_MAX;
+                float best_dot = 0.0f;
+                for (int k = 0; k < frontier_count; k++) {
+                    const int g = frontier[k];
+                    if (cluster_of[g] != -1) {
+                        frontier[k--] = frontier[--frontier_count];
+                        continue;
+                    }
+                    const float score = score_candidate(&face_info[g], axis, center, expected_radius);
+                    if (score > best_score) {
+                        best = k;
+                        best_score = score;
+                        best_dot = face_info[g].is_degenerate ? 1.0f : vec3_dot(face_info[g].normal, axis);
+                    }
+                }
+                if (best < 0) {
+                    if (size >= BRH_CLUSTER_MIN_FACES) break;
+
+                    // Out of connected faces (a separate part of the mesh): continue with the
+                    // best of the next unassigned faces, which files tend to keep nearby
+                    int searched = 0;
+                    for (int g = seed; g < num_faces && searched < BRH_CLUSTER_SEARCH_WINDOW; g++) {
+                        if (cluster_of[g] != -1) continue;
+                        searched++;
+                        const float score = score_candidate(&face_info[g], axis, center, expected_radius);
+                        if (score > best_score) {
+                            best_score = score;
+                            next = g;
+                        }
+                    }
+                    if (searched == 0) break;
+                    continue;
+                }
+                if (size >= BRH_CLUSTER_MIN_FACES && best_dot < BRH_CLUSTER_CONE_LIMIT) break;
+
+                next = frontier[best];
+                frontier[best] = frontier[--frontier_count];
+            }
+
+            brh_mesh_cluster cluster = { .first_face = first, .face_count = assigned - first };
+            array_push(clusters, cluster);
+            if (!clusters) {
+                fprintf(stderr, "Error: Failed to allocate mesh clusters\n");
+                ok = false;
+                break;
+            }
+            cluster_count++;
+        }
+    }
+
+    if (ok) {
+        for (int c = 0; c < cluster_count; c++) {
+            compute_cluster_bounds(mesh_data, face_info, order, &clusters[c]);
+        }
+
+        // Store the faces in cluster order
+        reordered = (brh_face*)array_hold(NULL, num_faces, sizeof(brh_face));
+        if (!reordered) {
+            fprintf(stderr, "Error: Failed to allocate reordered faces\n");
+            ok = false;
+        }
+        else {
+            for (int i = 0; i < num_faces; i++) {
+                reordered[i] = mesh_data->faces[order[i]];
+            }
+            array_free(mesh_data->faces);
+            mesh_data->faces = reordered;
+            mesh_data->clusters = clusters;
+        }
+    }
+
+    if (!ok && clusters) {
+        array_free(clusters);
+    }
+    free(face_info);
+    free(cluster_of);
+    free(order);
+    free(frontier);
+    free(frontier_mark);
+    free(vertex_face_start);
+    free(vertex_faces);
+    free(weld);
+    return ok;
+}
+
+void begin_cluster_culling(brh_cluster_culler* culler, const brh_mat4* world_matrix,
+    const brh_mat4* camera_matrix, const brh_mat4* projection_matrix, bool cull_backfaces)
+{
+    mat4_mul_mat4_ref(world_matrix, camera_matrix, &culler->model_view);
+    const brh_mat4* mv = &culler->model_view;
+
+    // Clip space keeps -w <= x, y, z <= w, so each plane is the last row plus or minus another
+    const float(*p)[4] = projection_matrix->m;
+    for (int i = 0; i < 3; i++) {
+        for (int side = 0; side < 2; side++) {
+            const float sign = side == 0 ? 1.0f : -1.0f;
+            brh_vector4 plane = {
+                p[3][0] + sign * p[i][0],
+                p[3][1] + sign * p[i][1],
+                p[3][2] + sign * p[i][2],
+                p[3][3] + sign * p[i][3]
+            };
+            const float length = sqrtf(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+            if (length > EPSILON) {
+                plane.x /= length;
+                plane.y /= length;
+                plane.z /= length;
+                plane.w /= length;
+            }
+            culler->planes[i * 2 + side] = plane;
+        }
+    }
+
+    // Columns of the upper 3x3 are the scaled model axes
+    float column_min = FLT_MAX;
+    float column_max = 0.0f;
+    for (int j = 0; j < 3; j++) {
+        const float length = sqrtf(mv->m[0][j] * mv->m[0][j] + mv->m[1][j] * mv->m[1][j] + mv->m[2][j] * mv->m[2][j]);
+        column_min = MIN(column_min, length);
+        column_max = MAX(column_max, length);
+    }
+    const float determinant =
+        mv->m[0][0] * (mv->m[1][1] * mv->m[2][2] - mv->m[1][2] * mv->m[2][1]) -
+        mv->m[0][1] * (mv->m[1][0] * mv->m[2][2] - mv->m[1][2] * mv->m[2][0]) +
+        mv->m[0][2] * (mv->m[1][0] * mv->m[2][1] - mv->m[1][1] * mv->m[2][0]);
+
+    culler->radius_scale = column_max;
+    culler->cone_sign = determinant < 0.0f ? -1.0f : 1.0f;
+    // Non-uniform scale bends normals by different amounts, so model-space cones do not carry over
+    culler->test_cones = cull_backfaces && column_max > EPSILON && column_max - column_min <= 1e-3f * column_max;
+}
+
+bool is_cluster_visible(const brh_cluster_culler* culler, const brh_mesh_cluster* cluster)
+{
+    const brh_mat4* mv = &culler->model_view;
+    const brh_vector4 center4 = mat4_mul_vec4(mv, vec4_from_vec3(cluster->center));
+    const brh_vector3 center = vec3_from_vec4(center4);
+    const float radius = cluster->radius * culler->radius_scale;
+
+    for (int i = 0; i < 6; i++) {
+        const brh_vector4 plane = culler->planes[i];
+        if (plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w < -radius) {
+            return false;
+        }
+    }
+
+    if (culler->test_cones && cluster->cone_cos > 0.0f) {
+        // The camera sits at the origin of camera space, so the center is also the view vector
+        brh_vector3 axis = {
+            mv->m[0][0] * cluster->cone_axis.x + mv->m[0][1] * cluster->cone_axis.y + mv->m[0][2] * cluster->cone_axis.z,
+            mv->m[1][0] * cluster->cone_axis.x + mv->m[1][1] * cluster->cone_axis.y + mv->m[1][2] * cluster->cone_axis.z,
+            mv->m[2][0] * cluster->cone_axis.x + mv->m[2][1] * cluster->cone_axis.y + mv->m[2][2] * cluster->cone_axis.z
+        };
+        axis = vec3_scale(axis, culler->cone_sign / vec3_magnitude(axis));
+
+        // With theta the angle between the axis and the view vector, the face normal closest
+        // to facing the camera is at theta + alpha, so the nearest point of the sphere sees
+        // every face from behind when |c| cos(theta + alpha) >= r. A small margin keeps faces
+        // the per-face test sees edge-on from being rejected.
+        const float distance = vec3_magnitude(center);
+        const float along = vec3_dot(center, axis);
+        const float across = sqrtf(MAX(0.0f, distance * distance - along * along));
+        const float margin = 1e-4f * (distance + radius);
+        if (along * cluster->cone_cos - across * cluster->cone_sin >= radius + margin) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int find_face_cluster(const brh_mesh* mesh_data, int face)
+{
+    const int count = array_length(mesh_data->clusters);
+    if (count == 0) return -1;
+
+    // Last cluster starting at or before the face
+    int low = 0;
+    int high = count - 1;
+    while (low < high) {
+        const int mid = (low + high + 1) / 2;
+        if (mesh_data->clusters[mid].first_face <= face) {
+            low = mid;
+        }
+        else {
+            high = mid - 1;
+        }
+    }
+    return low;
+}
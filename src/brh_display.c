@@ -1,7 +1,21 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "math_utils.h"
 #include "brh_display.h"
+#include "brh_profiler.h"
+#include "brh_jobs.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BRH_CLEAR_SSE2
+#include <emmintrin.h>
+#endif
+
+// Rows cleared per job when a clear is split across the job workers
+#define BRH_CLEAR_ROWS_PER_JOB 32
+// Buffers at least this large are cleared with non-temporal stores. They would not stay
+// cached anyway, and streaming skips the read-for-ownership of every cache line.
+#define BRH_STREAMING_CLEAR_BYTES (4 * 1024 * 1024)
 
 static enum cull_method cull_method = CULL_NONE;
 static enum render_method render_method = RENDER_WIREFRAME;
@@ -13,9 +27,38 @@ static uint32_t* color_buffer = NULL;
 static SDL_Texture* color_buffer_texture = NULL;
 static float* z_buffer = NULL;
 
+// With PRESENT_LOCKED_TEXTURE the color buffer is the locked texture memory, whose rows
+// may be padded; otherwise it is a malloc'd, tightly packed buffer
+static enum present_method present_method = PRESENT_UPDATE_TEXTURE;
+static bool color_buffer_locked = false;
+static bool presented_frame_retained = false; // Color buffer still holds the last presented frame
+static int color_buffer_pitch = 0;          // Pixels between the starts of consecutive rows
+static uint32_t* packed_frame = NULL;       // Tightly packed copy for the frame sink, if rows are padded
+
 static int window_width = 800;
 static int window_height = 600;
 
+// Internal render resolution. The buffers are allocated at the window size and only their
+// top-left render_width x render_height region is drawn, so changing it never reallocates.
+static int render_width = 800;
+static int render_height = 600;
+
+static bool headless = false;
+static brh_frame_sink frame_sink = NULL;
+static void* frame_sink_user_data = NULL;
+static int frame_index = 0;
+
+// Per-tile frame epochs for DEPTH_CLEAR_TILE_EPOCH. A tile whose epoch differs from
+// depth_epoch still holds depth from an earlier frame.
+static enum depth_clear_method depth_clear_method = DEPTH_CLEAR_FULL;
+static uint32_t* depth_tile_epochs = NULL;
+static int depth_tiles_x = 0;
+static int depth_tiles_y = 0;
+static uint32_t depth_epoch = 0;
+
+static bool allocate_frame_buffers(int width, int height);
+static void release_color_buffer(void);
+
 int get_window_width(void)
 {
     return window_width;
@@ -26,6 +69,22 @@ int get_window_height(void)
     return window_height;
 }
 
+int get_render_width(void)
+{
+    return render_width;
+}
+
+int get_render_height(void)
+{
+    return render_height;
+}
+
+void set_render_resolution(int width, int height)
+{
+    render_width = MAX(1, MIN(width, window_width));
+    render_height = MAX(1, MIN(height, window_height));
+}
+
 float get_aspect_ratio(void)
 {
 	return (float)window_width / (float)window_height;
@@ -33,18 +92,34 @@ float get_aspect_ratio(void)
 
 void set_window_size(int width, int height)
 {
+    if (width <= 0 || height <= 0)
+    {
+        fprintf(stderr, "Error: Invalid window size %dx%d\n", width, height);
+        return;
+    }
+
     window_width = width;
     window_height = height;
     if (window)
     {
         SDL_SetWindowSize(window, window_width, window_height);
     }
-    else
+
+    // Resize the frame buffers if they already exist
+    if (color_buffer || z_buffer)
     {
-        fprintf(stderr, "Error: Window not initialized\n");
+        if (!allocate_frame_buffers(window_width, window_height))
+        {
+            fprintf(stderr, "Error: Failed to resize frame buffers to %dx%d\n", window_width, window_height);
+        }
     }
 }
 
+bool is_headless_display(void)
+{
+    return headless;
+}
+
 bool initialize_window(void)
 {
     if (SDL_Init(SDL_INIT_VIDEO) == false)
@@ -92,30 +167,134 @@ bool initialize_display_resources(void)
         return false;
     }
 
-    // Allocate color and z-buffers
+    // Allocate color and z-buffers, plus the streaming texture they are presented through
+    if (!allocate_frame_buffers(window_width, window_height))
+    {
+        cleanup_display_resources();
+        return false;
+    }
+
+    return true;
+}
+
+bool initialize_headless_display(int width, int height)
+{
+    if (width <= 0 || height <= 0)
+    {
+        fprintf(stderr, "Error: Invalid headless display size %dx%d\n", width, height);
+        return false;
+    }
+
+    // No SDL video subsystem, window or renderer: only the CPU-side buffers exist
+    headless = true;
+    window_width = width;
+    window_height = height;
+
+    if (!allocate_frame_buffers(window_width, window_height))
+    {
+        cleanup_display_resources();
+        return false;
+    }
+
+    return true;
+}
+
+/*
+* Points the color buffer at the locked streaming texture (PRESENT_LOCKED_TEXTURE with a
+* renderer), or allocates a tightly packed buffer. A texture that cannot be locked falls
+* back to the copying path.
+*/
+static bool acquire_color_buffer(void)
+{
+    presented_frame_retained = false;
+    if (present_method == PRESENT_LOCKED_TEXTURE && color_buffer_texture)
+    {
+        void* pixels = NULL;
+        int pitch = 0;
+        if (SDL_LockTexture(color_buffer_texture, NULL, &pixels, &pitch))
+        {
+            color_buffer = (uint32_t*)pixels;
+            color_buffer_pitch = pitch / (int)sizeof(uint32_t);
+            color_buffer_locked = true;
+            return true;
+        }
+        fprintf(stderr, "Error: Failed to lock color buffer texture, falling back to SDL_UpdateTexture: %s\n", SDL_GetError());
+        present_method = PRESENT_UPDATE_TEXTURE;
+    }
+
     color_buffer = (uint32_t*)malloc(sizeof(uint32_t) * window_width * window_height);
-    z_buffer = (float*)malloc(sizeof(float) * window_width * window_height);
+    color_buffer_pitch = window_width;
+    color_buffer_locked = false;
+    return color_buffer != NULL;
+}
 
-    if (!color_buffer || !z_buffer)
+// Unlocks or frees the color buffer, whichever acquire_color_buffer() did
+static void release_color_buffer(void)
+{
+    if (color_buffer_locked)
+    {
+        SDL_UnlockTexture(color_buffer_texture);
+    }
+    else
+    {
+        free(color_buffer);
+    }
+    color_buffer = NULL;
+    color_buffer_locked = false;
+
+    free(packed_frame);
+    packed_frame = NULL;
+}
+
+/*
+* Allocates (or reallocates) the color buffer, z-buffer and, when a renderer exists,
+* the streaming texture used to present the color buffer.
+*/
+static bool allocate_frame_buffers(int width, int height)
+{
+    release_color_buffer();
+    free(z_buffer);
+    free(depth_tile_epochs);
+    z_buffer = (float*)malloc(sizeof(float) * width * height);
+    depth_tiles_x = (width + BRH_DEPTH_TILE_SIZE - 1) / BRH_DEPTH_TILE_SIZE;
+    depth_tiles_y = (height + BRH_DEPTH_TILE_SIZE - 1) / BRH_DEPTH_TILE_SIZE;
+    depth_tile_epochs = (uint32_t*)calloc((size_t)depth_tiles_x * depth_tiles_y, sizeof(uint32_t));
+    depth_epoch = 0;
+    render_width = width;
+    render_height = height;
+
+    if (!z_buffer || !depth_tile_epochs)
     {
         fprintf(stderr, "Error: Failed to allocate color or Z buffer\n");
-        cleanup_display_resources();
         return false;
     }
 
-    // Create color buffer texture
-    color_buffer_texture = SDL_CreateTexture(
-        renderer,
-        SDL_PIXELFORMAT_ARGB8888,
-        SDL_TEXTUREACCESS_STREAMING,
-        window_width,
-        window_height
-    );
+    if (renderer)
+    {
+        if (color_buffer_texture)
+        {
+            SDL_DestroyTexture(color_buffer_texture);
+        }
+
+        // Create color buffer texture
+        color_buffer_texture = SDL_CreateTexture(
+            renderer,
+            SDL_PIXELFORMAT_ARGB8888,
+            SDL_TEXTUREACCESS_STREAMING,
+            width,
+            height
+        );
 
-    if (!color_buffer_texture)
+        if (!color_buffer_texture)
+        {
+            fprintf(stderr, "Error: Failed to create color buffer texture: %s\n", SDL_GetError());
+            return false;
+        }
+    }
+
+    if (!acquire_color_buffer())
     {
-        fprintf(stderr, "Error: Failed to create color buffer texture: %s\n", SDL_GetError());
-        cleanup_display_resources();
+        fprintf(stderr, "Error: Failed to allocate color or Z buffer\n");
         return false;
     }
 
@@ -150,6 +329,8 @@ void destroy_window(void)
 
 void cleanup_display_resources(void)
 {
+    release_color_buffer(); // Unlocks the texture before it is destroyed
+
     if (color_buffer_texture)
     {
         SDL_DestroyTexture(color_buffer_texture);
@@ -168,19 +349,21 @@ void cleanup_display_resources(void)
         window = NULL;
     }
 
-    if (color_buffer)
-    {
-        free(color_buffer);
-        color_buffer = NULL;
-    }
-
     if (z_buffer)
     {
         free(z_buffer);
         z_buffer = NULL;
     }
 
-    SDL_Quit();
+    free(depth_tile_epochs);
+    depth_tile_epochs = NULL;
+
+    if (!headless)
+    {
+        SDL_Quit();
+    }
+    headless = false;
+    frame_index = 0;
 }
 
 SDL_Renderer* get_renderer(void)
@@ -190,12 +373,12 @@ SDL_Renderer* get_renderer(void)
 
 uint32_t get_color_buffer_at(int x, int y)
 {
-	if (x < 0 || x >= window_width || y < 0 || y >= window_height || !color_buffer)
+	if (x < 0 || x >= render_width || y < 0 || y >= render_height || !color_buffer)
 	{
 		fprintf(stderr, "Error: Coordinates out of bounds or color buffer not initialized\n");
 		return 0xFFFFFFFF; // Return white color for out-of-bounds access
 	}
-	return color_buffer[(window_width * y) + x];
+	return color_buffer[(color_buffer_pitch * y) + x];
 }
 
 uint32_t* get_color_buffer_ptr(void)
@@ -203,25 +386,31 @@ uint32_t* get_color_buffer_ptr(void)
     return color_buffer;
 }
 
+int get_color_buffer_pitch(void)
+{
+    return color_buffer_pitch;
+}
+
 void set_color_buffer_at(int x, int y, uint32_t color)
 {
-	if (x < 0 || x >= window_width || y < 0 || y >= window_height || !color_buffer)
+	if (x < 0 || x >= render_width || y < 0 || y >= render_height || !color_buffer)
 	{
 		fprintf(stderr, "Error: Coordinates out of bounds or color buffer not initialized\n");
 		return;
 	}
-	color_buffer[(window_width * y) + x] = color;
+	color_buffer[(color_buffer_pitch * y) + x] = color;
 }
 
 float get_z_buffer_at(int x, int y)
 {
-	if (x < 0 || x >= window_width || y < 0 || y >= window_height || !z_buffer)
+	if (x < 0 || x >= render_width || y < 0 || y >= render_height || !z_buffer)
 	{
 		fprintf(stderr, "Error: Coordinates out of bounds or z-buffer not initialized\n");
         return 1.0f;
 	}
 
-	return z_buffer[(window_width * y) + x];
+    validate_depth_tiles(x, y, x + 1, y + 1);
+	return z_buffer[(render_width * y) + x];
 }
 
 float* get_z_buffer_ptr(void)
@@ -231,12 +420,13 @@ float* get_z_buffer_ptr(void)
 
 void set_z_buffer_at(int x, int y, float depth)
 {
-	if (x < 0 || x >= window_width || y < 0 || y >= window_height || !z_buffer)
+	if (x < 0 || x >= render_width || y < 0 || y >= render_height || !z_buffer)
 	{
 		fprintf(stderr, "Error: Coordinates out of bounds or z-buffer not initialized\n");
 		return;
 	}
-	z_buffer[(window_width * y) + x] = depth;
+    validate_depth_tiles(x, y, x + 1, y + 1);
+	z_buffer[(render_width * y) + x] = depth;
 }
 
 SDL_Texture* get_color_buffer_texture(void)
@@ -254,34 +444,305 @@ enum cull_method get_cull_method(void)
     return cull_method;
 }
 
+/*
+* Fills count 32-bit words with a bit pattern, using 64-byte SSE2 stores (non-temporal
+* when streaming) for the aligned middle part.
+*/
+static void fill_words(void* buffer, size_t count, uint32_t pattern, bool streaming)
+{
+    unsigned char* dst = (unsigned char*)buffer;
+    size_t i = 0;
+
+#ifdef BRH_CLEAR_SSE2
+    for (; i < count && ((uintptr_t)(dst + i * 4) & 15) != 0; i++) {
+        memcpy(dst + i * 4, &pattern, 4);
+    }
+
+    const __m128i value = _mm_set1_epi32((int)pattern);
+    if (streaming) {
+        for (; i + 16 <= count; i += 16) {
+            __m128i* p = (__m128i*)(dst + i * 4);
+            _mm_stream_si128(p + 0, value);
+            _mm_stream_si128(p + 1, value);
+            _mm_stream_si128(p + 2, value);
+            _mm_stream_si128(p + 3, value);
+        }
+        _mm_sfence(); // Make the streamed stores visible before the job reports completion
+    }
+    else {
+        for (; i + 16 <= count; i += 16) {
+            __m128i* p = (__m128i*)(dst + i * 4);
+            _mm_store_si128(p + 0, value);
+            _mm_store_si128(p + 1, value);
+            _mm_store_si128(p + 2, value);
+            _mm_store_si128(p + 3, value);
+        }
+    }
+#else
+    (void)streaming;
+#endif
+
+    for (; i < count; i++) {
+        memcpy(dst + i * 4, &pattern, 4);
+    }
+}
+
+typedef struct {
+    void* buffer;        // Color buffer or z-buffer (both 32 bits per pixel)
+    int pitch;           // Pixels between the starts of consecutive rows
+    uint32_t pattern;    // Bits to store in every pixel
+    bool streaming;
+} brh_clear_job;
+
+static void clear_buffer_rows(void* data, int row_begin, int row_end)
+{
+    const brh_clear_job* job = (const brh_clear_job*)data;
+    unsigned char* first = (unsigned char*)job->buffer + (size_t)row_begin * job->pitch * 4;
+
+    // Packed rows are one contiguous run; padded rows are filled one at a time
+    if (job->pitch == render_width) {
+        fill_words(first, (size_t)(row_end - row_begin) * render_width, job->pattern, job->streaming);
+        return;
+    }
+    for (int y = row_begin; y < row_end; y++) {
+        fill_words(first + (size_t)(y - row_begin) * job->pitch * 4, render_width, job->pattern, job->streaming);
+    }
+}
+
+// Clears a full-screen 32-bit buffer, split by rows across the job workers
+static void clear_buffer(void* buffer, int pitch, uint32_t pattern)
+{
+    const size_t bytes = (size_t)pitch * render_height * 4;
+    brh_clear_job job = { buffer, pitch, pattern, bytes >= BRH_STREAMING_CLEAR_BYTES };
+    parallel_for(render_height, BRH_CLEAR_ROWS_PER_JOB, clear_buffer_rows, &job);
+}
+
 void clear_color_buffer(uint32_t color)
 {
     if (!color_buffer) return;
 
-    for (int i = 0; i < window_width * window_height; i++)
-    {
-        color_buffer[i] = color;
-    }
+    BRH_PROFILE_BEGIN(clear_color_buffer);
+    presented_frame_retained = false;
+    clear_buffer(color_buffer, color_buffer_pitch, color);
+    BRH_PROFILE_END(clear_color_buffer);
 }
 
 void clear_z_buffer(void)
 {
     if (!z_buffer) return;
 
-    const int num_pixels = window_width * window_height;
-    for (int i = 0; i < num_pixels; i++)
+    BRH_PROFILE_BEGIN(clear_z_buffer);
+    if (depth_clear_method == DEPTH_CLEAR_TILE_EPOCH) {
+        // Every tile becomes stale; the rasterizer clears the ones it touches
+        if (++depth_epoch == 0) {
+            memset(depth_tile_epochs, 0, sizeof(uint32_t) * depth_tiles_x * depth_tiles_y);
+            depth_epoch = 1;
+        }
+    }
+    else {
+        clear_buffer(z_buffer, render_width, 0); // 0.0f: "infinitely far" (smallest possible 1/w)
+    }
+    BRH_PROFILE_END(clear_z_buffer);
+}
+
+void set_depth_clear_method(enum depth_clear_method method)
+{
+    // Bring every tile up to date so the full-clear path sees a consistent buffer
+    if (method == DEPTH_CLEAR_FULL) {
+        validate_depth_tiles(0, 0, render_width, render_height);
+    }
+    depth_clear_method = method;
+}
+
+enum depth_clear_method get_depth_clear_method(void)
+{
+    return depth_clear_method;
+}
+
+void validate_depth_tiles(int x0, int y0, int x1, int y1)
+{
+    if (depth_clear_method != DEPTH_CLEAR_TILE_EPOCH || !z_buffer || !depth_tile_epochs) return;
+
+    x0 = MAX(x0, 0);
+    y0 = MAX(y0, 0);
+    x1 = MIN(x1, render_width);
+    y1 = MIN(y1, render_height);
+    if (x0 >= x1 || y0 >= y1) return;
+
+    for (int ty = y0 / BRH_DEPTH_TILE_SIZE; ty <= (y1 - 1) / BRH_DEPTH_TILE_SIZE; ty++) {
+        for (int tx = x0 / BRH_DEPTH_TILE_SIZE; tx <= (x1 - 1) / BRH_DEPTH_TILE_SIZE; tx++) {
+            uint32_t* epoch = &depth_tile_epochs[ty * depth_tiles_x + tx];
+            if (*epoch == depth_epoch) continue;
+
+            // First touch this frame: clear the tile (clipped to the buffer)
+            const int tile_x = tx * BRH_DEPTH_TILE_SIZE;
+            const int tile_y = ty * BRH_DEPTH_TILE_SIZE;
+            const int tile_w = MIN(BRH_DEPTH_TILE_SIZE, render_width - tile_x);
+            const int tile_h = MIN(BRH_DEPTH_TILE_SIZE, render_height - tile_y);
+            for (int y = tile_y; y < tile_y + tile_h; y++) {
+                memset(z_buffer + (size_t)y * render_width + tile_x, 0, sizeof(float) * tile_w);
+            }
+            *epoch = depth_epoch;
+        }
+    }
+}
+
+void set_frame_sink(brh_frame_sink sink, void* user_data)
+{
+    frame_sink = sink;
+    frame_sink_user_data = user_data;
+}
+
+bool write_ppm(const char* path, const uint32_t* pixels, int width, int height)
+{
+    if (!path || !pixels || width <= 0 || height <= 0)
+    {
+        fprintf(stderr, "Error: Invalid arguments to write_ppm\n");
+        return false;
+    }
+
+    FILE* file = fopen(path, "wb");
+    if (!file)
     {
-        z_buffer[i] = 0.0f; // Initialize to "infinitely far" (smallest possible 1/w)
+        fprintf(stderr, "Error: Could not open %s for writing\n", path);
+        return false;
     }
+
+    fprintf(file, "P6\n%d %d\n255\n", width, height);
+
+    // Convert one ARGB row at a time to packed RGB
+    uint8_t* row = (uint8_t*)malloc((size_t)width * 3);
+    if (!row)
+    {
+        fprintf(stderr, "Error: Failed to allocate PPM row buffer\n");
+        fclose(file);
+        return false;
+    }
+
+    bool ok = true;
+    for (int y = 0; y < height && ok; y++)
+    {
+        const uint32_t* src = pixels + (size_t)y * width;
+        for (int x = 0; x < width; x++)
+        {
+            row[x * 3 + 0] = (uint8_t)((src[x] >> 16) & 0xFF);
+            row[x * 3 + 1] = (uint8_t)((src[x] >> 8) & 0xFF);
+            row[x * 3 + 2] = (uint8_t)(src[x] & 0xFF);
+        }
+        ok = fwrite(row, 3, (size_t)width, file) == (size_t)width;
+    }
+
+    free(row);
+    fclose(file);
+
+    if (!ok)
+    {
+        fprintf(stderr, "Error: Failed to write %s\n", path);
+    }
+    return ok;
+}
+
+void ppm_frame_sink(const uint32_t* pixels, int width, int height, int frame, void* user_data)
+{
+    const char* path_pattern = (const char*)user_data;
+    if (!path_pattern) return;
+
+    char path[1024];
+    snprintf(path, sizeof(path), path_pattern, frame);
+    write_ppm(path, pixels, width, height);
 }
 
 void render_color_buffer(void)
 {
-    if (!color_buffer || !color_buffer_texture || !renderer) return;
+    if (!color_buffer) return;
+
+    BRH_PROFILE_BEGIN(render_color_buffer);
+
+    // Hand the finished frame to the sink (file writer, capture callback, ...)
+    if (frame_sink)
+    {
+        const uint32_t* pixels = color_buffer;
+        if (color_buffer_pitch != render_width)
+        {
+            // Sinks take packed rows; repack the padded texture rows
+            if (!packed_frame)
+            {
+                packed_frame = (uint32_t*)malloc(sizeof(uint32_t) * window_width * window_height);
+            }
+            if (packed_frame)
+            {
+                for (int y = 0; y < render_height; y++)
+                {
+                    memcpy(packed_frame + (size_t)y * render_width, color_buffer + (size_t)y * color_buffer_pitch, sizeof(uint32_t) * render_width);
+                }
+            }
+            pixels = packed_frame;
+        }
+        if (pixels)
+        {
+            frame_sink(pixels, render_width, render_height, frame_index, frame_sink_user_data);
+        }
+    }
+    frame_index++;
 
-    SDL_UpdateTexture(color_buffer_texture, NULL, color_buffer, window_width * sizeof(uint32_t));
-    SDL_RenderTexture(renderer, color_buffer_texture, NULL, NULL);
-    SDL_RenderPresent(renderer);
+    if (!headless && color_buffer_texture && renderer)
+    {
+        // Only the top-left render_width x render_height region holds the frame; it is
+        // stretched over the whole window
+        const SDL_Rect region = { 0, 0, render_width, render_height };
+        const SDL_FRect source = { 0.0f, 0.0f, (float)render_width, (float)render_height };
+        if (color_buffer_locked)
+        {
+            // The frame was rasterized straight into the texture: unlock it to present,
+            // then lock it again for the next frame
+            SDL_UnlockTexture(color_buffer_texture);
+            color_buffer = NULL;
+            color_buffer_locked = false;
+        }
+        else
+        {
+            SDL_UpdateTexture(color_buffer_texture, &region, color_buffer, color_buffer_pitch * (int)sizeof(uint32_t));
+        }
+        SDL_RenderTexture(renderer, color_buffer_texture, &source, NULL);
+        draw_profiler_overlay(renderer);
+        SDL_RenderPresent(renderer);
+
+        if (!color_buffer && !acquire_color_buffer())
+        {
+            fprintf(stderr, "Error: Failed to allocate color buffer\n");
+        }
+    }
+
+    // A CPU buffer keeps its pixels; a relocked texture's contents are undefined
+    presented_frame_retained = color_buffer != NULL && !color_buffer_locked;
+
+    BRH_PROFILE_END(render_color_buffer);
+}
+
+bool is_presented_frame_retained(void)
+{
+    return presented_frame_retained;
+}
+
+void set_present_method(enum present_method method)
+{
+    if (method == present_method) return;
+    present_method = method;
+
+    // Switch the existing color buffer over (its contents are not preserved)
+    if (color_buffer)
+    {
+        release_color_buffer();
+        if (!acquire_color_buffer())
+        {
+            fprintf(stderr, "Error: Failed to allocate color buffer\n");
+        }
+    }
+}
+
+enum present_method get_present_method(void)
+{
+    return present_method;
 }
 
 void set_render_method(enum render_method method)
@@ -296,25 +757,26 @@ void set_cull_method(enum cull_method method)
 
 void draw_pixel(int x, int y, uint32_t color)
 {
-    if (x < 0 || x >= window_width || y < 0 || y >= window_height || !color_buffer)
+    if (x < 0 || x >= render_width || y < 0 || y >= render_height || !color_buffer)
     {
         return;
     }
 
-    color_buffer[(window_width * y) + x] = color;
+    color_buffer[(color_buffer_pitch * y) + x] = color;
 }
 
 void draw_pixel_with_depth(int x, int y, float depth, uint32_t color)
 {
-    if (x < 0 || x >= window_width || y < 0 || y >= window_height || !color_buffer || !z_buffer)
+    if (x < 0 || x >= render_width || y < 0 || y >= render_height || !color_buffer || !z_buffer)
     {
         return;
     }
 
-    int index = (window_width * y) + x;
+    validate_depth_tiles(x, y, x + 1, y + 1);
+    int index = (render_width * y) + x;
     if (depth > z_buffer[index])
     {
-        color_buffer[index] = color;
+        color_buffer[(color_buffer_pitch * y) + x] = color;
         z_buffer[index] = depth;
     }
 }
@@ -322,18 +784,18 @@ void draw_pixel_with_depth(int x, int y, float depth, uint32_t color)
 void draw_grid(int cell_size, uint32_t color)
 {
     // Draw vertical lines
-    for (int x = 0; x < window_width; x += cell_size)
+    for (int x = 0; x < render_width; x += cell_size)
     {
-        for (int y = 0; y < window_height; y++)
+        for (int y = 0; y < render_height; y++)
         {
             draw_pixel(x, y, color);
         }
     }
 
     // Draw horizontal lines
-    for (int y = 0; y < window_height; y += cell_size)
+    for (int y = 0; y < render_height; y += cell_size)
     {
-        for (int x = 0; x < window_width; x++)
+        for (int x = 0; x < render_width; x++)
         {
             draw_pixel(x, y, color);
         }
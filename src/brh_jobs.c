@@ -0,0 +1,345 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <SDL3/SDL.h>
+#include "brh_jobs.h"
+#include "brh_affinity.h"
+#include "math_utils.h"
+
+// Iterations a worker polls for new jobs before going to sleep
+#define BRH_JOB_SPIN_COUNT 64
+
+typedef struct {
+    brh_job job;
+    brh_job_counter* counter;
+} brh_queued_job;
+
+// Bounded deque. The owner pushes and pops at the bottom, thieves take from the top.
+typedef struct {
+    brh_queued_job jobs[BRH_JOB_DEQUE_SIZE];
+    int top;             // Oldest job
+    int bottom;          // One past the newest job
+    SDL_SpinLock lock;
+} brh_job_deque;
+
+// deques[0] is the injection deque shared by non-worker threads, deques[i] belongs to worker i
+static brh_job_deque* deques = NULL;
+static SDL_Thread* workers[BRH_MAX_JOB_WORKERS];
+static int worker_count = 0;
+static brh_job_system_options worker_options;
+
+static SDL_AtomicInt queued_jobs;            // Jobs sitting in any deque
+static SDL_Mutex* wake_mutex = NULL;
+static SDL_Condition* wake_condition = NULL; // Signaled when jobs are queued, a counter reaches zero, or on shutdown
+static bool workers_quit = false;
+
+static SDL_TLSID worker_index_tls;           // Worker index of the current thread, unset (0) elsewhere
+
+/* --------- Deques --------- */
+static bool push_job(brh_job_deque* deque, const brh_queued_job* queued)
+{
+    bool pushed = false;
+    SDL_LockSpinlock(&deque->lock);
+    if (deque->bottom - deque->top < BRH_JOB_DEQUE_SIZE) {
+        deque->jobs[deque->bottom % BRH_JOB_DEQUE_SIZE] = *queued;
+        deque->bottom++;
+        pushed = true;
+    }
+    SDL_UnlockSpinlock(&deque->lock);
+    return pushed;
+}
+
+static bool pop_job(brh_job_deque* deque, brh_queued_job* out)
+{
+    bool popped = false;
+    SDL_LockSpinlock(&deque->lock);
+    if (deque->bottom > deque->top) {
+        deque->bottom--;
+        *out = deque->jobs[deque->bottom % BRH_JOB_DEQUE_SIZE];
+        popped = true;
+    }
+    if (deque->bottom == deque->top) {
+        deque->bottom = deque->top = 0;
+    }
+    SDL_UnlockSpinlock(&deque->lock);
+    return popped;
+}
+
+static bool steal_job(brh_job_deque* deque, brh_queued_job* out)
+{
+    bool stolen = false;
+    SDL_LockSpinlock(&deque->lock);
+    if (deque->bottom > deque->top) {
+        *out = deque->jobs[deque->top % BRH_JOB_DEQUE_SIZE];
+        deque->top++;
+        stolen = true;
+    }
+    if (deque->bottom == deque->top) {
+        deque->bottom = deque->top = 0;
+    }
+    SDL_UnlockSpinlock(&deque->lock);
+    return stolen;
+}
+
+// Takes a job from the thread's own deque, or steals one from the others
+static bool find_job(int self, brh_queued_job* out)
+{
+    if (SDL_GetAtomicInt(&queued_jobs) == 0) {
+        return false;
+    }
+
+    bool found = pop_job(&deques[self], out);
+    for (int i = 1; !found && i <= worker_count; i++) {
+        found = steal_job(&deques[(self + i) % (worker_count + 1)], out);
+    }
+
+    if (found) {
+        SDL_AddAtomicInt(&queued_jobs, -1);
+    }
+    return found;
+}
+
+static void wake_waiting_threads(void)
+{
+    SDL_LockMutex(wake_mutex);
+    SDL_BroadcastCondition(wake_condition);
+    SDL_UnlockMutex(wake_mutex);
+}
+
+static void execute_job(const brh_queued_job* queued)
+{
+    queued->job.func(queued->job.data);
+
+    // The last job of a counter wakes the threads waiting on it
+    if (queued->counter && SDL_AddAtomicInt(&queued->counter->pending, -1) == 1) {
+        wake_waiting_threads();
+    }
+}
+
+/* --------- Workers --------- */
+static int worker_main(void* data)
+{
+    const int self = (int)(intptr_t)data;
+    SDL_SetTLS(&worker_index_tls, data, NULL);
+
+    if (worker_options.pin_workers) {
+        pin_current_thread(self % SDL_GetNumLogicalCPUCores());
+    }
+    if (worker_options.low_priority) {
+        SDL_SetCurrentThreadPriority(SDL_THREAD_PRIORITY_LOW);
+    }
+
+    for (;;) {
+        brh_queued_job queued;
+        if (find_job(self, &queued)) {
+            execute_job(&queued);
+            continue;
+        }
+
+        // Poll briefly before sleeping, since jobs usually arrive in bursts
+        for (int spin = 0; spin < BRH_JOB_SPIN_COUNT && SDL_GetAtomicInt(&queued_jobs) == 0; spin++) {
+            SDL_CPUPauseInstruction();
+        }
+
+        SDL_LockMutex(wake_mutex);
+        while (!workers_quit && SDL_GetAtomicInt(&queued_jobs) == 0) {
+            SDL_WaitCondition(wake_condition, wake_mutex);
+        }
+        const bool quit = workers_quit;
+        SDL_UnlockMutex(wake_mutex);
+        if (quit) break;
+    }
+    return 0;
+}
+
+bool initialize_job_system(const brh_job_system_options* options)
+{
+    cleanup_job_system();
+
+    brh_job_system_options defaults = { .worker_count = -1, .pin_workers = false, .low_priority = false };
+    worker_options = options ? *options : defaults;
+
+    int requested_workers = worker_options.worker_count;
+    if (requested_workers < 0) {
+        requested_workers = SDL_GetNumLogicalCPUCores() - 1;
+    }
+    requested_workers = MAX(0, MIN(BRH_MAX_JOB_WORKERS, requested_workers));
+
+    deques = (brh_job_deque*)calloc((size_t)requested_workers + 1, sizeof(brh_job_deque));
+    wake_mutex = SDL_CreateMutex();
+    wake_condition = SDL_CreateCondition();
+    if (!deques || !wake_mutex || !wake_condition) {
+        fprintf(stderr, "Error: Could not create job system state: %s\n", SDL_GetError());
+        cleanup_job_system();
+        return false;
+    }
+
+    SDL_SetAtomicInt(&queued_jobs, 0);
+    workers_quit = false;
+
+    // Workers are numbered from 1; each starts stealing as soon as it runs
+    for (int i = 0; i < requested_workers; i++) {
+        workers[i] = SDL_CreateThread(worker_main, "brh_worker", (void*)(intptr_t)(i + 1));
+        if (!workers[i]) {
+            fprintf(stderr, "Error: Could not create job worker thread: %s\n", SDL_GetError());
+            cleanup_job_system();
+            return false;
+        }
+        worker_count++;
+    }
+
+    return true;
+}
+
+void cleanup_job_system(void)
+{
+    if (wake_mutex) {
+        SDL_LockMutex(wake_mutex);
+        workers_quit = true;
+        SDL_BroadcastCondition(wake_condition);
+        SDL_UnlockMutex(wake_mutex);
+    }
+
+    for (int i = 0; i < worker_count; i++) {
+        SDL_WaitThread(workers[i], NULL);
+        workers[i] = NULL;
+    }
+    worker_count = 0;
+
+    if (wake_condition) {
+        SDL_DestroyCondition(wake_condition);
+        wake_condition = NULL;
+    }
+    if (wake_mutex) {
+        SDL_DestroyMutex(wake_mutex);
+        wake_mutex = NULL;
+    }
+    free(deques);
+    deques = NULL;
+}
+
+int get_job_worker_count(void)
+{
+    return worker_count;
+}
+
+int get_current_job_worker_index(void)
+{
+    return (int)(intptr_t)SDL_GetTLS(&worker_index_tls);
+}
+
+/* --------- Submission --------- */
+void submit_jobs(const brh_job* jobs, int count, brh_job_counter* counter)
+{
+    if (count <= 0) return;
+
+    if (counter) {
+        SDL_AddAtomicInt(&counter->pending, count);
+    }
+
+    // Without workers there is nobody to hand the jobs to
+    if (worker_count == 0) {
+        for (int i = 0; i < count; i++) {
+            const brh_queued_job queued = { jobs[i], counter };
+            execute_job(&queued);
+        }
+        return;
+    }
+
+    // Counted before pushing so a sleeping worker never misses a queued job
+    brh_job_deque* deque = &deques[get_current_job_worker_index()];
+    SDL_AddAtomicInt(&queued_jobs, count);
+
+    int overflow = count;
+    for (int i = 0; i < count; i++) {
+        const brh_queued_job queued = { jobs[i], counter };
+        if (!push_job(deque, &queued)) {
+            overflow = i;
+            break;
+        }
+    }
+
+    if (overflow < count) {
+        SDL_AddAtomicInt(&queued_jobs, -(count - overflow));
+    }
+    wake_waiting_threads();
+
+    // The deque is full; run the rest here while the workers drain it
+    for (int i = overflow; i < count; i++) {
+        const brh_queued_job queued = { jobs[i], counter };
+        execute_job(&queued);
+    }
+}
+
+void wait_for_jobs(brh_job_counter* counter)
+{
+    if (!counter) return;
+
+    const int self = get_current_job_worker_index();
+    while (SDL_GetAtomicInt(&counter->pending) > 0) {
+        brh_queued_job queued;
+        if (worker_count > 0 && find_job(self, &queued)) {
+            execute_job(&queued);
+            continue;
+        }
+
+        // Everything left is running on other threads
+        SDL_LockMutex(wake_mutex);
+        while (SDL_GetAtomicInt(&counter->pending) > 0 && SDL_GetAtomicInt(&queued_jobs) == 0) {
+            SDL_WaitCondition(wake_condition, wake_mutex);
+        }
+        SDL_UnlockMutex(wake_mutex);
+    }
+}
+
+void run_jobs(const brh_job* jobs, int count)
+{
+    if (count <= 0) return;
+
+    // A single job gains nothing from being handed off
+    if (count == 1) {
+        jobs[0].func(jobs[0].data);
+        return;
+    }
+
+    brh_job_counter counter = { 0 };
+    submit_jobs(jobs, count, &counter);
+    wait_for_jobs(&counter);
+}
+
+typedef struct {
+    brh_range_func func;
+    void* data;
+    int begin;
+    int end;
+} brh_parallel_range;
+
+static void run_parallel_range(void* data)
+{
+    const brh_parallel_range* range = (const brh_parallel_range*)data;
+    range->func(range->data, range->begin, range->end);
+}
+
+void parallel_for(int count, int grain, brh_range_func func, void* data)
+{
+    if (count <= 0) return;
+
+    grain = MAX(1, grain);
+    int job_count = MIN(BRH_PARALLEL_FOR_MAX_JOBS, (count + grain - 1) / grain);
+    if (job_count <= 1 || worker_count == 0) {
+        func(data, 0, count);
+        return;
+    }
+
+    const int per_job = (count + job_count - 1) / job_count;
+    brh_parallel_range ranges[BRH_PARALLEL_FOR_MAX_JOBS];
+    brh_job jobs[BRH_PARALLEL_FOR_MAX_JOBS];
+    job_count = 0;
+    for (int begin = 0; begin < count; begin += per_job) {
+        ranges[job_count] = (brh_parallel_range){ func, data, begin, MIN(count, begin + per_job) };
+        jobs[job_count] = (brh_job){ run_parallel_range, &ranges[job_count] };
+        job_count++;
+    }
+
+    run_jobs(jobs, job_count);
+}
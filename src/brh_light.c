@@ -1,9 +1,15 @@
 #include <stdint.h>
+#include <stdio.h>
 #include <math.h>
 #include "brh_light.h"
 #include "brh_vector.h"
 #include "math_utils.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BRH_LIGHT_SSE2
+#include <emmintrin.h>
+#endif
+
 static enum shading_method renderer_shading_method = SHADING_FLAT;
 
 static brh_global_light global_light = {
@@ -14,6 +20,12 @@ static brh_global_light global_light = {
     .specular_power = 64 // Common default shininess
 };
 
+// Point and spot lights, addressed by handle
+static brh_slot_map local_light_map = BRH_SLOT_MAP_INIT(sizeof(brh_local_light));
+
+// Bumped by every change to any light
+static uint32_t light_version = 1;
+
 
 shading_method get_shading_method(void)
 {
@@ -33,6 +45,7 @@ brh_global_light get_global_light(void)
 void set_global_light_direction(brh_vector3 direction)
 {
     global_light.direction = vec3_unit_vector(direction);
+    light_version++;
 }
 
 
@@ -42,6 +55,150 @@ void set_light_parameters(float ambient, float diffuse, float specular, int spec
     global_light.diffuse = (float)fmax(0.0f, fmin(1.0f, diffuse));
     global_light.specular = (float)fmax(0.0f, fmin(1.0f, specular));
     global_light.specular_power = (int)fmax(1, specular_power);
+    light_version++;
+}
+
+// Checks a light's parameters and copies them with the direction normalized
+static bool validate_local_light(const brh_local_light* light, brh_local_light* out)
+{
+    if (!light || !(light->radius > 0.0f)) {
+        fprintf(stderr, "Error: Local light radius must be positive\n");
+        return false;
+    }
+    if (light->type == LIGHT_SPOT && !(light->inner_angle >= 0.0f && light->inner_angle <= light->outer_angle && light->outer_angle < (float)M_PI)) {
+        fprintf(stderr, "Error: Spot light angles must satisfy 0 <= inner <= outer < pi\n");
+        return false;
+    }
+
+    *out = *light;
+    if (light->type == LIGHT_SPOT) {
+        out->direction = vec3_unit_vector(light->direction);
+    }
+    return true;
+}
+
+brh_light_handle create_local_light(const brh_local_light* light)
+{
+    brh_local_light validated;
+    if (!validate_local_light(light, &validated)) {
+        return BRH_NULL_HANDLE;
+    }
+    if (local_light_map.count >= BRH_MAX_LOCAL_LIGHTS) {
+        fprintf(stderr, "Error: Maximum number of local lights (%d) reached\n", BRH_MAX_LOCAL_LIGHTS);
+        return BRH_NULL_HANDLE;
+    }
+
+    brh_light_handle light_handle;
+    brh_local_light* entry = (brh_local_light*)insert_slot_map_item(&local_light_map, &light_handle);
+    if (!entry) {
+        return BRH_NULL_HANDLE;
+    }
+    *entry = validated;
+    light_version++;
+    return light_handle;
+}
+
+bool set_local_light(brh_light_handle light_handle, const brh_local_light* light)
+{
+    brh_local_light* entry = (brh_local_light*)get_slot_map_item(&local_light_map, light_handle);
+    if (!entry || !validate_local_light(light, entry)) {
+        return false;
+    }
+    light_version++;
+    return true;
+}
+
+void destroy_local_light(brh_light_handle light_handle)
+{
+    if (remove_slot_map_item(&local_light_map, light_handle)) {
+        light_version++;
+    }
+}
+
+void cleanup_local_lights(void)
+{
+    cleanup_slot_map(&local_light_map);
+    light_version++;
+}
+
+const brh_local_light* get_local_lights(int* count)
+{
+    *count = local_light_map.count;
+    return (const brh_local_light*)local_light_map.items;
+}
+
+uint32_t get_light_version(void)
+{
+    return light_version;
+}
+
+brh_shading_light prepare_shading_light(const brh_local_light* light)
+{
+    const bool is_spot = light->type == LIGHT_SPOT;
+    brh_shading_light shading_light = {
+        .position = light->position,
+        .direction = light->direction,
+        .color = light->color,
+        .radius_squared = light->radius * light->radius,
+        .cos_inner = is_spot ? cosf(light->inner_angle) : -1.0f,
+        .cos_outer = is_spot ? cosf(light->outer_angle) : -1.0f,
+    };
+    return shading_light;
+}
+
+/*
+* Adds the diffuse and specular light of every listed local light at a point, per color
+* channel. The falloff (1 - d^2/r^2)^2 reaches zero, with zero slope, at the radius, so a
+* light's tile bounds can stop there. Pass a NULL view direction to skip specular.
+*/
+static void accumulate_local_lights(const brh_light_list* local_lights, brh_vector3 normal, brh_vector3 point,
+    const brh_vector3* view_direction, brh_vector3* diffuse, brh_vector3* specular)
+{
+    for (int i = 0; i < local_lights->count; i++) {
+        const brh_shading_light* light = &local_lights->lights[local_lights->indices[i]];
+
+        const brh_vector3 to_light = vec3_subtract(light->position, point);
+        const float distance_squared = vec3_dot(to_light, to_light);
+        if (distance_squared >= light->radius_squared || distance_squared < EPSILON) {
+            continue;
+        }
+        const brh_vector3 light_direction = vec3_scale(to_light, 1.0f / sqrtf(distance_squared));
+        const float n_dot_l = vec3_dot(normal, light_direction);
+        if (n_dot_l <= 0.0f) {
+            continue;
+        }
+
+        const float window = 1.0f - distance_squared / light->radius_squared;
+        float strength = window * window;
+
+        // Spot cone: smooth fade between the outer and inner angles
+        if (light->cos_outer > -1.0f) {
+            const float cos_angle = -vec3_dot(light_direction, light->direction);
+            if (cos_angle <= light->cos_outer) {
+                continue;
+            }
+            if (cos_angle < light->cos_inner) {
+                const float t = (cos_angle - light->cos_outer) / (light->cos_inner - light->cos_outer);
+                strength *= t * t * (3.0f - 2.0f * t);
+            }
+        }
+
+        const float diffuse_strength = n_dot_l * strength;
+        diffuse->x += light->color.x * diffuse_strength;
+        diffuse->y += light->color.y * diffuse_strength;
+        diffuse->z += light->color.z * diffuse_strength;
+
+        if (view_direction && global_light.specular > EPSILON) {
+            const brh_vector3 reflected = vec3_subtract(vec3_scale(normal, 2.0f * n_dot_l), light_direction);
+            const float r_dot_v = vec3_dot(reflected, *view_direction);
+            if (r_dot_v > EPSILON) {
+                const float specular_strength = global_light.specular * powf(r_dot_v, (float)global_light.specular_power) * strength;
+                specular->x += light->color.x * specular_strength;
+                specular->y += light->color.y * specular_strength;
+                specular->z += light->color.z * specular_strength;
+            }
+        }
+    }
 }
 
 // Helper to apply intensity to a color component
@@ -63,7 +220,8 @@ static uint8_t add_component_clamped(uint8_t c1, uint8_t c2) {
 
 
 // --- Flat Shading Calculation ---
-uint32_t calculate_flat_shading_color(brh_vector3 face_normal_world, uint32_t baseColor)
+uint32_t calculate_flat_shading_color(brh_vector3 face_normal_world, brh_vector3 face_pos_world, uint32_t baseColor,
+    const brh_light_list* local_lights, float light_visibility)
 {
     brh_global_light light = get_global_light(); // Get current light settings
 
@@ -79,8 +237,14 @@ uint32_t calculate_flat_shading_color(brh_vector3 face_normal_world, uint32_t ba
 
     // Calculate final intensity (Ambient + Diffuse)
     // Note: Flat shading typically doesn't include specular highlights
-    float intensity = light.ambient + (light.diffuse * diffuse_factor);
-    intensity = MIN(1.0f, intensity); // Clamp intensity
+    float intensity = light.ambient + (light.diffuse * diffuse_factor * light_visibility);
+
+    // Local lights tint each channel separately
+    brh_vector3 local_diffuse = { 0.0f, 0.0f, 0.0f };
+    brh_vector3 local_specular = { 0.0f, 0.0f, 0.0f };
+    if (local_lights && local_lights->count > 0) {
+        accumulate_local_lights(local_lights, face_normal_world, face_pos_world, NULL, &local_diffuse, &local_specular);
+    }
 
     // Extract base color components
     uint8_t a = (baseColor >> 24) & 0xFF;
@@ -89,9 +253,9 @@ uint32_t calculate_flat_shading_color(brh_vector3 face_normal_world, uint32_t ba
     uint8_t b = baseColor & 0xFF;
 
     // Apply intensity to each component
-    r = apply_intensity(r, intensity);
-    g = apply_intensity(g, intensity);
-    b = apply_intensity(b, intensity);
+    r = apply_intensity(r, MIN(1.0f, intensity + local_diffuse.x)); // Clamp intensity
+    g = apply_intensity(g, MIN(1.0f, intensity + local_diffuse.y));
+    b = apply_intensity(b, MIN(1.0f, intensity + local_diffuse.z));
 
     // Combine components back into an ARGB color
     return combine_argb(a, r, g, b);
@@ -101,6 +265,7 @@ static void calculate_diffuse_specular(
     brh_vector3 normal_world,
     brh_vector3 point_pos_world,
     brh_vector3 camera_pos_world,
+    float light_visibility,
     float* out_diffuse_intensity, 
     float* out_specular_intensity)
 {
@@ -109,7 +274,7 @@ static void calculate_diffuse_specular(
     // --- Diffuse Calculation ---
 	float diffuse_factor = vec3_dot(normal_world, vec3_scale(global_light.direction, -1.0));
 	diffuse_factor = MAX(0.0f, diffuse_factor);
-	*out_diffuse_intensity = global_light.ambient + (global_light.diffuse * diffuse_factor);
+	*out_diffuse_intensity = global_light.ambient + (global_light.diffuse * diffuse_factor * light_visibility);
 
     // --- Specular Calculation ---
 	*out_specular_intensity = 0.0f; // Default to zero
@@ -129,14 +294,15 @@ static void calculate_diffuse_specular(
         float R_dot_V = vec3_dot(R, V);
         if (R_dot_V > EPSILON) { // Check if reflection is towards the viewer
             float specular_factor = powf(R_dot_V, (float)global_light.specular_power);
-            *out_specular_intensity = global_light.specular * specular_factor;
+            *out_specular_intensity = global_light.specular * specular_factor * light_visibility;
         }
     }
 }
 
 
 // --- Vertex Shading Calculation (Gouraud) ---
-uint32_t calculate_vertex_shading_color(brh_vector3 vertex_normal_world, brh_vector3 vertex_pos_world, brh_vector3 camera_pos_world, uint32_t baseColor)
+uint32_t calculate_vertex_shading_color(brh_vector3 vertex_normal_world, brh_vector3 vertex_pos_world, brh_vector3 camera_pos_world, uint32_t baseColor,
+    const brh_light_list* local_lights, float light_visibility)
 {
     brh_global_light light = get_global_light();
     float diffuse_intensity, specular_intensity;
@@ -145,10 +311,20 @@ uint32_t calculate_vertex_shading_color(brh_vector3 vertex_normal_world, brh_vec
         vertex_normal_world,
         vertex_pos_world,
         camera_pos_world,
+        light_visibility,
         &diffuse_intensity,
         &specular_intensity
     );
 
+    // Local lights tint each channel separately
+    brh_vector3 local_diffuse = { 0.0f, 0.0f, 0.0f };
+    brh_vector3 local_specular = { 0.0f, 0.0f, 0.0f };
+    if (local_lights && local_lights->count > 0) {
+        const brh_vector3 view_direction = vec3_unit_vector(vec3_subtract(camera_pos_world, vertex_pos_world));
+        accumulate_local_lights(local_lights, vec3_unit_vector(vertex_normal_world), vertex_pos_world,
+            &view_direction, &local_diffuse, &local_specular);
+    }
+
     // Extract base color components
     uint8_t a_base = (baseColor >> 24) & 0xFF;
     uint8_t r_base = (baseColor >> 16) & 0xFF;
@@ -157,15 +333,14 @@ uint32_t calculate_vertex_shading_color(brh_vector3 vertex_normal_world, brh_vec
 
     // Calculate ambient and diffuse color components
     float ambient_diffuse_intensity = light.ambient + diffuse_intensity;
-    uint8_t r_ad = apply_intensity(r_base, ambient_diffuse_intensity);
-    uint8_t g_ad = apply_intensity(g_base, ambient_diffuse_intensity);
-    uint8_t b_ad = apply_intensity(b_base, ambient_diffuse_intensity);
+    uint8_t r_ad = apply_intensity(r_base, ambient_diffuse_intensity + local_diffuse.x);
+    uint8_t g_ad = apply_intensity(g_base, ambient_diffuse_intensity + local_diffuse.y);
+    uint8_t b_ad = apply_intensity(b_base, ambient_diffuse_intensity + local_diffuse.z);
 
-    // Calculate specular color component (usually white or light color)
-    // Let's use white specular for simplicity for now
-    uint8_t r_spec = apply_intensity(255, specular_intensity);
-    uint8_t g_spec = apply_intensity(255, specular_intensity);
-    uint8_t b_spec = apply_intensity(255, specular_intensity);
+    // Calculate specular color component: white for the global light, the light's color for local ones
+    uint8_t r_spec = apply_intensity(255, specular_intensity + local_specular.x);
+    uint8_t g_spec = apply_intensity(255, specular_intensity + local_specular.y);
+    uint8_t b_spec = apply_intensity(255, specular_intensity + local_specular.z);
 
     // Add components together, clamping
     uint8_t r_final = add_component_clamped(r_ad, r_spec);
@@ -175,8 +350,195 @@ uint32_t calculate_vertex_shading_color(brh_vector3 vertex_normal_world, brh_vec
     return combine_argb(a_base, r_final, g_final, b_final);
 }
 
+// --- Batched Vertex Shading (Gouraud) ---
+#ifdef BRH_LIGHT_SSE2
+// Loads up to four floats; missing lanes repeat the first one so they stay finite
+static __m128 load_lanes(const float* values, int count)
+{
+    if (count == 4) {
+        return _mm_loadu_ps(values);
+    }
+    float lanes[4];
+    for (int i = 0; i < 4; i++) {
+        lanes[i] = values[i < count ? i : 0];
+    }
+    return _mm_loadu_ps(lanes);
+}
+
+// Loads up to four colors; missing lanes are black
+static __m128i load_color_lanes(const uint32_t* colors, int count)
+{
+    if (count == 4) {
+        return _mm_loadu_si128((const __m128i*)colors);
+    }
+    uint32_t lanes[4] = { 0 };
+    for (int i = 0; i < count; i++) {
+        lanes[i] = colors[i];
+    }
+    return _mm_loadu_si128((const __m128i*)lanes);
+}
+
+static __m128 dot3_lanes(__m128 ax, __m128 ay, __m128 az, __m128 bx, __m128 by, __m128 bz)
+{
+    return _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_mul_ps(az, bz));
+}
+
+// Normalizes four vectors in place, dividing by the length like vec3_unit_vector()
+static void normalize_lanes(__m128* x, __m128* y, __m128* z)
+{
+    const __m128 magnitude = _mm_sqrt_ps(dot3_lanes(*x, *y, *z, *x, *y, *z));
+    *x = _mm_div_ps(*x, magnitude);
+    *y = _mm_div_ps(*y, magnitude);
+    *z = _mm_div_ps(*z, magnitude);
+}
+
+// Raises four values in [0, 1] to a power shared by all lanes, by repeated squaring. Terms
+// below BRH_POW_FLOOR are flushed to zero: their products would go subnormal, which is
+// very slow on most x86 cores, and would still light no channel by a level.
+#define BRH_POW_FLOOR 1e-18f
+static __m128 pow_lanes(__m128 base, int power)
+{
+    const __m128 floor = _mm_set1_ps(BRH_POW_FLOOR);
+    __m128 result = _mm_set1_ps(1.0f);
+    base = _mm_and_ps(base, _mm_cmpge_ps(base, floor));
+    while (power > 0) {
+        if (power & 1) {
+            result = _mm_mul_ps(result, base);
+            result = _mm_and_ps(result, _mm_cmpge_ps(result, floor));
+        }
+        power >>= 1;
+        if (power > 0) {
+            base = _mm_mul_ps(base, base);
+            base = _mm_and_ps(base, _mm_cmpge_ps(base, floor));
+        }
+    }
+    return result;
+}
+
+// One 8-bit channel of four colors: its lit intensities, truncated and clamped like apply_intensity()
+static __m128i light_channel_lanes(__m128i base_channel, __m128 ambient_diffuse, __m128 specular)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 max_channel = _mm_set1_ps(255.0f);
+    const __m128 lit = _mm_mul_ps(_mm_cvtepi32_ps(base_channel), ambient_diffuse);
+    const __m128 highlight = _mm_mul_ps(max_channel, specular);
+    const __m128i lit_channel = _mm_cvttps_epi32(_mm_max_ps(_mm_min_ps(lit, max_channel), zero));
+    const __m128i highlight_channel = _mm_cvttps_epi32(_mm_max_ps(_mm_min_ps(highlight, max_channel), zero));
+    // Both are at most 255, so the sum is clamped exactly in float
+    const __m128 sum = _mm_cvtepi32_ps(_mm_add_epi32(lit_channel, highlight_channel));
+    return _mm_cvttps_epi32(_mm_min_ps(sum, max_channel));
+}
+
+// Lights up to four vertices starting at first
+static void shade_vertex_lanes(const brh_vertex_batch* batch, int first, int count, brh_vector3 camera_pos_world, uint32_t* out_colors)
+{
+    // Local lights, one vertex at a time, as calculate_vertex_shading_color() gathers them
+    float local_diffuse[3][4] = { { 0.0f } };
+    float local_specular[3][4] = { { 0.0f } };
+    for (int i = 0; i < count && batch->local_lights; i++) {
+        const brh_light_list* local_lights = &batch->local_lights[first + i];
+        if (local_lights->count <= 0) {
+            continue;
+        }
+        const brh_vector3 position = { batch->position_x[first + i], batch->position_y[first + i], batch->position_z[first + i] };
+        const brh_vector3 normal = { batch->normal_x[first + i], batch->normal_y[first + i], batch->normal_z[first + i] };
+        const brh_vector3 view_direction = vec3_unit_vector(vec3_subtract(camera_pos_world, position));
+        brh_vector3 diffuse = { 0.0f, 0.0f, 0.0f };
+        brh_vector3 specular = { 0.0f, 0.0f, 0.0f };
+        accumulate_local_lights(local_lights, vec3_unit_vector(normal), position, &view_direction, &diffuse, &specular);
+        local_diffuse[0][i] = diffuse.x;
+        local_diffuse[1][i] = diffuse.y;
+        local_diffuse[2][i] = diffuse.z;
+        local_specular[0][i] = specular.x;
+        local_specular[1][i] = specular.y;
+        local_specular[2][i] = specular.z;
+    }
+
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 epsilon = _mm_set1_ps(EPSILON);
+    const __m128 visibility = batch->light_visibility ? load_lanes(&batch->light_visibility[first], count) : _mm_set1_ps(1.0f);
+
+    // Diffuse: the light travels along its direction, so the surface faces it when N.(-L) > 0
+    __m128 nx = load_lanes(&batch->normal_x[first], count);
+    __m128 ny = load_lanes(&batch->normal_y[first], count);
+    __m128 nz = load_lanes(&batch->normal_z[first], count);
+    normalize_lanes(&nx, &ny, &nz);
+    const __m128 lx = _mm_set1_ps(global_light.direction.x);
+    const __m128 ly = _mm_set1_ps(global_light.direction.y);
+    const __m128 lz = _mm_set1_ps(global_light.direction.z);
+    const __m128 minus_one = _mm_set1_ps(-1.0f);
+    const __m128 diffuse_factor = _mm_max_ps(dot3_lanes(nx, ny, nz,
+        _mm_mul_ps(lx, minus_one), _mm_mul_ps(ly, minus_one), _mm_mul_ps(lz, minus_one)), zero);
+    const __m128 ambient = _mm_set1_ps(global_light.ambient);
+    const __m128 diffuse_intensity = _mm_add_ps(ambient,
+        _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(global_light.diffuse), diffuse_factor), visibility));
+
+    // Specular: (R.V)^power, for lanes facing the light whose reflection points at the viewer
+    __m128 specular_intensity = zero;
+    if (global_light.specular > EPSILON && global_light.specular_power > 0) {
+        const __m128 two_diffuse = _mm_mul_ps(_mm_set1_ps(2.0f), diffuse_factor);
+        __m128 rx = _mm_sub_ps(_mm_mul_ps(nx, two_diffuse), lx);
+        __m128 ry = _mm_sub_ps(_mm_mul_ps(ny, two_diffuse), ly);
+        __m128 rz = _mm_sub_ps(_mm_mul_ps(nz, two_diffuse), lz);
+        normalize_lanes(&rx, &ry, &rz);
+        __m128 vx = _mm_sub_ps(_mm_set1_ps(camera_pos_world.x), load_lanes(&batch->position_x[first], count));
+        __m128 vy = _mm_sub_ps(_mm_set1_ps(camera_pos_world.y), load_lanes(&batch->position_y[first], count));
+        __m128 vz = _mm_sub_ps(_mm_set1_ps(camera_pos_world.z), load_lanes(&batch->position_z[first], count));
+        normalize_lanes(&vx, &vy, &vz);
+        const __m128 r_dot_v = dot3_lanes(rx, ry, rz, vx, vy, vz);
+        const __m128 lit = _mm_and_ps(_mm_cmpgt_ps(diffuse_factor, epsilon), _mm_cmpgt_ps(r_dot_v, epsilon));
+        const __m128 highlight = _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(global_light.specular),
+            pow_lanes(r_dot_v, global_light.specular_power)), visibility);
+        specular_intensity = _mm_and_ps(lit, highlight);
+    }
+
+    // The ambient term is counted twice, as in calculate_vertex_shading_color()
+    const __m128 ambient_diffuse = _mm_add_ps(ambient, diffuse_intensity);
+    const __m128i base = load_color_lanes(&batch->base_colors[first], count);
+    const __m128i channel_mask = _mm_set1_epi32(0xFF);
+    __m128i color = _mm_slli_epi32(_mm_srli_epi32(base, 24), 24);
+    for (int c = 0; c < 3; c++) {
+        const int shift = 16 - 8 * c;
+        const __m128i base_channel = _mm_and_si128(_mm_srli_epi32(base, shift), channel_mask);
+        const __m128i channel = light_channel_lanes(base_channel,
+            _mm_add_ps(ambient_diffuse, _mm_loadu_ps(local_diffuse[c])),
+            _mm_add_ps(specular_intensity, _mm_loadu_ps(local_specular[c])));
+        color = _mm_or_si128(color, _mm_slli_epi32(channel, shift));
+    }
+
+    if (count == 4) {
+        _mm_storeu_si128((__m128i*)&out_colors[first], color);
+    }
+    else {
+        uint32_t lanes[4];
+        _mm_storeu_si128((__m128i*)lanes, color);
+        for (int i = 0; i < count; i++) {
+            out_colors[first + i] = lanes[i];
+        }
+    }
+}
+#endif
+
+void calculate_vertex_shading_colors(const brh_vertex_batch* batch, brh_vector3 camera_pos_world, uint32_t* out_colors)
+{
+#ifdef BRH_LIGHT_SSE2
+    for (int first = 0; first < batch->count; first += 4) {
+        shade_vertex_lanes(batch, first, MIN(4, batch->count - first), camera_pos_world, out_colors);
+    }
+#else
+    for (int i = 0; i < batch->count; i++) {
+        const brh_vector3 normal = { batch->normal_x[i], batch->normal_y[i], batch->normal_z[i] };
+        const brh_vector3 position = { batch->position_x[i], batch->position_y[i], batch->position_z[i] };
+        out_colors[i] = calculate_vertex_shading_color(normal, position, camera_pos_world, batch->base_colors[i],
+            batch->local_lights ? &batch->local_lights[i] : NULL,
+            batch->light_visibility ? batch->light_visibility[i] : 1.0f);
+    }
+#endif
+}
+
 // --- Pixel Shading Calculation (Phong) ---
-uint32_t calculate_phong_shading_color(brh_vector3 interpolated_normal_world, brh_vector3 pixel_pos_world, brh_vector3 camera_pos_world, uint32_t baseColor)
+uint32_t calculate_phong_shading_color(brh_vector3 interpolated_normal_world, brh_vector3 pixel_pos_world, brh_vector3 camera_pos_world, uint32_t baseColor,
+    const brh_light_list* local_lights, float light_visibility)
 {
     // Phong calculation is identical to Gouraud at the point level,
     // the difference is *when* it's calculated (per-pixel vs per-vertex)
@@ -185,7 +547,9 @@ uint32_t calculate_phong_shading_color(brh_vector3 interpolated_normal_world, br
         interpolated_normal_world,
         pixel_pos_world,
         camera_pos_world,
-        baseColor
+        baseColor,
+        local_lights,
+        light_visibility
     );
 }
 
@@ -0,0 +1,184 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "brh_light_tiles.h"
+#include "array.h"
+#include "math_utils.h"
+
+// Tiles a light covers, inclusive; empty when x0 > x1
+typedef struct {
+    int x0, y0, x1, y1;
+} brh_tile_rect;
+
+// Lights of the frame, prepared for shading
+static brh_shading_light shading_lights[BRH_MAX_LOCAL_LIGHTS];
+static uint16_t all_light_indices[BRH_MAX_LOCAL_LIGHTS];
+static brh_tile_rect light_rects[BRH_MAX_LOCAL_LIGHTS];
+static int light_count = 0;
+
+// Grid of the frame and its lists: tile t holds tile_indices[tile_offsets[t], tile_offsets[t + 1])
+static int tiles_x = 0;
+static int tiles_y = 0;
+static float screen_width = 0.0f;
+static float screen_height = 0.0f;
+static int* tile_offsets = NULL;
+static int tile_offset_capacity = 0;
+static uint16_t* tile_indices = NULL;
+static int tile_index_capacity = 0;
+
+static brh_light_tile_stats tile_stats;
+
+// Finds the tiles a light's bounding sphere may cover
+static brh_tile_rect compute_light_rect(const brh_shading_light* light, const brh_mat4* view_projection)
+{
+    const brh_tile_rect everywhere = { 0, 0, tiles_x - 1, tiles_y - 1 };
+    const brh_tile_rect nowhere = { 0, 0, -1, -1 };
+    const float radius = sqrtf(light->radius_squared);
+
+    // Project the corners of the sphere's bounding box
+    float min_x = INFINITY, min_y = INFINITY, max_x = -INFINITY, max_y = -INFINITY;
+    for (int i = 0; i < 8; i++) {
+        const brh_vector4 corner = {
+            light->position.x + ((i & 1) ? radius : -radius),
+            light->position.y + ((i & 2) ? radius : -radius),
+            light->position.z + ((i & 4) ? radius : -radius),
+            1.0f
+        };
+        const brh_vector4 clip = mat4_mul_vec4(view_projection, corner);
+        if (clip.w <= EPSILON) {
+            // The box reaches behind the camera, where projection folds over
+            return everywhere;
+        }
+        const float x = (clip.x / clip.w + 1.0f) * 0.5f * screen_width;
+        const float y = (1.0f - clip.y / clip.w) * 0.5f * screen_height;
+        min_x = MIN(min_x, x);
+        max_x = MAX(max_x, x);
+        min_y = MIN(min_y, y);
+        max_y = MAX(max_y, y);
+    }
+
+    if (max_x < 0.0f || max_y < 0.0f || min_x >= screen_width || min_y >= screen_height) {
+        return nowhere;
+    }
+    brh_tile_rect rect = {
+        MAX(0, (int)(min_x / BRH_LIGHT_TILE_SIZE)),
+        MAX(0, (int)(min_y / BRH_LIGHT_TILE_SIZE)),
+        MIN(tiles_x - 1, (int)(max_x / BRH_LIGHT_TILE_SIZE)),
+        MIN(tiles_y - 1, (int)(max_y / BRH_LIGHT_TILE_SIZE)),
+    };
+    return rect;
+}
+
+void build_light_tiles(const brh_mat4* camera_matrix, const brh_mat4* projection_matrix,
+    int viewport_width, int viewport_height)
+{
+    memset(&tile_stats, 0, sizeof(tile_stats));
+    tiles_x = MAX(1, (viewport_width + BRH_LIGHT_TILE_SIZE - 1) / BRH_LIGHT_TILE_SIZE);
+    tiles_y = MAX(1, (viewport_height + BRH_LIGHT_TILE_SIZE - 1) / BRH_LIGHT_TILE_SIZE);
+    screen_width = (float)viewport_width;
+    screen_height = (float)viewport_height;
+
+    // Snapshot the lights so the frame's jobs never see them change
+    int count = 0;
+    const brh_local_light* lights = get_local_lights(&count);
+    light_count = MIN(count, BRH_MAX_LOCAL_LIGHTS);
+    for (int i = 0; i < light_count; i++) {
+        shading_lights[i] = prepare_shading_light(&lights[i]);
+        all_light_indices[i] = (uint16_t)i;
+    }
+
+    const int tile_count = tiles_x * tiles_y;
+    if (!reserve_buffer((void**)&tile_offsets, &tile_offset_capacity, tile_count + 1, sizeof(int), "light tile offsets")) {
+        light_count = 0;
+        tiles_x = tiles_y = 0;
+        return;
+    }
+    memset(tile_offsets, 0, sizeof(int) * (tile_count + 1));
+
+    // Count the lights of each tile, then turn the counts into list offsets
+    brh_mat4 view_projection;
+    mat4_mul_mat4_ref(camera_matrix, projection_matrix, &view_projection);
+    for (int i = 0; i < light_count; i++) {
+        light_rects[i] = compute_light_rect(&shading_lights[i], &view_projection);
+        const brh_tile_rect* rect = &light_rects[i];
+        for (int y = rect->y0; y <= rect->y1; y++) {
+            for (int x = rect->x0; x <= rect->x1; x++) {
+                tile_offsets[y * tiles_x + x + 1]++;
+            }
+        }
+    }
+    for (int t = 0; t < tile_count; t++) {
+        tile_offsets[t + 1] += tile_offsets[t];
+    }
+
+    // Fill the lists in light order; each tile's cursor starts at its offset
+    const int entries = tile_offsets[tile_count];
+    if (!reserve_buffer((void**)&tile_indices, &tile_index_capacity, MAX(1, entries), sizeof(uint16_t), "light tile entries")) {
+        light_count = 0;
+        tiles_x = tiles_y = 0;
+        return;
+    }
+    for (int i = 0; i < light_count; i++) {
+        const brh_tile_rect* rect = &light_rects[i];
+        for (int y = rect->y0; y <= rect->y1; y++) {
+            for (int x = rect->x0; x <= rect->x1; x++) {
+                tile_indices[tile_offsets[y * tiles_x + x]++] = (uint16_t)i;
+            }
+        }
+    }
+    // The fill advanced every offset to the start of the next tile; shift them back
+    for (int t = tile_count; t > 0; t--) {
+        tile_offsets[t] = tile_offsets[t - 1];
+    }
+    tile_offsets[0] = 0;
+
+    tile_stats.light_count = light_count;
+    tile_stats.tile_count = tile_count;
+    tile_stats.tile_entries = entries;
+}
+
+brh_light_list get_light_tile_list(int tile_x, int tile_y)
+{
+    brh_light_list list = { shading_lights, all_light_indices, 0 };
+    if (light_count == 0 || tile_x < 0 || tile_y < 0 || tile_x >= tiles_x || tile_y >= tiles_y) {
+        return list;
+    }
+    const int tile = tile_y * tiles_x + tile_x;
+    list.indices = &tile_indices[tile_offsets[tile]];
+    list.count = tile_offsets[tile + 1] - tile_offsets[tile];
+    return list;
+}
+
+brh_light_list get_light_list_at(brh_vector4 clip_position)
+{
+    brh_light_list list = { shading_lights, all_light_indices, light_count };
+    if (light_count == 0 || clip_position.w <= EPSILON) {
+        return list;
+    }
+
+    const float inv_w = 1.0f / clip_position.w;
+    const float x = (clip_position.x * inv_w + 1.0f) * 0.5f * screen_width;
+    const float y = (1.0f - clip_position.y * inv_w) * 0.5f * screen_height;
+    if (!(x >= 0.0f && y >= 0.0f && x < screen_width && y < screen_height)) {
+        return list;
+    }
+    return get_light_tile_list((int)(x / BRH_LIGHT_TILE_SIZE), (int)(y / BRH_LIGHT_TILE_SIZE));
+}
+
+brh_light_tile_stats get_light_tile_stats(void)
+{
+    return tile_stats;
+}
+
+void cleanup_light_tiles(void)
+{
+    free(tile_offsets);
+    free(tile_indices);
+    tile_offsets = NULL;
+    tile_indices = NULL;
+    tile_offset_capacity = 0;
+    tile_index_capacity = 0;
+    tiles_x = tiles_y = 0;
+    light_count = 0;
+}
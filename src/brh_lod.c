@@ -0,0 +1,480 @@
+#include <float.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "brh_lod.h"
+#include "brh_cluster.h"
+#include "array.h"
+#include "math_utils.h"
+
+// Open edges weigh this much more than faces, so the outline of open meshes holds
+#define BRH_LOD_BOUNDARY_WEIGHT 10.0
+// Collapses that turn a face normal by more than about 78 degrees (cosine below this) are skipped
+#define BRH_LOD_FLIP_LIMIT 0.2
+// A level that removes less than this fraction of faces is not worth keeping
+#define BRH_LOD_MIN_REDUCTION 0.1
+
+#define BRH_LOD_CACHE_MAGIC 0x444F4C48u  // "HLOD"
+#define BRH_LOD_CACHE_VERSION 1
+
+// Symmetric 4x4 error quadric: xx xy xz xw yy yz yw zz zw ww
+typedef struct {
+    double q[10];
+} brh_quadric;
+
+// A candidate collapse of vertex from onto vertex to, valid while neither has changed
+typedef struct {
+    double cost;
+    int from;
+    int to;
+    int from_stamp;
+    int to_stamp;
+} brh_collapse;
+
+typedef struct {
+    const brh_vector3* positions;
+    int (*face_vertices)[3];    // Welded vertex indices of each face
+    bool* face_alive;
+    int** vertex_faces;         // Dynamic arrays of faces around each welded vertex (may hold dead faces)
+    brh_quadric* quadrics;
+    int* stamps;
+    bool* vertex_alive;
+    brh_collapse* heap;
+    int heap_count;
+    int heap_capacity;
+} brh_simplifier;
+
+static void quadric_add_plane(brh_quadric* quadric, double nx, double ny, double nz, double d, double weight)
+{
+    double* q = quadric->q;
+    q[0] += weight * nx * nx; q[1] += weight * nx * ny; q[2] += weight * nx * nz; q[3] += weight * nx * d;
+    q[4] += weight * ny * ny; q[5] += weight * ny * nz; q[6] += weight * ny * d;
+    q[7] += weight * nz * nz; q[8] += weight * nz * d;
+    q[9] += weight * d * d;
+}
+
+static double quadric_error(const brh_quadric* a, const brh_quadric* b, brh_vector3 p)
+{
+    double q[10];
+    for (int i = 0; i < 10; i++) q[i] = a->q[i] + b->q[i];
+    const double x = p.x, y = p.y, z = p.z;
+    return q[0] * x * x + 2.0 * q[1] * x * y + 2.0 * q[2] * x * z + 2.0 * q[3] * x +
+        q[4] * y * y + 2.0 * q[5] * y * z + 2.0 * q[6] * y +
+        q[7] * z * z + 2.0 * q[8] * z +
+        q[9];
+}
+
+/* --------- Collapse Heap --------- */
+static bool heap_push(brh_simplifier* s, brh_collapse collapse)
+{
+    if (!reserve_buffer((void**)&s->heap, &s->heap_capacity, MAX(1024, s->heap_count + 1), sizeof(brh_collapse), "edge collapses")) {
+        return false;
+    }
+
+    int i = s->heap_count++;
+    while (i > 0 && s->heap[(i - 1) / 2].cost > collapse.cost) {
+        s->heap[i] = s->heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    s->heap[i] = collapse;
+    return true;
+}
+
+static brh_collapse heap_pop(brh_simplifier* s)
+{
+    const brh_collapse top = s->heap[0];
+    const brh_collapse last = s->heap[--s->heap_count];
+    int i = 0;
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= s->heap_count) break;
+        if (child + 1 < s->heap_count && s->heap[child + 1].cost < s->heap[child].cost) child++;
+        if (s->heap[child].cost >= last.cost) break;
+        s->heap[i] = s->heap[child];
+        i = child;
+    }
+    if (s->heap_count > 0) s->heap[i] = last;
+    return top;
+}
+
+// Queues the cheaper direction of collapsing the edge between a and b
+static bool push_edge(brh_simplifier* s, int a, int b)
+{
+    const double onto_b = quadric_error(&s->quadrics[a], &s->quadrics[b], s->positions[b]);
+    const double onto_a = quadric_error(&s->quadrics[a], &s->quadrics[b], s->positions[a]);
+    brh_collapse collapse = onto_b <= onto_a ?
+        (brh_collapse){ onto_b, a, b, s->stamps[a], s->stamps[b] } :
+        (brh_collapse){ onto_a, b, a, s->stamps[b], s->stamps[a] };
+    return heap_push(s, collapse);
+}
+
+static bool face_has_vertex(const int* face, int v)
+{
+    return face[0] == v || face[1] == v || face[2] == v;
+}
+
+static brh_vector3 face_cross(const brh_simplifier* s, const int* face, int from, int to)
+{
+    brh_vector3 p[3];
+    for (int k = 0; k < 3; k++) {
+        p[k] = s->positions[face[k] == from ? to : face[k]];
+    }
+    return vec3_cross(vec3_subtract(p[1], p[0]), vec3_subtract(p[2], p[0]));
+}
+
+// Whether moving vertex from onto to keeps every surviving face around it facing the same way
+static bool is_collapse_valid(const brh_simplifier* s, int from, int to)
+{
+    int* faces = s->vertex_faces[from];
+    for (int i = 0; i < array_length(faces); i++) {
+        const int f = faces[i];
+        if (!s->face_alive[f] || face_has_vertex(s->face_vertices[f], to)) continue;
+
+        const brh_vector3 before = face_cross(s, s->face_vertices[f], -1, -1);
+        const brh_vector3 after = face_cross(s, s->face_vertices[f], from, to);
+        const double length_before = vec3_magnitude(before);
+        const double length_after = vec3_magnitude(after);
+        if (length_after <= 1e-12 * MAX(1.0, length_before)) return false;
+        if (vec3_dot(before, after) < BRH_LOD_FLIP_LIMIT * length_before * length_after) return false;
+    }
+    return true;
+}
+
+// Collapses vertex from onto to and returns the number of faces removed
+static int collapse_edge(brh_simplifier* s, int from, int to, int* neighbor_mark, int iteration)
+{
+    int removed = 0;
+    int* faces = s->vertex_faces[from];
+    for (int i = 0; i < array_length(faces); i++) {
+        const int f = faces[i];
+        if (!s->face_alive[f]) continue;
+        int* face = s->face_vertices[f];
+        if (face_has_vertex(face, to)) {
+            s->face_alive[f] = false;
+            removed++;
+            continue;
+        }
+        for (int k = 0; k < 3; k++) {
+            if (face[k] == from) face[k] = to;
+        }
+        array_push(s->vertex_faces[to], f);
+    }
+    array_free(s->vertex_faces[from]);
+    s->vertex_faces[from] = NULL;
+    s->vertex_alive[from] = false;
+
+    for (int i = 0; i < 10; i++) s->quadrics[to].q[i] += s->quadrics[from].q[i];
+    s->stamps[to]++;
+
+    // Requeue the survivor's edges at their new cost
+    const int* survivor = s->vertex_faces[to];
+    for (int i = 0; i < array_length((void*)survivor); i++) {
+        const int f = survivor[i];
+        if (!s->face_alive[f]) continue;
+        for (int k = 0; k < 3; k++) {
+            const int w = s->face_vertices[f][k];
+            if (w != to && neighbor_mark[w] != iteration) {
+                neighbor_mark[w] = iteration;
+                push_edge(s, to, w);
+            }
+        }
+    }
+    return removed;
+}
+
+typedef struct {
+    int a;
+    int b;
+    int face;
+} brh_lod_edge;
+
+static int compare_lod_edges(const void* x, const void* y)
+{
+    const brh_lod_edge* a = (const brh_lod_edge*)x;
+    const brh_lod_edge* b = (const brh_lod_edge*)y;
+    if (a->a != b->a) return a->a < b->a ? -1 : 1;
+    if (a->b != b->b) return a->b < b->b ? -1 : 1;
+    return a->face - b->face;
+}
+
+brh_face* simplify_mesh_faces(const brh_mesh* mesh_data, int target_faces)
+{
+    const int num_faces = array_length(mesh_data->faces);
+    const int num_vertices = array_length(mesh_data->vertices);
+    if (num_faces == 0 || num_vertices == 0) return NULL;
+
+    brh_simplifier s = { 0 };
+    s.positions = mesh_data->vertices;
+    s.face_vertices = (int(*)[3])malloc(sizeof(int[3]) * num_faces);
+    s.face_alive = (bool*)malloc(sizeof(bool) * num_faces);
+    s.vertex_faces = (int**)calloc(num_vertices, sizeof(int*));
+    s.quadrics = (brh_quadric*)calloc(num_vertices, sizeof(brh_quadric));
+    s.stamps = (int*)calloc(num_vertices, sizeof(int));
+    s.vertex_alive = (bool*)calloc(num_vertices, sizeof(bool));
+    int* weld = (int*)malloc(sizeof(int) * num_vertices);
+    int* neighbor_mark = (int*)malloc(sizeof(int) * num_vertices);
+    brh_lod_edge* edges = (brh_lod_edge*)malloc(sizeof(brh_lod_edge) * 3 * (size_t)num_faces);
+    brh_face* result = NULL;
+    bool ok = s.face_vertices && s.face_alive && s.vertex_faces && s.quadrics && s.stamps && s.vertex_alive &&
+        weld && neighbor_mark && edges && weld_mesh_vertices(mesh_data, weld);
+    if (!ok) {
+        fprintf(stderr, "Error: Failed to allocate mesh simplification buffers\n");
+    }
+
+    int alive_faces = 0;
+    if (ok) {
+        // Face planes, weighted by area, accumulate on the welded vertices
+        int edge_count = 0;
+        for (int f = 0; f < num_faces; f++) {
+            const brh_face* face = &mesh_data->faces[f];
+            s.face_alive[f] = false;
+            if (face->a < 0 || face->a >= num_vertices || face->b < 0 || face->b >= num_vertices ||
+                face->c < 0 || face->c >= num_vertices) {
+                continue;
+            }
+            int* v = s.face_vertices[f];
+            v[0] = weld[face->a];
+            v[1] = weld[face->b];
+            v[2] = weld[face->c];
+            if (v[0] == v[1] || v[1] == v[2] || v[2] == v[0]) continue;
+
+            s.face_alive[f] = true;
+            alive_faces++;
+            const brh_vector3 normal = face_cross(&s, v, -1, -1);
+            const double length = vec3_magnitude(normal);
+            for (int k = 0; k < 3; k++) {
+                if (length > 0.0) {
+                    const double nx = normal.x / length, ny = normal.y / length, nz = normal.z / length;
+                    const brh_vector3 p = s.positions[v[0]];
+                    quadric_add_plane(&s.quadrics[v[k]], nx, ny, nz, -(nx * p.x + ny * p.y + nz * p.z), 0.5 * length);
+                }
+                s.vertex_alive[v[k]] = true;
+                array_push(s.vertex_faces[v[k]], f);
+                const int a = v[k], b = v[(k + 1) % 3];
+                edges[edge_count++] = (brh_lod_edge){ MIN(a, b), MAX(a, b), f };
+            }
+        }
+
+        // Edges used by one face are open: add a plane through them, perpendicular to the face
+        qsort(edges, edge_count, sizeof(brh_lod_edge), compare_lod_edges);
+        for (int i = 0; i < edge_count && ok; ) {
+            int j = i + 1;
+            while (j < edge_count && edges[j].a == edges[i].a && edges[j].b == edges[i].b) j++;
+            if (j - i == 1) {
+                const brh_vector3 pa = s.positions[edges[i].a];
+                const brh_vector3 pb = s.positions[edges[i].b];
+                const brh_vector3 edge = vec3_subtract(pb, pa);
+                const brh_vector3 face_normal = face_cross(&s, s.face_vertices[edges[i].face], -1, -1);
+                const brh_vector3 normal = vec3_cross(edge, face_normal);
+                const double length = vec3_magnitude(normal);
+                if (length > 0.0) {
+                    const double nx = normal.x / length, ny = normal.y / length, nz = normal.z / length;
+                    const double d = -(nx * pa.x + ny * pa.y + nz * pa.z);
+                    const double weight = BRH_LOD_BOUNDARY_WEIGHT * vec3_dot(edge, edge);
+                    quadric_add_plane(&s.quadrics[edges[i].a], nx, ny, nz, d, weight);
+                    quadric_add_plane(&s.quadrics[edges[i].b], nx, ny, nz, d, weight);
+                }
+            }
+            ok = push_edge(&s, edges[i].a, edges[i].b);
+            i = j;
+        }
+        if (!ok) {
+            fprintf(stderr, "Error: Failed to allocate mesh simplification heap\n");
+        }
+    }
+
+    if (ok) {
+        // Collapse the cheapest edges until the target is reached or no valid collapse is left
+        for (int v = 0; v < num_vertices; v++) neighbor_mark[v] = -1;
+        int iteration = 0;
+        while (alive_faces > target_faces && s.heap_count > 0) {
+            const brh_collapse collapse = heap_pop(&s);
+            if (!s.vertex_alive[collapse.from] || !s.vertex_alive[collapse.to] ||
+                s.stamps[collapse.from] != collapse.from_stamp || s.stamps[collapse.to] != collapse.to_stamp) {
+                continue;
+            }
+            if (!is_collapse_valid(&s, collapse.from, collapse.to)) {
+                continue;
+            }
+            alive_faces -= collapse_edge(&s, collapse.from, collapse.to, neighbor_mark, iteration++);
+        }
+
+        // Surviving faces keep their order, texcoords and normals; only positions move
+        result = (brh_face*)array_hold(NULL, alive_faces, sizeof(brh_face));
+        if (!result && alive_faces > 0) {
+            fprintf(stderr, "Error: Failed to allocate simplified faces\n");
+        }
+        int count = 0;
+        for (int f = 0; f < num_faces && result; f++) {
+            if (!s.face_alive[f]) continue;
+            brh_face face = mesh_data->faces[f];
+            face.a = s.face_vertices[f][0];
+            face.b = s.face_vertices[f][1];
+            face.c = s.face_vertices[f][2];
+            result[count++] = face;
+        }
+    }
+
+    if (s.vertex_faces) {
+        for (int v = 0; v < num_vertices; v++) array_free(s.vertex_faces[v]);
+    }
+    free(s.face_vertices);
+    free(s.face_alive);
+    free(s.vertex_faces);
+    free(s.quadrics);
+    free(s.stamps);
+    free(s.vertex_alive);
+    free(s.heap);
+    free(weld);
+    free(neighbor_mark);
+    free(edges);
+    return result;
+}
+
+/* --------- Cache --------- */
+static uint64_t hash_bytes(uint64_t hash, const void* data, size_t size)
+{
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+    }
+    return hash;
+}
+
+static uint64_t hash_mesh(const brh_mesh* mesh_data)
+{
+    uint64_t hash = 0xCBF29CE484222325ull;
+    hash = hash_bytes(hash, mesh_data->vertices, sizeof(brh_vector3) * array_length(mesh_data->vertices));
+    hash = hash_bytes(hash, mesh_data->faces, sizeof(brh_face) * array_length(mesh_data->faces));
+    return hash;
+}
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t source_hash;
+    uint32_t face_size;     // sizeof(brh_face) of the writer
+    int32_t level_count;
+} brh_lod_cache_header;
+
+static int load_lod_cache(const char* path, const brh_mesh* mesh_data, uint64_t hash, brh_face* levels[])
+{
+    FILE* file = fopen(path, "rb");
+    if (!file) return 0;
+
+    brh_lod_cache_header header;
+    int count = 0;
+    bool ok = fread(&header, sizeof(header), 1, file) == 1 &&
+        header.magic == BRH_LOD_CACHE_MAGIC && header.version == BRH_LOD_CACHE_VERSION &&
+        header.source_hash == hash && header.face_size == sizeof(brh_face) &&
+        header.level_count >= 0 && header.level_count < BRH_MAX_LOD_LEVELS;
+
+    const int num_vertices = array_length(mesh_data->vertices);
+    for (int level = 0; ok && level < header.level_count; level++) {
+        int32_t face_count = 0;
+        ok = fread(&face_count, sizeof(face_count), 1, file) == 1 && face_count > 0 &&
+            face_count <= array_length(mesh_data->faces);
+        brh_face* faces = ok ? (brh_face*)array_hold(NULL, face_count, sizeof(brh_face)) : NULL;
+        ok = faces && fread(faces, sizeof(brh_face), face_count, file) == (size_t)face_count;
+        for (int f = 0; ok && f < face_count; f++) {
+            ok = faces[f].a >= 0 && faces[f].a < num_vertices &&
+                faces[f].b >= 0 && faces[f].b < num_vertices &&
+                faces[f].c >= 0 && faces[f].c < num_vertices;
+        }
+        if (ok) {
+            levels[count++] = faces;
+        }
+        else {
+            array_free(faces);
+        }
+    }
+    fclose(file);
+
+    if (!ok) {
+        // Stale or damaged: regenerate and overwrite
+        for (int i = 0; i < count; i++) array_free(levels[i]);
+        return -1;
+    }
+    return count;
+}
+
+static void save_lod_cache(const char* path, uint64_t hash, brh_face* levels[], int count)
+{
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "Warning: Could not write LOD cache %s\n", path);
+        return;
+    }
+
+    brh_lod_cache_header header = { BRH_LOD_CACHE_MAGIC, BRH_LOD_CACHE_VERSION, hash, (uint32_t)sizeof(brh_face), count };
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    for (int level = 0; ok && level < count; level++) {
+        const int32_t face_count = array_length(levels[level]);
+        ok = fwrite(&face_count, sizeof(face_count), 1, file) == 1 &&
+            fwrite(levels[level], sizeof(brh_face), face_count, file) == (size_t)face_count;
+    }
+    if (fclose(file) != 0 || !ok) {
+        fprintf(stderr, "Warning: Failed to write LOD cache %s\n", path);
+        remove(path);
+    }
+}
+
+/* --------- Levels --------- */
+int generate_mesh_lods(const brh_mesh* mesh_data, const char* cache_path, brh_mesh* lods[])
+{
+    if (!mesh_data || array_length(mesh_data->faces) == 0) return 0;
+
+    brh_face* levels[BRH_MAX_LOD_LEVELS - 1];
+    const uint64_t hash = hash_mesh(mesh_data);
+    int count = cache_path ? load_lod_cache(cache_path, mesh_data, hash, levels) : 0;
+
+    if (count <= 0) {
+        // Each level simplifies the one before it to half its faces
+        count = 0;
+        brh_mesh source = *mesh_data;
+        while (count < BRH_MAX_LOD_LEVELS - 1) {
+            const int source_faces = array_length(source.faces);
+            const int target = source_faces / 2;
+            if (target < BRH_LOD_MIN_FACES) break;
+
+            brh_face* faces = simplify_mesh_faces(&source, target);
+            if (!faces || array_length(faces) > (int)((1.0 - BRH_LOD_MIN_REDUCTION) * source_faces)) {
+                array_free(faces);
+                break;
+            }
+            levels[count++] = faces;
+            source.faces = faces;
+        }
+        if (cache_path) {
+            save_lod_cache(cache_path, hash, levels, count);
+        }
+    }
+
+    // Levels share the source's vertex arrays and get clusters of their own
+    for (int i = 0; i < count; i++) {
+        brh_mesh* lod = (brh_mesh*)malloc(sizeof(brh_mesh));
+        if (!lod) {
+            fprintf(stderr, "Error: Failed to allocate mesh level of detail\n");
+            for (int j = i; j < count; j++) array_free(levels[j]);
+            return i;
+        }
+        *lod = *mesh_data;
+        lod->faces = levels[i];
+        lod->clusters = NULL;
+        if (!build_mesh_clusters(lod)) {
+            fprintf(stderr, "Warning: Failed to build clusters for level of detail %d\n", i + 1);
+        }
+        lods[i] = lod;
+    }
+    return count;
+}
+
+void free_mesh_lod(brh_mesh* lod)
+{
+    if (!lod) return;
+    array_free(lod->faces);
+    array_free(lod->clusters);
+    free(lod);
+}
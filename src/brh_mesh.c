@@ -6,6 +6,7 @@
 brh_mesh mesh = {
 	.vertices = NULL,
 	.faces = NULL,
+	.clusters = NULL,
 	.rotation = {.x = 0.0f, .y = 0.0f, .z = 0.0f },
 	.scale = {.x = 1.0f, .y = 1.0f, .z = 1.0f },
 	.translation = {.x = 0.0f, .y = 0.0f, .z = 0.0f }
@@ -1,65 +1,127 @@
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include "brh_mesh_manager.h"
 #include "array.h"
 #include "model_loader.h"
+#include "brh_cluster.h"
+#include "brh_lod.h"
+#include "math_utils.h"
+#include "brh_slot_map.h"
 
-#define MAX_MESHES 32  // Maximum number of meshes that can be loaded simultaneously
-
-typedef struct brh_mesh_handle_t {
-    int id;            // Unique identifier for this mesh
+typedef struct {
     brh_mesh* mesh;    // Pointer to the actual mesh data
-    bool is_valid;     // Whether this handle is valid
-} brh_mesh_handle_t;
+    brh_mesh* lods[BRH_MAX_LOD_LEVELS - 1]; // Coarser levels, finest first (share mesh's vertex arrays)
+    int lod_count;     // Number of coarser levels
+    char* file_path;   // Path the mesh was loaded from; with is_right_handed, the cache key
+    bool is_right_handed;
+    int ref_count;     // Outstanding load_mesh() calls for this handle
+} brh_mesh_entry;
+
+// Loaded meshes, addressed by handle; each file is loaded once and shared
+static brh_slot_map mesh_map = BRH_SLOT_MAP_INIT(sizeof(brh_mesh_entry));
 
-// Array of mesh handles
-static brh_mesh_handle_t mesh_handles[MAX_MESHES];
-static int next_mesh_id = 1;  // Start from 1, 0 can be reserved for invalid handles
+static void free_mesh_entry(brh_mesh_handle mesh_handle);
+
+// Directory for level-of-detail cache files, empty to always simplify at load time
+static char lod_cache_directory[512] = "";
 
 bool initialize_mesh_system(void)
 {
-    // Initialize all mesh handles as invalid
-    for (int i = 0; i < MAX_MESHES; i++) {
-        mesh_handles[i].id = 0;
-        mesh_handles[i].mesh = NULL;
-        mesh_handles[i].is_valid = false;
-    }
-    next_mesh_id = 1;
+    cleanup_mesh_system();
     return true;
 }
 
 void cleanup_mesh_system(void)
 {
-    // Free all valid meshes
-    for (int i = 0; i < MAX_MESHES; i++) {
-        if (mesh_handles[i].is_valid && mesh_handles[i].mesh != NULL) {
-            unload_mesh((brh_mesh_handle)&mesh_handles[i]);
-        }
+    // Free all loaded meshes whatever their reference counts; each free moves the last entry to the front
+    while (mesh_map.count > 0) {
+        free_mesh_entry(get_slot_map_handle_at(&mesh_map, 0));
     }
+    cleanup_slot_map(&mesh_map);
 }
 
-brh_mesh_handle load_mesh(const char* file_path, bool is_right_handed)
+static brh_mesh_entry* get_mesh_entry(brh_mesh_handle mesh_handle)
 {
-    // Find an empty slot
-    int slot = -1;
-    for (int i = 0; i < MAX_MESHES; i++) {
-        if (!mesh_handles[i].is_valid) {
-            slot = i;
-            break;
+    return (brh_mesh_entry*)get_slot_map_item(&mesh_map, mesh_handle);
+}
+
+// Finds the loaded mesh of a file, or returns BRH_NULL_HANDLE
+static brh_mesh_handle find_mesh(const char* file_path, bool is_right_handed)
+{
+    const brh_mesh_entry* entries = (const brh_mesh_entry*)mesh_map.items;
+    for (int i = 0; i < mesh_map.count; i++) {
+        if (entries[i].is_right_handed == is_right_handed && strcmp(entries[i].file_path, file_path) == 0) {
+            return get_slot_map_handle_at(&mesh_map, i);
         }
     }
+    return BRH_NULL_HANDLE;
+}
 
-    if (slot == -1) {
-        fprintf(stderr, "Error: Maximum number of meshes (%d) reached\n", MAX_MESHES);
-        return NULL;
+// FNV-1a hash of a mesh's cache key, so meshes with the same file name in different
+// directories (or loaded with different handedness) get different cache files
+static uint64_t hash_mesh_key(const char* file_path, bool is_right_handed)
+{
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (const unsigned char* c = (const unsigned char*)file_path; *c; c++) {
+        hash = (hash ^ *c) * 0x100000001B3ull;
+    }
+    return (hash ^ (is_right_handed ? 1u : 0u)) * 0x100000001B3ull;
+}
+
+// Frees a mesh, its levels of detail and its structure
+static void free_mesh(brh_mesh* mesh, brh_mesh* const* lods, int lod_count)
+{
+    // Levels of detail borrow the vertex arrays, so they go first
+    for (int i = 0; i < lod_count; i++) {
+        free_mesh_lod(lods[i]);
+    }
+
+    // Free mesh resources
+    if (mesh->vertices) {
+        array_free(mesh->vertices);
+        mesh->vertices = NULL;
+    }
+
+    if (mesh->faces) {
+        array_free(mesh->faces);
+        mesh->faces = NULL;
+    }
+
+    if (mesh->texcoords) {
+        array_free(mesh->texcoords);
+        mesh->texcoords = NULL;
+    }
+
+    if (mesh->normals) {
+        array_free(mesh->normals);
+        mesh->normals = NULL;
+    }
+
+    if (mesh->clusters) {
+        array_free(mesh->clusters);
+        mesh->clusters = NULL;
+    }
+
+    // Free mesh structure
+    free(mesh);
+}
+
+brh_mesh_handle load_mesh(const char* file_path, bool is_right_handed)
+{
+    // Share the mesh if this file is already loaded
+    const brh_mesh_handle shared = find_mesh(file_path, is_right_handed);
+    if (shared) {
+        get_mesh_entry(shared)->ref_count++;
+        return shared;
     }
 
     // Allocate mesh structure
     brh_mesh* new_mesh = (brh_mesh*)malloc(sizeof(brh_mesh));
     if (!new_mesh) {
         fprintf(stderr, "Error: Failed to allocate memory for mesh\n");
-        return NULL;
+        return BRH_NULL_HANDLE;
     }
 
     // Initialize mesh arrays
@@ -67,6 +129,7 @@ brh_mesh_handle load_mesh(const char* file_path, bool is_right_handed)
     new_mesh->faces = NULL;
     new_mesh->texcoords = NULL;
     new_mesh->normals = NULL;
+    new_mesh->clusters = NULL;
 
     // Set default transform
     new_mesh->scale = (brh_vector3){ 1.0f, 1.0f, 1.0f };
@@ -78,124 +141,174 @@ brh_mesh_handle load_mesh(const char* file_path, bool is_right_handed)
     if (!loaded) {
         fprintf(stderr, "Error: Failed to load mesh from file: %s\n", file_path);
         free(new_mesh);
-        return NULL;
+        return BRH_NULL_HANDLE;
     }
 
-    // Setup the handle
-    mesh_handles[slot].id = next_mesh_id++;
-    mesh_handles[slot].mesh = new_mesh;
-    mesh_handles[slot].is_valid = true;
-
-    return (brh_mesh_handle)&mesh_handles[slot];
-}
-
-void unload_mesh(brh_mesh_handle mesh_handle)
-{
-    if (!mesh_handle || !((brh_mesh_handle_t*)mesh_handle)->is_valid) {
-        return;
-    }
-
-    brh_mesh_handle_t* handle = (brh_mesh_handle_t*)mesh_handle;
-    brh_mesh* mesh = handle->mesh;
-
-    // Free mesh resources
-    if (mesh->vertices) {
-        array_free(mesh->vertices);
-        mesh->vertices = NULL;
+    // Partition the faces into clusters the geometry stage can cull as a whole
+    if (!build_mesh_clusters(new_mesh)) {
+        fprintf(stderr, "Warning: Failed to build clusters for %s, faces will be culled individually\n", file_path);
     }
 
-    if (mesh->faces) {
-        array_free(mesh->faces);
-        mesh->faces = NULL;
+    // Simplified levels of detail, from the cache when one is configured and up to date
+    char cache_path[1024];
+    const char* cache_file = NULL;
+    if (lod_cache_directory[0] != '\0') {
+        const char* name = file_path;
+        for (const char* c = file_path; *c; c++) {
+            if (*c == '/' || *c == '\\') name = c + 1;
+        }
+        snprintf(cache_path, sizeof(cache_path), "%s/%s-%016llx.lod", lod_cache_directory, name,
+            (unsigned long long)hash_mesh_key(file_path, is_right_handed));
+        cache_file = cache_path;
     }
+    brh_mesh* lods[BRH_MAX_LOD_LEVELS - 1];
+    const int lod_count = generate_mesh_lods(new_mesh, cache_file, lods);
 
-    if (mesh->texcoords) {
-        array_free(mesh->texcoords);
-        mesh->texcoords = NULL;
+    // Setup the handle
+    brh_mesh_handle mesh_handle;
+    char* path_copy = (char*)malloc(strlen(file_path) + 1);
+    brh_mesh_entry* entry = path_copy ? (brh_mesh_entry*)insert_slot_map_item(&mesh_map, &mesh_handle) : NULL;
+    if (!entry) {
+        free(path_copy);
+        free_mesh(new_mesh, lods, lod_count);
+        return BRH_NULL_HANDLE;
     }
+    strcpy(path_copy, file_path);
+    entry->mesh = new_mesh;
+    entry->lod_count = lod_count;
+    memcpy(entry->lods, lods, sizeof(brh_mesh*) * lod_count);
+    entry->file_path = path_copy;
+    entry->is_right_handed = is_right_handed;
+    entry->ref_count = 1;
+
+    return mesh_handle;
+}
 
-    if (mesh->normals) {
-        array_free(mesh->normals);
-        mesh->normals = NULL;
+// Frees a mesh and its handle regardless of its reference count
+static void free_mesh_entry(brh_mesh_handle mesh_handle)
+{
+    brh_mesh_entry* entry = get_mesh_entry(mesh_handle);
+    if (!entry) {
+        return;
     }
 
-    // Free mesh structure
-    free(mesh);
+    free_mesh(entry->mesh, entry->lods, entry->lod_count);
+    free(entry->file_path);
 
     // Invalidate handle
-    handle->mesh = NULL;
-    handle->is_valid = false;
+    remove_slot_map_item(&mesh_map, mesh_handle);
+}
+
+void unload_mesh(brh_mesh_handle mesh_handle)
+{
+    brh_mesh_entry* entry = get_mesh_entry(mesh_handle);
+    if (entry && --entry->ref_count == 0) {
+        free_mesh_entry(mesh_handle);
+    }
 }
 
 brh_mesh* get_mesh_data(brh_mesh_handle mesh_handle)
 {
-    if (!mesh_handle || !((brh_mesh_handle_t*)mesh_handle)->is_valid) {
+    const brh_mesh_entry* entry = get_mesh_entry(mesh_handle);
+    if (!entry) {
         return NULL;
     }
 
-    return ((brh_mesh_handle_t*)mesh_handle)->mesh;
+    return entry->mesh;
 }
 
 void set_mesh_position(brh_mesh_handle mesh_handle, brh_vector3 position)
 {
-    if (!mesh_handle || !((brh_mesh_handle_t*)mesh_handle)->is_valid) {
+    const brh_mesh_entry* entry = get_mesh_entry(mesh_handle);
+    if (!entry) {
         return;
     }
 
-    ((brh_mesh_handle_t*)mesh_handle)->mesh->translation = position;
+    entry->mesh->translation = position;
 }
 
 void set_mesh_rotation(brh_mesh_handle mesh_handle, brh_vector3 rotation)
 {
-    if (!mesh_handle || !((brh_mesh_handle_t*)mesh_handle)->is_valid) {
+    const brh_mesh_entry* entry = get_mesh_entry(mesh_handle);
+    if (!entry) {
         return;
     }
 
-    ((brh_mesh_handle_t*)mesh_handle)->mesh->rotation = rotation;
+    entry->mesh->rotation = rotation;
 }
 
 void set_mesh_scale(brh_mesh_handle mesh_handle, brh_vector3 scale)
 {
-    if (!mesh_handle || !((brh_mesh_handle_t*)mesh_handle)->is_valid) {
+    const brh_mesh_entry* entry = get_mesh_entry(mesh_handle);
+    if (!entry) {
         return;
     }
 
-    ((brh_mesh_handle_t*)mesh_handle)->mesh->scale = scale;
+    entry->mesh->scale = scale;
 }
 
 brh_vector3 get_mesh_position(brh_mesh_handle mesh_handle)
 {
-    if (!mesh_handle || !((brh_mesh_handle_t*)mesh_handle)->is_valid) {
+    const brh_mesh_entry* entry = get_mesh_entry(mesh_handle);
+    if (!entry) {
         return (brh_vector3) { 0.0f, 0.0f, 0.0f };
     }
 
-    return ((brh_mesh_handle_t*)mesh_handle)->mesh->translation;
+    return entry->mesh->translation;
 }
 
 brh_vector3 get_mesh_rotation(brh_mesh_handle mesh_handle)
 {
-    if (!mesh_handle || !((brh_mesh_handle_t*)mesh_handle)->is_valid) {
+    const brh_mesh_entry* entry = get_mesh_entry(mesh_handle);
+    if (!entry) {
         return (brh_vector3) { 0.0f, 0.0f, 0.0f };
     }
 
-    return ((brh_mesh_handle_t*)mesh_handle)->mesh->rotation;
+    return entry->mesh->rotation;
 }
 
 brh_vector3 get_mesh_scale(brh_mesh_handle mesh_handle)
 {
-    if (!mesh_handle || !((brh_mesh_handle_t*)mesh_handle)->is_valid) {
+    const brh_mesh_entry* entry = get_mesh_entry(mesh_handle);
+    if (!entry) {
         return (brh_vector3) { 1.0f, 1.0f, 1.0f };
     }
 
-    return ((brh_mesh_handle_t*)mesh_handle)->mesh->scale;
+    return entry->mesh->scale;
 }
 
 int get_mesh_face_count(brh_mesh_handle mesh_handle)
 {
-    if (!mesh_handle || !((brh_mesh_handle_t*)mesh_handle)->is_valid) {
+    const brh_mesh_entry* entry = get_mesh_entry(mesh_handle);
+    if (!entry) {
+        return 0;
+    }
+
+    return array_length(entry->mesh->faces);
+}
+
+void set_mesh_lod_cache_directory(const char* directory)
+{
+    snprintf(lod_cache_directory, sizeof(lod_cache_directory), "%s", directory ? directory : "");
+}
+
+int get_mesh_lod_count(brh_mesh_handle mesh_handle)
+{
+    const brh_mesh_entry* entry = get_mesh_entry(mesh_handle);
+    if (!entry) {
         return 0;
     }
 
-    brh_mesh* mesh = ((brh_mesh_handle_t*)mesh_handle)->mesh;
-    return array_length(mesh->faces);
+    return entry->lod_count + 1;
+}
+
+brh_mesh* get_mesh_lod_data(brh_mesh_handle mesh_handle, int level)
+{
+    const brh_mesh_entry* entry = get_mesh_entry(mesh_handle);
+    if (!entry) {
+        return NULL;
+    }
+
+    level = MIN(level, entry->lod_count);
+    return level <= 0 ? entry->mesh : entry->lods[level - 1];
 }
\ No newline at end of file
@@ -0,0 +1,213 @@
+#include <float.h>
+#include <math.h>
+#include <string.h>
+#include "brh_occlusion.h"
+#include "array.h"
+#include "math_utils.h"
+
+// Occluder triangles smaller than this (in occlusion pixels squared, doubled) cover nothing
+#define BRH_OCCLUSION_MIN_AREA 1e-6f
+
+// A vertex projected into occlusion buffer pixels
+typedef struct {
+    float x;
+    float y;
+    float inv_w;
+} brh_occlusion_vertex;
+
+static float occlusion_depth[BRH_OCCLUSION_WIDTH * BRH_OCCLUSION_HEIGHT];
+static brh_mat4 occlusion_view_projection;
+
+void begin_occlusion_frame(const brh_mat4* view_projection)
+{
+    occlusion_view_projection = *view_projection;
+    memset(occlusion_depth, 0, sizeof(occlusion_depth));
+}
+
+const float* get_occlusion_buffer(void)
+{
+    return occlusion_depth;
+}
+
+// Maps a clip-space position (w > 0) to occlusion buffer pixels, y down like the screen
+static brh_occlusion_vertex project_to_occlusion(brh_vector4 clip)
+{
+    const float inv_w = 1.0f / clip.w;
+    brh_occlusion_vertex v = {
+        (clip.x * inv_w * 0.5f + 0.5f) * (float)BRH_OCCLUSION_WIDTH,
+        (0.5f - clip.y * inv_w * 0.5f) * (float)BRH_OCCLUSION_HEIGHT,
+        inv_w
+    };
+    return v;
+}
+
+static bool is_in_front_of_near_plane(brh_vector4 clip)
+{
+    return clip.w > EPSILON && clip.z >= -clip.w;
+}
+
+/*
+* Depth-only triangle kernel. Edge functions are evaluated at pixel centers, offset by half
+* a pixel's extent so only fully covered pixels pass, and each pixel stores the farthest
+* 1/w over its area.
+*/
+static void rasterize_occluder_triangle(brh_occlusion_vertex a, brh_occlusion_vertex b, brh_occlusion_vertex c)
+{
+    float area = (b.x - a.x) * (c.y - a.y) - (c.x - a.x) * (b.y - a.y);
+    if (fabsf(area) < BRH_OCCLUSION_MIN_AREA) return;
+    if (area < 0.0f) {
+        // Occluders are not backface culled; make the winding consistent instead
+        const brh_occlusion_vertex t = b;
+        b = c;
+        c = t;
+        area = -area;
+    }
+
+    const int x0 = MAX(0, (int)floorf(MIN(a.x, MIN(b.x, c.x))));
+    const int y0 = MAX(0, (int)floorf(MIN(a.y, MIN(b.y, c.y))));
+    const int x1 = MIN(BRH_OCCLUSION_WIDTH, (int)ceilf(MAX(a.x, MAX(b.x, c.x))));
+    const int y1 = MIN(BRH_OCCLUSION_HEIGHT, (int)ceilf(MAX(a.y, MAX(b.y, c.y))));
+    if (x0 >= x1 || y0 >= y1) return;
+
+    // Edge function of p->q: (q.x - p.x) * (y - p.y) - (q.y - p.y) * (x - p.x), positive inside
+    const brh_occlusion_vertex* edges[3][2] = { { &b, &c }, { &c, &a }, { &a, &b } };
+    float dx[3], dy[3], row_start[3], inner[3];
+    const float px = (float)x0 + 0.5f;
+    const float py = (float)y0 + 0.5f;
+    for (int e = 0; e < 3; e++) {
+        const brh_occlusion_vertex* p = edges[e][0];
+        const brh_occlusion_vertex* q = edges[e][1];
+        dx[e] = -(q->y - p->y);
+        dy[e] = q->x - p->x;
+        row_start[e] = dy[e] * (py - p->y) + dx[e] * (px - p->x);
+        inner[e] = 0.5f * (fabsf(dx[e]) + fabsf(dy[e]));
+    }
+
+    // 1/w is affine in screen space: z = a.inv_w + dzdx * (x - a.x) + dzdy * (y - a.y)
+    const float dzdx = ((b.inv_w - a.inv_w) * (c.y - a.y) - (c.inv_w - a.inv_w) * (b.y - a.y)) / area;
+    const float dzdy = ((c.inv_w - a.inv_w) * (b.x - a.x) - (b.inv_w - a.inv_w) * (c.x - a.x)) / area;
+    const float z_margin = 0.5f * (fabsf(dzdx) + fabsf(dzdy));
+    const float z_floor = MIN(a.inv_w, MIN(b.inv_w, c.inv_w));
+    float z_row = a.inv_w + dzdx * (px - a.x) + dzdy * (py - a.y) - z_margin;
+
+    for (int y = y0; y < y1; y++) {
+        float e0 = row_start[0], e1 = row_start[1], e2 = row_start[2];
+        float z = z_row;
+        float* depth_row = occlusion_depth + y * BRH_OCCLUSION_WIDTH;
+        for (int x = x0; x < x1; x++) {
+            if (e0 >= inner[0] && e1 >= inner[1] && e2 >= inner[2]) {
+                const float depth = MAX(z, z_floor);
+                if (depth > depth_row[x]) {
+                    depth_row[x] = depth;
+                }
+            }
+            e0 += dx[0];
+            e1 += dx[1];
+            e2 += dx[2];
+            z += dzdx;
+        }
+        row_start[0] += dy[0];
+        row_start[1] += dy[1];
+        row_start[2] += dy[2];
+        z_row += dzdy;
+    }
+}
+
+void rasterize_occluder(const brh_mesh* mesh_data, const brh_mat4* world_matrix)
+{
+    if (!mesh_data || !mesh_data->vertices || !mesh_data->faces) return;
+
+    brh_mat4 model_view_projection;
+    mat4_mul_mat4_ref(world_matrix, &occlusion_view_projection, &model_view_projection);
+
+    const int num_vertices = array_length(mesh_data->vertices);
+    const int num_faces = array_length(mesh_data->faces);
+    for (int i = 0; i < num_faces; i++) {
+        const brh_face face = mesh_data->faces[i];
+        if (face.a < 0 || face.a >= num_vertices ||
+            face.b < 0 || face.b >= num_vertices ||
+            face.c < 0 || face.c >= num_vertices) {
+            continue;
+        }
+
+        const brh_vector4 clip_a = mat4_mul_vec4(&model_view_projection, vec4_from_vec3(mesh_data->vertices[face.a]));
+        const brh_vector4 clip_b = mat4_mul_vec4(&model_view_projection, vec4_from_vec3(mesh_data->vertices[face.b]));
+        const brh_vector4 clip_c = mat4_mul_vec4(&model_view_projection, vec4_from_vec3(mesh_data->vertices[face.c]));
+
+        // The renderer clips away whatever is in front of the near plane, so that part
+        // hides nothing; skipping the whole triangle keeps the buffer conservative
+        if (!is_in_front_of_near_plane(clip_a) || !is_in_front_of_near_plane(clip_b) || !is_in_front_of_near_plane(clip_c)) {
+            continue;
+        }
+
+        rasterize_occluder_triangle(project_to_occlusion(clip_a), project_to_occlusion(clip_b), project_to_occlusion(clip_c));
+    }
+}
+
+enum box_visibility test_box_visibility(brh_vector3 bounds_min, brh_vector3 bounds_max, const brh_mat4* world_matrix, bool test_occlusion)
+{
+    brh_mat4 model_view_projection;
+    mat4_mul_mat4_ref(world_matrix, &occlusion_view_projection, &model_view_projection);
+
+    // Clip-space corners, with one outcode bit per frustum plane they lie outside of
+    brh_vector4 corners[8];
+    unsigned outside_all = 0x3F;
+    bool crosses_near = false;
+    for (int i = 0; i < 8; i++) {
+        const brh_vector4 corner = {
+            (i & 1) ? bounds_max.x : bounds_min.x,
+            (i & 2) ? bounds_max.y : bounds_min.y,
+            (i & 4) ? bounds_max.z : bounds_min.z,
+            1.0f
+        };
+        corners[i] = mat4_mul_vec4(&model_view_projection, corner);
+
+        const brh_vector4 c = corners[i];
+        unsigned outcode = 0;
+        if (c.x < -c.w) outcode |= 0x01;
+        if (c.x > c.w)  outcode |= 0x02;
+        if (c.y < -c.w) outcode |= 0x04;
+        if (c.y > c.w)  outcode |= 0x08;
+        if (c.z < -c.w) outcode |= 0x10;
+        if (c.z > c.w)  outcode |= 0x20;
+        outside_all &= outcode;
+        crosses_near = crosses_near || !is_in_front_of_near_plane(c);
+    }
+
+    if (outside_all != 0) {
+        return BOX_OUTSIDE_FRUSTUM;
+    }
+    if (!test_occlusion || crosses_near) {
+        return BOX_VISIBLE;
+    }
+
+    // Screen rectangle of the box and the depth of its nearest corner
+    float min_x = FLT_MAX, min_y = FLT_MAX, max_x = -FLT_MAX, max_y = -FLT_MAX;
+    float nearest = 0.0f;
+    for (int i = 0; i < 8; i++) {
+        const brh_occlusion_vertex v = project_to_occlusion(corners[i]);
+        min_x = MIN(min_x, v.x);
+        min_y = MIN(min_y, v.y);
+        max_x = MAX(max_x, v.x);
+        max_y = MAX(max_y, v.y);
+        nearest = MAX(nearest, v.inv_w);
+    }
+
+    const int x0 = MAX(0, (int)floorf(min_x));
+    const int y0 = MAX(0, (int)floorf(min_y));
+    const int x1 = MIN(BRH_OCCLUSION_WIDTH, (int)ceilf(max_x));
+    const int y1 = MIN(BRH_OCCLUSION_HEIGHT, (int)ceilf(max_y));
+    if (x0 >= x1 || y0 >= y1) {
+        return BOX_OUTSIDE_FRUSTUM;
+    }
+
+    for (int y = y0; y < y1; y++) {
+        const float* depth_row = occlusion_depth + y * BRH_OCCLUSION_WIDTH;
+        for (int x = x0; x < x1; x++) {
+            if (depth_row[x] <= nearest) {
+                return BOX_VISIBLE; // Nothing at least as close covers this pixel
+            }
+        }
+    }
+    return BOX_OCCLUDED;
+}
@@ -0,0 +1,70 @@
+#include <stdio.h>
+#include <SDL3/SDL.h>
+#include "brh_pacing.h"
+#include "brh_display.h"
+
+static enum frame_pacing_mode pacing_mode = FRAME_PACING_FIXED;
+static double target_fps = FPS;
+static Uint64 frame_period_ns = SDL_NS_PER_SECOND / FPS;
+
+static Uint64 next_deadline_ns = 0;   // When the next frame may start (FRAME_PACING_FIXED)
+static Uint64 last_frame_start_ns = 0; // When the previous wait returned, 0 before the first frame
+static Uint64 last_work_ns = 0;        // Work time of the last frame
+
+void set_frame_pacing(enum frame_pacing_mode mode, double fps)
+{
+    if (fps > 0.0) {
+        target_fps = fps;
+        frame_period_ns = (Uint64)((double)SDL_NS_PER_SECOND / fps);
+    }
+
+    // Headless rendering has no renderer to sync to
+    if (mode == FRAME_PACING_VSYNC && !get_renderer()) {
+        fprintf(stderr, "Warning: Vsync needs a renderer, pacing at %.2f FPS instead\n", target_fps);
+        mode = FRAME_PACING_FIXED;
+    }
+    pacing_mode = mode;
+
+    if (get_renderer() && !SDL_SetRenderVSync(get_renderer(), mode == FRAME_PACING_VSYNC ? 1 : SDL_RENDERER_VSYNC_DISABLED)) {
+        fprintf(stderr, "Warning: Could not change vsync: %s\n", SDL_GetError());
+    }
+
+    next_deadline_ns = 0;
+}
+
+enum frame_pacing_mode get_frame_pacing_mode(void)
+{
+    return pacing_mode;
+}
+
+double get_frame_pacing_target_fps(void)
+{
+    return target_fps;
+}
+
+float wait_for_next_frame(void)
+{
+    Uint64 now = SDL_GetTicksNS();
+    last_work_ns = last_frame_start_ns ? now - last_frame_start_ns : 0;
+
+    if (pacing_mode == FRAME_PACING_FIXED) {
+        if (next_deadline_ns == 0 || now > next_deadline_ns + frame_period_ns) {
+            // First frame, or too far behind to catch up: restart the schedule from now
+            next_deadline_ns = now;
+        }
+        else if (now < next_deadline_ns) {
+            SDL_DelayPrecise(next_deadline_ns - now);
+            now = SDL_GetTicksNS();
+        }
+        next_deadline_ns += frame_period_ns;
+    }
+
+    const float delta_seconds = last_frame_start_ns ? (float)((double)(now - last_frame_start_ns) / (double)SDL_NS_PER_SECOND) : 0.0f;
+    last_frame_start_ns = now;
+    return delta_seconds;
+}
+
+double get_frame_work_ms(void)
+{
+    return (double)last_work_ns / (double)SDL_NS_PER_MS;
+}
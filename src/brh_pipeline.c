@@ -0,0 +1,367 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL3/SDL.h>
+#include "brh_pipeline.h"
+#include "brh_profiler.h"
+#include "brh_triangle.h"
+#include "brh_visibility.h"
+
+// Frames in flight, indexed by frame_index % BRH_RENDERABLE_FRAME_SLOTS
+static brh_frame_commands frames[BRH_RENDERABLE_FRAME_SLOTS];
+static int pipeline_depth = 0;
+
+// Frame counters. A frame is in flight from submission until release.
+static int submitted_frames = 0;   // Next frame index to submit
+static int geometry_frames = 0;    // Next frame index the geometry stage will process
+static int released_frames = 0;    // Next frame index the raster stage will acquire
+
+static SDL_Thread* geometry_thread = NULL;
+static SDL_Mutex* pipeline_mutex = NULL;
+static SDL_Condition* geometry_work = NULL;     // Signaled when a frame is submitted or on shutdown
+static SDL_Condition* geometry_done = NULL;     // Signaled when geometry finishes or a slot is released
+static bool geometry_quit = false;
+
+// Scene version of the last released frame
+static uint32_t released_scene_version = 0;
+static bool has_released_frame = false;
+
+// Rolling latency window
+typedef struct {
+    double geometry_ms;
+    double queue_ms;
+    double raster_ms;
+    double latency_ms;
+    double latency_frames;
+} brh_pipeline_sample;
+
+static brh_pipeline_sample history[BRH_PIPELINE_HISTORY];
+static brh_pipeline_sample history_sum;
+static int history_index = 0;
+static int history_frames = 0;
+
+static double ticks_to_milliseconds(uint64_t ticks)
+{
+    return (double)ticks * 1000.0 / (double)SDL_GetPerformanceFrequency();
+}
+
+static void run_geometry(brh_frame_commands* frame)
+{
+    BRH_PROFILE_BEGIN(geometry);
+    frame->geometry_start_ticks = get_profiler_ticks();
+
+    // Make room for one command per renderable
+    const int renderable_count = get_renderable_count();
+    if (renderable_count > frame->command_capacity) {
+        brh_draw_command* commands = (brh_draw_command*)realloc(frame->commands, sizeof(brh_draw_command) * renderable_count);
+        if (commands) {
+            frame->commands = commands;
+            frame->command_capacity = renderable_count;
+        }
+        else {
+            fprintf(stderr, "Error: Failed to allocate %d draw commands\n", renderable_count);
+        }
+    }
+
+    frame->command_count = update_renderables_to_slot(frame->slot, &frame->view, frame->commands, frame->command_capacity);
+    frame->triangle_count = 0;
+    for (int i = 0; i < frame->command_count; i++) {
+        frame->triangle_count += frame->commands[i].triangle_count;
+    }
+    frame->cull_stats = get_renderable_cull_stats();
+    frame->shadow_stats = get_renderable_shadow_stats();
+    frame->scene_version = get_renderable_scene_version();
+
+    frame->geometry_end_ticks = get_profiler_ticks();
+    BRH_PROFILE_END_ID(geometry, frame->frame_index);
+}
+
+static int geometry_thread_main(void* data)
+{
+    (void)data;
+
+    SDL_LockMutex(pipeline_mutex);
+    for (;;) {
+        while (!geometry_quit && geometry_frames == submitted_frames) {
+            SDL_WaitCondition(geometry_work, pipeline_mutex);
+        }
+        if (geometry_quit) break;
+
+        brh_frame_commands* frame = &frames[geometry_frames % BRH_RENDERABLE_FRAME_SLOTS];
+        SDL_UnlockMutex(pipeline_mutex);
+
+        run_geometry(frame);
+
+        SDL_LockMutex(pipeline_mutex);
+        frame->geometry_done = true;
+        geometry_frames++;
+        SDL_BroadcastCondition(geometry_done);
+    }
+    SDL_UnlockMutex(pipeline_mutex);
+    return 0;
+}
+
+bool initialize_frame_pipeline(int depth)
+{
+    cleanup_frame_pipeline();
+
+    if (depth < 0 || depth > BRH_PIPELINE_MAX_DEPTH) {
+        fprintf(stderr, "Error: Pipeline depth must be between 0 and %d\n", BRH_PIPELINE_MAX_DEPTH);
+        return false;
+    }
+
+    memset(frames, 0, sizeof(frames));
+    memset(history, 0, sizeof(history));
+    memset(&history_sum, 0, sizeof(history_sum));
+    history_index = 0;
+    history_frames = 0;
+    submitted_frames = 0;
+    geometry_frames = 0;
+    released_frames = 0;
+    has_released_frame = false;
+    geometry_quit = false;
+    pipeline_depth = depth;
+
+    if (depth == 0) {
+        return true;
+    }
+
+    pipeline_mutex = SDL_CreateMutex();
+    geometry_work = SDL_CreateCondition();
+    geometry_done = SDL_CreateCondition();
+    if (!pipeline_mutex || !geometry_work || !geometry_done) {
+        fprintf(stderr, "Error: Could not create pipeline synchronization objects: %s\n", SDL_GetError());
+        cleanup_frame_pipeline();
+        return false;
+    }
+
+    geometry_thread = SDL_CreateThread(geometry_thread_main, "brh_geometry", NULL);
+    if (!geometry_thread) {
+        fprintf(stderr, "Error: Could not create geometry thread: %s\n", SDL_GetError());
+        cleanup_frame_pipeline();
+        return false;
+    }
+
+    return true;
+}
+
+void cleanup_frame_pipeline(void)
+{
+    if (geometry_thread) {
+        SDL_LockMutex(pipeline_mutex);
+        geometry_quit = true;
+        SDL_SignalCondition(geometry_work);
+        SDL_UnlockMutex(pipeline_mutex);
+
+        SDL_WaitThread(geometry_thread, NULL);
+        geometry_thread = NULL;
+    }
+
+    if (geometry_done) {
+        SDL_DestroyCondition(geometry_done);
+        geometry_done = NULL;
+    }
+    if (geometry_work) {
+        SDL_DestroyCondition(geometry_work);
+        geometry_work = NULL;
+    }
+    if (pipeline_mutex) {
+        SDL_DestroyMutex(pipeline_mutex);
+        pipeline_mutex = NULL;
+    }
+
+    for (int i = 0; i < BRH_RENDERABLE_FRAME_SLOTS; i++) {
+        free(frames[i].commands);
+        frames[i].commands = NULL;
+        frames[i].command_capacity = 0;
+    }
+
+    pipeline_depth = 0;
+    submitted_frames = geometry_frames = released_frames = 0;
+}
+
+int get_frame_pipeline_depth(void)
+{
+    return pipeline_depth;
+}
+
+void submit_frame(const brh_frame_view* view)
+{
+    if (!view) return;
+
+    if (pipeline_depth == 0) {
+        brh_frame_commands* frame = &frames[0];
+        frame->frame_index = submitted_frames++;
+        frame->slot = 0;
+        frame->view = *view;
+        frame->submit_ticks = get_profiler_ticks();
+        run_geometry(frame);
+        frame->geometry_done = true;
+        geometry_frames = submitted_frames;
+        return;
+    }
+
+    SDL_LockMutex(pipeline_mutex);
+
+    // Every slot still holds a frame that has not been presented yet
+    while (submitted_frames - released_frames > pipeline_depth) {
+        SDL_WaitCondition(geometry_done, pipeline_mutex);
+    }
+
+    brh_frame_commands* frame = &frames[submitted_frames % BRH_RENDERABLE_FRAME_SLOTS];
+    frame->frame_index = submitted_frames;
+    frame->slot = submitted_frames % (pipeline_depth + 1);
+    frame->view = *view;
+    frame->command_count = 0;
+    frame->triangle_count = 0;
+    frame->geometry_done = false;
+    frame->submit_ticks = get_profiler_ticks();
+    submitted_frames++;
+
+    SDL_SignalCondition(geometry_work);
+    SDL_UnlockMutex(pipeline_mutex);
+}
+
+void flush_frame_pipeline(void)
+{
+    if (pipeline_depth == 0) {
+        // Geometry already ran inside submit_frame()
+        released_frames = submitted_frames;
+        return;
+    }
+
+    SDL_LockMutex(pipeline_mutex);
+    while (geometry_frames != submitted_frames) {
+        SDL_WaitCondition(geometry_done, pipeline_mutex);
+    }
+    for (int i = released_frames; i < submitted_frames; i++) {
+        frames[i % BRH_RENDERABLE_FRAME_SLOTS].geometry_done = false;
+    }
+    released_frames = submitted_frames;
+    SDL_BroadcastCondition(geometry_done);
+    SDL_UnlockMutex(pipeline_mutex);
+}
+
+brh_frame_commands* acquire_frame(void)
+{
+    if (pipeline_depth == 0) {
+        if (submitted_frames == released_frames) return NULL;
+        frames[0].raster_start_ticks = get_profiler_ticks();
+        return &frames[0];
+    }
+
+    // Keep `depth` frames of geometry queued behind the one being rasterized
+    if (submitted_frames - released_frames <= pipeline_depth) {
+        return NULL;
+    }
+
+    brh_frame_commands* frame = &frames[released_frames % BRH_RENDERABLE_FRAME_SLOTS];
+
+    BRH_PROFILE_BEGIN(pipeline_wait);
+    SDL_LockMutex(pipeline_mutex);
+    while (!frame->geometry_done) {
+        SDL_WaitCondition(geometry_done, pipeline_mutex);
+    }
+    SDL_UnlockMutex(pipeline_mutex);
+    BRH_PROFILE_END_ID(pipeline_wait, frame->frame_index);
+
+    frame->raster_start_ticks = get_profiler_ticks();
+    return frame;
+}
+
+void draw_frame_commands(const brh_frame_commands* frame)
+{
+    if (!frame) return;
+
+    const enum render_method render_method = frame->view.render_method;
+    if (frame->view.visibility_buffer) {
+        // Shades each pixel once, so it has no use for a prepass
+        draw_visibility_commands(frame->commands, frame->command_count, render_method);
+        return;
+    }
+    if (!frame->view.depth_prepass) {
+        for (int i = 0; i < frame->command_count; i++) {
+            draw_renderable_command(&frame->commands[i], render_method);
+        }
+        return;
+    }
+
+    // Lay down the depth of every triangle, then shade only the fragments that kept it
+    BRH_PROFILE_BEGIN(depth_prepass);
+    for (int i = 0; i < frame->command_count; i++) {
+        draw_renderable_depth_command(&frame->commands[i], render_method);
+    }
+    BRH_PROFILE_END_ID(depth_prepass, frame->frame_index);
+
+    set_depth_test(DEPTH_TEST_EQUAL);
+    for (int i = 0; i < frame->command_count; i++) {
+        draw_renderable_command(&frame->commands[i], render_method);
+    }
+    set_depth_test(DEPTH_TEST_GREATER);
+}
+
+bool is_frame_unchanged(const brh_frame_commands* frame)
+{
+    return frame && has_released_frame && frame->scene_version == released_scene_version;
+}
+
+static void record_latency(const brh_frame_commands* frame, uint64_t release_ticks)
+{
+    brh_pipeline_sample sample = {
+        .geometry_ms = ticks_to_milliseconds(frame->geometry_end_ticks - frame->geometry_start_ticks),
+        .queue_ms = ticks_to_milliseconds(frame->raster_start_ticks - frame->geometry_end_ticks),
+        .raster_ms = ticks_to_milliseconds(release_ticks - frame->raster_start_ticks),
+        .latency_ms = ticks_to_milliseconds(release_ticks - frame->submit_ticks),
+        .latency_frames = (double)(submitted_frames - 1 - frame->frame_index),
+    };
+
+    brh_pipeline_sample* oldest = &history[history_index];
+    history_sum.geometry_ms += sample.geometry_ms - oldest->geometry_ms;
+    history_sum.queue_ms += sample.queue_ms - oldest->queue_ms;
+    history_sum.raster_ms += sample.raster_ms - oldest->raster_ms;
+    history_sum.latency_ms += sample.latency_ms - oldest->latency_ms;
+    history_sum.latency_frames += sample.latency_frames - oldest->latency_frames;
+    *oldest = sample;
+
+    history_index = (history_index + 1) % BRH_PIPELINE_HISTORY;
+    if (history_frames < BRH_PIPELINE_HISTORY) history_frames++;
+}
+
+void release_frame(brh_frame_commands* frame)
+{
+    if (!frame) return;
+
+    const uint64_t release_ticks = get_profiler_ticks();
+    record_latency(frame, release_ticks);
+#ifdef BRH_ENABLE_PROFILER
+    record_profiler_zone("frame_latency", frame->frame_index, frame->submit_ticks, release_ticks);
+#endif
+    released_scene_version = frame->scene_version;
+    has_released_frame = true;
+
+    if (pipeline_depth == 0) {
+        released_frames++;
+        return;
+    }
+
+    SDL_LockMutex(pipeline_mutex);
+    frame->geometry_done = false;
+    released_frames++;
+    SDL_BroadcastCondition(geometry_done);
+    SDL_UnlockMutex(pipeline_mutex);
+}
+
+brh_pipeline_stats get_frame_pipeline_stats(void)
+{
+    brh_pipeline_stats stats = { 0 };
+    if (history_frames == 0) return stats;
+
+    const double n = (double)history_frames;
+    stats.geometry_ms = history_sum.geometry_ms / n;
+    stats.queue_ms = history_sum.queue_ms / n;
+    stats.raster_ms = history_sum.raster_ms / n;
+    stats.latency_ms = history_sum.latency_ms / n;
+    stats.latency_frames = history_sum.latency_frames / n;
+    stats.frames = history_frames;
+    return stats;
+}
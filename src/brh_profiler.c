@@ -0,0 +1,231 @@
+#include <stdio.h>
+#include <string.h>
+#include "brh_profiler.h"
+
+typedef struct {
+    const char* name;
+    int id;
+    uint64_t start_ticks;
+    uint64_t end_ticks;
+    SDL_ThreadID thread_id;
+} brh_profiler_event;
+
+typedef struct {
+    const char* name;
+    double frame_ms;                          // Time accumulated in the current frame
+    double history_ms[BRH_PROFILER_HISTORY];  // Per-frame totals, ring buffer
+    double history_sum_ms;
+} brh_profiler_zone;
+
+#ifdef BRH_ENABLE_PROFILER
+static bool profiler_enabled = true;
+#else
+static bool profiler_enabled = false;
+#endif
+static bool overlay_enabled = false;
+
+// Events of the frame in progress. The spinlock is held only to append one event, or to
+// hand the whole list over when the frame ends, so zones may be recorded from other threads
+// (e.g. the geometry thread) while the main thread ends a frame.
+static brh_profiler_event events[BRH_PROFILER_MAX_EVENTS];
+static int event_count = 0;
+static SDL_SpinLock event_lock = 0;
+
+// Events of the frame being folded into the averages and trace
+static brh_profiler_event frame_events[BRH_PROFILER_MAX_EVENTS];
+
+static brh_profiler_zone zones[BRH_PROFILER_MAX_ZONES];
+static int zone_count = 0;
+static int history_index = 0;
+static int history_frames = 0;
+
+static uint64_t frame_start_ticks = 0;
+static double ticks_to_ms = 0.0;
+
+static FILE* trace_file = NULL;
+static bool trace_first_event = true;
+static uint64_t trace_start_ticks = 0;
+
+static double ticks_to_milliseconds(uint64_t ticks)
+{
+    if (ticks_to_ms == 0.0) {
+        ticks_to_ms = 1000.0 / (double)SDL_GetPerformanceFrequency();
+    }
+    return (double)ticks * ticks_to_ms;
+}
+
+static brh_profiler_zone* find_or_add_zone(const char* name)
+{
+    for (int i = 0; i < zone_count; i++) {
+        // Identical literals in different translation units may not share an address
+        if (zones[i].name == name || strcmp(zones[i].name, name) == 0) {
+            return &zones[i];
+        }
+    }
+
+    if (zone_count >= BRH_PROFILER_MAX_ZONES) {
+        return NULL;
+    }
+
+    brh_profiler_zone* zone = &zones[zone_count++];
+    memset(zone, 0, sizeof(*zone));
+    zone->name = name;
+    return zone;
+}
+
+void set_profiler_enabled(bool enabled)
+{
+#ifdef BRH_ENABLE_PROFILER
+    profiler_enabled = enabled;
+#else
+    (void)enabled;
+#endif
+}
+
+bool is_profiler_enabled(void)
+{
+    return profiler_enabled;
+}
+
+void record_profiler_zone(const char* name, int id, uint64_t start_ticks, uint64_t end_ticks)
+{
+    if (!profiler_enabled) return;
+
+    const SDL_ThreadID thread_id = SDL_GetCurrentThreadID();
+
+    SDL_LockSpinlock(&event_lock);
+    if (event_count < BRH_PROFILER_MAX_EVENTS) { // Otherwise the frame buffer is full, drop the event
+        brh_profiler_event* event = &events[event_count++];
+        event->name = name;
+        event->id = id;
+        event->start_ticks = start_ticks;
+        event->end_ticks = end_ticks;
+        event->thread_id = thread_id;
+    }
+    SDL_UnlockSpinlock(&event_lock);
+}
+
+void profiler_begin_frame(void)
+{
+    frame_start_ticks = get_profiler_ticks();
+}
+
+static void write_trace_event(const brh_profiler_event* event)
+{
+    const double ts_us = ticks_to_milliseconds(event->start_ticks - trace_start_ticks) * 1000.0;
+    const double dur_us = ticks_to_milliseconds(event->end_ticks - event->start_ticks) * 1000.0;
+
+    fprintf(trace_file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%llu,\"ts\":%.3f,\"dur\":%.3f",
+        trace_first_event ? "" : ",\n", event->name, (unsigned long long)event->thread_id, ts_us, dur_us);
+    if (event->id >= 0) {
+        fprintf(trace_file, ",\"args\":{\"id\":%d}", event->id);
+    }
+    fputc('}', trace_file);
+    trace_first_event = false;
+}
+
+void profiler_end_frame(void)
+{
+    if (!profiler_enabled) {
+        SDL_LockSpinlock(&event_lock);
+        event_count = 0;
+        SDL_UnlockSpinlock(&event_lock);
+        return;
+    }
+
+    // The whole frame is recorded as a zone of its own
+    record_profiler_zone("frame", -1, frame_start_ticks, get_profiler_ticks());
+
+    // Take the frame's events; zones recorded from now on belong to the next frame
+    SDL_LockSpinlock(&event_lock);
+    const int count = event_count;
+    memcpy(frame_events, events, sizeof(brh_profiler_event) * (size_t)count);
+    event_count = 0;
+    SDL_UnlockSpinlock(&event_lock);
+
+    for (int i = 0; i < count; i++) {
+        const brh_profiler_event* event = &frame_events[i];
+        brh_profiler_zone* zone = find_or_add_zone(event->name);
+        if (zone) {
+            zone->frame_ms += ticks_to_milliseconds(event->end_ticks - event->start_ticks);
+        }
+        if (trace_file && event->start_ticks >= trace_start_ticks) {
+            write_trace_event(event);
+        }
+    }
+
+    // Push this frame's totals into the rolling window
+    for (int z = 0; z < zone_count; z++) {
+        brh_profiler_zone* zone = &zones[z];
+        zone->history_sum_ms += zone->frame_ms - zone->history_ms[history_index];
+        zone->history_ms[history_index] = zone->frame_ms;
+        zone->frame_ms = 0.0;
+    }
+    history_index = (history_index + 1) % BRH_PROFILER_HISTORY;
+    if (history_frames < BRH_PROFILER_HISTORY) history_frames++;
+}
+
+bool start_profiler_trace(const char* file_path)
+{
+    stop_profiler_trace();
+
+    trace_file = fopen(file_path, "w");
+    if (!trace_file) {
+        fprintf(stderr, "Error: Could not open trace file %s\n", file_path);
+        return false;
+    }
+
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", trace_file);
+    trace_first_event = true;
+    trace_start_ticks = get_profiler_ticks();
+    return true;
+}
+
+void stop_profiler_trace(void)
+{
+    if (!trace_file) return;
+
+    fputs("\n]}\n", trace_file);
+    fclose(trace_file);
+    trace_file = NULL;
+}
+
+double get_profiler_zone_average_ms(const char* name)
+{
+    for (int i = 0; i < zone_count; i++) {
+        if (zones[i].name == name || strcmp(zones[i].name, name) == 0) {
+            return history_frames > 0 ? zones[i].history_sum_ms / (double)history_frames : 0.0;
+        }
+    }
+    return 0.0;
+}
+
+void set_profiler_overlay_enabled(bool enabled)
+{
+    overlay_enabled = enabled;
+}
+
+bool is_profiler_overlay_enabled(void)
+{
+    return overlay_enabled;
+}
+
+void draw_profiler_overlay(SDL_Renderer* renderer)
+{
+    if (!overlay_enabled || !renderer || history_frames == 0) return;
+
+    const float line_height = 10.0f; // SDL debug font glyphs are 8x8
+    float y = 4.0f;
+    char line[96];
+
+    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+    snprintf(line, sizeof(line), "avg over %d frames (ms)", history_frames);
+    SDL_RenderDebugText(renderer, 4.0f, y, line);
+    y += line_height;
+
+    for (int i = 0; i < zone_count; i++) {
+        snprintf(line, sizeof(line), "%-24s %7.3f", zones[i].name, zones[i].history_sum_ms / (double)history_frames);
+        SDL_RenderDebugText(renderer, 4.0f, y, line);
+        y += line_height;
+    }
+}
@@ -1,67 +1,229 @@
+#include <math.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include "brh_renderable.h"
 #include "brh_mesh_manager.h"
 #include "brh_texture_manager.h"
 #include "array.h"
 #include "brh_light.h"
+#include "brh_light_tiles.h"
 #include "brh_matrix.h"
 #include "brh_clipping.h"
 #include "brh_display.h"
+#include "brh_profiler.h"
+#include "brh_jobs.h"
+#include "brh_occlusion.h"
+#include "brh_shadow.h"
+#include "brh_cluster.h"
 #include "math_utils.h"
 
-#define MAX_RENDERABLES 32  // Maximum number of renderables that can be created simultaneously
-
-static void update_renderable_triangles(brh_renderable_handle renderable_handle, brh_mat4 camera_matrix, brh_mat4 projection_matrix, brh_vector3 camera_pos_world);
-
-typedef struct brh_renderable_handle_t {
+// Screen triangles produced for one frame slot
+typedef struct {
+    brh_screen_triangle* triangles;    // Buffer of compact screen-space triangles to render
+    brh_screen_texcoords* texcoords;   // Parallel texcoord stream (NULL for untextured renderables)
+    bool has_texcoords;                // Whether texcoords were written for the current triangles
+    enum shading_method shading_method; // Shading method the triangles were built with
+    int triangle_count;                // Number of triangles in the buffer
+    int capacity;                      // Number of triangles the buffers can hold
+    brh_cull_stats cull_stats;         // The renderable's share of the frame's culling counts
+    uint32_t version;                  // Renderable version the triangles were built from (0 if none)
+    uint32_t view_version;             // View version the triangles were built for
+} brh_triangle_slot;
+
+// Faces per geometry job. Draws with fewer faces are batched into one job until it has this many.
+#define BRH_GEOMETRY_JOB_FACES 4096
+// Most face ranges one draw is split into; larger meshes get larger ranges
+#define BRH_MAX_JOBS_PER_DRAW 32
+// Faces a geometry job transforms and culls before lighting their vertices as one batch
+#define BRH_LIGHTING_BATCH_FACES 32
+// Screen area (pixels) per face that a level of detail should keep at least
+#define BRH_LOD_PIXELS_PER_FACE 16.0f
+// How far past a level boundary (in levels) the projected size must go before switching
+#define BRH_LOD_HYSTERESIS 0.25f
+
+// A contiguous range of the faces of one draw (the renderable, or one of its instances),
+// processed into its own segment of the slot's triangle buffer
+typedef struct {
+    struct brh_renderable_t* handle;
+    const brh_mesh* mesh_data;
+    const brh_frame_view* view;
+    brh_triangle_slot* target;
+    brh_mat4 world_matrix;
+    brh_mat4 normal_matrix;
+    brh_cluster_culler culler;
+    int first_face;
+    int last_face;          // One past the last face of the range
+    int segment_start;      // First triangle of the segment in the slot's buffer
+    int triangle_count;     // Triangles written to the segment
+    int clusters_tested;    // Clusters that start in the range
+    int clusters_culled;    // Of those, clusters rejected before any vertex transform
+    bool overflowed;        // Segment filled up before the range was finished
+} brh_geometry_job;
+
+// Consecutive face ranges run by one job
+typedef struct {
+    brh_geometry_job* jobs;
+    int job_count;
+} brh_geometry_batch;
+
+// One placement of an instanced renderable's mesh
+typedef struct {
+    brh_vector3 position;    // Relative to the renderable's transform
+    brh_vector3 rotation;
+    brh_vector3 scale;
+    brh_mat4 local_matrix;   // Cached instance matrix
+    brh_mat4 world_matrix;   // Cached renderable world matrix times local_matrix
+    int lod_level;           // Level of detail drawn in the latest frame
+    bool needs_update;       // Whether local_matrix needs to be recalculated
+} brh_renderable_instance;
+
+typedef struct brh_renderable_t {
     int id;                  // Unique identifier for this renderable
     brh_mesh_handle mesh;    // Handle to the mesh
-    brh_texture_handle texture; // Handle to the texture (can be NULL)
+    brh_texture_handle texture; // Handle to the texture (can be BRH_NULL_HANDLE)
     brh_vector3 position;    // Position in world space
     brh_vector3 rotation;    // Rotation in world space (in radians)
     brh_vector3 scale;       // Scale in world space
     brh_mat4 world_matrix;   // Cached world matrix
     // Rendering data
-    brh_triangle* triangles;      // Buffer of triangles to render
-    int triangle_count;           // Number of triangles in the buffer
-    int triangle_capacity;        // Capacity of the triangle buffer
-    bool is_valid;           // Whether this handle is valid
+    brh_triangle_slot slots[BRH_RENDERABLE_FRAME_SLOTS]; // Triangle buffers, one per frame slot
+    int latest_slot;                   // Slot written by the most recent update
+    int triangle_capacity;             // Capacity of each triangle buffer
+    brh_vector3 bounds_min;  // Model-space bounding box of the mesh
+    brh_vector3 bounds_max;
+    bool is_occluder;        // Rasterized into the occlusion buffer each frame
+    int lod_level;           // Level of detail drawn in the latest frame
+    brh_renderable_instance* instances; // Instance transforms (NULL unless instanced)
+    int instance_count;      // 0 draws the mesh once with world_matrix
+    bool instances_need_update; // Whether world_matrix changed since the instances were composed
+    int first_job;           // Face ranges of the frame being built: geometry_jobs[first_job, +job_count)
+    int job_count;
     bool needs_update;       // Whether the world matrix needs to be recalculated
     bool owns_resources;     // Whether this renderable owns its mesh and texture
-} brh_renderable_handle_t;
+    uint32_t version;        // Bumped by every change that moves its triangles
+    uint32_t seen_version;   // Version the latest update saw
+} brh_renderable_t;
 
-// Array of renderable handles
-static brh_renderable_handle_t renderable_handles[MAX_RENDERABLES];
+// Live renderables, packed for iteration and addressed by handle
+static brh_slot_map renderable_map = BRH_SLOT_MAP_INIT(sizeof(brh_renderable_t));
 static int next_renderable_id = 1;  // Start from 1, 0 can be reserved for invalid handles
 
-bool initialize_renderable_system(void)
+// Culling counts and shadow map work of the last update_renderables_to_slot()
+static brh_cull_stats cull_stats;
+static brh_shadow_stats shadow_stats;
+
+// Change tracking. The view version moves whenever the triangles of every renderable would
+// change: a different frame view or light, moved occluders while occlusion culling is on, or
+// any renderable changing while shadows are on (it may cast onto all the others).
+// The scene version moves whenever anything visible changes at all.
+static uint32_t view_version = 0;
+static uint32_t scene_version = 0;
+static uint32_t occluder_version = 0;        // Bumped when any occluder moves, appears or goes
+static uint32_t seen_occluder_version = 0;
+static uint32_t caster_version = 0;          // Bumped when any renderable moves, appears or goes
+static uint32_t seen_caster_version = 0;
+static brh_frame_view previous_view;
+static uint32_t previous_light_version = 0;
+static int previous_renderable_count = -1;
+
+// Face ranges of the frame slot being built, and the jobs that run them. Grown as needed;
+// update_renderables_to_slot() is not reentrant.
+static brh_geometry_job* geometry_jobs = NULL;
+static brh_geometry_batch* geometry_batches = NULL;
+static brh_job* geometry_job_list = NULL;
+static int geometry_job_capacity = 0;
+static int geometry_batch_capacity = 0;
+static int geometry_job_list_capacity = 0;
+
+// Computes the model-space bounding box of a mesh's vertices (empty meshes get a zero box)
+static void compute_mesh_bounds(const brh_mesh* mesh_data, brh_vector3* bounds_min, brh_vector3* bounds_max)
+{
+    const int num_vertices = mesh_data && mesh_data->vertices ? array_length(mesh_data->vertices) : 0;
+    *bounds_min = num_vertices > 0 ? mesh_data->vertices[0] : (brh_vector3){ 0.0f, 0.0f, 0.0f };
+    *bounds_max = *bounds_min;
+    for (int i = 1; i < num_vertices; i++) {
+        const brh_vector3 v = mesh_data->vertices[i];
+        bounds_min->x = MIN(bounds_min->x, v.x);
+        bounds_min->y = MIN(bounds_min->y, v.y);
+        bounds_min->z = MIN(bounds_min->z, v.z);
+        bounds_max->x = MAX(bounds_max->x, v.x);
+        bounds_max->y = MAX(bounds_max->y, v.y);
+        bounds_max->z = MAX(bounds_max->z, v.z);
+    }
+}
+
+// Allocates the buffers of a frame slot if they do not exist yet or are too small for the
+// current number of instances. Each draw gets triangle_capacity triangles.
+static bool allocate_triangle_slot(brh_renderable_t* handle, int slot)
+{
+    brh_triangle_slot* triangle_slot = &handle->slots[slot];
+    const int capacity = handle->triangle_capacity * MAX(1, handle->instance_count);
+    if (triangle_slot->capacity >= capacity || capacity <= 0) {
+        return true;
+    }
+
+    // Texcoord stream only if the renderable can be textured
+    free(triangle_slot->triangles);
+    free(triangle_slot->texcoords);
+    triangle_slot->texcoords = NULL;
+    triangle_slot->capacity = 0;
+    triangle_slot->triangles = (brh_screen_triangle*)malloc(sizeof(brh_screen_triangle) * capacity);
+    if (handle->texture) {
+        triangle_slot->texcoords = (brh_screen_texcoords*)malloc(sizeof(brh_screen_texcoords) * capacity);
+    }
+    if (!triangle_slot->triangles || (handle->texture && !triangle_slot->texcoords)) {
+        fprintf(stderr, "Error: Failed to allocate triangle buffer for renderable\n");
+        free(triangle_slot->triangles);
+        free(triangle_slot->texcoords);
+        triangle_slot->triangles = NULL;
+        triangle_slot->texcoords = NULL;
+        return false;
+    }
+    triangle_slot->capacity = capacity;
+    return true;
+}
+
+static brh_renderable_t* get_renderable(brh_renderable_handle renderable_handle)
+{
+    return (brh_renderable_t*)get_slot_map_item(&renderable_map, renderable_handle);
+}
+
+// Records that a renderable's triangles are out of date (and, for occluders, everyone's)
+static void mark_renderable_changed(brh_renderable_t* handle)
 {
-    // Initialize all renderable handles as invalid
-    for (int i = 0; i < MAX_RENDERABLES; i++) {
-        renderable_handles[i].id = 0;
-        renderable_handles[i].mesh = NULL;
-        renderable_handles[i].texture = NULL;
-        renderable_handles[i].position = (brh_vector3){ 0.0f, 0.0f, 0.0f };
-        renderable_handles[i].rotation = (brh_vector3){ 0.0f, 0.0f, 0.0f };
-        renderable_handles[i].scale = (brh_vector3){ 1.0f, 1.0f, 1.0f };
-        renderable_handles[i].world_matrix = mat4_identity();
-        renderable_handles[i].is_valid = false;
-        renderable_handles[i].needs_update = true;
-        renderable_handles[i].owns_resources = false;
+    handle->version++;
+    caster_version++;
+    if (handle->is_occluder) {
+        occluder_version++;
     }
+}
+
+bool initialize_renderable_system(void)
+{
+    cleanup_renderable_system();
     next_renderable_id = 1;
     return true;
 }
 
 void cleanup_renderable_system(void)
 {
-    // Free all valid renderables
-    for (int i = 0; i < MAX_RENDERABLES; i++) {
-        if (renderable_handles[i].is_valid) {
-            destroy_renderable((brh_renderable_handle)&renderable_handles[i]);
-        }
+    // Free all renderables; each destroy moves the last one to the front
+    while (renderable_map.count > 0) {
+        destroy_renderable(get_slot_map_handle_at(&renderable_map, 0));
     }
+    cleanup_slot_map(&renderable_map);
+    previous_renderable_count = -1;
+
+    free(geometry_jobs);
+    free(geometry_batches);
+    free(geometry_job_list);
+    geometry_jobs = NULL;
+    geometry_batches = NULL;
+    geometry_job_list = NULL;
+    geometry_job_capacity = 0;
+    geometry_batch_capacity = 0;
+    geometry_job_list_capacity = 0;
 }
 
 brh_renderable_handle create_renderable(brh_mesh_handle mesh_handle, brh_texture_handle texture_handle)
@@ -69,56 +231,52 @@ brh_renderable_handle create_renderable(brh_mesh_handle mesh_handle, brh_texture
     // Check if mesh handle is valid
     if (mesh_handle && get_mesh_data(mesh_handle) == NULL) {
         fprintf(stderr, "Error: Invalid mesh handle\n");
-        return NULL;
+        return BRH_NULL_HANDLE;
     }
 
-    // Find an empty slot
-    int slot = -1;
-    for (int i = 0; i < MAX_RENDERABLES; i++) {
-        if (!renderable_handles[i].is_valid) {
-            slot = i;
-            break;
-        }
-    }
-
-    if (slot == -1) {
-        fprintf(stderr, "Error: Maximum number of renderables (%d) reached\n", MAX_RENDERABLES);
-        return NULL;
+    // Take a zero-filled entry
+    brh_renderable_handle renderable_handle;
+    brh_renderable_t* handle = (brh_renderable_t*)insert_slot_map_item(&renderable_map, &renderable_handle);
+    if (!handle) {
+        return BRH_NULL_HANDLE;
     }
 
     // Get mesh face count to allocate triangle buffer
     int face_count = 0;
-    if (mesh_handle) {
-        brh_mesh* mesh_data = get_mesh_data(mesh_handle);
+    brh_mesh* mesh_data = mesh_handle ? get_mesh_data(mesh_handle) : NULL;
+    if (mesh_data) {
         face_count = array_length(mesh_data->faces);
     }
-
-    // Allocate triangle buffer
-    brh_triangle* triangles = NULL;
-    if (face_count > 0) {
-        triangles = (brh_triangle*)malloc(sizeof(brh_triangle) * face_count);
-        if (!triangles) {
-            fprintf(stderr, "Error: Failed to allocate triangle buffer for renderable\n");
-            return NULL;
-        }
+    compute_mesh_bounds(mesh_data, &handle->bounds_min, &handle->bounds_max);
+
+    // Allocate the triangle buffer of the first frame slot up front
+    handle->texture = texture_handle;
+    handle->triangle_capacity = face_count;
+    if (!allocate_triangle_slot(handle, 0)) {
+        remove_slot_map_item(&renderable_map, renderable_handle);
+        return BRH_NULL_HANDLE;
     }
 
-    // Setup the handle
-    renderable_handles[slot].id = next_renderable_id++;
-    renderable_handles[slot].mesh = mesh_handle;
-    renderable_handles[slot].texture = texture_handle;
-    renderable_handles[slot].position = (brh_vector3){ 0.0f, 0.0f, 0.0f };
-    renderable_handles[slot].rotation = (brh_vector3){ 0.0f, 0.0f, 0.0f };
-    renderable_handles[slot].scale = (brh_vector3){ 1.0f, 1.0f, 1.0f };
-    renderable_handles[slot].world_matrix = mat4_identity();
-    renderable_handles[slot].triangles = triangles;
-    renderable_handles[slot].triangle_count = 0;
-    renderable_handles[slot].triangle_capacity = face_count;
-    renderable_handles[slot].is_valid = true;
-    renderable_handles[slot].needs_update = true;
-    renderable_handles[slot].owns_resources = false;
+    // Setup the handle (other fields start zeroed)
+    handle->id = next_renderable_id++;
+    handle->mesh = mesh_handle;
+    handle->position = (brh_vector3){ 0.0f, 0.0f, 0.0f };
+    handle->rotation = (brh_vector3){ 0.0f, 0.0f, 0.0f };
+    handle->scale = (brh_vector3){ 1.0f, 1.0f, 1.0f };
+    handle->world_matrix = mat4_identity();
+    handle->latest_slot = 0;
+    handle->is_occluder = false;
+    handle->lod_level = 0;
+    handle->instances = NULL;
+    handle->instance_count = 0;
+    handle->instances_need_update = false;
+    handle->needs_update = true;
+    handle->owns_resources = false;
+    handle->version = 1;
+    handle->seen_version = 0;
+    caster_version++;
 
-    return (brh_renderable_handle)&renderable_handles[slot];
+    return renderable_handle;
 }
 
 brh_renderable_handle create_renderable_from_files(const char* mesh_file, const char* texture_file)
@@ -127,17 +285,17 @@ brh_renderable_handle create_renderable_from_files(const char* mesh_file, const
     brh_mesh_handle mesh_handle = load_mesh(mesh_file, true);
     if (!mesh_handle) {
         fprintf(stderr, "Error: Failed to load mesh: %s\n", mesh_file);
-        return NULL;
+        return BRH_NULL_HANDLE;
     }
 
     // Load texture if provided
-    brh_texture_handle texture_handle = NULL;
+    brh_texture_handle texture_handle = BRH_NULL_HANDLE;
     if (texture_file != NULL) {
         texture_handle = load_texture(texture_file);
         if (!texture_handle) {
             fprintf(stderr, "Error: Failed to load texture: %s\n", texture_file);
             unload_mesh(mesh_handle);
-            return NULL;
+            return BRH_NULL_HANDLE;
         }
     }
 
@@ -146,29 +304,31 @@ brh_renderable_handle create_renderable_from_files(const char* mesh_file, const
     if (!renderable) {
         if (texture_handle) unload_texture(texture_handle);
         unload_mesh(mesh_handle);
-        return NULL;
+        return BRH_NULL_HANDLE;
     }
 
     // Mark that this renderable owns its resources
-    ((brh_renderable_handle_t*)renderable)->owns_resources = true;
+    get_renderable(renderable)->owns_resources = true;
 
     return renderable;
 }
 
 void destroy_renderable(brh_renderable_handle renderable_handle)
 {
-    if (!renderable_handle || !((brh_renderable_handle_t*)renderable_handle)->is_valid) {
+    brh_renderable_t* handle = get_renderable(renderable_handle);
+    if (!handle) {
         return;
     }
 
-    brh_renderable_handle_t* handle = (brh_renderable_handle_t*)renderable_handle;
-
-    // Free triangle buffer
-    if (handle->triangles) {
-        free(handle->triangles);
-        handle->triangles = NULL;
-        handle->triangle_count = 0;
-        handle->triangle_capacity = 0;
+    // Free triangle buffers of every frame slot
+    for (int i = 0; i < BRH_RENDERABLE_FRAME_SLOTS; i++) {
+        free(handle->slots[i].triangles);
+        free(handle->slots[i].texcoords);
+    }
+    free(handle->instances);
+    caster_version++;
+    if (handle->is_occluder) {
+        occluder_version++;
     }
 
     // If this renderable owns its resources, unload them
@@ -181,81 +341,184 @@ void destroy_renderable(brh_renderable_handle renderable_handle)
         }
     }
 
-    // Invalidate the handle
-    handle->is_valid = false;
-    handle->mesh = NULL;
-    handle->texture = NULL;
+    // Invalidate the handle; the last renderable moves into this entry
+    remove_slot_map_item(&renderable_map, renderable_handle);
+}
+
+int get_renderable_count(void)
+{
+    return renderable_map.count;
 }
 
 void set_renderable_position(brh_renderable_handle renderable_handle, brh_vector3 position)
 {
-    if (!renderable_handle || !((brh_renderable_handle_t*)renderable_handle)->is_valid) {
+    brh_renderable_t* handle = get_renderable(renderable_handle);
+    if (!handle) {
         return;
     }
 
-    brh_renderable_handle_t* handle = (brh_renderable_handle_t*)renderable_handle;
     handle->position = position;
     handle->needs_update = true;
+    mark_renderable_changed(handle);
 }
 
 void set_renderable_rotation(brh_renderable_handle renderable_handle, brh_vector3 rotation)
 {
-    if (!renderable_handle || !((brh_renderable_handle_t*)renderable_handle)->is_valid) {
+    brh_renderable_t* handle = get_renderable(renderable_handle);
+    if (!handle) {
         return;
     }
 
-    brh_renderable_handle_t* handle = (brh_renderable_handle_t*)renderable_handle;
     handle->rotation = rotation;
     handle->needs_update = true;
+    mark_renderable_changed(handle);
 }
 
 void set_renderable_scale(brh_renderable_handle renderable_handle, brh_vector3 scale)
 {
-    if (!renderable_handle || !((brh_renderable_handle_t*)renderable_handle)->is_valid) {
+    brh_renderable_t* handle = get_renderable(renderable_handle);
+    if (!handle) {
         return;
     }
 
-    brh_renderable_handle_t* handle = (brh_renderable_handle_t*)renderable_handle;
     handle->scale = scale;
     handle->needs_update = true;
+    mark_renderable_changed(handle);
 }
 
 brh_vector3 get_renderable_position(brh_renderable_handle renderable_handle)
 {
-    if (!renderable_handle || !((brh_renderable_handle_t*)renderable_handle)->is_valid) {
+    brh_renderable_t* handle = get_renderable(renderable_handle);
+    if (!handle) {
         return (brh_vector3) { 0.0f, 0.0f, 0.0f };
     }
 
-    return ((brh_renderable_handle_t*)renderable_handle)->position;
+    return handle->position;
 }
 
 brh_vector3 get_renderable_rotation(brh_renderable_handle renderable_handle)
 {
-    if (!renderable_handle || !((brh_renderable_handle_t*)renderable_handle)->is_valid) {
+    brh_renderable_t* handle = get_renderable(renderable_handle);
+    if (!handle) {
         return (brh_vector3) { 0.0f, 0.0f, 0.0f };
     }
 
-    return ((brh_renderable_handle_t*)renderable_handle)->rotation;
+    return handle->rotation;
 }
 
 brh_vector3 get_renderable_scale(brh_renderable_handle renderable_handle)
 {
-    if (!renderable_handle || !((brh_renderable_handle_t*)renderable_handle)->is_valid) {
+    brh_renderable_t* handle = get_renderable(renderable_handle);
+    if (!handle) {
         return (brh_vector3) { 1.0f, 1.0f, 1.0f };
     }
 
-    return ((brh_renderable_handle_t*)renderable_handle)->scale;
+    return handle->scale;
 }
 
-brh_mat4 get_renderable_world_matrix(brh_renderable_handle renderable_handle)
+void set_renderable_occluder(brh_renderable_handle renderable_handle, bool is_occluder)
 {
-    if (!renderable_handle || !((brh_renderable_handle_t*)renderable_handle)->is_valid) {
-        return mat4_identity();
+    brh_renderable_t* handle = get_renderable(renderable_handle);
+    if (!handle) {
+        return;
     }
 
-    brh_renderable_handle_t* handle = (brh_renderable_handle_t*)renderable_handle;
+    if (handle->is_occluder != is_occluder) {
+        handle->is_occluder = is_occluder;
+        handle->version++;
+        occluder_version++;
+    }
+}
 
-    // Update world matrix if needed
+bool is_renderable_occluder(brh_renderable_handle renderable_handle)
+{
+    brh_renderable_t* handle = get_renderable(renderable_handle);
+    if (!handle) {
+        return false;
+    }
+    return handle->is_occluder;
+}
+
+int get_renderable_lod_level(brh_renderable_handle renderable_handle)
+{
+    const brh_renderable_t* handle = get_renderable(renderable_handle);
+    if (!handle) {
+        return 0;
+    }
+    return handle->instance_count > 0 ? handle->instances[0].lod_level : handle->lod_level;
+}
+
+bool set_renderable_instance_count(brh_renderable_handle renderable_handle, int instance_count)
+{
+    brh_renderable_t* handle = get_renderable(renderable_handle);
+    if (!handle) {
+        return false;
+    }
+
+    if (instance_count < 0 || instance_count > MAX_RENDERABLE_INSTANCES) {
+        fprintf(stderr, "Error: Instance count %d out of range (0-%d)\n", instance_count, MAX_RENDERABLE_INSTANCES);
+        return false;
+    }
+
+    mark_renderable_changed(handle);
+    if (instance_count == 0) {
+        free(handle->instances);
+        handle->instances = NULL;
+        handle->instance_count = 0;
+        return true;
+    }
+
+    brh_renderable_instance* instances = (brh_renderable_instance*)realloc(handle->instances, sizeof(brh_renderable_instance) * instance_count);
+    if (!instances) {
+        fprintf(stderr, "Error: Failed to allocate %d renderable instances\n", instance_count);
+        return false;
+    }
+
+    // New instances sit at the renderable's own transform
+    for (int i = handle->instance_count; i < instance_count; i++) {
+        instances[i].position = (brh_vector3){ 0.0f, 0.0f, 0.0f };
+        instances[i].rotation = (brh_vector3){ 0.0f, 0.0f, 0.0f };
+        instances[i].scale = (brh_vector3){ 1.0f, 1.0f, 1.0f };
+        instances[i].local_matrix = mat4_identity();
+        instances[i].world_matrix = mat4_identity();
+        instances[i].lod_level = 0;
+        instances[i].needs_update = true;
+    }
+    handle->instances = instances;
+    handle->instance_count = instance_count;
+    return true;
+}
+
+int get_renderable_instance_count(brh_renderable_handle renderable_handle)
+{
+    brh_renderable_t* handle = get_renderable(renderable_handle);
+    if (!handle) {
+        return 0;
+    }
+    return handle->instance_count;
+}
+
+void set_renderable_instance_transform(brh_renderable_handle renderable_handle, int index,
+    brh_vector3 position, brh_vector3 rotation, brh_vector3 scale)
+{
+    brh_renderable_t* handle = get_renderable(renderable_handle);
+    if (!handle) {
+        return;
+    }
+
+    if (index < 0 || index >= handle->instance_count) {
+        return;
+    }
+    handle->instances[index].position = position;
+    handle->instances[index].rotation = rotation;
+    handle->instances[index].scale = scale;
+    handle->instances[index].needs_update = true;
+    mark_renderable_changed(handle);
+}
+
+// Recalculates the world matrix if the transform changed since it was last built
+static void update_world_matrix(brh_renderable_t* handle)
+{
     if (handle->needs_update) {
         handle->world_matrix = mat4_create_world_matrix(
             handle->position,
@@ -263,289 +526,939 @@ brh_mat4 get_renderable_world_matrix(brh_renderable_handle renderable_handle)
             handle->scale
         );
         handle->needs_update = false;
+        handle->instances_need_update = true;
+    }
+}
+
+// Rebuilds the matrices of instances whose transform changed, in one pass over the
+// instances, and composes them with the renderable's world matrix
+static void update_instance_matrices(brh_renderable_t* handle)
+{
+    for (int i = 0; i < handle->instance_count; i++) {
+        brh_renderable_instance* instance = &handle->instances[i];
+        if (instance->needs_update) {
+            instance->local_matrix = mat4_create_world_matrix(instance->position, instance->rotation, instance->scale);
+        }
+        if (instance->needs_update || handle->instances_need_update) {
+            mat4_mul_mat4_ref(&instance->local_matrix, &handle->world_matrix, &instance->world_matrix);
+            instance->needs_update = false;
+        }
     }
+    handle->instances_need_update = false;
+}
+
+// World matrix of one of a renderable's draws: an instance, or the renderable itself
+static const brh_mat4* get_draw_world_matrix(const brh_renderable_t* handle, int draw)
+{
+    return handle->instance_count > 0 ? &handle->instances[draw].world_matrix : &handle->world_matrix;
+}
+
+brh_mat4 get_renderable_world_matrix(brh_renderable_handle renderable_handle)
+{
+    brh_renderable_t* handle = get_renderable(renderable_handle);
+    if (!handle) {
+        return mat4_identity();
+    }
+
+    // Update world matrix if needed
+    update_world_matrix(handle);
 
     return handle->world_matrix;
 }
 
 brh_mesh_handle get_renderable_mesh(brh_renderable_handle renderable_handle)
 {
-    if (!renderable_handle || !((brh_renderable_handle_t*)renderable_handle)->is_valid) {
-        return NULL;
+    brh_renderable_t* handle = get_renderable(renderable_handle);
+    if (!handle) {
+        return BRH_NULL_HANDLE;
     }
 
-    return ((brh_renderable_handle_t*)renderable_handle)->mesh;
+    return handle->mesh;
 }
 
 brh_texture_handle get_renderable_texture(brh_renderable_handle renderable_handle)
 {
-    if (!renderable_handle || !((brh_renderable_handle_t*)renderable_handle)->is_valid) {
-        return NULL;
+    brh_renderable_t* handle = get_renderable(renderable_handle);
+    if (!handle) {
+        return BRH_NULL_HANDLE;
     }
 
-    return ((brh_renderable_handle_t*)renderable_handle)->texture;
+    return handle->texture;
 }
 
-static void update_renderable_triangles(brh_renderable_handle renderable_handle, brh_mat4 camera_matrix, brh_mat4 projection_matrix, brh_vector3 camera_pos_world)
+// Picks the level of detail of one draw from its projected size, given the level it was drawn
+// at last frame. Each level halves the face count, so the ideal level is log2 of how many
+// times too many faces level 0 has for its screen area. A level changes only once the ideal
+// is BRH_LOD_HYSTERESIS past the boundary, so objects hovering at a boundary do not switch
+// every frame.
+static int select_lod_level(const brh_renderable_t* handle, const brh_mat4* world, const brh_frame_view* view, int level)
 {
-    if (!renderable_handle || !((brh_renderable_handle_t*)renderable_handle)->is_valid) {
-        return;
+    const int level_count = get_mesh_lod_count(handle->mesh);
+    if (!view->level_of_detail || level_count <= 1) {
+        return 0;
+    }
+
+    // World-space bounding sphere of the bounding box
+    float scale = 0.0f;
+    for (int j = 0; j < 3; j++) {
+        scale = MAX(scale, sqrtf(world->m[0][j] * world->m[0][j] + world->m[1][j] * world->m[1][j] + world->m[2][j] * world->m[2][j]));
+    }
+    const brh_vector3 local_center = vec3_scale(vec3_add(handle->bounds_min, handle->bounds_max), 0.5f);
+    const brh_vector3 center = vec3_from_vec4(mat4_mul_vec4(world, vec4_from_vec3(local_center)));
+    const float radius = 0.5f * vec3_magnitude(vec3_subtract(handle->bounds_max, handle->bounds_min)) * scale;
+    const float distance = vec3_magnitude(vec3_subtract(center, view->camera_position));
+    if (distance <= radius) {
+        return 0;
     }
 
-    brh_renderable_handle_t* handle = (brh_renderable_handle_t*)renderable_handle;
+    const float radius_pixels = radius / distance * view->projection_matrix.m[1][1] * 0.5f * (float)view->viewport_height;
+    const float area_pixels = MAX(1.0f, (float)M_PI * radius_pixels * radius_pixels);
+    const float faces = (float)handle->triangle_capacity;
+    const float ideal = log2f(faces * BRH_LOD_PIXELS_PER_FACE / area_pixels);
+
+    const int coarser = (int)floorf(ideal - BRH_LOD_HYSTERESIS);
+    const int finer = (int)floorf(ideal + BRH_LOD_HYSTERESIS);
+    if (coarser > level) {
+        level = coarser;
+    }
+    else if (finer < level) {
+        level = finer;
+    }
+    return MAX(0, MIN(level_count - 1, level));
+}
+
+// Prepares a renderable's buffers for the geometry stage of a frame slot. Returns false if
+// it produces no triangles.
+static bool begin_renderable_geometry(brh_renderable_t* handle, int slot, const brh_frame_view* view)
+{
+    brh_triangle_slot* target = &handle->slots[slot];
+    handle->latest_slot = slot;
+
+    // Reset triangle count for this frame
+    target->triangle_count = 0;
+    target->has_texcoords = false;
+    target->shading_method = view->shading_method;
 
     // Skip if no mesh or no triangle buffer
-    if (!handle->mesh || !handle->triangles || handle->triangle_capacity <= 0) {
-        handle->triangle_count = 0; // Ensure count is zero if no mesh/buffer
-        return;
+    if (!handle->mesh || handle->triangle_capacity <= 0 || !allocate_triangle_slot(handle, slot)) {
+        return false;
     }
 
     // Get mesh data
     brh_mesh* mesh_data = get_mesh_data(handle->mesh);
     if (!mesh_data || !mesh_data->vertices || !mesh_data->faces) {
-        handle->triangle_count = 0; // Ensure count is zero if mesh data invalid
-        return;
+        return false;
     }
 
-    // Reset triangle count for this frame
-    handle->triangle_count = 0;
+    // Texture coordinates are only carried to the raster stage when they will be sampled
+    target->has_texcoords = target->texcoords != NULL &&
+        (view->render_method == RENDER_TEXTURED || view->render_method == RENDER_TEXTURED_WIREFRAME);
+    return true;
+}
+
+// Fills in the parts of a draw's geometry jobs shared by all of its face ranges
+static void begin_draw_geometry(brh_renderable_t* handle, int slot, const brh_frame_view* view,
+    const brh_mesh* mesh_data, const brh_mat4* world_matrix, brh_geometry_job* job)
+{
+    job->handle = handle;
+    job->mesh_data = mesh_data;
+    job->view = view;
+    job->target = &handle->slots[slot];
 
     // Get world matrix and calculate normal matrix (inverse transpose of upper 3x3)
-    brh_mat4 world_matrix = get_renderable_world_matrix(renderable_handle);
+    job->world_matrix = *world_matrix;
     // For simplicity, if only uniform scale/rotation/translation, just use upper 3x3 of world matrix for normal transform.
     // A proper implementation uses inverse transpose. Let's approximate for now.
     // TODO: Implement proper inverse transpose for normal transformation if non-uniform scaling is used.
-    brh_mat4 normal_matrix = world_matrix; // Approximation!
-    normal_matrix.m[3][0] = normal_matrix.m[3][1] = normal_matrix.m[3][2] = 0.0f; // Zero out translation
+    job->normal_matrix = job->world_matrix; // Approximation!
+    job->normal_matrix.m[3][0] = job->normal_matrix.m[3][1] = job->normal_matrix.m[3][2] = 0.0f; // Zero out translation
+
+    begin_cluster_culling(&job->culler, &job->world_matrix, &view->camera_matrix, &view->projection_matrix,
+        view->cull_method == CULL_BACKFACE);
+}
+
+// Transforms, lights, culls, clips and packs one face range into the job's own segment of
+// the slot's triangle buffer. Runs on any job worker.
+static void process_face_range(void* data)
+{
+    brh_geometry_job* job = (brh_geometry_job*)data;
+    BRH_PROFILE_BEGIN(geometry_job);
+
+    const brh_mesh* mesh_data = job->mesh_data;
+    const brh_mat4 world_matrix = job->world_matrix;
+    const brh_mat4 normal_matrix = job->normal_matrix;
+    const brh_mat4 camera_matrix = job->view->camera_matrix;
+    const brh_mat4 projection_matrix = job->view->projection_matrix;
+    const brh_vector3 camera_pos_world = job->view->camera_position;
+    const bool has_texcoords = job->target->has_texcoords;
+
+    // The segment holds one triangle per face of the range
+    brh_screen_triangle* segment_triangles = job->target->triangles + job->segment_start;
+    brh_screen_texcoords* segment_texcoords = has_texcoords ? job->target->texcoords + job->segment_start : NULL;
+    const int segment_capacity = job->last_face - job->first_face;
+    job->triangle_count = 0;
+    job->clusters_tested = 0;
+    job->clusters_culled = 0;
+    job->overflowed = false;
+
+    // Clusters are contiguous runs of faces; each is tested once, when the range reaches it
+    const int cluster_count = array_length(mesh_data->clusters);
+    int next_cluster = find_face_cluster(mesh_data, job->first_face);
+    int cluster_end = job->first_face;
 
-    int num_faces = array_length(mesh_data->faces);
     int num_vertices = array_length(mesh_data->vertices);
     int num_texcoords = array_length(mesh_data->texcoords);
     int num_normals = array_length(mesh_data->normals);
 
-    // Get current shading method
-    shading_method current_shading = get_shading_method();
+    // Shading method the frame was submitted with
+    const shading_method current_shading = job->view->shading_method;
 
     // Temporary buffer for clipped triangles
     brh_triangle clipped_triangles[MAX_CLIPPED_TRIANGLES]; // Defined in brh_clipping.h
 
-    for (int i = 0; i < num_faces && handle->triangle_count < handle->triangle_capacity; i++) {
-        brh_face face = mesh_data->faces[i];
+#ifdef BRH_ENABLE_PROFILER
+    // Clipping runs once per face, so its time is summed and recorded as one zone per job
+    const bool profile_clipping = is_profiler_enabled();
+    uint64_t clip_ticks = 0;
+#endif
+
+    // Viewport dimensions for the final screen-space transform
+    const float screen_width = (float)job->view->viewport_width;
+    const float screen_height = (float)job->view->viewport_height;
+
+    // Faces are processed in batches: transform and cull up to BRH_LIGHTING_BATCH_FACES of
+    // them, light the survivors' vertices together (Gouraud), then clip and pack them
+    brh_triangle pending_triangles[BRH_LIGHTING_BATCH_FACES];
+    int pending_faces[BRH_LIGHTING_BATCH_FACES];
+    float position_x[3 * BRH_LIGHTING_BATCH_FACES], position_y[3 * BRH_LIGHTING_BATCH_FACES], position_z[3 * BRH_LIGHTING_BATCH_FACES];
+    float normal_x[3 * BRH_LIGHTING_BATCH_FACES], normal_y[3 * BRH_LIGHTING_BATCH_FACES], normal_z[3 * BRH_LIGHTING_BATCH_FACES];
+    float light_visibility[3 * BRH_LIGHTING_BATCH_FACES];
+    uint32_t base_colors[3 * BRH_LIGHTING_BATCH_FACES];
+    uint32_t vertex_colors[3 * BRH_LIGHTING_BATCH_FACES];
+    brh_light_list local_lights[3 * BRH_LIGHTING_BATCH_FACES];
+
+    for (int i = job->first_face; i < job->last_face && !job->overflowed;) {
+        int pending_count = 0;
+        for (; i < job->last_face && pending_count < BRH_LIGHTING_BATCH_FACES; i++) {
+            // --- 0. Reject whole clusters outside the frustum or facing away ---
+            if (next_cluster >= 0 && next_cluster < cluster_count && i >= cluster_end) {
+                const brh_mesh_cluster* cluster = &mesh_data->clusters[next_cluster++];
+                cluster_end = cluster->first_face + cluster->face_count;
+                job->clusters_tested++;
+                if (!is_cluster_visible(&job->culler, cluster)) {
+                    job->clusters_culled++;
+                    i = MIN(cluster_end, job->last_face) - 1;
+                    continue;
+                }
+            }
 
-        // Basic validation of face indices
-        if (face.a < 0 || face.a >= num_vertices ||
-            face.b < 0 || face.b >= num_vertices ||
-            face.c < 0 || face.c >= num_vertices) {
-            fprintf(stderr, "Warning: Invalid vertex index in face %d\n", i);
-            continue;
-        }
+            brh_face face = mesh_data->faces[i];
 
-        brh_vertex triangle_vertices[3]; // Holds processed vertex data for the triangle
-        brh_vector3 face_vertices_model[3];
-        brh_vector3 face_normals_model[3] = { {0,0,1}, {0,0,1}, {0,0,1} }; // Default normal
-        brh_texel face_texels[3] = { {0, 0}, {0, 0}, {0, 0} };
-        brh_vector4 face_vertices_world[3];
-        brh_vector4 face_vertices_camera[3];
-        brh_vector3 face_normals_world[3];
-
-        // --- 1. Gather Vertex Data (Position, Texcoord, Normal) ---
-        face_vertices_model[0] = mesh_data->vertices[face.a];
-        face_vertices_model[1] = mesh_data->vertices[face.b];
-        face_vertices_model[2] = mesh_data->vertices[face.c];
-
-        if (num_texcoords > 0) {
-            // Validate texcoord indices before access
-            if (face.a_vt >= 0 && face.a_vt < num_texcoords) face_texels[0] = mesh_data->texcoords[face.a_vt];
-            if (face.b_vt >= 0 && face.b_vt < num_texcoords) face_texels[1] = mesh_data->texcoords[face.b_vt];
-            if (face.c_vt >= 0 && face.c_vt < num_texcoords) face_texels[2] = mesh_data->texcoords[face.c_vt];
-        }
+            // Basic validation of face indices
+            if (face.a < 0 || face.a >= num_vertices ||
+                face.b < 0 || face.b >= num_vertices ||
+                face.c < 0 || face.c >= num_vertices) {
+                fprintf(stderr, "Warning: Invalid vertex index in face %d\n", i);
+                continue;
+            }
 
-        if (num_normals > 0) {
-            // Validate normal indices before access
-            if (face.a_vn >= 0 && face.a_vn < num_normals) face_normals_model[0] = mesh_data->normals[face.a_vn];
-            if (face.b_vn >= 0 && face.b_vn < num_normals) face_normals_model[1] = mesh_data->normals[face.b_vn];
-            if (face.c_vn >= 0 && face.c_vn < num_normals) face_normals_model[2] = mesh_data->normals[face.c_vn];
-        }
+            brh_vertex triangle_vertices[3]; // Holds processed vertex data for the triangle
+            brh_vector3 face_vertices_model[3];
+            brh_vector3 face_normals_model[3] = { {0,0,1}, {0,0,1}, {0,0,1} }; // Default normal
+            brh_texel face_texels[3] = { {0, 0}, {0, 0}, {0, 0} };
+            brh_vector4 face_vertices_world[3];
+            brh_vector4 face_vertices_camera[3];
+            brh_vector3 face_normals_world[3];
+
+            // --- 1. Gather Vertex Data (Position, Texcoord, Normal) ---
+            face_vertices_model[0] = mesh_data->vertices[face.a];
+            face_vertices_model[1] = mesh_data->vertices[face.b];
+            face_vertices_model[2] = mesh_data->vertices[face.c];
+
+            if (num_texcoords > 0) {
+                // Validate texcoord indices before access
+                if (face.a_vt >= 0 && face.a_vt < num_texcoords) face_texels[0] = mesh_data->texcoords[face.a_vt];
+                if (face.b_vt >= 0 && face.b_vt < num_texcoords) face_texels[1] = mesh_data->texcoords[face.b_vt];
+                if (face.c_vt >= 0 && face.c_vt < num_texcoords) face_texels[2] = mesh_data->texcoords[face.c_vt];
+            }
 
-        // --- 2. Transform Vertices and Normals, Calculate Initial Vertex Data ---
-        for (int j = 0; j < 3; j++) {
-            // Transform vertex position to World -> Camera -> Clip space
-            brh_vector4 world_vertex = vec4_from_vec3(face_vertices_model[j]);
-            mat4_mul_vec4_ref(&world_matrix, &world_vertex);
-            face_vertices_world[j] = world_vertex; // Store world pos (needed for lighting)
-
-            brh_vector4 camera_vertex = world_vertex;
-            mat4_mul_vec4_ref(&camera_matrix, &camera_vertex);
-            face_vertices_camera[j] = camera_vertex; // Store camera pos (needed for culling)
-
-            brh_vector4 clip_vertex = mat4_mul_vec4(&projection_matrix, camera_vertex);
-
-            // Transform vertex normal to World Space (using approximation)
-            brh_vector4 normal = vec4_from_vec3(face_normals_model[j]);
-            normal.w = 0; // Normals are directions, ignore translation
-            mat4_mul_vec4_ref(&normal_matrix, &normal);
-            face_normals_world[j] = vec3_unit_vector(vec3_from_vec4(normal)); // Normalize world normal
-
-            // Store initial data in brh_vertex
-            triangle_vertices[j].position = clip_vertex; // Clip space position
-            triangle_vertices[j].texel = face_texels[j];
-            triangle_vertices[j].normal = face_normals_world[j]; // Store WORLD SPACE normal
-            triangle_vertices[j].color = face.color; // Store base color temporarily
-
-            // Calculate 1/w for perspective correction (handle w=0 case)
-            if (fabsf(clip_vertex.w) < EPSILON) {
-                triangle_vertices[j].inv_w = 0.0f; // Avoid division by zero
+            if (num_normals > 0) {
+                // Validate normal indices before access
+                if (face.a_vn >= 0 && face.a_vn < num_normals) face_normals_model[0] = mesh_data->normals[face.a_vn];
+                if (face.b_vn >= 0 && face.b_vn < num_normals) face_normals_model[1] = mesh_data->normals[face.b_vn];
+                if (face.c_vn >= 0 && face.c_vn < num_normals) face_normals_model[2] = mesh_data->normals[face.c_vn];
             }
-            else {
-                triangle_vertices[j].inv_w = 1.0f / clip_vertex.w;
+
+            // --- 2. Transform Vertices and Normals, Calculate Initial Vertex Data ---
+            for (int j = 0; j < 3; j++) {
+                // Transform vertex position to World -> Camera -> Clip space
+                brh_vector4 world_vertex = vec4_from_vec3(face_vertices_model[j]);
+                mat4_mul_vec4_ref(&world_matrix, &world_vertex);
+                face_vertices_world[j] = world_vertex; // Store world pos (needed for lighting)
+
+                brh_vector4 camera_vertex = world_vertex;
+                mat4_mul_vec4_ref(&camera_matrix, &camera_vertex);
+                face_vertices_camera[j] = camera_vertex; // Store camera pos (needed for culling)
+
+                brh_vector4 clip_vertex = mat4_mul_vec4(&projection_matrix, camera_vertex);
+
+                // Transform vertex normal to World Space (using approximation)
+                brh_vector4 normal = vec4_from_vec3(face_normals_model[j]);
+                normal.w = 0; // Normals are directions, ignore translation
+                mat4_mul_vec4_ref(&normal_matrix, &normal);
+                face_normals_world[j] = vec3_unit_vector(vec3_from_vec4(normal)); // Normalize world normal
+
+                // Store initial data in brh_vertex
+                triangle_vertices[j].position = clip_vertex; // Clip space position
+                triangle_vertices[j].texel = face_texels[j];
+                triangle_vertices[j].normal = face_normals_world[j]; // Store WORLD SPACE normal
+                triangle_vertices[j].color = face.color; // Store base color temporarily
+
+                // Calculate 1/w for perspective correction (handle w=0 case)
+                if (fabsf(clip_vertex.w) < EPSILON) {
+                    triangle_vertices[j].inv_w = 0.0f; // Avoid division by zero
+                }
+                else {
+                    triangle_vertices[j].inv_w = 1.0f / clip_vertex.w;
+                }
             }
-        }
 
-        // --- 3. Backface Culling (in Camera Space) ---
-        if (get_cull_method() == CULL_BACKFACE) {
-            brh_vector3 vecA_camera = vec3_from_vec4(face_vertices_camera[0]);
-            brh_vector3 vecB_camera = vec3_from_vec4(face_vertices_camera[1]);
-            brh_vector3 vecC_camera = vec3_from_vec4(face_vertices_camera[2]);
+            // --- 3. Backface Culling (in Camera Space) ---
+            if (job->view->cull_method == CULL_BACKFACE) {
+                brh_vector3 vecA_camera = vec3_from_vec4(face_vertices_camera[0]);
+                brh_vector3 vecB_camera = vec3_from_vec4(face_vertices_camera[1]);
+                brh_vector3 vecC_camera = vec3_from_vec4(face_vertices_camera[2]);
 
-            // Calculate normal in camera space for culling
-            brh_vector3 normal_camera = get_face_normal(vecA_camera, vecB_camera, vecC_camera);
+                // Calculate normal in camera space for culling
+                brh_vector3 normal_camera = get_face_normal(vecA_camera, vecB_camera, vecC_camera);
 
-            // View vector from origin (camera) to vertex A in camera space
-            brh_vector3 view_vector_camera = vec3_from_vec4(face_vertices_camera[0]); // Or just vecA_camera
+                // View vector from origin (camera) to vertex A in camera space
+                brh_vector3 view_vector_camera = vec3_from_vec4(face_vertices_camera[0]); // Or just vecA_camera
 
-            // Dot product determines if face is visible
-            float angle_dot_product = vec3_dot(normal_camera, view_vector_camera);
+                // Dot product determines if face is visible
+                float angle_dot_product = vec3_dot(normal_camera, view_vector_camera);
 
-            // Cull if angle is >= 90 degrees (normal points away or parallel to view)
-            if (angle_dot_product >= 0) {
-                continue; // Skip this face
+                // Cull if angle is >= 90 degrees (normal points away or parallel to view)
+                if (angle_dot_product >= 0) {
+                    continue; // Skip this face
+                }
             }
-        }
 
-        // --- 4. Calculate Shading (based on method) ---
-        uint32_t flat_shaded_color = face.color; // Used if flat shading
-
-        if (current_shading == SHADING_FLAT) {
-            // Calculate flat shading using the geometric normal in world space
-            brh_vector3 world_v0 = vec3_from_vec4(face_vertices_world[0]);
-            brh_vector3 world_v1 = vec3_from_vec4(face_vertices_world[1]);
-            brh_vector3 world_v2 = vec3_from_vec4(face_vertices_world[2]);
-            brh_vector3 face_normal_world = get_face_normal(world_v0, world_v1, world_v2);
-            flat_shaded_color = calculate_flat_shading_color(face_normal_world, face.color);
-            // Store this color in the vertices (will be constant across the clipped triangle)
-            triangle_vertices[0].color = flat_shaded_color;
-            triangle_vertices[1].color = flat_shaded_color;
-            triangle_vertices[2].color = flat_shaded_color;
+            // --- 4. Calculate Shading (based on method) ---
+            uint32_t flat_shaded_color = face.color; // Used if flat shading
+
+            if (current_shading == SHADING_FLAT) {
+                // Calculate flat shading using the geometric normal in world space
+                brh_vector3 world_v0 = vec3_from_vec4(face_vertices_world[0]);
+                brh_vector3 world_v1 = vec3_from_vec4(face_vertices_world[1]);
+                brh_vector3 world_v2 = vec3_from_vec4(face_vertices_world[2]);
+                brh_vector3 face_normal_world = get_face_normal(world_v0, world_v1, world_v2);
+
+                // Local lights are gathered at the centroid, from the tile it projects to
+                brh_vector3 centroid_world = vec3_scale(vec3_add(vec3_add(world_v0, world_v1), world_v2), 1.0f / 3.0f);
+                brh_vector4 centroid_clip = {
+                    (triangle_vertices[0].position.x + triangle_vertices[1].position.x + triangle_vertices[2].position.x) / 3.0f,
+                    (triangle_vertices[0].position.y + triangle_vertices[1].position.y + triangle_vertices[2].position.y) / 3.0f,
+                    (triangle_vertices[0].position.z + triangle_vertices[1].position.z + triangle_vertices[2].position.z) / 3.0f,
+                    (triangle_vertices[0].position.w + triangle_vertices[1].position.w + triangle_vertices[2].position.w) / 3.0f
+                };
+                const brh_light_list local_lights = get_light_list_at(centroid_clip);
+                const float light_visibility = job->view->shadows ? sample_shadow_map(centroid_world, face_normal_world) : 1.0f;
+                flat_shaded_color = calculate_flat_shading_color(face_normal_world, centroid_world, face.color,
+                    &local_lights, light_visibility);
+                // Store this color in the vertices (will be constant across the clipped triangle)
+                triangle_vertices[0].color = flat_shaded_color;
+                triangle_vertices[1].color = flat_shaded_color;
+                triangle_vertices[2].color = flat_shaded_color;
+            }
+            else if (current_shading == SHADING_GOURAUD) {
+                // Queue the vertices for the batch's lighting, as a structure of arrays
+                for (int j = 0; j < 3; j++) {
+                    const int v = 3 * pending_count + j;
+                    const brh_vector3 vertex_pos_world = vec3_from_vec4(face_vertices_world[j]);
+                    position_x[v] = vertex_pos_world.x;
+                    position_y[v] = vertex_pos_world.y;
+                    position_z[v] = vertex_pos_world.z;
+                    normal_x[v] = triangle_vertices[j].normal.x; // Already calculated world-space normal
+                    normal_y[v] = triangle_vertices[j].normal.y;
+                    normal_z[v] = triangle_vertices[j].normal.z;
+                    base_colors[v] = face.color;
+                    local_lights[v] = get_light_list_at(triangle_vertices[j].position);
+                    light_visibility[v] = job->view->shadows ? sample_shadow_map(vertex_pos_world, triangle_vertices[j].normal) : 1.0f;
+                }
+            }
+            // For SHADING_PHONG and SHADING_NONE, we don't pre-calculate colors here.
+            // Phong needs interpolated normals, None uses base color/texture directly.
+            // The world-space normals are already stored in triangle_vertices[j].normal
+
+
+            // --- 5. Assemble Triangle for Clipping ---
+            brh_triangle clip_space_triangle = {
+                .vertices = { triangle_vertices[0], triangle_vertices[1], triangle_vertices[2] },
+                .color = (current_shading == SHADING_FLAT) ? flat_shaded_color : face.color, // Pass flat color or original face color
+            };
+            pending_triangles[pending_count] = clip_space_triangle;
+            pending_faces[pending_count] = i;
+            pending_count++;
         }
-        else if (current_shading == SHADING_GOURAUD) {
-            // Calculate lighting per vertex and store in vertex.color
-            for (int j = 0; j < 3; j++) {
-                brh_vector3 vertex_pos_world = vec3_from_vec4(face_vertices_world[j]);
-                triangle_vertices[j].color = calculate_vertex_shading_color(
-                    triangle_vertices[j].normal, // Already calculated world-space normal
-                    vertex_pos_world,
-                    camera_pos_world,
-                    face.color // Base color for the vertex
-                );
+
+        // Light the batch's vertices together
+        if (current_shading == SHADING_GOURAUD && pending_count > 0) {
+            const brh_vertex_batch batch = {
+                .position_x = position_x, .position_y = position_y, .position_z = position_z,
+                .normal_x = normal_x, .normal_y = normal_y, .normal_z = normal_z,
+                .base_colors = base_colors,
+                .light_visibility = light_visibility,
+                .local_lights = local_lights,
+                .count = 3 * pending_count,
+            };
+            calculate_vertex_shading_colors(&batch, camera_pos_world, vertex_colors);
+            for (int p = 0; p < pending_count; p++) {
+                for (int j = 0; j < 3; j++) {
+                    pending_triangles[p].vertices[j].color = vertex_colors[3 * p + j];
+                }
             }
         }
-        // For SHADING_PHONG and SHADING_NONE, we don't pre-calculate colors here.
-        // Phong needs interpolated normals, None uses base color/texture directly.
-        // The world-space normals are already stored in triangle_vertices[j].normal
-
-
-        // --- 5. Assemble Triangle for Clipping ---
-        brh_triangle clip_space_triangle = {
-            .vertices = { triangle_vertices[0], triangle_vertices[1], triangle_vertices[2] },
-            .color = (current_shading == SHADING_FLAT) ? flat_shaded_color : face.color, // Pass flat color or original face color
-        };
-
-
-        // --- 6. Clip Triangle ---
-        int num_clipped_triangles = clip_triangle(&clip_space_triangle, clipped_triangles);
-
-        // --- 7. Process Clipped Triangles ---
-        for (int k = 0; k < num_clipped_triangles && handle->triangle_count < handle->triangle_capacity; k++) {
-            brh_triangle triangle_to_render = clipped_triangles[k];
-
-            // --- 8. Perspective Division & Viewport Transformation ---
-            for (int v = 0; v < 3; v++) {
-                brh_vector4 clip_pos = triangle_to_render.vertices[v].position;
-
-                // Perspective division (guard against w near zero)
-                float inv_w = (fabsf(clip_pos.w) < EPSILON) ? 0.0f : (1.0f / clip_pos.w);
-                brh_vector4 ndc_vertex; // Normalized Device Coordinates
-                ndc_vertex.x = clip_pos.x * inv_w;
-                ndc_vertex.y = clip_pos.y * inv_w;
-                ndc_vertex.z = clip_pos.z * inv_w; // Typically used for depth buffer (0 to 1 or -1 to 1)
-                // We will store 1/w in the Z-buffer for depth comparison later
-                // ndc_vertex.w = clip_pos.w; // Not needed after division
-
-                // Viewport transform
-                // Map NDC X/Y from [-1, 1] to screen coordinates [0, Width]/[0, Height]
-                // Note: Y is often flipped (NDC +1 is top, screen +1 is bottom)
-                triangle_to_render.vertices[v].position.x = (ndc_vertex.x + 1.0f) * 0.5f * (float)get_window_width();
-                triangle_to_render.vertices[v].position.y = (1.0f - ndc_vertex.y) * 0.5f * (float)get_window_height(); // Flip Y
-
-                // Store 1/w for depth testing and perspective correction during rasterization
-                // We use the *original* clip-space W for calculating 1/w
-                triangle_to_render.vertices[v].inv_w = inv_w;
-
-                // Keep Z and W from clip space if needed later (though inv_w is primary for depth/interpolation)
-                triangle_to_render.vertices[v].position.z = clip_pos.z; // Keep original Z if needed
-                triangle_to_render.vertices[v].position.w = clip_pos.w; // Keep original W if needed
+
+        for (int p = 0; p < pending_count; p++) {
+            brh_triangle* clip_space_triangle = &pending_triangles[p];
+
+            // --- 6. Clip Triangle ---
+#ifdef BRH_ENABLE_PROFILER
+            const uint64_t clip_start = profile_clipping ? get_profiler_ticks() : 0;
+#endif
+            int num_clipped_triangles = clip_triangle(clip_space_triangle, clipped_triangles);
+#ifdef BRH_ENABLE_PROFILER
+            if (profile_clipping) clip_ticks += get_profiler_ticks() - clip_start;
+#endif
+
+            // --- 7. Process Clipped Triangles ---
+            int k = 0;
+            for (; k < num_clipped_triangles && job->triangle_count < segment_capacity; k++) {
+                const brh_triangle* clipped = &clipped_triangles[k];
+                brh_screen_triangle* screen_triangle = &segment_triangles[job->triangle_count];
+
+                // --- 8. Perspective Division, Viewport Transformation & Packing ---
+                for (int v = 0; v < 3; v++) {
+                    brh_vector4 clip_pos = clipped->vertices[v].position;
+
+                    // Perspective division (guard against w near zero)
+                    // We store 1/w (from the original clip-space W) for depth testing and perspective correction
+                    float inv_w = (fabsf(clip_pos.w) < EPSILON) ? 0.0f : (1.0f / clip_pos.w);
+                    float ndc_x = clip_pos.x * inv_w;
+                    float ndc_y = clip_pos.y * inv_w;
+
+                    // Viewport transform
+                    // Map NDC X/Y from [-1, 1] to screen coordinates [0, Width]/[0, Height]
+                    // Note: Y is flipped (NDC +1 is top, screen +1 is bottom)
+                    float screen_x = (ndc_x + 1.0f) * 0.5f * screen_width;
+                    float screen_y = (1.0f - ndc_y) * 0.5f * screen_height;
+
+                    // Snap to the subpixel grid used by the rasterizer
+                    screen_triangle->vertices[v].x = (int32_t)lrintf(screen_x * (float)BRH_SUBPIXEL_ONE);
+                    screen_triangle->vertices[v].y = (int32_t)lrintf(screen_y * (float)BRH_SUBPIXEL_ONE);
+                    screen_triangle->vertices[v].inv_w = inv_w;
+                    screen_triangle->vertices[v].color = clipped->vertices[v].color;
+                }
+
+                if (has_texcoords) {
+                    brh_screen_texcoords* texcoords = &segment_texcoords[job->triangle_count];
+                    texcoords->texels[0] = clipped->vertices[0].texel;
+                    texcoords->texels[1] = clipped->vertices[1].texel;
+                    texcoords->texels[2] = clipped->vertices[2].texel;
+                }
+
+                job->triangle_count++;
             }
 
-            // Add the final screen-space triangle to the renderable's buffer
-            handle->triangles[handle->triangle_count++] = triangle_to_render;
+
+            // The segment is full: clipped triangles left over, or faces still to come, need
+            // the room a single range would have
+            if (k < num_clipped_triangles ||
+                (job->triangle_count >= segment_capacity && pending_faces[p] + 1 < job->last_face)) {
+                job->overflowed = true;
+                break; // Stop processing this range if its segment is full
+            }
         }
+    } // End face loop
 
+#ifdef BRH_ENABLE_PROFILER
+    if (profile_clipping && clip_ticks > 0) {
+        const uint64_t now = get_profiler_ticks();
+        record_profiler_zone("clip_triangles", job->handle->id, now - clip_ticks, now);
+    }
+#endif
+    BRH_PROFILE_END_ID(geometry_job, job->handle->id);
+}
+
+static void process_geometry_batch(void* data)
+{
+    const brh_geometry_batch* batch = (const brh_geometry_batch*)data;
+    for (int i = 0; i < batch->job_count; i++) {
+        process_face_range(&batch->jobs[i]);
+    }
+}
 
-        if (handle->triangle_count >= handle->triangle_capacity) {
-            fprintf(stderr, "Warning: Renderable %d triangle buffer filled to capacity (%d triangles)\n", handle->id, handle->triangle_capacity);
-            break; // Stop processing faces for this renderable if buffer is full
+// Moves the segments of a renderable's jobs down into one contiguous run of triangles, in
+// draw and face order, so the output does not depend on how the faces were split or scheduled
+static void compact_renderable_segments(const brh_geometry_job* jobs, int job_count)
+{
+    brh_triangle_slot* target = jobs[0].target;
+    bool overflowed = false;
+
+    int count = 0;
+    for (int j = 0; j < job_count; j++) {
+        const brh_geometry_job* job = &jobs[j];
+        if (count != job->segment_start && job->triangle_count > 0) {
+            memmove(&target->triangles[count], &target->triangles[job->segment_start], sizeof(brh_screen_triangle) * job->triangle_count);
+            if (target->has_texcoords) {
+                memmove(&target->texcoords[count], &target->texcoords[job->segment_start], sizeof(brh_screen_texcoords) * job->triangle_count);
+            }
         }
-    } // End face loop
+        count += job->triangle_count;
+        overflowed = overflowed || job->overflowed;
+    }
+    target->triangle_count = count;
+
+    if (overflowed) {
+        fprintf(stderr, "Warning: Renderable %d triangle buffer filled to capacity (%d triangles)\n", jobs[0].handle->id, jobs[0].handle->triangle_capacity);
+    }
+}
+
+// Finishes a renderable's jobs: reruns overflowed draws, counts their clusters and compacts
+// the segments
+static void build_renderable_segments(brh_geometry_job* jobs, int job_count, brh_cull_stats* stats)
+{
+    // A range that clipped into more triangles than it has faces ran out of segment space.
+    // Redo its draw as a single range, which can use the room culled faces leave.
+    for (int first = 0, last; first < job_count; first = last) {
+        bool overflowed = jobs[first].overflowed;
+        for (last = first + 1; last < job_count && jobs[last].first_face > 0; last++) {
+            overflowed = overflowed || jobs[last].overflowed;
+        }
+        if (overflowed && last - first > 1) {
+            jobs[first].last_face = array_length(jobs[first].mesh_data->faces);
+            process_face_range(&jobs[first]);
+            for (int j = first + 1; j < last; j++) {
+                jobs[j].triangle_count = 0;
+                jobs[j].clusters_tested = 0;
+                jobs[j].clusters_culled = 0;
+                jobs[j].overflowed = false;
+            }
+        }
+    }
+    for (int j = 0; j < job_count; j++) {
+        stats->clusters_tested += jobs[j].clusters_tested;
+        stats->clusters_culled += jobs[j].clusters_culled;
+    }
+
+    compact_renderable_segments(jobs, job_count);
+}
+
+brh_screen_triangle* get_renderable_triangles(brh_renderable_handle renderable_handle)
+{
+    brh_renderable_t* handle = get_renderable(renderable_handle);
+    if (!handle) {
+        return NULL;
+    }
+    return handle->slots[handle->latest_slot].triangles;
 }
 
-brh_triangle* get_renderable_triangles(brh_renderable_handle renderable_handle)
+brh_screen_texcoords* get_renderable_texcoords(brh_renderable_handle renderable_handle)
 {
-    if (!renderable_handle || !((brh_renderable_handle_t*)renderable_handle)->is_valid) {
+    brh_renderable_t* handle = get_renderable(renderable_handle);
+    if (!handle) {
         return NULL;
     }
 
-    return ((brh_renderable_handle_t*)renderable_handle)->triangles;
+    const brh_triangle_slot* latest = &handle->slots[handle->latest_slot];
+    return latest->has_texcoords ? latest->texcoords : NULL;
 }
 
 int get_renderable_triangle_count(brh_renderable_handle renderable_handle)
 {
-    if (!renderable_handle || !((brh_renderable_handle_t*)renderable_handle)->is_valid) {
+    brh_renderable_t* handle = get_renderable(renderable_handle);
+    if (!handle) {
         return 0;
     }
+    return handle->slots[handle->latest_slot].triangle_count;
+}
 
-    return ((brh_renderable_handle_t*)renderable_handle)->triangle_count;
+// Builds the draw command for the triangles a renderable wrote to a frame slot
+static brh_draw_command make_draw_command(const brh_renderable_t* handle, int slot)
+{
+    const brh_triangle_slot* source = &handle->slots[slot];
+    brh_draw_command command = {
+        .triangles = source->triangles,
+        .texcoords = source->has_texcoords ? source->texcoords : NULL,
+        .texture = handle->texture,
+        .triangle_count = source->triangle_count,
+        .renderable_id = handle->id,
+        .shading_method = source->shading_method,
+    };
+    return command;
 }
 
-void update_renderables(float delta_time, brh_mat4 camera_matrix, brh_mat4 projection_matrix, brh_mouse_camera* camera)
+void draw_renderable(brh_renderable_handle renderable_handle)
+{
+    brh_renderable_t* handle = get_renderable(renderable_handle);
+    if (!handle) {
+        return;
+    }
+
+    const brh_draw_command command = make_draw_command(handle, handle->latest_slot);
+    draw_renderable_command(&command, get_render_method());
+}
+
+void draw_renderable_command(const brh_draw_command* command, enum render_method render_method)
 {
-    // Update all valid renderables
-    for (int i = 0; i < MAX_RENDERABLES; i++) {
-        if (renderable_handles[i].is_valid) {
-            // Update world matrix if needed
-            if (renderable_handles[i].needs_update) {
-                renderable_handles[i].world_matrix = mat4_create_world_matrix(
-                    renderable_handles[i].position,
-                    renderable_handles[i].rotation,
-                    renderable_handles[i].scale
+    if (!command || command->triangle_count <= 0) {
+        return;
+    }
+    BRH_PROFILE_BEGIN(rasterize_renderable);
+
+    const enum render_method current_render_method = render_method;
+    brh_texture_handle texture = command->texture;
+    const brh_screen_texcoords* texcoords = command->texcoords;
+
+    // Draw filled/textured triangles first (they use Z-buffer)
+    const bool needs_fill = (current_render_method == RENDER_FILL || current_render_method == RENDER_FILL_WIREFRAME);
+    const bool needs_texture = (current_render_method == RENDER_TEXTURED || current_render_method == RENDER_TEXTURED_WIREFRAME);
+    const bool needs_outline = (current_render_method == RENDER_WIREFRAME ||
+                                current_render_method == RENDER_WIREFRAME_VERTEX ||
+                                current_render_method == RENDER_FILL_WIREFRAME ||
+                                current_render_method == RENDER_TEXTURED_WIREFRAME);
+
+    for (int i = 0; i < command->triangle_count; i++) {
+        const brh_screen_triangle* triangle = &command->triangles[i];
+        if (needs_texture && texture != BRH_NULL_HANDLE && texcoords != NULL) {
+            draw_textured_triangle(triangle, &texcoords[i], texture, command->shading_method);
+        }
+        else if (needs_fill || needs_texture) { // Fallback to fill if texture needed but missing
+            // Fill color comes from the vertex colors (base or flat-shaded color)
+            draw_filled_triangle(triangle, command->shading_method);
+        }
+
+        // Draw wireframe overlay if required (drawn on top)
+        if (needs_outline) {
+            draw_triangle_outline(triangle, 0xFFBBBBBB);  // Light gray wireframe
+        }
+
+        // Draw vertex markers if required (drawn on top)
+        if (current_render_method == RENDER_WIREFRAME_VERTEX) {
+            for (int j = 0; j < 3; j++) {
+                draw_rect(
+                    (triangle->vertices[j].x >> BRH_SUBPIXEL_BITS) - 2,
+                    (triangle->vertices[j].y >> BRH_SUBPIXEL_BITS) - 2,
+                    4, 4, 0xFFFF0000 // Red vertices
                 );
-                renderable_handles[i].needs_update = false;
             }
+        }
+    }
+
+    BRH_PROFILE_END_ID(rasterize_renderable, command->renderable_id);
+}
+
+// Whether a command draws through the texture kernels (the others fall back to a fill)
+static bool is_textured_command(const brh_draw_command* command, enum render_method render_method)
+{
+    const bool needs_texture = (render_method == RENDER_TEXTURED || render_method == RENDER_TEXTURED_WIREFRAME);
+    return needs_texture && command->texture != BRH_NULL_HANDLE && command->texcoords != NULL;
+}
+
+// Writes the depth of a command's filled triangles, and with an id buffer the id of each one
+// (first_id for its first triangle, counting up)
+static void draw_command_depth_pass(const brh_draw_command* command, enum render_method render_method,
+    uint32_t* id_buffer, uint32_t first_id)
+{
+    const bool needs_fill = (render_method == RENDER_FILL || render_method == RENDER_FILL_WIREFRAME ||
+                             render_method == RENDER_TEXTURED || render_method == RENDER_TEXTURED_WIREFRAME);
+    if (!command || command->triangle_count <= 0 || !needs_fill) {
+        return;
+    }
+
+    // Flat shading fills the lit face color without sampling, so only the other textured
+    // modes can leave holes; Gouraud fills skip triangles whose base color has no alpha
+    const bool textured = is_textured_command(command, render_method);
+    const bool alpha_tested = textured && command->shading_method != SHADING_FLAT && !is_texture_opaque(command->texture);
+    const bool alpha_gated = !textured && command->shading_method == SHADING_GOURAUD;
+    for (int i = 0; i < command->triangle_count; i++) {
+        const brh_screen_triangle* triangle = &command->triangles[i];
+        if (alpha_gated && (triangle->vertices[0].color >> 24) == 0) {
+            continue;
+        }
+        const brh_screen_texcoords* texcoords = alpha_tested ? &command->texcoords[i] : NULL;
+        const brh_texture_handle texture = alpha_tested ? command->texture : BRH_NULL_HANDLE;
+        if (id_buffer) {
+            draw_visibility_triangle(triangle, texcoords, texture, id_buffer, first_id + (uint32_t)i);
+        }
+        else {
+            draw_prepass_triangle(triangle, texcoords, texture);
+        }
+    }
+}
+
+void draw_renderable_depth_command(const brh_draw_command* command, enum render_method render_method)
+{
+    draw_command_depth_pass(command, render_method, NULL, 0);
+}
+
+void draw_renderable_visibility_command(const brh_draw_command* command, enum render_method render_method,
+    uint32_t* id_buffer, uint32_t first_id)
+{
+    if (id_buffer) {
+        draw_command_depth_pass(command, render_method, id_buffer, first_id);
+    }
+}
+
+void update_renderables(float delta_time, brh_mat4 camera_matrix, brh_mat4 projection_matrix, brh_mouse_camera* camera)
+{
+    (void)delta_time;
+
+    const brh_frame_view view = {
+        .camera_matrix = camera_matrix,
+        .projection_matrix = projection_matrix,
+        .camera_position = get_mouse_camera_position(camera),
+        .render_method = get_render_method(),
+        .shading_method = get_shading_method(),
+        .cull_method = get_cull_method(),
+        .viewport_width = get_render_width(),
+        .viewport_height = get_render_height(),
+        .occlusion_culling = false,
+        .level_of_detail = false,
+        .shadows = false,
+        .depth_prepass = false,
+        .visibility_buffer = false,
+    };
+    update_renderables_to_slot(0, &view, NULL, 0);
+}
+
+// Grows the per-frame job buffers to hold at least count face ranges
+static bool reserve_geometry_jobs(int count)
+{
+    return reserve_buffer((void**)&geometry_jobs, &geometry_job_capacity, count, sizeof(brh_geometry_job), "geometry jobs") &&
+        reserve_buffer((void**)&geometry_batches, &geometry_batch_capacity, count, sizeof(brh_geometry_batch), "geometry job batches") &&
+        reserve_buffer((void**)&geometry_job_list, &geometry_job_list_capacity, count, sizeof(brh_job), "geometry job entries");
+}
+
+// Whether two frame views produce the same triangles
+static bool frame_views_equal(const brh_frame_view* a, const brh_frame_view* b)
+{
+    return memcmp(&a->camera_matrix, &b->camera_matrix, sizeof(brh_mat4)) == 0 &&
+        memcmp(&a->projection_matrix, &b->projection_matrix, sizeof(brh_mat4)) == 0 &&
+        a->camera_position.x == b->camera_position.x &&
+        a->camera_position.y == b->camera_position.y &&
+        a->camera_position.z == b->camera_position.z &&
+        a->render_method == b->render_method &&
+        a->shading_method == b->shading_method &&
+        a->cull_method == b->cull_method &&
+        a->viewport_width == b->viewport_width &&
+        a->viewport_height == b->viewport_height &&
+        a->occlusion_culling == b->occlusion_culling &&
+        a->level_of_detail == b->level_of_detail &&
+        a->shadows == b->shadows;
+}
+
+int update_renderables_to_slot(int slot, const brh_frame_view* view, brh_draw_command* commands, int max_commands)
+{
+    if (slot < 0 || slot >= BRH_RENDERABLE_FRAME_SLOTS || !view) {
+        return 0;
+    }
+
+    brh_renderable_t* renderables = (brh_renderable_t*)renderable_map.items;
+    const int renderable_count = renderable_map.count;
+    int job_count = 0;
+
+    // Anything that changes the triangles of every renderable starts a new view version
+    const uint32_t light_version = get_light_version();
+    if (view_version == 0 || !frame_views_equal(view, &previous_view) || light_version != previous_light_version ||
+        (view->occlusion_culling && occluder_version != seen_occluder_version) ||
+        (view->shadows && caster_version != seen_caster_version)) {
+        view_version++;
+        scene_version++;
+    }
+    previous_view = *view;
+    previous_light_version = light_version;
+    seen_occluder_version = occluder_version;
+    seen_caster_version = caster_version;
+    if (renderable_count != previous_renderable_count) {
+        scene_version++;
+        previous_renderable_count = renderable_count;
+    }
+
+    // Update world matrices that changed, then the instances placed relative to them. A
+    // renderable whose slot already holds triangles of its current version for this view
+    // keeps them.
+    int rebuild_count = 0;
+    for (int i = 0; i < renderable_count; i++) {
+        brh_renderable_t* handle = &renderables[i];
+        update_world_matrix(handle);
+        update_instance_matrices(handle);
+        if (handle->version != handle->seen_version) {
+            handle->seen_version = handle->version;
+            scene_version++;
+        }
+        if (handle->slots[slot].version != handle->version || handle->slots[slot].view_version != view_version) {
+            rebuild_count++;
+        }
+    }
+
+    // Bin the local lights into screen tiles and rasterize the occluders before any
+    // renderable is shaded or tested against them
+    if (rebuild_count > 0) {
+        build_light_tiles(&view->camera_matrix, &view->projection_matrix, view->viewport_width, view->viewport_height);
+
+        brh_mat4 view_projection;
+        mat4_mul_mat4_ref(&view->camera_matrix, &view->projection_matrix, &view_projection);
+        begin_occlusion_frame(&view_projection);
+    }
+    if (view->occlusion_culling && rebuild_count > 0) {
+        BRH_PROFILE_BEGIN(occlusion);
+        for (int i = 0; i < renderable_count; i++) {
+            const brh_renderable_t* handle = &renderables[i];
+            if (handle->is_occluder && handle->mesh) {
+                for (int k = 0; k < MAX(1, handle->instance_count); k++) {
+                    rasterize_occluder(get_mesh_data(handle->mesh), get_draw_world_matrix(handle, k));
+                }
+            }
+        }
+        BRH_PROFILE_END(occlusion);
+    }
+
+    // Every renderable casts shadows, culled or not; the map is complete before any vertex is lit
+    memset(&shadow_stats, 0, sizeof(shadow_stats));
+    if (view->shadows && rebuild_count > 0) {
+        begin_shadow_frame(get_global_light().direction);
+        for (int i = 0; i < renderable_count; i++) {
+            const brh_renderable_t* handle = &renderables[i];
+            if (handle->mesh) {
+                for (int k = 0; k < MAX(1, handle->instance_count); k++) {
+                    add_shadow_caster(get_mesh_data(handle->mesh), get_draw_world_matrix(handle, k),
+                        handle->bounds_min, handle->bounds_max);
+                }
+            }
+        }
+        build_shadow_map();
+        shadow_stats = get_shadow_stats();
+    }
+    memset(&cull_stats, 0, sizeof(cull_stats));
+
+    // Split every visible draw into face ranges. An instanced renderable draws its mesh once
+    // per instance; the visible instances write consecutive segments of one triangle buffer.
+    for (int i = 0; i < renderable_count; i++) {
+        brh_renderable_t* handle = &renderables[i];
+        brh_triangle_slot* target = &handle->slots[slot];
+        handle->job_count = 0;
+        handle->first_job = job_count;
+        if (target->version == handle->version && target->view_version == view_version) {
+            handle->latest_slot = slot;
+            cull_stats.geometry_reused++;
+            continue;
+        }
+        memset(&target->cull_stats, 0, sizeof(target->cull_stats));
+        target->version = 0;
+        if (!begin_renderable_geometry(handle, slot, view)) {
+            continue;
+        }
+        target->version = handle->version;
+        target->view_version = view_version;
+
+        int visible_draws = 0;
+        for (int k = 0; k < MAX(1, handle->instance_count); k++) {
+            const brh_mat4* world_matrix = get_draw_world_matrix(handle, k);
+            int* lod_level = handle->instance_count > 0 ? &handle->instances[k].lod_level : &handle->lod_level;
+            *lod_level = select_lod_level(handle, world_matrix, view, *lod_level);
+
+            // Skip draws entirely outside the frustum or hidden behind the occluders
+            const bool test_occlusion = view->occlusion_culling && !handle->is_occluder;
+            const enum box_visibility visibility = test_box_visibility(handle->bounds_min,
+                handle->bounds_max, world_matrix, test_occlusion);
+            target->cull_stats.tested++;
+            if (visibility == BOX_OUTSIDE_FRUSTUM) {
+                target->cull_stats.frustum_culled++;
+                continue;
+            }
+            if (visibility == BOX_OCCLUDED) {
+                target->cull_stats.occlusion_culled++;
+                continue;
+            }
+
+            // Small draws run as one range; large ones are split into ranges of similar size
+            const brh_mesh* mesh_data = get_mesh_lod_data(handle->mesh, *lod_level);
+            const int num_faces = array_length(mesh_data->faces);
+            const int ranges = MIN(BRH_MAX_JOBS_PER_DRAW, (num_faces + BRH_GEOMETRY_JOB_FACES - 1) / BRH_GEOMETRY_JOB_FACES);
+            if (ranges <= 0 || !reserve_geometry_jobs(job_count + ranges)) {
+                continue;
+            }
+
+            brh_geometry_job shared;
+            begin_draw_geometry(handle, slot, view, mesh_data, world_matrix, &shared);
+            const int draw_start = visible_draws++ * handle->triangle_capacity;
+            const int faces_per_range = (num_faces + ranges - 1) / ranges;
+            for (int first_face = 0; first_face < num_faces; first_face += faces_per_range) {
+                brh_geometry_job* job = &geometry_jobs[job_count++];
+                *job = shared;
+                job->first_face = first_face;
+                job->last_face = MIN(num_faces, first_face + faces_per_range);
+                job->segment_start = draw_start + first_face;
+            }
+        }
+        handle->job_count = job_count - handle->first_job;
+    }
 
-            // Update triangles
-            update_renderable_triangles((brh_renderable_handle)&renderable_handles[i],
-                camera_matrix,
-                projection_matrix,
-                get_mouse_camera_position(camera));
+    // Batch consecutive ranges into jobs of about BRH_GEOMETRY_JOB_FACES faces, so many small
+    // renderables or instances do not each pay for scheduling a job
+    int batch_count = 0;
+    for (int j = 0; j < job_count;) {
+        brh_geometry_batch* batch = &geometry_batches[batch_count];
+        batch->jobs = &geometry_jobs[j];
+        batch->job_count = 0;
+        int faces = 0;
+        do {
+            faces += geometry_jobs[j].last_face - geometry_jobs[j].first_face;
+            batch->job_count++;
+            j++;
+        } while (j < job_count && faces < BRH_GEOMETRY_JOB_FACES);
+        geometry_job_list[batch_count++] = (brh_job){ process_geometry_batch, batch };
+    }
+
+    run_jobs(geometry_job_list, batch_count);
+
+    // Compact each renderable's new segments and append its triangles, new or reused, to the
+    // frame's command list
+    int command_count = 0;
+    for (int i = 0; i < renderable_count; i++) {
+        brh_renderable_t* handle = &renderables[i];
+        brh_triangle_slot* target = &handle->slots[slot];
+        if (handle->job_count > 0) {
+            build_renderable_segments(&geometry_jobs[handle->first_job], handle->job_count, &target->cull_stats);
+        }
+
+        cull_stats.tested += target->cull_stats.tested;
+        cull_stats.frustum_culled += target->cull_stats.frustum_culled;
+        cull_stats.occlusion_culled += target->cull_stats.occlusion_culled;
+        cull_stats.clusters_tested += target->cull_stats.clusters_tested;
+        cull_stats.clusters_culled += target->cull_stats.clusters_culled;
+
+        if (commands && command_count < max_commands && target->triangle_count > 0) {
+            commands[command_count++] = make_draw_command(handle, slot);
         }
     }
-}
\ No newline at end of file
+
+    return command_count;
+}
+
+brh_cull_stats get_renderable_cull_stats(void)
+{
+    return cull_stats;
+}
+
+brh_shadow_stats get_renderable_shadow_stats(void)
+{
+    return shadow_stats;
+}
+
+uint32_t get_renderable_scene_version(void)
+{
+    return scene_version;
+}
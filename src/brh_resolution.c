@@ -0,0 +1,83 @@
+#include <math.h>
+#include "brh_resolution.h"
+#include "brh_display.h"
+#include "math_utils.h"
+
+// Weight of the newest frame in the smoothed frame time
+#define BRH_RESOLUTION_SMOOTHING 0.1
+// Scale up only below this fraction of the budget, so small dips do not cause changes
+#define BRH_RESOLUTION_HEADROOM 0.8
+// Adjustments aim slightly under the budget to leave room for frame-to-frame variance
+#define BRH_RESOLUTION_AIM 0.9
+
+static brh_resolution_options resolution_options = { 0.0, 1.0f, 1.0f };
+static float render_scale = 1.0f;
+static double average_frame_ms = 0.0;
+static int cooldown_frames = 0;
+
+void initialize_resolution_controller(const brh_resolution_options* options)
+{
+    brh_resolution_options defaults = { .target_frame_ms = 0.0, .min_scale = 1.0f, .max_scale = 1.0f };
+    resolution_options = options ? *options : defaults;
+
+    resolution_options.max_scale = MAX(0.1f, MIN(1.0f, resolution_options.max_scale));
+    resolution_options.min_scale = MAX(0.1f, MIN(resolution_options.max_scale, resolution_options.min_scale));
+
+    render_scale = resolution_options.max_scale;
+    average_frame_ms = 0.0;
+    cooldown_frames = 0;
+}
+
+bool is_resolution_controller_enabled(void)
+{
+    return resolution_options.target_frame_ms > 0.0;
+}
+
+void update_resolution_controller(double frame_ms)
+{
+    if (!is_resolution_controller_enabled() || frame_ms <= 0.0) return;
+
+    average_frame_ms = average_frame_ms > 0.0 ?
+        average_frame_ms + BRH_RESOLUTION_SMOOTHING * (frame_ms - average_frame_ms) :
+        frame_ms;
+
+    if (cooldown_frames > 0) {
+        cooldown_frames--;
+        return;
+    }
+
+    // Scale down as soon as the budget is exceeded, but up only with clear headroom
+    const double budget = resolution_options.target_frame_ms;
+    if (average_frame_ms <= budget && average_frame_ms >= budget * BRH_RESOLUTION_HEADROOM) return;
+
+    float scale = render_scale * (float)sqrt(budget * BRH_RESOLUTION_AIM / average_frame_ms);
+    scale = MAX(render_scale - BRH_RESOLUTION_MAX_STEP, MIN(render_scale + BRH_RESOLUTION_MAX_STEP, scale));
+    scale = MAX(resolution_options.min_scale, MIN(resolution_options.max_scale, scale));
+    if (fabsf(scale - render_scale) < 0.01f) return;
+
+    // Predict the new frame time from the pixel ratio until fresh measurements arrive
+    const float ratio = scale / render_scale;
+    average_frame_ms *= (double)(ratio * ratio);
+    render_scale = scale;
+    cooldown_frames = BRH_RESOLUTION_COOLDOWN_FRAMES;
+}
+
+float get_render_scale(void)
+{
+    return render_scale;
+}
+
+void set_render_scale(float scale)
+{
+    render_scale = MAX(resolution_options.min_scale, MIN(resolution_options.max_scale, scale));
+}
+
+void get_scaled_render_size(int* width, int* height)
+{
+    if (width) {
+        *width = MAX(1, (int)lroundf((float)get_window_width() * render_scale));
+    }
+    if (height) {
+        *height = MAX(1, (int)lroundf((float)get_window_height() * render_scale));
+    }
+}
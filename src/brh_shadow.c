@@ -0,0 +1,349 @@
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "brh_shadow.h"
+#include "brh_triangle.h"
+#include "brh_jobs.h"
+#include "brh_profiler.h"
+#include "array.h"
+#include "math_utils.h"
+
+// Rows of the shadow map filled by one raster job
+#define BRH_SHADOW_BAND_ROWS 32
+#define BRH_SHADOW_BAND_COUNT ((BRH_SHADOW_MAP_SIZE + BRH_SHADOW_BAND_ROWS - 1) / BRH_SHADOW_BAND_ROWS)
+// Casters transformed by one job at least
+#define BRH_SHADOW_CASTER_GRAIN 4
+// How far (in texels) a looked-up point is pushed along its normal
+#define BRH_SHADOW_NORMAL_OFFSET 1.0f
+// How far (in texels' worth of depth) a point may be behind the stored depth and still be lit
+#define BRH_SHADOW_DEPTH_BIAS 2.0f
+
+// A registered caster and where its transformed vertices and triangles go
+typedef struct {
+    const brh_mesh* mesh_data;
+    brh_mat4 world_matrix;
+    int first_vertex;
+    int first_triangle;
+} brh_shadow_caster;
+
+// A caster vertex in map space, snapped like a screen vertex
+typedef struct {
+    int32_t x;
+    int32_t y;
+    float depth;
+} brh_shadow_vertex;
+
+static float* shadow_map = NULL;
+static bool shadow_map_valid = false;   // Whether the map holds casters, so lookups read it
+
+static brh_shadow_caster* casters = NULL;
+static int caster_count = 0;
+static int caster_capacity = 0;
+
+static brh_screen_triangle* caster_triangles = NULL;
+static int caster_triangle_capacity = 0;
+static int caster_triangle_count = 0;
+static brh_shadow_vertex* caster_vertices = NULL;
+static int caster_vertex_capacity = 0;
+
+// Triangles binned by the bands they touch: band b draws band_triangles[band_offsets[b], band_offsets[b + 1])
+static int band_offsets[BRH_SHADOW_BAND_COUNT + 1];
+static int* band_triangles = NULL;
+static int band_triangle_capacity = 0;
+
+// Light basis, and the casters' bounds along it
+static brh_vector3 light_right;
+static brh_vector3 light_up;
+static brh_vector3 light_forward;
+static brh_vector3 light_bounds_min;
+static brh_vector3 light_bounds_max;
+
+// World space to (texel x, texel y, depth key), and the lookup offsets derived from it
+static brh_mat4 light_matrix;
+static float texel_world_size = 0.0f;
+static float depth_bias = 0.0f;
+
+static brh_shadow_stats shadow_stats;
+
+void begin_shadow_frame(brh_vector3 light_direction)
+{
+    caster_count = 0;
+    light_bounds_min = (brh_vector3){ FLT_MAX, FLT_MAX, FLT_MAX };
+    light_bounds_max = (brh_vector3){ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+    // Any basis around the direction will do; avoid an up vector parallel to it
+    light_forward = vec3_unit_vector(light_direction);
+    const brh_vector3 up_hint = fabsf(light_forward.y) < 0.99f ? (brh_vector3){ 0.0f, 1.0f, 0.0f } : (brh_vector3){ 1.0f, 0.0f, 0.0f };
+    light_right = vec3_unit_vector(vec3_cross(up_hint, light_forward));
+    light_up = vec3_cross(light_forward, light_right);
+}
+
+void add_shadow_caster(const brh_mesh* mesh_data, const brh_mat4* world_matrix, brh_vector3 bounds_min, brh_vector3 bounds_max)
+{
+    if (!mesh_data || !mesh_data->vertices || !mesh_data->faces) return;
+
+    if (!reserve_buffer((void**)&casters, &caster_capacity, MAX(64, caster_count + 1), sizeof(brh_shadow_caster), "shadow casters")) {
+        return;
+    }
+    brh_shadow_caster* caster = &casters[caster_count++];
+    caster->mesh_data = mesh_data;
+    caster->world_matrix = *world_matrix;
+
+    // Grow the light-space box around the corners of the caster's world bounds
+    for (int i = 0; i < 8; i++) {
+        brh_vector4 corner = {
+            (i & 1) ? bounds_max.x : bounds_min.x,
+            (i & 2) ? bounds_max.y : bounds_min.y,
+            (i & 4) ? bounds_max.z : bounds_min.z,
+            1.0f
+        };
+        mat4_mul_vec4_ref(world_matrix, &corner);
+        const brh_vector3 p = vec3_from_vec4(corner);
+        const brh_vector3 l = { vec3_dot(p, light_right), vec3_dot(p, light_up), vec3_dot(p, light_forward) };
+        light_bounds_min.x = MIN(light_bounds_min.x, l.x);
+        light_bounds_min.y = MIN(light_bounds_min.y, l.y);
+        light_bounds_min.z = MIN(light_bounds_min.z, l.z);
+        light_bounds_max.x = MAX(light_bounds_max.x, l.x);
+        light_bounds_max.y = MAX(light_bounds_max.y, l.y);
+        light_bounds_max.z = MAX(light_bounds_max.z, l.z);
+    }
+}
+
+// Builds the world-to-map transform of the light box: x and y to texels (y down), and the
+// depth along the light to a key that is 1 on the side facing the light and 0 on the far side
+static void fit_light_matrix(void)
+{
+    const float size = (float)BRH_SHADOW_MAP_SIZE;
+    const float extent_x = MAX(light_bounds_max.x - light_bounds_min.x, EPSILON);
+    const float extent_y = MAX(light_bounds_max.y - light_bounds_min.y, EPSILON);
+    const float extent_z = MAX(light_bounds_max.z - light_bounds_min.z, EPSILON);
+    const float scale_x = size / extent_x;
+    const float scale_y = size / extent_y;
+    const float scale_z = 1.0f / extent_z;
+
+    light_matrix = mat4_identity();
+    light_matrix.m[0][0] = light_right.x * scale_x;
+    light_matrix.m[0][1] = light_right.y * scale_x;
+    light_matrix.m[0][2] = light_right.z * scale_x;
+    light_matrix.m[0][3] = -light_bounds_min.x * scale_x;
+    light_matrix.m[1][0] = -light_up.x * scale_y;
+    light_matrix.m[1][1] = -light_up.y * scale_y;
+    light_matrix.m[1][2] = -light_up.z * scale_y;
+    light_matrix.m[1][3] = light_bounds_max.y * scale_y;
+    light_matrix.m[2][0] = -light_forward.x * scale_z;
+    light_matrix.m[2][1] = -light_forward.y * scale_z;
+    light_matrix.m[2][2] = -light_forward.z * scale_z;
+    light_matrix.m[2][3] = light_bounds_max.z * scale_z;
+
+    texel_world_size = MAX(extent_x, extent_y) / size;
+    depth_bias = BRH_SHADOW_DEPTH_BIAS * texel_world_size * scale_z;
+}
+
+// Transforms the vertices of casters [begin, end) into the light's map space once each, then
+// assembles their faces. The map transform is affine, so w is never needed.
+static void transform_casters(void* data, int begin, int end)
+{
+    (void)data;
+    const float subpixel = (float)BRH_SUBPIXEL_ONE;
+    for (int c = begin; c < end; c++) {
+        const brh_shadow_caster* caster = &casters[c];
+        const brh_mesh* mesh_data = caster->mesh_data;
+        brh_mat4 model_to_map;
+        mat4_mul_mat4_ref(&caster->world_matrix, &light_matrix, &model_to_map);
+        const float (*m)[4] = model_to_map.m;
+
+        const int num_vertices = array_length(mesh_data->vertices);
+        brh_shadow_vertex* vertices = &caster_vertices[caster->first_vertex];
+        for (int i = 0; i < num_vertices; i++) {
+            const brh_vector3 v = mesh_data->vertices[i];
+            vertices[i].x = (int32_t)lrintf((m[0][0] * v.x + m[0][1] * v.y + m[0][2] * v.z + m[0][3]) * subpixel);
+            vertices[i].y = (int32_t)lrintf((m[1][0] * v.x + m[1][1] * v.y + m[1][2] * v.z + m[1][3]) * subpixel);
+            vertices[i].depth = m[2][0] * v.x + m[2][1] * v.y + m[2][2] * v.z + m[2][3];
+        }
+
+        const int num_faces = array_length(mesh_data->faces);
+        brh_screen_triangle* out = &caster_triangles[caster->first_triangle];
+        for (int i = 0; i < num_faces; i++) {
+            const brh_face face = mesh_data->faces[i];
+            const int indices[3] = { face.a, face.b, face.c };
+            for (int k = 0; k < 3; k++) {
+                if (indices[k] < 0 || indices[k] >= num_vertices) {
+                    // Collapse the triangle; the kernel skips zero-area triangles
+                    memset(&out[i], 0, sizeof(out[i]));
+                    break;
+                }
+                const brh_shadow_vertex* v = &vertices[indices[k]];
+                out[i].vertices[k] = (brh_screen_vertex){ v->x, v->y, v->depth, 0 };
+            }
+        }
+    }
+}
+
+// Finds the bands a triangle's vertical extent touches; false if it misses the map
+static bool get_triangle_bands(const brh_screen_triangle* triangle, int* first_band, int* last_band)
+{
+    const int32_t y0 = triangle->vertices[0].y, y1 = triangle->vertices[1].y, y2 = triangle->vertices[2].y;
+    const int top_row = MIN(y0, MIN(y1, y2)) >> BRH_SUBPIXEL_BITS;
+    const int bottom_row = MAX(y0, MAX(y1, y2)) >> BRH_SUBPIXEL_BITS;
+    if (bottom_row < 0 || top_row >= BRH_SHADOW_MAP_SIZE) {
+        return false;
+    }
+    *first_band = MAX(top_row, 0) / BRH_SHADOW_BAND_ROWS;
+    *last_band = MIN(bottom_row, BRH_SHADOW_MAP_SIZE - 1) / BRH_SHADOW_BAND_ROWS;
+    return true;
+}
+
+// Lists, for every band, the triangles that touch it, in triangle order
+static bool bin_caster_triangles(void)
+{
+    int first, last;
+    memset(band_offsets, 0, sizeof(band_offsets));
+    for (int i = 0; i < caster_triangle_count; i++) {
+        if (get_triangle_bands(&caster_triangles[i], &first, &last)) {
+            for (int b = first; b <= last; b++) band_offsets[b + 1]++;
+        }
+    }
+    for (int b = 0; b < BRH_SHADOW_BAND_COUNT; b++) {
+        band_offsets[b + 1] += band_offsets[b];
+    }
+
+    const int entries = band_offsets[BRH_SHADOW_BAND_COUNT];
+    if (!reserve_buffer((void**)&band_triangles, &band_triangle_capacity, entries, sizeof(int), "shadow band entries")) {
+        return false;
+    }
+
+    // Fill with each band's cursor at its offset, then shift the advanced offsets back
+    for (int i = 0; i < caster_triangle_count; i++) {
+        if (get_triangle_bands(&caster_triangles[i], &first, &last)) {
+            for (int b = first; b <= last; b++) band_triangles[band_offsets[b]++] = i;
+        }
+    }
+    for (int b = BRH_SHADOW_BAND_COUNT; b > 0; b--) {
+        band_offsets[b] = band_offsets[b - 1];
+    }
+    band_offsets[0] = 0;
+    return true;
+}
+
+// Clears the rows of bands [begin, end) and draws their triangles into them
+static void rasterize_shadow_bands(void* data, int begin, int end)
+{
+    (void)data;
+    for (int band = begin; band < end; band++) {
+        const int row_begin = band * BRH_SHADOW_BAND_ROWS;
+        const int row_end = MIN(row_begin + BRH_SHADOW_BAND_ROWS, BRH_SHADOW_MAP_SIZE);
+        memset(shadow_map + (size_t)row_begin * BRH_SHADOW_MAP_SIZE, 0, sizeof(float) * BRH_SHADOW_MAP_SIZE * (row_end - row_begin));
+
+        for (int i = band_offsets[band]; i < band_offsets[band + 1]; i++) {
+            draw_depth_triangle(&caster_triangles[band_triangles[i]], shadow_map, BRH_SHADOW_MAP_SIZE, BRH_SHADOW_MAP_SIZE, row_begin, row_end);
+        }
+    }
+}
+
+void build_shadow_map(void)
+{
+    BRH_PROFILE_BEGIN(shadow_map);
+    const uint64_t start_ticks = get_profiler_ticks();
+    memset(&shadow_stats, 0, sizeof(shadow_stats));
+    shadow_map_valid = false;
+
+    if (!shadow_map) {
+        shadow_map = (float*)malloc(sizeof(float) * BRH_SHADOW_MAP_SIZE * BRH_SHADOW_MAP_SIZE);
+        if (!shadow_map) {
+            fprintf(stderr, "Error: Failed to allocate the %dx%d shadow map\n", BRH_SHADOW_MAP_SIZE, BRH_SHADOW_MAP_SIZE);
+            return;
+        }
+    }
+    if (caster_count == 0) {
+        memset(shadow_map, 0, sizeof(float) * BRH_SHADOW_MAP_SIZE * BRH_SHADOW_MAP_SIZE);
+        return;
+    }
+
+    // One vertex per mesh vertex and one triangle per face, so each caster's output ranges are known up front
+    int vertex_count = 0;
+    int triangle_count = 0;
+    for (int c = 0; c < caster_count; c++) {
+        casters[c].first_vertex = vertex_count;
+        casters[c].first_triangle = triangle_count;
+        vertex_count += array_length(casters[c].mesh_data->vertices);
+        triangle_count += array_length(casters[c].mesh_data->faces);
+    }
+    if (!reserve_buffer((void**)&caster_vertices, &caster_vertex_capacity, vertex_count, sizeof(brh_shadow_vertex), "shadow caster vertices") ||
+        !reserve_buffer((void**)&caster_triangles, &caster_triangle_capacity, triangle_count, sizeof(brh_screen_triangle), "shadow caster triangles")) {
+        return;
+    }
+    caster_triangle_count = triangle_count;
+
+    fit_light_matrix();
+    parallel_for(caster_count, BRH_SHADOW_CASTER_GRAIN, transform_casters, NULL);
+    if (!bin_caster_triangles()) {
+        return;
+    }
+    parallel_for(BRH_SHADOW_BAND_COUNT, 1, rasterize_shadow_bands, NULL);
+    shadow_map_valid = true;
+
+    shadow_stats.casters = caster_count;
+    shadow_stats.triangles = triangle_count;
+    shadow_stats.depth_ms = (double)(get_profiler_ticks() - start_ticks) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+    BRH_PROFILE_END(shadow_map);
+}
+
+float sample_shadow_map(brh_vector3 position, brh_vector3 normal)
+{
+    if (!shadow_map_valid) {
+        return 1.0f;
+    }
+
+    // Push the point off its surface so the surface does not shadow itself
+    const brh_vector3 offset = vec3_add(position, vec3_scale(normal, BRH_SHADOW_NORMAL_OFFSET * texel_world_size));
+    const brh_vector4 p = mat4_mul_vec4(&light_matrix, vec4_from_vec3(offset));
+    if (!(p.x >= 0.0f && p.y >= 0.0f && p.x < (float)BRH_SHADOW_MAP_SIZE && p.y < (float)BRH_SHADOW_MAP_SIZE)) {
+        return 1.0f; // Outside every caster's shadow
+    }
+
+    const int center_x = (int)p.x;
+    const int center_y = (int)p.y;
+    const float depth = p.z + depth_bias;
+    int lit = 0;
+    for (int dy = -BRH_SHADOW_PCF_RADIUS; dy <= BRH_SHADOW_PCF_RADIUS; dy++) {
+        const int y = MIN(MAX(center_y + dy, 0), BRH_SHADOW_MAP_SIZE - 1);
+        const float* row = shadow_map + (size_t)y * BRH_SHADOW_MAP_SIZE;
+        for (int dx = -BRH_SHADOW_PCF_RADIUS; dx <= BRH_SHADOW_PCF_RADIUS; dx++) {
+            const int x = MIN(MAX(center_x + dx, 0), BRH_SHADOW_MAP_SIZE - 1);
+            lit += depth >= row[x];
+        }
+    }
+    const int taps = (2 * BRH_SHADOW_PCF_RADIUS + 1) * (2 * BRH_SHADOW_PCF_RADIUS + 1);
+    return (float)lit / (float)taps;
+}
+
+brh_shadow_stats get_shadow_stats(void)
+{
+    return shadow_stats;
+}
+
+const float* get_shadow_map(void)
+{
+    return shadow_map;
+}
+
+void cleanup_shadow_map(void)
+{
+    free(shadow_map);
+    free(casters);
+    free(caster_triangles);
+    free(band_triangles);
+    free(caster_vertices);
+    band_triangles = NULL;
+    caster_vertices = NULL;
+    band_triangle_capacity = 0;
+    caster_vertex_capacity = 0;
+    shadow_map = NULL;
+    casters = NULL;
+    caster_triangles = NULL;
+    shadow_map_valid = false;
+    caster_count = caster_capacity = 0;
+    caster_triangle_count = caster_triangle_capacity = 0;
+}
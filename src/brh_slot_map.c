@@ -0,0 +1,129 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "brh_slot_map.h"
+
+#define BRH_SLOT_INDEX_MASK ((1u << BRH_SLOT_INDEX_BITS) - 1)
+#define BRH_SLOT_GENERATION_MASK ((1u << BRH_SLOT_GENERATION_BITS) - 1)
+// Capacity of a map's first allocation
+#define BRH_SLOT_MAP_MIN_CAPACITY 16
+
+static brh_slot_handle make_slot_handle(int slot, uint16_t generation)
+{
+    return ((brh_slot_handle)generation << BRH_SLOT_INDEX_BITS) | (brh_slot_handle)slot;
+}
+
+void initialize_slot_map(brh_slot_map* map, int item_size)
+{
+    const brh_slot_map empty = BRH_SLOT_MAP_INIT(item_size);
+    *map = empty;
+}
+
+void cleanup_slot_map(brh_slot_map* map)
+{
+    free(map->items);
+    free(map->item_slots);
+    free(map->slot_entries);
+    free(map->generations);
+    initialize_slot_map(map, map->item_size);
+}
+
+// Grows every array to hold at least one more slot
+static bool grow_slot_map(brh_slot_map* map)
+{
+    const int capacity = map->capacity > 0 ? map->capacity * 2 : BRH_SLOT_MAP_MIN_CAPACITY;
+
+    // Each array is replaced as soon as it is reallocated, so a failure leaves a consistent map
+    unsigned char* items = (unsigned char*)realloc(map->items, (size_t)map->item_size * capacity);
+    if (items) map->items = items;
+    uint32_t* item_slots = (uint32_t*)realloc(map->item_slots, sizeof(uint32_t) * capacity);
+    if (item_slots) map->item_slots = item_slots;
+    uint32_t* slot_entries = (uint32_t*)realloc(map->slot_entries, sizeof(uint32_t) * capacity);
+    if (slot_entries) map->slot_entries = slot_entries;
+    uint16_t* generations = (uint16_t*)realloc(map->generations, sizeof(uint16_t) * capacity);
+    if (generations) map->generations = generations;
+
+    if (!items || !item_slots || !slot_entries || !generations) {
+        fprintf(stderr, "Error: Failed to grow slot map to %d items\n", capacity);
+        return false;
+    }
+    map->capacity = capacity;
+    return true;
+}
+
+void* insert_slot_map_item(brh_slot_map* map, brh_slot_handle* handle)
+{
+    int slot;
+    if (map->free_slot >= 0) {
+        slot = map->free_slot;
+        map->free_slot = map->slot_entries[slot] == UINT32_MAX ? -1 : (int)map->slot_entries[slot];
+    }
+    else {
+        if (map->slot_count >= BRH_SLOT_MAP_MAX_ITEMS) {
+            fprintf(stderr, "Error: Slot map is full (%d items)\n", BRH_SLOT_MAP_MAX_ITEMS);
+            return NULL;
+        }
+        if (map->slot_count == map->capacity && !grow_slot_map(map)) {
+            return NULL;
+        }
+        slot = map->slot_count++;
+        map->generations[slot] = 1;
+    }
+
+    // Free slots never outnumber free item positions, so the dense array has room
+    const int index = map->count++;
+    map->slot_entries[slot] = (uint32_t)index;
+    map->item_slots[index] = (uint32_t)slot;
+    void* item = map->items + (size_t)index * map->item_size;
+    memset(item, 0, map->item_size);
+
+    *handle = make_slot_handle(slot, map->generations[slot]);
+    return item;
+}
+
+bool remove_slot_map_item(brh_slot_map* map, brh_slot_handle handle)
+{
+    if (!get_slot_map_item(map, handle)) {
+        return false;
+    }
+
+    const int slot = (int)(handle & BRH_SLOT_INDEX_MASK);
+    const int index = (int)map->slot_entries[slot];
+    const int last = --map->count;
+
+    // Fill the hole with the last item so live items stay contiguous
+    if (index != last) {
+        memcpy(map->items + (size_t)index * map->item_size, map->items + (size_t)last * map->item_size, map->item_size);
+        map->item_slots[index] = map->item_slots[last];
+        map->slot_entries[map->item_slots[index]] = (uint32_t)index;
+    }
+
+    // Outdate every handle to this slot, skipping generation 0
+    uint16_t generation = (uint16_t)((map->generations[slot] + 1) & BRH_SLOT_GENERATION_MASK);
+    map->generations[slot] = generation == 0 ? 1 : generation;
+    map->slot_entries[slot] = map->free_slot < 0 ? UINT32_MAX : (uint32_t)map->free_slot;
+    map->free_slot = slot;
+    return true;
+}
+
+void* get_slot_map_item(const brh_slot_map* map, brh_slot_handle handle)
+{
+    const int slot = (int)(handle & BRH_SLOT_INDEX_MASK);
+    const uint16_t generation = (uint16_t)(handle >> BRH_SLOT_INDEX_BITS);
+    if (generation == 0 || slot >= map->slot_count || map->generations[slot] != generation) {
+        return NULL;
+    }
+
+    // A free slot already carries the generation of its next item; its entry is a list link
+    const uint32_t index = map->slot_entries[slot];
+    if (index >= (uint32_t)map->count || map->item_slots[index] != (uint32_t)slot) {
+        return NULL;
+    }
+    return map->items + (size_t)index * map->item_size;
+}
+
+brh_slot_handle get_slot_map_handle_at(const brh_slot_map* map, int index)
+{
+    const int slot = (int)map->item_slots[index];
+    return make_slot_handle(slot, map->generations[slot]);
+}
@@ -1,70 +1,75 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include "upng.h"
 #include "brh_texture_manager.h"
-
-#define MAX_TEXTURES 32  // Maximum number of textures that can be loaded simultaneously
+#include "brh_slot_map.h"
 
 typedef struct brh_texture_data {
 	uint32_t* data;			// Texture pixel data
 	int width;				// Texture width
 	int height;				// Texture height
 	upng_t* png;	        // UPNG structure for this texture
+	bool opaque;			// No texel has zero alpha
 } brh_texture_data;
 
-typedef struct brh_texture_handle_t {
-	int id;						// Unique identifier for this texture
+typedef struct {
 	brh_texture_data* texture;	// Pointer to the actual texture data
-	bool is_valid;				// Whether this handle is valid
-} brh_texture_handle_t;
+	char* file_path;			// Path the texture was loaded from (the cache key)
+	int ref_count;				// Outstanding load_texture() calls for this handle
+} brh_texture_entry;
+
+// Loaded textures, addressed by handle; each file is loaded once and shared
+static brh_slot_map texture_map = BRH_SLOT_MAP_INIT(sizeof(brh_texture_entry));
 
-static brh_texture_handle_t texture_handles[MAX_TEXTURES];
-static int next_texture_id = 1;  // Start from 1, 0 can be reserved for invalid handles
+static void free_texture_entry(brh_texture_handle texture_handle);
 
 bool initialize_texture_system(void)
 {
-	for (int i = 0; i < MAX_TEXTURES; i++)
-	{
-		texture_handles[i].id = 0;
-		texture_handles[i].texture = NULL;
-		texture_handles[i].is_valid = false;
-	}
-
-	next_texture_id = 1;
+	cleanup_texture_system();
 	return true;
 }
 
 void cleanup_texture_system(void)
 {
-    // Free all valid textures
-    for (int i = 0; i < MAX_TEXTURES; i++) {
-        if (texture_handles[i].is_valid && texture_handles[i].texture != NULL) {
-            unload_texture((brh_texture_handle)&texture_handles[i]);
-        }
+    // Free all loaded textures whatever their reference counts; each free moves the last entry to the front
+    while (texture_map.count > 0) {
+        free_texture_entry(get_slot_map_handle_at(&texture_map, 0));
     }
+    cleanup_slot_map(&texture_map);
 }
 
-brh_texture_handle load_texture(const char* file_path)
+static brh_texture_entry* get_texture_entry(brh_texture_handle texture_handle)
 {
-    // Find an empty slot
-    int slot = -1;
-    for (int i = 0; i < MAX_TEXTURES; i++) {
-        if (!texture_handles[i].is_valid) {
-            slot = i;
-            break;
+    return (brh_texture_entry*)get_slot_map_item(&texture_map, texture_handle);
+}
+
+// Finds the loaded texture of a file, or returns BRH_NULL_HANDLE
+static brh_texture_handle find_texture(const char* file_path)
+{
+    const brh_texture_entry* entries = (const brh_texture_entry*)texture_map.items;
+    for (int i = 0; i < texture_map.count; i++) {
+        if (strcmp(entries[i].file_path, file_path) == 0) {
+            return get_slot_map_handle_at(&texture_map, i);
         }
     }
+    return BRH_NULL_HANDLE;
+}
 
-    if (slot == -1) {
-        fprintf(stderr, "Error: Maximum number of textures (%d) reached\n", MAX_TEXTURES);
-        return NULL;
+brh_texture_handle load_texture(const char* file_path)
+{
+    // Share the texture if this file is already loaded
+    const brh_texture_handle shared = find_texture(file_path);
+    if (shared) {
+        get_texture_entry(shared)->ref_count++;
+        return shared;
     }
 
     // Allocate texture structure
     brh_texture_data* new_texture = (brh_texture_data*)malloc(sizeof(brh_texture_data));
     if (!new_texture) {
         fprintf(stderr, "Error: Failed to allocate memory for texture\n");
-        return NULL;
+        return BRH_NULL_HANDLE;
     }
 
     // Load texture data from file
@@ -72,7 +77,7 @@ brh_texture_handle load_texture(const char* file_path)
     if (png == NULL) {
         fprintf(stderr, "Error: Failed to load texture from file: %s\n", file_path);
         free(new_texture);
-        return NULL;
+        return BRH_NULL_HANDLE;
     }
 
     upng_decode(png);
@@ -80,7 +85,7 @@ brh_texture_handle load_texture(const char* file_path)
         fprintf(stderr, "Error: Failed to decode texture: %i\n", upng_get_error_line(png));
         upng_free(png);
         free(new_texture);
-        return NULL;
+        return BRH_NULL_HANDLE;
     }
 
     // Setup texture data
@@ -90,9 +95,11 @@ brh_texture_handle load_texture(const char* file_path)
     new_texture->png = png;
 
     // Convert RGBA to ARGB format (if needed for your renderer)
+    new_texture->opaque = true;
     for (int i = 0; i < new_texture->width * new_texture->height; i++) {
         uint32_t color = new_texture->data[i];
         uint32_t a = (color & 0xFF000000);
+        new_texture->opaque = new_texture->opaque && a != 0;
         uint32_t r = (color & 0x00FF0000) >> 16;
         uint32_t g = (color & 0x0000FF00);
         uint32_t b = (color & 0x000000FF) << 16;
@@ -100,21 +107,32 @@ brh_texture_handle load_texture(const char* file_path)
     }
 
     // Setup the handle
-    texture_handles[slot].id = next_texture_id++;
-    texture_handles[slot].texture = new_texture;
-    texture_handles[slot].is_valid = true;
+    brh_texture_handle texture_handle;
+    char* path_copy = (char*)malloc(strlen(file_path) + 1);
+    brh_texture_entry* entry = path_copy ? (brh_texture_entry*)insert_slot_map_item(&texture_map, &texture_handle) : NULL;
+    if (!entry) {
+        free(path_copy);
+        upng_free(png);
+        free(new_texture);
+        return BRH_NULL_HANDLE;
+    }
+    strcpy(path_copy, file_path);
+    entry->texture = new_texture;
+    entry->file_path = path_copy;
+    entry->ref_count = 1;
 
-    return (brh_texture_handle)&texture_handles[slot];
+    return texture_handle;
 }
 
-void unload_texture(brh_texture_handle texture_handle)
+// Frees a texture and its handle regardless of its reference count
+static void free_texture_entry(brh_texture_handle texture_handle)
 {
-    if (!texture_handle || !((brh_texture_handle_t*)texture_handle)->is_valid) {
+    brh_texture_entry* entry = get_texture_entry(texture_handle);
+    if (!entry) {
         return;
     }
 
-    brh_texture_handle_t* handle = (brh_texture_handle_t*)texture_handle;
-    brh_texture_data* texture = handle->texture;
+    brh_texture_data* texture = entry->texture;
 
     // Free texture resources
     if (texture->png) {
@@ -126,35 +144,56 @@ void unload_texture(brh_texture_handle texture_handle)
 
     // Free texture structure
     free(texture);
+    free(entry->file_path);
 
     // Invalidate handle
-    handle->texture = NULL;
-    handle->is_valid = false;
+    remove_slot_map_item(&texture_map, texture_handle);
+}
+
+void unload_texture(brh_texture_handle texture_handle)
+{
+    brh_texture_entry* entry = get_texture_entry(texture_handle);
+    if (entry && --entry->ref_count == 0) {
+        free_texture_entry(texture_handle);
+    }
 }
 
 uint32_t* get_texture_data(brh_texture_handle texture_handle)
 {
-    if (!texture_handle || !((brh_texture_handle_t*)texture_handle)->is_valid) {
+    const brh_texture_entry* entry = get_texture_entry(texture_handle);
+    if (!entry) {
         return NULL;
     }
 
-    return ((brh_texture_handle_t*)texture_handle)->texture->data;
+    return entry->texture->data;
 }
 
 int get_texture_width(brh_texture_handle texture_handle)
 {
-    if (!texture_handle || !((brh_texture_handle_t*)texture_handle)->is_valid) {
+    const brh_texture_entry* entry = get_texture_entry(texture_handle);
+    if (!entry) {
         return 0;
     }
 
-    return ((brh_texture_handle_t*)texture_handle)->texture->width;
+    return entry->texture->width;
 }
 
 int get_texture_height(brh_texture_handle texture_handle)
 {
-    if (!texture_handle || !((brh_texture_handle_t*)texture_handle)->is_valid) {
+    const brh_texture_entry* entry = get_texture_entry(texture_handle);
+    if (!entry) {
         return 0;
     }
 
-    return ((brh_texture_handle_t*)texture_handle)->texture->height;
-}
\ No newline at end of file
+    return entry->texture->height;
+}
+
+bool is_texture_opaque(brh_texture_handle texture_handle)
+{
+    const brh_texture_entry* entry = get_texture_entry(texture_handle);
+    if (!entry) {
+        return false;
+    }
+
+    return entry->texture->opaque;
+}
@@ -2,54 +2,96 @@
 #include <math.h>
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 #include "brh_triangle.h"
 #include "brh_vector.h"
 #include "math_utils.h"
 #include "brh_display.h"
 #include "brh_light.h"   
 
-// --- Forward Declarations --- 
-static void texture_flat_bottom_perspective_none(int x0, int y0, brh_perspective_attribs pa0, int x1, int y1, brh_perspective_attribs pa1, int x2, int y2, brh_perspective_attribs pa2, const uint32_t* texture, int tex_w, int tex_h, uint32_t* color_buffer, float* z_buffer, int win_w, int win_h);
-static void texture_flat_top_perspective_none(int x0, int y0, brh_perspective_attribs pa0, int x1, int y1, brh_perspective_attribs pa1, int x2, int y2, brh_perspective_attribs pa2, const uint32_t* texture, int tex_w, int tex_h, uint32_t* color_buffer, float* z_buffer, int win_w, int win_h);
-static void texture_flat_bottom_perspective_flat(int x0, int y0, brh_perspective_attribs pa0, int x1, int y1, brh_perspective_attribs pa1, int x2, int y2, brh_perspective_attribs pa2, uint32_t flat_color, uint32_t* color_buffer, float* z_buffer, int win_w, int win_h);
-static void texture_flat_top_perspective_flat(int x0, int y0, brh_perspective_attribs pa0, int x1, int y1, brh_perspective_attribs pa1, int x2, int y2, brh_perspective_attribs pa2, uint32_t flat_color, uint32_t* color_buffer, float* z_buffer, int win_w, int win_h);
-static void texture_flat_bottom_perspective_gouraud(int x0, int y0, brh_perspective_attribs pa0, int x1, int y1, brh_perspective_attribs pa1, int x2, int y2, brh_perspective_attribs pa2, const uint32_t* texture, int tex_w, int tex_h, uint32_t* color_buffer, float* z_buffer, int win_w, int win_h);
-static void texture_flat_top_perspective_gouraud(int x0, int y0, brh_perspective_attribs pa0, int x1, int y1, brh_perspective_attribs pa1, int x2, int y2, brh_perspective_attribs pa2, const uint32_t* texture, int tex_w, int tex_h, uint32_t* color_buffer, float* z_buffer, int win_w, int win_h);
-// static void texture_flat_bottom_perspective_phong(...); // Not implemented yet
-// static void texture_flat_top_perspective_phong(...);   // Not implemented yet
-static void fill_flat_bottom_perspective_none(int x0, int y0, brh_perspective_attribs pa0, int x1, int y1, brh_perspective_attribs pa1, int x2, int y2, brh_perspective_attribs pa2, uint32_t base_color, uint32_t* color_buffer, float* z_buffer, int win_w, int win_h);
-static void fill_flat_top_perspective_none(int x0, int y0, brh_perspective_attribs pa0, int x1, int y1, brh_perspective_attribs pa1, int x2, int y2, brh_perspective_attribs pa2, uint32_t base_color, uint32_t* color_buffer, float* z_buffer, int win_w, int win_h);
-static void fill_flat_bottom_perspective_flat(int x0, int y0, brh_perspective_attribs pa0, int x1, int y1, brh_perspective_attribs pa1, int x2, int y2, brh_perspective_attribs pa2, uint32_t flat_color, uint32_t* color_buffer, float* z_buffer, int win_w, int win_h);
-static void fill_flat_top_perspective_flat(int x0, int y0, brh_perspective_attribs pa0, int x1, int y1, brh_perspective_attribs pa1, int x2, int y2, brh_perspective_attribs pa2, uint32_t flat_color, uint32_t* color_buffer, float* z_buffer, int win_w, int win_h);
-static void fill_flat_bottom_perspective_gouraud(int x0, int y0, brh_perspective_attribs pa0, int x1, int y1, brh_perspective_attribs pa1, int x2, int y2, brh_perspective_attribs pa2, uint32_t base_color, uint32_t* color_buffer, float* z_buffer, int win_w, int win_h);
-static void fill_flat_top_perspective_gouraud(int x0, int y0, brh_perspective_attribs pa0, int x1, int y1, brh_perspective_attribs pa1, int x2, int y2, brh_perspective_attribs pa2, uint32_t base_color, uint32_t* color_buffer, float* z_buffer, int win_w, int win_h);
-// static void fill_flat_bottom_perspective_phong(...); // Not implemented yet
-// static void fill_flat_top_perspective_phong(...);   // Not implemented yet
-
-
-// --- Helper: Swap Perspective Attributes ---
-void swap_perspective_attribs(brh_perspective_attribs* a, brh_perspective_attribs* b) {
-    brh_perspective_attribs temp = *a;
-    *a = *b;
-    *b = temp;
-}
+/** Half a pixel in subpixel units (pixel centers sit at +0.5). */
+#define BRH_SUBPIXEL_HALF (BRH_SUBPIXEL_ONE >> 1)
+
+// --- Raster State ---
+// Everything a span function needs that is constant for the whole triangle.
+typedef struct {
+    uint32_t* color_buffer;
+    float* z_buffer;
+    int color_pitch;         // Pixels per color buffer row (the z-buffer is packed)
+    int win_w;
+    int win_h;
+
+    const uint32_t* texture; // NULL for untextured modes
+    int tex_w;
+    int tex_h;
+
+    uint32_t color;          // Base or flat color (alpha also gates Gouraud writes)
+
+    int row_begin;           // Rows the triangle may write: [row_begin, row_end)
+    int row_end;
+    bool depth_only;         // Interpolate only inv_w; the other attributes are left unset
+    enum depth_test depth_test;
+    bool lazy_depth_tiles;   // The z-buffer is the display's, whose tiles are cleared on first use
+
+    uint32_t* id_buffer;     // Visibility buffer the depth spans also write id to, or NULL
+    uint32_t id;
+    uint64_t* shaded_fragments; // Counter the color spans add their shaded fragments to
+} brh_raster_context;
+
+// Per-triangle plane equations for the perspective attributes.
+// value(x, y) = at_v0 + ddx * (x - v0_x) + ddy * (y - v0_y), with x/y in pixels.
+typedef struct {
+    brh_perspective_attribs at_v0;
+    brh_perspective_attribs ddx;
+    brh_perspective_attribs ddy;
+    int32_t v0_x;            // Reference vertex in 28.4 fixed point
+    int32_t v0_y;
+} brh_attrib_gradients;
+
+// Span functions fill pixels [x_start, x_end) of row y, starting with the attributes in `start`
+// (already evaluated at the center of pixel x_start) and stepping by gradients->ddx.
+typedef void (*brh_span_func)(const brh_raster_context* ctx, const brh_attrib_gradients* gradients,
+    int y, int x_start, int x_end, brh_perspective_attribs start);
+
+// Integer edge stepper. Tracks the first pixel whose center lies on or to the right of the edge
+// on the current scanline, using an exact error term instead of a float x coordinate.
+typedef struct {
+    int32_t x;               // ceil(edge_x - 0.5) on the current scanline, in whole pixels
+    int32_t step;            // Whole pixels to advance per scanline
+    int64_t error;           // x * denominator - numerator, kept in [0, denominator)
+    int64_t error_step;      // Fractional part of the per-scanline advance
+    int64_t denominator;
+} brh_edge;
+
+// Depth test of the color kernels (see set_depth_test())
+static enum depth_test current_depth_test = DEPTH_TEST_GREATER;
+// Fragments the color kernels have shaded (see get_shaded_fragment_count())
+static uint64_t shaded_fragment_count = 0;
 
 // --- Helper: Prepare Perspective Attributes ---
-static void prepare_perspective_attribs(brh_vertex v, brh_perspective_attribs* pa) {
+// Builds the per-vertex interpolants from the compact screen vertex. The texel is optional
+// and only present when the render method samples a texture; the vertex colors are only
+// interpolated when the triangle was built for Gouraud shading.
+static void prepare_perspective_attribs(const brh_screen_vertex* v, const brh_texel* texel, enum shading_method shading,
+    brh_perspective_attribs* pa) {
     // Ensure inv_w is valid before multiplication
-    float safe_inv_w = (fabsf(v.inv_w) < EPSILON) ? 0.0f : v.inv_w;
+    float safe_inv_w = (fabsf(v->inv_w) < EPSILON) ? 0.0f : v->inv_w;
     pa->inv_w = safe_inv_w; // Store the potentially zero inv_w
 
     // Texture coords (needed for textured modes)
-    pa->u_over_w = v.texel.u * safe_inv_w;
-    pa->v_over_w = v.texel.v * safe_inv_w;
+    if (texel) {
+        pa->u_over_w = texel->u * safe_inv_w;
+        pa->v_over_w = texel->v * safe_inv_w;
+    }
+    else {
+        pa->u_over_w = pa->v_over_w = 0;
+    }
 
     // Gouraud Color (needed for Gouraud modes)
-    shading_method current_shading = get_shading_method(); // Get shading mode once
-    if (current_shading == SHADING_GOURAUD) {
-        uint8_t r = (v.color >> 16) & 0xFF;
-        uint8_t g = (v.color >> 8) & 0xFF;
-        uint8_t b = v.color & 0xFF;
+    if (shading == SHADING_GOURAUD) {
+        uint8_t r = (v->color >> 16) & 0xFF;
+        uint8_t g = (v->color >> 8) & 0xFF;
+        uint8_t b = v->color & 0xFF;
         pa->r_over_w = (float)r * safe_inv_w;
         pa->g_over_w = (float)g * safe_inv_w;
         pa->b_over_w = (float)b * safe_inv_w;
@@ -58,807 +100,447 @@ static void prepare_perspective_attribs(brh_vertex v, brh_perspective_attribs* p
         pa->r_over_w = pa->g_over_w = pa->b_over_w = 0;
     }
 
-    // Phong Normal (needed for Phong modes)
-    if (current_shading == SHADING_PHONG) {
-        pa->nx_over_w = v.normal.x * safe_inv_w;
-        pa->ny_over_w = v.normal.y * safe_inv_w;
-        pa->nz_over_w = v.normal.z * safe_inv_w;
-    }
-    else {
-        pa->nx_over_w = pa->ny_over_w = pa->nz_over_w = 0;
-    }
+    // Phong normals are not carried by the compact screen triangle (no Phong rasterizer yet)
+    pa->nx_over_w = pa->ny_over_w = pa->nz_over_w = 0;
 }
 
-//----------------------------------------------------------------------------
-// Specialized Rasterizer Implementations (Completed for None, Flat, Gouraud)
-//----------------------------------------------------------------------------
+// --- Helper: Integer division rounding towards -inf / +inf (divisor must be positive) ---
+static inline int64_t floor_div64(int64_t n, int64_t d) {
+    int64_t q = n / d;
+    return (n % d != 0 && n < 0) ? q - 1 : q;
+}
 
-// --- Texture + None + Flat Bottom ---
-static void texture_flat_bottom_perspective_none(
-    int x0, int y0, brh_perspective_attribs pa0,
-    int x1, int y1, brh_perspective_attribs pa1,
-    int x2, int y2, brh_perspective_attribs pa2,
-    const uint32_t* texture, int tex_w, int tex_h,
-    uint32_t* color_buffer, float* z_buffer, int win_w, int win_h)
-{
-    const float y_delta = (float)(y1 - y0);
-    if (fabsf(y_delta) < EPSILON) return;
-    const float inv_y_height = 1.0f / y_delta;
-
-    for (int y = y0; y <= y1; y++) {
-        if (y < 0 || y >= win_h) continue;
-        const float t = (float)(y - y0) * inv_y_height;
-
-        brh_perspective_attribs attrib_left, attrib_right;
-        attrib_left.inv_w = interpolate_float(pa0.inv_w, pa1.inv_w, t);
-        attrib_left.u_over_w = interpolate_float(pa0.u_over_w, pa1.u_over_w, t);
-        attrib_left.v_over_w = interpolate_float(pa0.v_over_w, pa1.v_over_w, t);
-
-        attrib_right.inv_w = interpolate_float(pa0.inv_w, pa2.inv_w, t);
-        attrib_right.u_over_w = interpolate_float(pa0.u_over_w, pa2.u_over_w, t);
-        attrib_right.v_over_w = interpolate_float(pa0.v_over_w, pa2.v_over_w, t);
-
-        float x_left_f = interpolate_float((float)x0, (float)x1, t);
-        float x_right_f = interpolate_float((float)x0, (float)x2, t);
-        int x_start = (int)roundf(x_left_f);
-        int x_end = (int)roundf(x_right_f);
-
-        if (x_start > x_end) { swap_int(&x_start, &x_end); swap_perspective_attribs(&attrib_left, &attrib_right); }
-
-        int x_start_clip = MAX(0, x_start);
-        int x_end_clip = MIN(win_w - 1, x_end);
-
-        const float x_scan_width_f = (float)(x_end - x_start);
-        float inv_w_step = 0, u_step = 0, v_step = 0;
-        brh_perspective_attribs current_attrib = attrib_left;
-
-        if (fabsf(x_scan_width_f) > EPSILON) {
-            const float inv_x_scan_width = 1.0f / x_scan_width_f;
-            inv_w_step = (attrib_right.inv_w - attrib_left.inv_w) * inv_x_scan_width;
-            u_step = (attrib_right.u_over_w - attrib_left.u_over_w) * inv_x_scan_width;
-            v_step = (attrib_right.v_over_w - attrib_left.v_over_w) * inv_x_scan_width;
-            if (x_start_clip > x_start) {
-                float offset = (float)(x_start_clip - x_start);
-                current_attrib.inv_w += inv_w_step * offset;
-                current_attrib.u_over_w += u_step * offset;
-                current_attrib.v_over_w += v_step * offset;
-            }
-        }
+static inline int64_t ceil_div64(int64_t n, int64_t d) {
+    return -floor_div64(-n, d);
+}
 
-        int current_index = y * win_w + x_start_clip;
-        for (int x = x_start_clip; x <= x_end_clip; x++) {
-            const float current_depth = current_attrib.inv_w;
-            if (current_depth > z_buffer[current_index]) {
-                const float current_w = 1.0f / current_depth;
-                const float u = current_attrib.u_over_w * current_w;
-                const float v = current_attrib.v_over_w * current_w;
-                int tx = (int)floorf(u * (float)tex_w);
-                int ty = (int)floorf((1.0f - v) * (float)tex_h); // Flip V
-                tx = ((tx % tex_w) + tex_w) % tex_w;
-                ty = ((ty % tex_h) + tex_h) % tex_h;
-                uint32_t pixel_color = texture[ty * tex_w + tx];
-
-                if ((pixel_color >> 24) > 0) {
-                    color_buffer[current_index] = pixel_color;
-                    z_buffer[current_index] = current_depth;
-                }
-            }
-            current_attrib.inv_w += inv_w_step;
-            current_attrib.u_over_w += u_step;
-            current_attrib.v_over_w += v_step;
-            current_index++;
-        }
-    }
+// --- Helper: First scanline whose pixel center is at or below a 28.4 Y coordinate ---
+static inline int first_row_at_or_below(int32_t y) {
+    return (int)ceil_div64((int64_t)y - BRH_SUBPIXEL_HALF, BRH_SUBPIXEL_ONE);
 }
 
-// --- Texture + None + Flat Top ---
-static void texture_flat_top_perspective_none(
-    int x0, int y0, brh_perspective_attribs pa0,
-    int x1, int y1, brh_perspective_attribs pa1,
-    int x2, int y2, brh_perspective_attribs pa2,
-    const uint32_t* texture, int tex_w, int tex_h,
-    uint32_t* color_buffer, float* z_buffer, int win_w, int win_h)
-{
-    const float y_delta = (float)(y2 - y0); // y2 is bottom, y0 is top
-    if (fabsf(y_delta) < EPSILON) return;
-    const float inv_y_height = 1.0f / y_delta;
-
-    for (int y = y2; y >= y0; y--) { // Iterate upwards
-        if (y < 0 || y >= win_h) continue;
-        const float t = (float)(y2 - y) * inv_y_height; // t=0 at y2, t=1 at y0
-
-        brh_perspective_attribs attrib_left, attrib_right;
-        attrib_left.inv_w = interpolate_float(pa2.inv_w, pa0.inv_w, t);
-        attrib_left.u_over_w = interpolate_float(pa2.u_over_w, pa0.u_over_w, t);
-        attrib_left.v_over_w = interpolate_float(pa2.v_over_w, pa0.v_over_w, t);
-
-        attrib_right.inv_w = interpolate_float(pa2.inv_w, pa1.inv_w, t);
-        attrib_right.u_over_w = interpolate_float(pa2.u_over_w, pa1.u_over_w, t);
-        attrib_right.v_over_w = interpolate_float(pa2.v_over_w, pa1.v_over_w, t);
-
-        float x_left_f = interpolate_float((float)x2, (float)x0, t);
-        float x_right_f = interpolate_float((float)x2, (float)x1, t);
-        int x_start = (int)roundf(x_left_f);
-        int x_end = (int)roundf(x_right_f);
-
-        if (x_start > x_end) { swap_int(&x_start, &x_end); swap_perspective_attribs(&attrib_left, &attrib_right); }
-
-        int x_start_clip = MAX(0, x_start);
-        int x_end_clip = MIN(win_w - 1, x_end);
-
-        const float x_scan_width_f = (float)(x_end - x_start);
-        float inv_w_step = 0, u_step = 0, v_step = 0;
-        brh_perspective_attribs current_attrib = attrib_left;
-
-        if (fabsf(x_scan_width_f) > EPSILON) {
-            const float inv_x_scan_width = 1.0f / x_scan_width_f;
-            inv_w_step = (attrib_right.inv_w - attrib_left.inv_w) * inv_x_scan_width;
-            u_step = (attrib_right.u_over_w - attrib_left.u_over_w) * inv_x_scan_width;
-            v_step = (attrib_right.v_over_w - attrib_left.v_over_w) * inv_x_scan_width;
-            if (x_start_clip > x_start) {
-                float offset = (float)(x_start_clip - x_start);
-                current_attrib.inv_w += inv_w_step * offset;
-                current_attrib.u_over_w += u_step * offset;
-                current_attrib.v_over_w += v_step * offset;
-            }
-        }
+// --- Helper: Set up an edge from (xa, ya) to (xb, yb) (yb > ya) at scanline `row` ---
+static void edge_init(brh_edge* edge, int32_t xa, int32_t ya, int32_t xb, int32_t yb, int row) {
+    const int64_t dx = (int64_t)xb - xa;
+    const int64_t dy = (int64_t)yb - ya;
+    const int64_t row_center = (int64_t)row * BRH_SUBPIXEL_ONE + BRH_SUBPIXEL_HALF;
+
+    // Edge x at the row center, minus half a pixel, is numerator / denominator pixels
+    const int64_t numerator = ((int64_t)xa - BRH_SUBPIXEL_HALF) * dy + (row_center - ya) * dx;
+    edge->denominator = dy * BRH_SUBPIXEL_ONE;
+    edge->x = (int32_t)ceil_div64(numerator, edge->denominator);
+    edge->error = (int64_t)edge->x * edge->denominator - numerator;
+
+    // Advancing one scanline adds dx * ONE to the numerator
+    const int64_t advance = dx * BRH_SUBPIXEL_ONE;
+    edge->step = (int32_t)floor_div64(advance, edge->denominator);
+    edge->error_step = advance - (int64_t)edge->step * edge->denominator;
+}
 
-        int current_index = y * win_w + x_start_clip;
-        for (int x = x_start_clip; x <= x_end_clip; x++) {
-            const float current_depth = current_attrib.inv_w;
-            if (current_depth > z_buffer[current_index]) {
-                const float current_w = 1.0f / current_depth;
-                const float u = current_attrib.u_over_w * current_w;
-                const float v = current_attrib.v_over_w * current_w;
-                int tx = (int)floorf(u * (float)tex_w);
-                int ty = (int)floorf((1.0f - v) * (float)tex_h); // Flip V
-                tx = ((tx % tex_w) + tex_w) % tex_w;
-                ty = ((ty % tex_h) + tex_h) % tex_h;
-                uint32_t pixel_color = texture[ty * tex_w + tx];
-
-                if ((pixel_color >> 24) > 0) {
-                    color_buffer[current_index] = pixel_color;
-                    z_buffer[current_index] = current_depth;
-                }
-            }
-            current_attrib.inv_w += inv_w_step;
-            current_attrib.u_over_w += u_step;
-            current_attrib.v_over_w += v_step;
-            current_index++;
-        }
+static inline void edge_step(brh_edge* edge) {
+    edge->x += edge->step;
+    edge->error -= edge->error_step;
+    if (edge->error < 0) {
+        edge->x++;
+        edge->error += edge->denominator;
     }
 }
 
-// --- Texture + Flat + Flat Bottom ---
-static void texture_flat_bottom_perspective_flat(
-    int x0, int y0, brh_perspective_attribs pa0,
-    int x1, int y1, brh_perspective_attribs pa1,
-    int x2, int y2, brh_perspective_attribs pa2,
-    uint32_t flat_color,
-    uint32_t* color_buffer, float* z_buffer, int win_w, int win_h)
+// --- Helper: Plane-equation gradients of the interpolants over the triangle ---
+static void compute_attrib_gradients(const brh_screen_vertex* v0, const brh_screen_vertex* v1, const brh_screen_vertex* v2,
+    const brh_perspective_attribs* pa0, const brh_perspective_attribs* pa1, const brh_perspective_attribs* pa2,
+    float area_pixels, bool depth_only, brh_attrib_gradients* gradients)
 {
-    const float y_delta = (float)(y1 - y0);
-    if (fabsf(y_delta) < EPSILON) return;
-    const float inv_y_height = 1.0f / y_delta;
-
-    for (int y = y0; y <= y1; y++) {
-        if (y < 0 || y >= win_h) continue;
-        const float t = (float)(y - y0) * inv_y_height;
-
-        float inv_w_left = interpolate_float(pa0.inv_w, pa1.inv_w, t);
-        float inv_w_right = interpolate_float(pa0.inv_w, pa2.inv_w, t);
-        float x_left_f = interpolate_float((float)x0, (float)x1, t);
-        float x_right_f = interpolate_float((float)x0, (float)x2, t);
-        int x_start = (int)roundf(x_left_f);
-        int x_end = (int)roundf(x_right_f);
-
-        if (x_start > x_end) { swap_int(&x_start, &x_end); swap_float(&inv_w_left, &inv_w_right); }
-
-        int x_start_clip = MAX(0, x_start);
-        int x_end_clip = MIN(win_w - 1, x_end);
-
-        const float x_scan_width_f = (float)(x_end - x_start);
-        float inv_w_step = 0;
-        float current_inv_w = inv_w_left;
-
-        if (fabsf(x_scan_width_f) > EPSILON) {
-            const float inv_x_scan_width = 1.0f / x_scan_width_f;
-            inv_w_step = (inv_w_right - inv_w_left) * inv_x_scan_width;
-            if (x_start_clip > x_start) {
-                float offset = (float)(x_start_clip - x_start);
-                current_inv_w += inv_w_step * offset;
-            }
-        }
-
-        int current_index = y * win_w + x_start_clip;
-        for (int x = x_start_clip; x <= x_end_clip; x++) {
-            if (current_inv_w > z_buffer[current_index]) {
-                color_buffer[current_index] = flat_color; // Use the passed flat color
-                z_buffer[current_index] = current_inv_w;
-            }
-            current_inv_w += inv_w_step;
-            current_index++;
-        }
+    const float inv_subpixel = 1.0f / (float)BRH_SUBPIXEL_ONE;
+    const float x10 = (float)(v1->x - v0->x) * inv_subpixel;
+    const float y10 = (float)(v1->y - v0->y) * inv_subpixel;
+    const float x20 = (float)(v2->x - v0->x) * inv_subpixel;
+    const float y20 = (float)(v2->y - v0->y) * inv_subpixel;
+    const float inv_area = 1.0f / area_pixels;
+
+#define BRH_GRADIENT(field) \
+    do { \
+        const float d10 = pa1->field - pa0->field; \
+        const float d20 = pa2->field - pa0->field; \
+        gradients->ddx.field = (d10 * y20 - d20 * y10) * inv_area; \
+        gradients->ddy.field = (d20 * x10 - d10 * x20) * inv_area; \
+    } while (0)
+
+    BRH_GRADIENT(inv_w);
+    if (depth_only) {
+        gradients->at_v0 = *pa0;
+        gradients->v0_x = v0->x;
+        gradients->v0_y = v0->y;
+        return;
     }
+    BRH_GRADIENT(u_over_w);
+    BRH_GRADIENT(v_over_w);
+    BRH_GRADIENT(r_over_w);
+    BRH_GRADIENT(g_over_w);
+    BRH_GRADIENT(b_over_w);
+    BRH_GRADIENT(nx_over_w);
+    BRH_GRADIENT(ny_over_w);
+    BRH_GRADIENT(nz_over_w);
+
+#undef BRH_GRADIENT
+
+    gradients->at_v0 = *pa0;
+    gradients->v0_x = v0->x;
+    gradients->v0_y = v0->y;
 }
 
-// --- Texture + Flat + Flat Top ---
-static void texture_flat_top_perspective_flat(
-    int x0, int y0, brh_perspective_attribs pa0,
-    int x1, int y1, brh_perspective_attribs pa1,
-    int x2, int y2, brh_perspective_attribs pa2,
-    uint32_t flat_color,
-    uint32_t* color_buffer, float* z_buffer, int win_w, int win_h)
-{
-    const float y_delta = (float)(y2 - y0);
-    if (fabsf(y_delta) < EPSILON) return;
-    const float inv_y_height = 1.0f / y_delta;
-
-    for (int y = y2; y >= y0; y--) { // Iterate upwards
-        if (y < 0 || y >= win_h) continue;
-        const float t = (float)(y2 - y) * inv_y_height;
-
-        float inv_w_left = interpolate_float(pa2.inv_w, pa0.inv_w, t);
-        float inv_w_right = interpolate_float(pa2.inv_w, pa1.inv_w, t);
-        float x_left_f = interpolate_float((float)x2, (float)x0, t);
-        float x_right_f = interpolate_float((float)x2, (float)x1, t);
-        int x_start = (int)roundf(x_left_f);
-        int x_end = (int)roundf(x_right_f);
-
-        if (x_start > x_end) { swap_int(&x_start, &x_end); swap_float(&inv_w_left, &inv_w_right); }
-
-        int x_start_clip = MAX(0, x_start);
-        int x_end_clip = MIN(win_w - 1, x_end);
-
-        const float x_scan_width_f = (float)(x_end - x_start);
-        float inv_w_step = 0;
-        float current_inv_w = inv_w_left;
-
-        if (fabsf(x_scan_width_f) > EPSILON) {
-            const float inv_x_scan_width = 1.0f / x_scan_width_f;
-            inv_w_step = (inv_w_right - inv_w_left) * inv_x_scan_width;
-            if (x_start_clip > x_start) {
-                float offset = (float)(x_start_clip - x_start);
-                current_inv_w += inv_w_step * offset;
-            }
-        }
+// --- Helper: Evaluate the interpolants at the center of pixel (x, y) ---
+static inline brh_perspective_attribs evaluate_attribs(const brh_attrib_gradients* g, int x, int y, bool depth_only) {
+    const float inv_subpixel = 1.0f / (float)BRH_SUBPIXEL_ONE;
+    const float dx = (float)(x * BRH_SUBPIXEL_ONE + BRH_SUBPIXEL_HALF - g->v0_x) * inv_subpixel;
+    const float dy = (float)(y * BRH_SUBPIXEL_ONE + BRH_SUBPIXEL_HALF - g->v0_y) * inv_subpixel;
 
-        int current_index = y * win_w + x_start_clip;
-        for (int x = x_start_clip; x <= x_end_clip; x++) {
-            if (current_inv_w > z_buffer[current_index]) {
-                color_buffer[current_index] = flat_color; // Use the passed flat color
-                z_buffer[current_index] = current_inv_w;
-            }
-            current_inv_w += inv_w_step;
-            current_index++;
-        }
+    brh_perspective_attribs a;
+    a.inv_w = g->at_v0.inv_w + g->ddx.inv_w * dx + g->ddy.inv_w * dy;
+    if (depth_only) {
+        return a;
     }
+    a.u_over_w = g->at_v0.u_over_w + g->ddx.u_over_w * dx + g->ddy.u_over_w * dy;
+    a.v_over_w = g->at_v0.v_over_w + g->ddx.v_over_w * dx + g->ddy.v_over_w * dy;
+    a.r_over_w = g->at_v0.r_over_w + g->ddx.r_over_w * dx + g->ddy.r_over_w * dy;
+    a.g_over_w = g->at_v0.g_over_w + g->ddx.g_over_w * dx + g->ddy.g_over_w * dy;
+    a.b_over_w = g->at_v0.b_over_w + g->ddx.b_over_w * dx + g->ddy.b_over_w * dy;
+    a.nx_over_w = a.ny_over_w = a.nz_over_w = 0; // Phong is not rasterized yet
+    return a;
 }
 
-// --- Texture + Gouraud + Flat Bottom ---
-static void texture_flat_bottom_perspective_gouraud(
-    int x0, int y0, brh_perspective_attribs pa0,
-    int x1, int y1, brh_perspective_attribs pa1,
-    int x2, int y2, brh_perspective_attribs pa2,
-    const uint32_t* texture, int tex_w, int tex_h,
-    uint32_t* color_buffer, float* z_buffer, int win_w, int win_h)
-{
-    const float y_delta = (float)(y1 - y0);
-    if (fabsf(y_delta) < EPSILON) return;
-    const float inv_y_height = 1.0f / y_delta;
-
-    for (int y = y0; y <= y1; y++) {
-        if (y < 0 || y >= win_h) continue;
-        const float t = (float)(y - y0) * inv_y_height;
-
-        brh_perspective_attribs attrib_left, attrib_right;
-        attrib_left.inv_w = interpolate_float(pa0.inv_w, pa1.inv_w, t);
-        attrib_left.u_over_w = interpolate_float(pa0.u_over_w, pa1.u_over_w, t);
-        attrib_left.v_over_w = interpolate_float(pa0.v_over_w, pa1.v_over_w, t);
-        attrib_left.r_over_w = interpolate_float(pa0.r_over_w, pa1.r_over_w, t);
-        attrib_left.g_over_w = interpolate_float(pa0.g_over_w, pa1.g_over_w, t);
-        attrib_left.b_over_w = interpolate_float(pa0.b_over_w, pa1.b_over_w, t);
-
-        attrib_right.inv_w = interpolate_float(pa0.inv_w, pa2.inv_w, t);
-        attrib_right.u_over_w = interpolate_float(pa0.u_over_w, pa2.u_over_w, t);
-        attrib_right.v_over_w = interpolate_float(pa0.v_over_w, pa2.v_over_w, t);
-        attrib_right.r_over_w = interpolate_float(pa0.r_over_w, pa2.r_over_w, t);
-        attrib_right.g_over_w = interpolate_float(pa0.g_over_w, pa2.g_over_w, t);
-        attrib_right.b_over_w = interpolate_float(pa0.b_over_w, pa2.b_over_w, t);
-
-        float x_left_f = interpolate_float((float)x0, (float)x1, t);
-        float x_right_f = interpolate_float((float)x0, (float)x2, t);
-        int x_start = (int)roundf(x_left_f);
-        int x_end = (int)roundf(x_right_f);
-
-        if (x_start > x_end) { swap_int(&x_start, &x_end); swap_perspective_attribs(&attrib_left, &attrib_right); }
-
-        int x_start_clip = MAX(0, x_start);
-        int x_end_clip = MIN(win_w - 1, x_end);
-
-        const float x_scan_width_f = (float)(x_end - x_start);
-        float inv_w_step = 0, u_step = 0, v_step = 0, r_step = 0, g_step = 0, b_step = 0;
-        brh_perspective_attribs current_attrib = attrib_left;
-
-        if (fabsf(x_scan_width_f) > EPSILON) {
-            const float inv_x_scan_width = 1.0f / x_scan_width_f;
-            inv_w_step = (attrib_right.inv_w - attrib_left.inv_w) * inv_x_scan_width;
-            u_step = (attrib_right.u_over_w - attrib_left.u_over_w) * inv_x_scan_width;
-            v_step = (attrib_right.v_over_w - attrib_left.v_over_w) * inv_x_scan_width;
-            r_step = (attrib_right.r_over_w - attrib_left.r_over_w) * inv_x_scan_width;
-            g_step = (attrib_right.g_over_w - attrib_left.g_over_w) * inv_x_scan_width;
-            b_step = (attrib_right.b_over_w - attrib_left.b_over_w) * inv_x_scan_width;
-            if (x_start_clip > x_start) {
-                float offset = (float)(x_start_clip - x_start);
-                current_attrib.inv_w += inv_w_step * offset;
-                current_attrib.u_over_w += u_step * offset;
-                current_attrib.v_over_w += v_step * offset;
-                current_attrib.r_over_w += r_step * offset;
-                current_attrib.g_over_w += g_step * offset;
-                current_attrib.b_over_w += b_step * offset;
-            }
-        }
-
-        int current_index = y * win_w + x_start_clip;
-        for (int x = x_start_clip; x <= x_end_clip; x++) {
-            const float current_depth = current_attrib.inv_w;
-            if (current_depth > z_buffer[current_index]) {
-                const float current_w = 1.0f / current_depth;
-                // Texture
-                const float u = current_attrib.u_over_w * current_w;
-                const float v = current_attrib.v_over_w * current_w;
-                int tx = (int)floorf(u * (float)tex_w);
-                int ty = (int)floorf((1.0f - v) * (float)tex_h); // Flip V
-                tx = ((tx % tex_w) + tex_w) % tex_w;
-                ty = ((ty % tex_h) + tex_h) % tex_h;
-                uint32_t base_color = texture[ty * tex_w + tx];
-                // Gouraud
-                uint8_t a_base = (base_color >> 24) & 0xFF;
-                uint8_t r_base = (base_color >> 16) & 0xFF;
-                uint8_t g_base = (base_color >> 8) & 0xFF;
-                uint8_t b_base = base_color & 0xFF;
-                float r_light = current_attrib.r_over_w * current_w;
-                float g_light = current_attrib.g_over_w * current_w;
-                float b_light = current_attrib.b_over_w * current_w;
-                float r_intensity = MAX(0.0f, MIN(1.0f, r_light / 255.0f));
-                float g_intensity = MAX(0.0f, MIN(1.0f, g_light / 255.0f));
-                float b_intensity = MAX(0.0f, MIN(1.0f, b_light / 255.0f));
-                uint8_t R = (uint8_t)((float)r_base * r_intensity);
-                uint8_t G = (uint8_t)((float)g_base * g_intensity);
-                uint8_t B = (uint8_t)((float)b_base * b_intensity);
-                uint32_t final_color = ((uint32_t)a_base << 24) | ((uint32_t)R << 16) | ((uint32_t)G << 8) | B;
-
-                if (a_base > 0) {
-                    color_buffer[current_index] = final_color;
-                    z_buffer[current_index] = current_depth;
-                }
-            }
-            current_attrib.inv_w += inv_w_step;
-            current_attrib.u_over_w += u_step;
-            current_attrib.v_over_w += v_step;
-            current_attrib.r_over_w += r_step;
-            current_attrib.g_over_w += g_step;
-            current_attrib.b_over_w += b_step;
-            current_index++;
-        }
+// --- Helper: Depth test of a fragment against the z-buffer ---
+// The equal test relies on draw_prepass_triangle() writing exactly the inv_w the spans compute.
+static inline bool passes_depth_test(enum depth_test test, float depth, float stored) {
+    switch (test) {
+    case DEPTH_TEST_EQUAL:  return depth == stored;
+    case DEPTH_TEST_ALWAYS: return true;
+    default:                return depth > stored;
     }
 }
 
-// --- Texture + Gouraud + Flat Top ---
-static void texture_flat_top_perspective_gouraud(
-    int x0, int y0, brh_perspective_attribs pa0,
-    int x1, int y1, brh_perspective_attribs pa1,
-    int x2, int y2, brh_perspective_attribs pa2,
-    const uint32_t* texture, int tex_w, int tex_h,
-    uint32_t* color_buffer, float* z_buffer, int win_w, int win_h)
-{
-    const float y_delta = (float)(y2 - y0); // y2 bottom, y0 top
-    if (fabsf(y_delta) < EPSILON) return;
-    const float inv_y_height = 1.0f / y_delta;
-
-    for (int y = y2; y >= y0; y--) { // Iterate upwards
-        if (y < 0 || y >= win_h) continue;
-        const float t = (float)(y2 - y) * inv_y_height; // t=0 at y2, t=1 at y0
-
-        brh_perspective_attribs attrib_left, attrib_right;
-        attrib_left.inv_w = interpolate_float(pa2.inv_w, pa0.inv_w, t);
-        attrib_left.u_over_w = interpolate_float(pa2.u_over_w, pa0.u_over_w, t);
-        attrib_left.v_over_w = interpolate_float(pa2.v_over_w, pa0.v_over_w, t);
-        attrib_left.r_over_w = interpolate_float(pa2.r_over_w, pa0.r_over_w, t);
-        attrib_left.g_over_w = interpolate_float(pa2.g_over_w, pa0.g_over_w, t);
-        attrib_left.b_over_w = interpolate_float(pa2.b_over_w, pa0.b_over_w, t);
-
-        attrib_right.inv_w = interpolate_float(pa2.inv_w, pa1.inv_w, t);
-        attrib_right.u_over_w = interpolate_float(pa2.u_over_w, pa1.u_over_w, t);
-        attrib_right.v_over_w = interpolate_float(pa2.v_over_w, pa1.v_over_w, t);
-        attrib_right.r_over_w = interpolate_float(pa2.r_over_w, pa1.r_over_w, t);
-        attrib_right.g_over_w = interpolate_float(pa2.g_over_w, pa1.g_over_w, t);
-        attrib_right.b_over_w = interpolate_float(pa2.b_over_w, pa1.b_over_w, t);
-
-        float x_left_f = interpolate_float((float)x2, (float)x0, t);
-        float x_right_f = interpolate_float((float)x2, (float)x1, t);
-        int x_start = (int)roundf(x_left_f);
-        int x_end = (int)roundf(x_right_f);
-
-        if (x_start > x_end) { swap_int(&x_start, &x_end); swap_perspective_attribs(&attrib_left, &attrib_right); }
-
-        int x_start_clip = MAX(0, x_start);
-        int x_end_clip = MIN(win_w - 1, x_end);
-
-        const float x_scan_width_f = (float)(x_end - x_start);
-        float inv_w_step = 0, u_step = 0, v_step = 0, r_step = 0, g_step = 0, b_step = 0;
-        brh_perspective_attribs current_attrib = attrib_left;
-
-        if (fabsf(x_scan_width_f) > EPSILON) {
-            const float inv_x_scan_width = 1.0f / x_scan_width_f;
-            inv_w_step = (attrib_right.inv_w - attrib_left.inv_w) * inv_x_scan_width;
-            u_step = (attrib_right.u_over_w - attrib_left.u_over_w) * inv_x_scan_width;
-            v_step = (attrib_right.v_over_w - attrib_left.v_over_w) * inv_x_scan_width;
-            r_step = (attrib_right.r_over_w - attrib_left.r_over_w) * inv_x_scan_width;
-            g_step = (attrib_right.g_over_w - attrib_left.g_over_w) * inv_x_scan_width;
-            b_step = (attrib_right.b_over_w - attrib_left.b_over_w) * inv_x_scan_width;
-            if (x_start_clip > x_start) {
-                float offset = (float)(x_start_clip - x_start);
-                current_attrib.inv_w += inv_w_step * offset;
-                current_attrib.u_over_w += u_step * offset;
-                current_attrib.v_over_w += v_step * offset;
-                current_attrib.r_over_w += r_step * offset;
-                current_attrib.g_over_w += g_step * offset;
-                current_attrib.b_over_w += b_step * offset;
-            }
-        }
+// --- Helper: Depth a shaded fragment leaves in the z-buffer ---
+// Under the equal test the stored depth moves up by one ulp, so a coplanar triangle drawn later
+// at exactly the same depth fails the test and the pixel is still shaded only once, by the
+// first triangle, as under the greater test.
+static inline float depth_to_store(enum depth_test test, float depth) {
+    if (test != DEPTH_TEST_EQUAL) return depth;
+    uint32_t bits;
+    memcpy(&bits, &depth, sizeof(bits));
+    bits++; // Depths are non-negative, so the next bit pattern is the next float up
+    memcpy(&depth, &bits, sizeof(depth));
+    return depth;
+}
 
-        int current_index = y * win_w + x_start_clip;
-        for (int x = x_start_clip; x <= x_end_clip; x++) {
-            const float current_depth = current_attrib.inv_w;
-            if (current_depth > z_buffer[current_index]) {
-                const float current_w = 1.0f / current_depth;
-                // Texture
-                const float u = current_attrib.u_over_w * current_w;
-                const float v = current_attrib.v_over_w * current_w;
-                int tx = (int)floorf(u * (float)tex_w);
-                int ty = (int)floorf((1.0f - v) * (float)tex_h); // Flip V
-                tx = ((tx % tex_w) + tex_w) % tex_w;
-                ty = ((ty % tex_h) + tex_h) % tex_h;
-                uint32_t base_color = texture[ty * tex_w + tx];
-                // Gouraud
-                uint8_t a_base = (base_color >> 24) & 0xFF;
-                uint8_t r_base = (base_color >> 16) & 0xFF;
-                uint8_t g_base = (base_color >> 8) & 0xFF;
-                uint8_t b_base = base_color & 0xFF;
-                float r_light = current_attrib.r_over_w * current_w;
-                float g_light = current_attrib.g_over_w * current_w;
-                float b_light = current_attrib.b_over_w * current_w;
-                float r_intensity = MAX(0.0f, MIN(1.0f, r_light / 255.0f));
-                float g_intensity = MAX(0.0f, MIN(1.0f, g_light / 255.0f));
-                float b_intensity = MAX(0.0f, MIN(1.0f, b_light / 255.0f));
-                uint8_t R = (uint8_t)((float)r_base * r_intensity);
-                uint8_t G = (uint8_t)((float)g_base * g_intensity);
-                uint8_t B = (uint8_t)((float)b_base * b_intensity);
-                uint32_t final_color = ((uint32_t)a_base << 24) | ((uint32_t)R << 16) | ((uint32_t)G << 8) | B;
-
-                if (a_base > 0) {
-                    color_buffer[current_index] = final_color;
-                    z_buffer[current_index] = current_depth;
-                }
-            }
-            current_attrib.inv_w += inv_w_step;
-            current_attrib.u_over_w += u_step;
-            current_attrib.v_over_w += v_step;
-            current_attrib.r_over_w += r_step;
-            current_attrib.g_over_w += g_step;
-            current_attrib.b_over_w += b_step;
-            current_index++;
-        }
-    }
+// --- Helper: Wrapped nearest-neighbor texture fetch ---
+static inline uint32_t sample_texture(const brh_raster_context* ctx, float u, float v) {
+    int tx = (int)floorf(u * (float)ctx->tex_w);
+    int ty = (int)floorf((1.0f - v) * (float)ctx->tex_h); // Flip V
+    tx = ((tx % ctx->tex_w) + ctx->tex_w) % ctx->tex_w;
+    ty = ((ty % ctx->tex_h) + ctx->tex_h) % ctx->tex_h;
+    return ctx->texture[ty * ctx->tex_w + tx];
+}
+
+// --- Helper: Sort a triangle's vertices, and their attributes with them, top to bottom ---
+static inline void sort_triangle_vertices(const brh_screen_vertex* v[3], const brh_perspective_attribs* pa[3]) {
+    const brh_screen_vertex* tv; const brh_perspective_attribs* tpa;
+    if (v[0]->y > v[1]->y) { tv = v[0]; v[0] = v[1]; v[1] = tv; tpa = pa[0]; pa[0] = pa[1]; pa[1] = tpa; }
+    if (v[1]->y > v[2]->y) { tv = v[1]; v[1] = v[2]; v[2] = tv; tpa = pa[1]; pa[1] = pa[2]; pa[2] = tpa; }
+    if (v[0]->y > v[1]->y) { tv = v[0]; v[0] = v[1]; v[1] = tv; tpa = pa[0]; pa[0] = pa[1]; pa[1] = tpa; }
+}
+
+// --- Helper: Twice the signed area of a triangle in subpixel units ---
+static inline int64_t triangle_area(const brh_screen_vertex* const v[3]) {
+    return ((int64_t)v[1]->x - v[0]->x) * ((int64_t)v[2]->y - v[0]->y) -
+           ((int64_t)v[2]->x - v[0]->x) * ((int64_t)v[1]->y - v[0]->y);
 }
 
-// --- Fill + None + Flat Bottom ---
-static void fill_flat_bottom_perspective_none(
-    int x0, int y0, brh_perspective_attribs pa0,
-    int x1, int y1, brh_perspective_attribs pa1,
-    int x2, int y2, brh_perspective_attribs pa2,
-    uint32_t base_color,
-    uint32_t* color_buffer, float* z_buffer, int win_w, int win_h)
+//----------------------------------------------------------------------------
+// Edge Walker
+//----------------------------------------------------------------------------
+// Walks the triangle one scanline at a time in 28.4 fixed point and hands each covered span to
+// `span`. Coverage follows the top-left rule: a pixel is inside when its center is strictly inside
+// the triangle, or lies exactly on a top or left edge. Rows cover centers in [y_top, y_bottom) and
+// spans cover centers in [x_left, x_right), so pixels on an edge shared by two triangles are
+// shaded exactly once.
+static void rasterize_triangle(const brh_screen_vertex* vertices[3], const brh_perspective_attribs* attribs[3],
+    const brh_raster_context* ctx, brh_span_func span)
 {
-    const float y_delta = (float)(y1 - y0);
-    if (fabsf(y_delta) < EPSILON) return;
-    const float inv_y_height = 1.0f / y_delta;
-
-    for (int y = y0; y <= y1; y++) {
-        if (y < 0 || y >= win_h) continue;
-        const float t = (float)(y - y0) * inv_y_height;
-
-        float inv_w_left = interpolate_float(pa0.inv_w, pa1.inv_w, t);
-        float inv_w_right = interpolate_float(pa0.inv_w, pa2.inv_w, t);
-        float x_left_f = interpolate_float((float)x0, (float)x1, t);
-        float x_right_f = interpolate_float((float)x0, (float)x2, t);
-        int x_start = (int)roundf(x_left_f);
-        int x_end = (int)roundf(x_right_f);
-
-        if (x_start > x_end) { swap_int(&x_start, &x_end); swap_float(&inv_w_left, &inv_w_right); }
-
-        int x_start_clip = MAX(0, x_start);
-        int x_end_clip = MIN(win_w - 1, x_end);
-
-        const float x_scan_width_f = (float)(x_end - x_start);
-        float inv_w_step = 0;
-        float current_inv_w = inv_w_left;
-
-        if (fabsf(x_scan_width_f) > EPSILON) {
-            const float inv_x_scan_width = 1.0f / x_scan_width_f;
-            inv_w_step = (inv_w_right - inv_w_left) * inv_x_scan_width;
-            if (x_start_clip > x_start) {
-                float offset = (float)(x_start_clip - x_start);
-                current_inv_w += inv_w_step * offset;
-            }
-        }
+    // 1. Sort vertices by Y (top to bottom)
+    const brh_screen_vertex* sorted[3] = { vertices[0], vertices[1], vertices[2] };
+    const brh_perspective_attribs* sorted_attribs[3] = { attribs[0], attribs[1], attribs[2] };
+    sort_triangle_vertices(sorted, sorted_attribs);
+    const brh_screen_vertex* v0 = sorted[0]; const brh_perspective_attribs* pa0 = sorted_attribs[0];
+    const brh_screen_vertex* v1 = sorted[1]; const brh_perspective_attribs* pa1 = sorted_attribs[1];
+    const brh_screen_vertex* v2 = sorted[2]; const brh_perspective_attribs* pa2 = sorted_attribs[2];
+
+    // 2. Twice the signed area in subpixel units. Positive means v1 lies right of the long edge v0->v2.
+    const int64_t area = triangle_area(sorted);
+    if (area == 0) return; // Degenerate (includes y0 == y2)
+    const bool long_edge_is_left = area > 0;
+
+    // 3. Scanline range, clipped to the viewport
+    const int row_top = MAX(first_row_at_or_below(v0->y), ctx->row_begin);
+    const int row_mid = first_row_at_or_below(v1->y);
+    const int row_bottom = MIN(first_row_at_or_below(v2->y), ctx->row_end);
+    if (row_top >= row_bottom) return;
+
+    // Depth tiles under the bounding box must be current before the spans test against them
+    if (ctx->lazy_depth_tiles) {
+        const int32_t min_x = MIN(v0->x, MIN(v1->x, v2->x));
+        const int32_t max_x = MAX(v0->x, MAX(v1->x, v2->x));
+        validate_depth_tiles(min_x >> BRH_SUBPIXEL_BITS, row_top, (max_x >> BRH_SUBPIXEL_BITS) + 1, row_bottom);
+    }
 
-        int current_index = y * win_w + x_start_clip;
-        for (int x = x_start_clip; x <= x_end_clip; x++) {
-            if (current_inv_w > z_buffer[current_index]) {
-                color_buffer[current_index] = base_color;
-                z_buffer[current_index] = current_inv_w;
+    brh_attrib_gradients gradients;
+    const float area_pixels = (float)area / (float)(BRH_SUBPIXEL_ONE * BRH_SUBPIXEL_ONE);
+    compute_attrib_gradients(v0, v1, v2, pa0, pa1, pa2, area_pixels, ctx->depth_only, &gradients);
+
+    brh_edge long_edge, short_edge;
+    edge_init(&long_edge, v0->x, v0->y, v2->x, v2->y, row_top);
+
+    // 4. Walk the upper part (v0->v1) then the lower part (v1->v2) against the long edge
+    for (int part = 0; part < 2; part++) {
+        const brh_screen_vertex* a = part == 0 ? v0 : v1;
+        const brh_screen_vertex* b = part == 0 ? v1 : v2;
+        const int row_begin = part == 0 ? row_top : MAX(row_mid, row_top);
+        const int row_end = part == 0 ? MIN(row_mid, row_bottom) : row_bottom;
+        if (row_begin >= row_end) continue;
+
+        edge_init(&short_edge, a->x, a->y, b->x, b->y, row_begin);
+        const brh_edge* left = long_edge_is_left ? &long_edge : &short_edge;
+        const brh_edge* right = long_edge_is_left ? &short_edge : &long_edge;
+
+        for (int y = row_begin; y < row_end; y++) {
+            const int x_start = MAX(left->x, 0);
+            const int x_end = MIN(right->x, ctx->win_w);
+            if (x_start < x_end) {
+                span(ctx, &gradients, y, x_start, x_end, evaluate_attribs(&gradients, x_start, y, ctx->depth_only));
             }
-            current_inv_w += inv_w_step;
-            current_index++;
+            edge_step(&long_edge);
+            edge_step(&short_edge);
         }
     }
 }
 
-// --- Fill + None + Flat Top ---
-static void fill_flat_top_perspective_none(
-    int x0, int y0, brh_perspective_attribs pa0,
-    int x1, int y1, brh_perspective_attribs pa1,
-    int x2, int y2, brh_perspective_attribs pa2,
-    uint32_t base_color,
-    uint32_t* color_buffer, float* z_buffer, int win_w, int win_h)
-{
-    const float y_delta = (float)(y2 - y0);
-    if (fabsf(y_delta) < EPSILON) return;
-    const float inv_y_height = 1.0f / y_delta;
-
-    for (int y = y2; y >= y0; y--) { // Iterate upwards
-        if (y < 0 || y >= win_h) continue;
-        const float t = (float)(y2 - y) * inv_y_height;
-
-        float inv_w_left = interpolate_float(pa2.inv_w, pa0.inv_w, t);
-        float inv_w_right = interpolate_float(pa2.inv_w, pa1.inv_w, t);
-        float x_left_f = interpolate_float((float)x2, (float)x0, t);
-        float x_right_f = interpolate_float((float)x2, (float)x1, t);
-        int x_start = (int)roundf(x_left_f);
-        int x_end = (int)roundf(x_right_f);
-
-        if (x_start > x_end) { swap_int(&x_start, &x_end); swap_float(&inv_w_left, &inv_w_right); }
-
-        int x_start_clip = MAX(0, x_start);
-        int x_end_clip = MIN(win_w - 1, x_end);
-
-        const float x_scan_width_f = (float)(x_end - x_start);
-        float inv_w_step = 0;
-        float current_inv_w = inv_w_left;
-
-        if (fabsf(x_scan_width_f) > EPSILON) {
-            const float inv_x_scan_width = 1.0f / x_scan_width_f;
-            inv_w_step = (inv_w_right - inv_w_left) * inv_x_scan_width;
-            if (x_start_clip > x_start) {
-                float offset = (float)(x_start_clip - x_start);
-                current_inv_w += inv_w_step * offset;
-            }
-        }
+//----------------------------------------------------------------------------
+// Specialized Span Implementations (Completed for None, Flat, Gouraud)
+//----------------------------------------------------------------------------
+// All spans step inv_w identically, so every mode produces bit-identical depth for a pixel.
 
-        int current_index = y * win_w + x_start_clip;
-        for (int x = x_start_clip; x <= x_end_clip; x++) {
-            if (current_inv_w > z_buffer[current_index]) {
-                color_buffer[current_index] = base_color;
-                z_buffer[current_index] = current_inv_w;
-            }
-            current_inv_w += inv_w_step;
-            current_index++;
+// --- Fill + None ---
+static void fill_span_perspective_none(const brh_raster_context* ctx, const brh_attrib_gradients* gradients,
+    int y, int x_start, int x_end, brh_perspective_attribs start)
+{
+    uint32_t* color_row = ctx->color_buffer + (size_t)y * ctx->color_pitch;
+    float* z_row = ctx->z_buffer + (size_t)y * ctx->win_w;
+    const uint32_t base_color = ctx->color;
+    const enum depth_test depth_test = ctx->depth_test;
+    const float inv_w_step = gradients->ddx.inv_w;
+    float current_inv_w = start.inv_w;
+    int shaded = 0;
+
+    for (int x = x_start; x < x_end; x++) {
+        if (passes_depth_test(depth_test, current_inv_w, z_row[x])) {
+            color_row[x] = base_color;
+            z_row[x] = depth_to_store(depth_test, current_inv_w);
+            shaded++;
         }
+        current_inv_w += inv_w_step;
     }
+    *ctx->shaded_fragments += shaded;
 }
 
-// --- Fill + Flat + Flat Bottom ---
-static void fill_flat_bottom_perspective_flat(
-    int x0, int y0, brh_perspective_attribs pa0,
-    int x1, int y1, brh_perspective_attribs pa1,
-    int x2, int y2, brh_perspective_attribs pa2,
-    uint32_t flat_color,
-    uint32_t* color_buffer, float* z_buffer, int win_w, int win_h)
+// --- Fill + Flat ---
+static void fill_span_perspective_flat(const brh_raster_context* ctx, const brh_attrib_gradients* gradients,
+    int y, int x_start, int x_end, brh_perspective_attribs start)
 {
-    fill_flat_bottom_perspective_none(x0, y0, pa0, x1, y1, pa1, x2, y2, pa2, flat_color, color_buffer, z_buffer, win_w, win_h);
+    // The geometry stage already baked the lit face color into the vertex color
+    fill_span_perspective_none(ctx, gradients, y, x_start, x_end, start);
 }
 
-// --- Fill + Flat + Flat Top ---
-static void fill_flat_top_perspective_flat(
-    int x0, int y0, brh_perspective_attribs pa0,
-    int x1, int y1, brh_perspective_attribs pa1,
-    int x2, int y2, brh_perspective_attribs pa2,
-    uint32_t flat_color,
-    uint32_t* color_buffer, float* z_buffer, int win_w, int win_h)
+// --- Fill + Gouraud ---
+static void fill_span_perspective_gouraud(const brh_raster_context* ctx, const brh_attrib_gradients* gradients,
+    int y, int x_start, int x_end, brh_perspective_attribs start)
 {
-    fill_flat_top_perspective_none(x0, y0, pa0, x1, y1, pa1, x2, y2, pa2, flat_color, color_buffer, z_buffer, win_w, win_h);
+    const uint8_t a_base = (ctx->color >> 24) & 0xFF;
+    if (a_base == 0) return;
+
+    uint32_t* color_row = ctx->color_buffer + (size_t)y * ctx->color_pitch;
+    float* z_row = ctx->z_buffer + (size_t)y * ctx->win_w;
+    const enum depth_test depth_test = ctx->depth_test;
+    const brh_perspective_attribs step = gradients->ddx;
+    brh_perspective_attribs current_attrib = start;
+    int shaded = 0;
+
+    for (int x = x_start; x < x_end; x++) {
+        const float current_depth = current_attrib.inv_w;
+        if (passes_depth_test(depth_test, current_depth, z_row[x])) {
+            shaded++;
+            const float current_w = 1.0f / current_depth;
+            float r = current_attrib.r_over_w * current_w;
+            float g = current_attrib.g_over_w * current_w;
+            float b = current_attrib.b_over_w * current_w;
+            uint8_t R = (uint8_t)MAX(0.0f, MIN(255.0f, r));
+            uint8_t G = (uint8_t)MAX(0.0f, MIN(255.0f, g));
+            uint8_t B = (uint8_t)MAX(0.0f, MIN(255.0f, b));
+
+            color_row[x] = ((uint32_t)a_base << 24) | ((uint32_t)R << 16) | ((uint32_t)G << 8) | B;
+            z_row[x] = depth_to_store(depth_test, current_depth);
+        }
+        current_attrib.inv_w += step.inv_w;
+        current_attrib.r_over_w += step.r_over_w;
+        current_attrib.g_over_w += step.g_over_w;
+        current_attrib.b_over_w += step.b_over_w;
+    }
+    *ctx->shaded_fragments += shaded;
 }
 
-// --- Fill + Gouraud + Flat Bottom ---
-static void fill_flat_bottom_perspective_gouraud(
-    int x0, int y0, brh_perspective_attribs pa0,
-    int x1, int y1, brh_perspective_attribs pa1,
-    int x2, int y2, brh_perspective_attribs pa2,
-    uint32_t base_color,
-    uint32_t* color_buffer, float* z_buffer, int win_w, int win_h)
+// --- Texture + None ---
+static void texture_span_perspective_none(const brh_raster_context* ctx, const brh_attrib_gradients* gradients,
+    int y, int x_start, int x_end, brh_perspective_attribs start)
 {
-    const float y_delta = (float)(y1 - y0);
-    if (fabsf(y_delta) < EPSILON) return;
-    const float inv_y_height = 1.0f / y_delta;
-    const uint8_t a_base = (base_color >> 24) & 0xFF;
-
-    for (int y = y0; y <= y1; y++) {
-        if (y < 0 || y >= win_h) continue;
-        const float t = (float)(y - y0) * inv_y_height;
-
-        brh_perspective_attribs attrib_left, attrib_right;
-        attrib_left.inv_w = interpolate_float(pa0.inv_w, pa1.inv_w, t);
-        attrib_left.r_over_w = interpolate_float(pa0.r_over_w, pa1.r_over_w, t);
-        attrib_left.g_over_w = interpolate_float(pa0.g_over_w, pa1.g_over_w, t);
-        attrib_left.b_over_w = interpolate_float(pa0.b_over_w, pa1.b_over_w, t);
-
-        attrib_right.inv_w = interpolate_float(pa0.inv_w, pa2.inv_w, t);
-        attrib_right.r_over_w = interpolate_float(pa0.r_over_w, pa2.r_over_w, t);
-        attrib_right.g_over_w = interpolate_float(pa0.g_over_w, pa2.g_over_w, t);
-        attrib_right.b_over_w = interpolate_float(pa0.b_over_w, pa2.b_over_w, t);
-
-        float x_left_f = interpolate_float((float)x0, (float)x1, t);
-        float x_right_f = interpolate_float((float)x0, (float)x2, t);
-        int x_start = (int)roundf(x_left_f);
-        int x_end = (int)roundf(x_right_f);
-
-        if (x_start > x_end) { swap_int(&x_start, &x_end); swap_perspective_attribs(&attrib_left, &attrib_right); }
-
-        int x_start_clip = MAX(0, x_start);
-        int x_end_clip = MIN(win_w - 1, x_end);
-
-        const float x_scan_width_f = (float)(x_end - x_start);
-        float inv_w_step = 0, r_step = 0, g_step = 0, b_step = 0;
-        brh_perspective_attribs current_attrib = attrib_left;
-
-        if (fabsf(x_scan_width_f) > EPSILON) {
-            const float inv_x_scan_width = 1.0f / x_scan_width_f;
-            inv_w_step = (attrib_right.inv_w - attrib_left.inv_w) * inv_x_scan_width;
-            r_step = (attrib_right.r_over_w - attrib_left.r_over_w) * inv_x_scan_width;
-            g_step = (attrib_right.g_over_w - attrib_left.g_over_w) * inv_x_scan_width;
-            b_step = (attrib_right.b_over_w - attrib_left.b_over_w) * inv_x_scan_width;
-            if (x_start_clip > x_start) {
-                float offset = (float)(x_start_clip - x_start);
-                current_attrib.inv_w += inv_w_step * offset;
-                current_attrib.r_over_w += r_step * offset;
-                current_attrib.g_over_w += g_step * offset;
-                current_attrib.b_over_w += b_step * offset;
+    uint32_t* color_row = ctx->color_buffer + (size_t)y * ctx->color_pitch;
+    float* z_row = ctx->z_buffer + (size_t)y * ctx->win_w;
+    const enum depth_test depth_test = ctx->depth_test;
+    const brh_perspective_attribs step = gradients->ddx;
+    brh_perspective_attribs current_attrib = start;
+    int shaded = 0;
+
+    for (int x = x_start; x < x_end; x++) {
+        const float current_depth = current_attrib.inv_w;
+        if (passes_depth_test(depth_test, current_depth, z_row[x])) {
+            shaded++;
+            const float current_w = 1.0f / current_depth;
+            uint32_t pixel_color = sample_texture(ctx, current_attrib.u_over_w * current_w, current_attrib.v_over_w * current_w);
+
+            if ((pixel_color >> 24) > 0) {
+                color_row[x] = pixel_color;
+                z_row[x] = depth_to_store(depth_test, current_depth);
             }
         }
+        current_attrib.inv_w += step.inv_w;
+        current_attrib.u_over_w += step.u_over_w;
+        current_attrib.v_over_w += step.v_over_w;
+    }
+    *ctx->shaded_fragments += shaded;
+}
 
-        int current_index = y * win_w + x_start_clip;
-        for (int x = x_start_clip; x <= x_end_clip; x++) {
-            const float current_depth = current_attrib.inv_w;
-            if (current_depth > z_buffer[current_index]) {
-                const float current_w = 1.0f / current_depth;
-                float r = current_attrib.r_over_w * current_w;
-                float g = current_attrib.g_over_w * current_w;
-                float b = current_attrib.b_over_w * current_w;
-                uint8_t R = (uint8_t)MAX(0.0f, MIN(255.0f, r));
-                uint8_t G = (uint8_t)MAX(0.0f, MIN(255.0f, g));
-                uint8_t B = (uint8_t)MAX(0.0f, MIN(255.0f, b));
-                uint32_t final_color = ((uint32_t)a_base << 24) | ((uint32_t)R << 16) | ((uint32_t)G << 8) | B;
-
-                if (a_base > 0) {
-                    color_buffer[current_index] = final_color;
-                    z_buffer[current_index] = current_depth;
-                }
+// --- Texture + Flat ---
+static void texture_span_perspective_flat(const brh_raster_context* ctx, const brh_attrib_gradients* gradients,
+    int y, int x_start, int x_end, brh_perspective_attribs start)
+{
+    // Flat shading draws the lit face color instead of sampling the texture
+    fill_span_perspective_none(ctx, gradients, y, x_start, x_end, start);
+}
+
+// --- Texture + Gouraud ---
+static void texture_span_perspective_gouraud(const brh_raster_context* ctx, const brh_attrib_gradients* gradients,
+    int y, int x_start, int x_end, brh_perspective_attribs start)
+{
+    uint32_t* color_row = ctx->color_buffer + (size_t)y * ctx->color_pitch;
+    float* z_row = ctx->z_buffer + (size_t)y * ctx->win_w;
+    const enum depth_test depth_test = ctx->depth_test;
+    const brh_perspective_attribs step = gradients->ddx;
+    brh_perspective_attribs current_attrib = start;
+    int shaded = 0;
+
+    for (int x = x_start; x < x_end; x++) {
+        const float current_depth = current_attrib.inv_w;
+        if (passes_depth_test(depth_test, current_depth, z_row[x])) {
+            shaded++;
+            const float current_w = 1.0f / current_depth;
+            // Texture
+            uint32_t base_color = sample_texture(ctx, current_attrib.u_over_w * current_w, current_attrib.v_over_w * current_w);
+            // Gouraud
+            uint8_t a_base = (base_color >> 24) & 0xFF;
+            uint8_t r_base = (base_color >> 16) & 0xFF;
+            uint8_t g_base = (base_color >> 8) & 0xFF;
+            uint8_t b_base = base_color & 0xFF;
+            float r_light = current_attrib.r_over_w * current_w;
+            float g_light = current_attrib.g_over_w * current_w;
+            float b_light = current_attrib.b_over_w * current_w;
+            float r_intensity = MAX(0.0f, MIN(1.0f, r_light / 255.0f));
+            float g_intensity = MAX(0.0f, MIN(1.0f, g_light / 255.0f));
+            float b_intensity = MAX(0.0f, MIN(1.0f, b_light / 255.0f));
+            uint8_t R = (uint8_t)((float)r_base * r_intensity);
+            uint8_t G = (uint8_t)((float)g_base * g_intensity);
+            uint8_t B = (uint8_t)((float)b_base * b_intensity);
+
+            if (a_base > 0) {
+                color_row[x] = ((uint32_t)a_base << 24) | ((uint32_t)R << 16) | ((uint32_t)G << 8) | B;
+                z_row[x] = depth_to_store(depth_test, current_depth);
             }
-            current_attrib.inv_w += inv_w_step;
-            current_attrib.r_over_w += r_step;
-            current_attrib.g_over_w += g_step;
-            current_attrib.b_over_w += b_step;
-            current_index++;
         }
+        current_attrib.inv_w += step.inv_w;
+        current_attrib.u_over_w += step.u_over_w;
+        current_attrib.v_over_w += step.v_over_w;
+        current_attrib.r_over_w += step.r_over_w;
+        current_attrib.g_over_w += step.g_over_w;
+        current_attrib.b_over_w += step.b_over_w;
     }
+    *ctx->shaded_fragments += shaded;
 }
 
-// --- Fill + Gouraud + Flat Top ---
-static void fill_flat_top_perspective_gouraud(
-    int x0, int y0, brh_perspective_attribs pa0,
-    int x1, int y1, brh_perspective_attribs pa1,
-    int x2, int y2, brh_perspective_attribs pa2,
-    uint32_t base_color,
-    uint32_t* color_buffer, float* z_buffer, int win_w, int win_h)
+
+// --- Depth Only ---
+// Writes no color and steps nothing but inv_w, which it keeps where it is larger (closer),
+// along with the triangle's id when drawing a visibility buffer
+static void depth_span(const brh_raster_context* ctx, const brh_attrib_gradients* gradients,
+    int y, int x_start, int x_end, brh_perspective_attribs start)
 {
-    const float y_delta = (float)(y2 - y0);
-    if (fabsf(y_delta) < EPSILON) return;
-    const float inv_y_height = 1.0f / y_delta;
-    const uint8_t a_base = (base_color >> 24) & 0xFF;
-
-    for (int y = y2; y >= y0; y--) { // Iterate upwards
-        if (y < 0 || y >= win_h) continue;
-        const float t = (float)(y2 - y) * inv_y_height;
-
-        brh_perspective_attribs attrib_left, attrib_right;
-        attrib_left.inv_w = interpolate_float(pa2.inv_w, pa0.inv_w, t);
-        attrib_left.r_over_w = interpolate_float(pa2.r_over_w, pa0.r_over_w, t);
-        attrib_left.g_over_w = interpolate_float(pa2.g_over_w, pa0.g_over_w, t);
-        attrib_left.b_over_w = interpolate_float(pa2.b_over_w, pa0.b_over_w, t);
-
-        attrib_right.inv_w = interpolate_float(pa2.inv_w, pa1.inv_w, t);
-        attrib_right.r_over_w = interpolate_float(pa2.r_over_w, pa1.r_over_w, t);
-        attrib_right.g_over_w = interpolate_float(pa2.g_over_w, pa1.g_over_w, t);
-        attrib_right.b_over_w = interpolate_float(pa2.b_over_w, pa1.b_over_w, t);
-
-        float x_left_f = interpolate_float((float)x2, (float)x0, t);
-        float x_right_f = interpolate_float((float)x2, (float)x1, t);
-        int x_start = (int)roundf(x_left_f);
-        int x_end = (int)roundf(x_right_f);
-
-        if (x_start > x_end) { swap_int(&x_start, &x_end); swap_perspective_attribs(&attrib_left, &attrib_right); }
-
-        int x_start_clip = MAX(0, x_start);
-        int x_end_clip = MIN(win_w - 1, x_end);
-
-        const float x_scan_width_f = (float)(x_end - x_start);
-        float inv_w_step = 0, r_step = 0, g_step = 0, b_step = 0;
-        brh_perspective_attribs current_attrib = attrib_left;
-
-        if (fabsf(x_scan_width_f) > EPSILON) {
-            const float inv_x_scan_width = 1.0f / x_scan_width_f;
-            inv_w_step = (attrib_right.inv_w - attrib_left.inv_w) * inv_x_scan_width;
-            r_step = (attrib_right.r_over_w - attrib_left.r_over_w) * inv_x_scan_width;
-            g_step = (attrib_right.g_over_w - attrib_left.g_over_w) * inv_x_scan_width;
-            b_step = (attrib_right.b_over_w - attrib_left.b_over_w) * inv_x_scan_width;
-            if (x_start_clip > x_start) {
-                float offset = (float)(x_start_clip - x_start);
-                current_attrib.inv_w += inv_w_step * offset;
-                current_attrib.r_over_w += r_step * offset;
-                current_attrib.g_over_w += g_step * offset;
-                current_attrib.b_over_w += b_step * offset;
-            }
+    float* z_row = ctx->z_buffer + (size_t)y * ctx->win_w;
+    uint32_t* id_row = ctx->id_buffer ? ctx->id_buffer + (size_t)y * ctx->win_w : NULL;
+    const uint32_t id = ctx->id;
+    const float inv_w_step = gradients->ddx.inv_w;
+    float current_inv_w = start.inv_w;
+
+    for (int x = x_start; x < x_end; x++) {
+        if (current_inv_w > z_row[x]) {
+            z_row[x] = current_inv_w;
+            if (id_row) id_row[x] = id;
         }
+        current_inv_w += inv_w_step;
+    }
+}
 
-        int current_index = y * win_w + x_start_clip;
-        for (int x = x_start_clip; x <= x_end_clip; x++) {
-            const float current_depth = current_attrib.inv_w;
-            if (current_depth > z_buffer[current_index]) {
-                const float current_w = 1.0f / current_depth;
-                float r = current_attrib.r_over_w * current_w;
-                float g = current_attrib.g_over_w * current_w;
-                float b = current_attrib.b_over_w * current_w;
-                uint8_t R = (uint8_t)MAX(0.0f, MIN(255.0f, r));
-                uint8_t G = (uint8_t)MAX(0.0f, MIN(255.0f, g));
-                uint8_t B = (uint8_t)MAX(0.0f, MIN(255.0f, b));
-                uint32_t final_color = ((uint32_t)a_base << 24) | ((uint32_t)R << 16) | ((uint32_t)G << 8) | B;
-
-                if (a_base > 0) {
-                    color_buffer[current_index] = final_color;
-                    z_buffer[current_index] = current_depth;
-                }
+// --- Depth Only, Alpha Tested ---
+// Like depth_span, but a fragment whose texel has zero alpha leaves the depth alone, as it
+// leaves the color alone in the texture spans. u/v step exactly as they do there.
+static void alpha_tested_depth_span(const brh_raster_context* ctx, const brh_attrib_gradients* gradients,
+    int y, int x_start, int x_end, brh_perspective_attribs start)
+{
+    float* z_row = ctx->z_buffer + (size_t)y * ctx->win_w;
+    uint32_t* id_row = ctx->id_buffer ? ctx->id_buffer + (size_t)y * ctx->win_w : NULL;
+    const uint32_t id = ctx->id;
+    const brh_perspective_attribs step = gradients->ddx;
+    brh_perspective_attribs current_attrib = start;
+
+    for (int x = x_start; x < x_end; x++) {
+        const float current_depth = current_attrib.inv_w;
+        if (current_depth > z_row[x]) {
+            const float current_w = 1.0f / current_depth;
+            const uint32_t texel = sample_texture(ctx, current_attrib.u_over_w * current_w, current_attrib.v_over_w * current_w);
+            if ((texel >> 24) > 0) {
+                z_row[x] = current_depth;
+                if (id_row) id_row[x] = id;
             }
-            current_attrib.inv_w += inv_w_step;
-            current_attrib.r_over_w += r_step;
-            current_attrib.g_over_w += g_step;
-            current_attrib.b_over_w += b_step;
-            current_index++;
         }
+        current_attrib.inv_w += step.inv_w;
+        current_attrib.u_over_w += step.u_over_w;
+        current_attrib.v_over_w += step.v_over_w;
     }
 }
 
-
-// --- TODO: Implement Phong Rasterizers ---
+// --- TODO: Implement Phong Spans ---
 // ...
 
 // --- Wireframe Drawing ---
-void draw_triangle_outline(const brh_triangle* triangle, uint32_t color)
+void draw_triangle_outline(const brh_screen_triangle* triangle, uint32_t color)
 {
-    int x0 = (int)triangle->vertices[0].position.x; int y0 = (int)triangle->vertices[0].position.y;
-    int x1 = (int)triangle->vertices[1].position.x; int y1 = (int)triangle->vertices[1].position.y;
-    int x2 = (int)triangle->vertices[2].position.x; int y2 = (int)triangle->vertices[2].position.y;
+    int x0 = triangle->vertices[0].x >> BRH_SUBPIXEL_BITS; int y0 = triangle->vertices[0].y >> BRH_SUBPIXEL_BITS;
+    int x1 = triangle->vertices[1].x >> BRH_SUBPIXEL_BITS; int y1 = triangle->vertices[1].y >> BRH_SUBPIXEL_BITS;
+    int x2 = triangle->vertices[2].x >> BRH_SUBPIXEL_BITS; int y2 = triangle->vertices[2].y >> BRH_SUBPIXEL_BITS;
 
     // Consider optimizing draw_line_dda if performance critical
     draw_line_dda(x0, y0, x1, y1, color);
@@ -867,203 +549,219 @@ void draw_triangle_outline(const brh_triangle* triangle, uint32_t color)
 }
 
 
-// --- High-level Triangle Drawing Functions (Dispatchers - UPDATED) ---
+// --- High-level Triangle Drawing Functions (Dispatchers) ---
 
-void draw_filled_triangle(brh_triangle* triangle, uint32_t color)
+// Sets up the context, interpolants and span function that draw a triangle in color with the
+// shading method it was built with: textured when texcoords and a texture are given, filled otherwise.
+// Returns NULL if there is nothing to draw into or the shading method has no span.
+static brh_span_func prepare_color_triangle(const brh_screen_triangle* triangle, const brh_screen_texcoords* texcoords,
+    brh_texture_handle texture_handle, enum shading_method shading, brh_raster_context* ctx, brh_perspective_attribs pa[3])
 {
     // 1. Get buffer pointers and dimensions ONCE
-    uint32_t* color_buffer = get_color_buffer_ptr();
-    float* z_buffer = get_z_buffer_ptr();
-    int win_w = get_window_width();
-    int win_h = get_window_height();
-    if (!color_buffer || !z_buffer || win_w <= 0 || win_h <= 0) return;
-
-    // 2. Prepare attributes and sort vertices
-    int x0 = (int)triangle->vertices[0].position.x; int y0 = (int)triangle->vertices[0].position.y;
-    int x1 = (int)triangle->vertices[1].position.x; int y1 = (int)triangle->vertices[1].position.y;
-    int x2 = (int)triangle->vertices[2].position.x; int y2 = (int)triangle->vertices[2].position.y;
-    brh_perspective_attribs pa0, pa1, pa2;
-    prepare_perspective_attribs(triangle->vertices[0], &pa0);
-    prepare_perspective_attribs(triangle->vertices[1], &pa1);
-    prepare_perspective_attribs(triangle->vertices[2], &pa2);
-    if (y0 > y1) { swap_int(&x0, &x1); swap_int(&y0, &y1); swap_perspective_attribs(&pa0, &pa1); }
-    if (y1 > y2) { swap_int(&x1, &x2); swap_int(&y1, &y2); swap_perspective_attribs(&pa1, &pa2); }
-    if (y0 > y1) { swap_int(&x0, &x1); swap_int(&y0, &y1); swap_perspective_attribs(&pa0, &pa1); }
-    assert(y0 <= y1 && y1 <= y2);
-    if (y2 == y0) return;
-
-    uint32_t base_or_flat_color = triangle->color;
-    shading_method current_shading = get_shading_method();
-
-    // 3. Split triangle and DISPATCH
-    if (y1 == y2) { // Flat Bottom
-        switch (current_shading) {
-        case SHADING_NONE:    fill_flat_bottom_perspective_none(x0, y0, pa0, x1, y1, pa1, x2, y2, pa2, base_or_flat_color, color_buffer, z_buffer, win_w, win_h); break;
-        case SHADING_FLAT:    fill_flat_bottom_perspective_flat(x0, y0, pa0, x1, y1, pa1, x2, y2, pa2, base_or_flat_color, color_buffer, z_buffer, win_w, win_h); break;
-        case SHADING_GOURAUD: fill_flat_bottom_perspective_gouraud(x0, y0, pa0, x1, y1, pa1, x2, y2, pa2, base_or_flat_color, color_buffer, z_buffer, win_w, win_h); break;
-        case SHADING_PHONG:   /*fill_flat_bottom_perspective_phong(...)*/; break; // TODO
+    *ctx = (brh_raster_context){ 0 };
+    ctx->color_buffer = get_color_buffer_ptr();
+    ctx->z_buffer = get_z_buffer_ptr();
+    ctx->color_pitch = get_color_buffer_pitch();
+    ctx->win_w = get_render_width();
+    ctx->win_h = get_render_height();
+    if (!ctx->color_buffer || !ctx->z_buffer || ctx->win_w <= 0 || ctx->win_h <= 0) return NULL;
+    ctx->row_begin = 0;
+    ctx->row_end = ctx->win_h;
+    ctx->lazy_depth_tiles = true;
+    ctx->depth_test = current_depth_test;
+    ctx->shaded_fragments = &shaded_fragment_count;
+    ctx->color = triangle->vertices[0].color; // Base or flat color
+
+    if (texture_handle && texcoords) {
+        ctx->texture = get_texture_data(texture_handle);
+        ctx->tex_w = get_texture_width(texture_handle);
+        ctx->tex_h = get_texture_height(texture_handle);
+        if (!ctx->texture || ctx->tex_w <= 0 || ctx->tex_h <= 0) {
+            fprintf(stderr, "Warning: Failed to get texture data for a textured triangle. Falling back to filled.\n");
+            ctx->texture = NULL;
         }
     }
-    else if (y0 == y1) { // Flat Top
-        switch (current_shading) {
-        case SHADING_NONE:    fill_flat_top_perspective_none(x0, y0, pa0, x1, y1, pa1, x2, y2, pa2, base_or_flat_color, color_buffer, z_buffer, win_w, win_h); break;
-        case SHADING_FLAT:    fill_flat_top_perspective_flat(x0, y0, pa0, x1, y1, pa1, x2, y2, pa2, base_or_flat_color, color_buffer, z_buffer, win_w, win_h); break;
-        case SHADING_GOURAUD: fill_flat_top_perspective_gouraud(x0, y0, pa0, x1, y1, pa1, x2, y2, pa2, base_or_flat_color, color_buffer, z_buffer, win_w, win_h); break;
-        case SHADING_PHONG:   /*fill_flat_top_perspective_phong(...)*/; break; // TODO
-        }
+    if (!ctx->texture) {
+        texcoords = NULL;
     }
-    else { // General triangle
-        int my = y1;
-        int mx = (int)roundf(interpolate_x_from_y(x0, y0, x2, y2, my));
-        float y_delta_total = (float)(y2 - y0);
-        if (fabsf(y_delta_total) < EPSILON) return;
-        float lerp_factor_y = (float)(y1 - y0) / y_delta_total;
-        brh_perspective_attribs pam;
-        pam.inv_w = interpolate_float(pa0.inv_w, pa2.inv_w, lerp_factor_y);
-        if (fabsf(pam.inv_w) < EPSILON) { pam.inv_w = EPSILON; }
-        pam.u_over_w = interpolate_float(pa0.u_over_w, pa2.u_over_w, lerp_factor_y);
-        pam.v_over_w = interpolate_float(pa0.v_over_w, pa2.v_over_w, lerp_factor_y);
-        pam.r_over_w = interpolate_float(pa0.r_over_w, pa2.r_over_w, lerp_factor_y);
-        pam.g_over_w = interpolate_float(pa0.g_over_w, pa2.g_over_w, lerp_factor_y);
-        pam.b_over_w = interpolate_float(pa0.b_over_w, pa2.b_over_w, lerp_factor_y);
-        pam.nx_over_w = interpolate_float(pa0.nx_over_w, pa2.nx_over_w, lerp_factor_y);
-        pam.ny_over_w = interpolate_float(pa0.ny_over_w, pa2.ny_over_w, lerp_factor_y);
-        pam.nz_over_w = interpolate_float(pa0.nz_over_w, pa2.nz_over_w, lerp_factor_y);
-
-        // Dispatch top part (Flat Bottom)
-        switch (current_shading) {
-        case SHADING_NONE:    fill_flat_bottom_perspective_none(x0, y0, pa0, x1, y1, pa1, mx, my, pam, base_or_flat_color, color_buffer, z_buffer, win_w, win_h); break;
-        case SHADING_FLAT:    fill_flat_bottom_perspective_flat(x0, y0, pa0, x1, y1, pa1, mx, my, pam, base_or_flat_color, color_buffer, z_buffer, win_w, win_h); break;
-        case SHADING_GOURAUD: fill_flat_bottom_perspective_gouraud(x0, y0, pa0, x1, y1, pa1, mx, my, pam, base_or_flat_color, color_buffer, z_buffer, win_w, win_h); break;
-        case SHADING_PHONG:   /*fill_flat_bottom_perspective_phong(...)*/; break; // TODO
-        }
 
-        // Dispatch bottom part (Flat Top)
-        if (x1 < mx) {
-            switch (current_shading) {
-            case SHADING_NONE:    fill_flat_top_perspective_none(x1, y1, pa1, mx, my, pam, x2, y2, pa2, base_or_flat_color, color_buffer, z_buffer, win_w, win_h); break;
-            case SHADING_FLAT:    fill_flat_top_perspective_flat(x1, y1, pa1, mx, my, pam, x2, y2, pa2, base_or_flat_color, color_buffer, z_buffer, win_w, win_h); break;
-            case SHADING_GOURAUD: fill_flat_top_perspective_gouraud(x1, y1, pa1, mx, my, pam, x2, y2, pa2, base_or_flat_color, color_buffer, z_buffer, win_w, win_h); break;
-            case SHADING_PHONG:   /*fill_flat_top_perspective_phong(...)*/; break; // TODO
-            }
-        }
-        else {
-            switch (current_shading) {
-            case SHADING_NONE:    fill_flat_top_perspective_none(mx, my, pam, x1, y1, pa1, x2, y2, pa2, base_or_flat_color, color_buffer, z_buffer, win_w, win_h); break;
-            case SHADING_FLAT:    fill_flat_top_perspective_flat(mx, my, pam, x1, y1, pa1, x2, y2, pa2, base_or_flat_color, color_buffer, z_buffer, win_w, win_h); break;
-            case SHADING_GOURAUD: fill_flat_top_perspective_gouraud(mx, my, pam, x1, y1, pa1, x2, y2, pa2, base_or_flat_color, color_buffer, z_buffer, win_w, win_h); break;
-            case SHADING_PHONG:   /*fill_flat_top_perspective_phong(...)*/; break; // TODO
-            }
-        }
+    // 2. Select the span function for the triangle's shading method
+    brh_span_func span = NULL;
+    switch (shading) {
+    case SHADING_NONE:    span = texcoords ? texture_span_perspective_none : fill_span_perspective_none; break;
+    case SHADING_FLAT:    span = texcoords ? texture_span_perspective_flat : fill_span_perspective_flat; break;
+    case SHADING_GOURAUD: span = texcoords ? texture_span_perspective_gouraud : fill_span_perspective_gouraud; break;
+    case SHADING_PHONG:   /* fill/texture_span_perspective_phong */ break; // TODO
     }
+    if (!span) return NULL;
+
+    // 3. Prepare attributes
+    for (int i = 0; i < 3; i++) {
+        prepare_perspective_attribs(&triangle->vertices[i], texcoords ? &texcoords->texels[i] : NULL, shading, &pa[i]);
+    }
+    return span;
+}
+
+void draw_filled_triangle(const brh_screen_triangle* triangle, enum shading_method shading)
+{
+    brh_raster_context ctx;
+    brh_perspective_attribs pa[3];
+    const brh_span_func span = prepare_color_triangle(triangle, NULL, BRH_NULL_HANDLE, shading, &ctx, pa);
+    if (!span) return;
+
+    const brh_screen_vertex* vertices[3] = { &triangle->vertices[0], &triangle->vertices[1], &triangle->vertices[2] };
+    const brh_perspective_attribs* attribs[3] = { &pa[0], &pa[1], &pa[2] };
+    rasterize_triangle(vertices, attribs, &ctx, span);
 }
 
 
-void draw_textured_triangle(brh_triangle* triangle, brh_texture_handle texture_handle)
+void draw_textured_triangle(const brh_screen_triangle* triangle, const brh_screen_texcoords* texcoords, brh_texture_handle texture_handle,
+    enum shading_method shading)
 {
-    // 1. Get buffer pointers, dimensions, and texture data
-    uint32_t* color_buffer = get_color_buffer_ptr();
-    float* z_buffer = get_z_buffer_ptr();
-    int win_w = get_window_width();
-    int win_h = get_window_height();
-    if (!color_buffer || !z_buffer || win_w <= 0 || win_h <= 0) return;
-
-    if (!texture_handle) { // Fallback to filled triangle if texture is missing
+    if (!texture_handle || !texcoords) { // Fallback to filled triangle if texture is missing
         fprintf(stderr, "Warning: Invalid texture handle in draw_textured_triangle. Falling back to filled.\n");
-        draw_filled_triangle(triangle, triangle->color); // Use stored triangle color
+        draw_filled_triangle(triangle, shading);
         return;
     }
-    uint32_t* texture_data = get_texture_data(texture_handle);
-    int texture_width = get_texture_width(texture_handle);
-    int texture_height = get_texture_height(texture_handle);
-    if (!texture_data || texture_width <= 0 || texture_height <= 0) {
-        fprintf(stderr, "Warning: Failed to get texture data in draw_textured_triangle. Falling back to filled.\n");
-        draw_filled_triangle(triangle, triangle->color); // Use stored triangle color
-        return;
+
+    brh_raster_context ctx;
+    brh_perspective_attribs pa[3];
+    const brh_span_func span = prepare_color_triangle(triangle, texcoords, texture_handle, shading, &ctx, pa);
+    if (!span) return;
+
+    const brh_screen_vertex* vertices[3] = { &triangle->vertices[0], &triangle->vertices[1], &triangle->vertices[2] };
+    const brh_perspective_attribs* attribs[3] = { &pa[0], &pa[1], &pa[2] };
+    rasterize_triangle(vertices, attribs, &ctx, span);
+}
+
+
+// Rasterizes the depth of a triangle into a depth-only context
+static void rasterize_depth_triangle(const brh_screen_triangle* triangle, const brh_raster_context* ctx)
+{
+    // Only inv_w is read; it gets the same zero guard as the color kernels
+    brh_perspective_attribs pa[3] = { { 0 } };
+    for (int i = 0; i < 3; i++) {
+        const float inv_w = triangle->vertices[i].inv_w;
+        pa[i].inv_w = (fabsf(inv_w) < EPSILON) ? 0.0f : inv_w;
     }
 
-    // 2. Prepare attributes and sort vertices
-    int x0 = (int)triangle->vertices[0].position.x; int y0 = (int)triangle->vertices[0].position.y;
-    int x1 = (int)triangle->vertices[1].position.x; int y1 = (int)triangle->vertices[1].position.y;
-    int x2 = (int)triangle->vertices[2].position.x; int y2 = (int)triangle->vertices[2].position.y;
-    brh_perspective_attribs pa0, pa1, pa2;
-    prepare_perspective_attribs(triangle->vertices[0], &pa0);
-    prepare_perspective_attribs(triangle->vertices[1], &pa1);
-    prepare_perspective_attribs(triangle->vertices[2], &pa2);
-    if (y0 > y1) { swap_int(&x0, &x1); swap_int(&y0, &y1); swap_perspective_attribs(&pa0, &pa1); }
-    if (y1 > y2) { swap_int(&x1, &x2); swap_int(&y1, &y2); swap_perspective_attribs(&pa1, &pa2); }
-    if (y0 > y1) { swap_int(&x0, &x1); swap_int(&y0, &y1); swap_perspective_attribs(&pa0, &pa1); }
-    assert(y0 <= y1 && y1 <= y2);
-    if (y2 == y0) return;
-
-    uint32_t flat_color = triangle->color; // Needed only for flat shading case
-    shading_method current_shading = get_shading_method();
-
-    // 3. Split triangle and DISPATCH
-    if (y1 == y2) { // Flat Bottom
-        switch (current_shading) {
-        case SHADING_NONE:    texture_flat_bottom_perspective_none(x0, y0, pa0, x1, y1, pa1, x2, y2, pa2, texture_data, texture_width, texture_height, color_buffer, z_buffer, win_w, win_h); break;
-        case SHADING_FLAT:    texture_flat_bottom_perspective_flat(x0, y0, pa0, x1, y1, pa1, x2, y2, pa2, flat_color, color_buffer, z_buffer, win_w, win_h); break;
-        case SHADING_GOURAUD: texture_flat_bottom_perspective_gouraud(x0, y0, pa0, x1, y1, pa1, x2, y2, pa2, texture_data, texture_width, texture_height, color_buffer, z_buffer, win_w, win_h); break;
-        case SHADING_PHONG:   /*texture_flat_bottom_perspective_phong(...)*/; break; // TODO
-        }
+    const brh_screen_vertex* vertices[3] = { &triangle->vertices[0], &triangle->vertices[1], &triangle->vertices[2] };
+    const brh_perspective_attribs* attribs[3] = { &pa[0], &pa[1], &pa[2] };
+    rasterize_triangle(vertices, attribs, ctx, depth_span);
+}
+
+void draw_depth_triangle(const brh_screen_triangle* triangle, float* depth_buffer, int width, int height, int row_begin, int row_end)
+{
+    brh_raster_context ctx = { 0 };
+    ctx.z_buffer = depth_buffer;
+    ctx.win_w = width;
+    ctx.win_h = height;
+    ctx.row_begin = MAX(row_begin, 0);
+    ctx.row_end = MIN(row_end, height);
+    ctx.depth_only = true;
+    if (!depth_buffer || width <= 0 || ctx.row_begin >= ctx.row_end) return;
+
+    rasterize_depth_triangle(triangle, &ctx);
+}
+
+// Rasterizes the depth, and optionally the id, of a triangle into the display's z-buffer,
+// alpha testing it when a texture is given
+static void rasterize_prepass_triangle(const brh_screen_triangle* triangle, const brh_screen_texcoords* texcoords,
+    brh_texture_handle texture_handle, uint32_t* id_buffer, uint32_t id)
+{
+    brh_raster_context ctx = { 0 };
+    ctx.z_buffer = get_z_buffer_ptr();
+    ctx.win_w = get_render_width();
+    ctx.win_h = get_render_height();
+    if (!ctx.z_buffer || ctx.win_w <= 0 || ctx.win_h <= 0) return;
+    ctx.row_begin = 0;
+    ctx.row_end = ctx.win_h;
+    ctx.lazy_depth_tiles = true;
+    ctx.id_buffer = id_buffer;
+    ctx.id = id;
+
+    if (texture_handle && texcoords) {
+        ctx.texture = get_texture_data(texture_handle);
+        ctx.tex_w = get_texture_width(texture_handle);
+        ctx.tex_h = get_texture_height(texture_handle);
     }
-    else if (y0 == y1) { // Flat Top
-        switch (current_shading) {
-        case SHADING_NONE:    texture_flat_top_perspective_none(x0, y0, pa0, x1, y1, pa1, x2, y2, pa2, texture_data, texture_width, texture_height, color_buffer, z_buffer, win_w, win_h); break;
-        case SHADING_FLAT:    texture_flat_top_perspective_flat(x0, y0, pa0, x1, y1, pa1, x2, y2, pa2, flat_color, color_buffer, z_buffer, win_w, win_h); break;
-        case SHADING_GOURAUD: texture_flat_top_perspective_gouraud(x0, y0, pa0, x1, y1, pa1, x2, y2, pa2, texture_data, texture_width, texture_height, color_buffer, z_buffer, win_w, win_h); break;
-        case SHADING_PHONG:   /*texture_flat_top_perspective_phong(...)*/; break; // TODO
-        }
+    if (!ctx.texture || ctx.tex_w <= 0 || ctx.tex_h <= 0) {
+        // Opaque, or a texture the color pass will also fall back to filling without
+        ctx.depth_only = true;
+        rasterize_depth_triangle(triangle, &ctx);
+        return;
     }
-    else { // General triangle
-        int my = y1;
-        int mx = (int)roundf(interpolate_x_from_y(x0, y0, x2, y2, my));
-        float y_delta_total = (float)(y2 - y0);
-        if (fabsf(y_delta_total) < EPSILON) return;
-        float lerp_factor_y = (float)(y1 - y0) / y_delta_total;
-        brh_perspective_attribs pam;
-        pam.inv_w = interpolate_float(pa0.inv_w, pa2.inv_w, lerp_factor_y);
-        if (fabsf(pam.inv_w) < EPSILON) { pam.inv_w = EPSILON; }
-        pam.u_over_w = interpolate_float(pa0.u_over_w, pa2.u_over_w, lerp_factor_y);
-        pam.v_over_w = interpolate_float(pa0.v_over_w, pa2.v_over_w, lerp_factor_y);
-        pam.r_over_w = interpolate_float(pa0.r_over_w, pa2.r_over_w, lerp_factor_y);
-        pam.g_over_w = interpolate_float(pa0.g_over_w, pa2.g_over_w, lerp_factor_y);
-        pam.b_over_w = interpolate_float(pa0.b_over_w, pa2.b_over_w, lerp_factor_y);
-        pam.nx_over_w = interpolate_float(pa0.nx_over_w, pa2.nx_over_w, lerp_factor_y);
-        pam.ny_over_w = interpolate_float(pa0.ny_over_w, pa2.ny_over_w, lerp_factor_y);
-        pam.nz_over_w = interpolate_float(pa0.nz_over_w, pa2.nz_over_w, lerp_factor_y);
-
-        // Dispatch top part (Flat Bottom)
-        switch (current_shading) {
-        case SHADING_NONE:    texture_flat_bottom_perspective_none(x0, y0, pa0, x1, y1, pa1, mx, my, pam, texture_data, texture_width, texture_height, color_buffer, z_buffer, win_w, win_h); break;
-        case SHADING_FLAT:    texture_flat_bottom_perspective_flat(x0, y0, pa0, x1, y1, pa1, mx, my, pam, flat_color, color_buffer, z_buffer, win_w, win_h); break;
-        case SHADING_GOURAUD: texture_flat_bottom_perspective_gouraud(x0, y0, pa0, x1, y1, pa1, mx, my, pam, texture_data, texture_width, texture_height, color_buffer, z_buffer, win_w, win_h); break;
-        case SHADING_PHONG:   /*texture_flat_bottom_perspective_phong(...)*/; break; // TODO
-        }
 
-        // Dispatch bottom part (Flat Top)
-        if (x1 < mx) {
-            switch (current_shading) {
-            case SHADING_NONE:    texture_flat_top_perspective_none(x1, y1, pa1, mx, my, pam, x2, y2, pa2, texture_data, texture_width, texture_height, color_buffer, z_buffer, win_w, win_h); break;
-            case SHADING_FLAT:    texture_flat_top_perspective_flat(x1, y1, pa1, mx, my, pam, x2, y2, pa2, flat_color, color_buffer, z_buffer, win_w, win_h); break;
-            case SHADING_GOURAUD: texture_flat_top_perspective_gouraud(x1, y1, pa1, mx, my, pam, x2, y2, pa2, texture_data, texture_width, texture_height, color_buffer, z_buffer, win_w, win_h); break;
-            case SHADING_PHONG:   /*texture_flat_top_perspective_phong(...)*/; break; // TODO
-            }
-        }
-        else {
-            switch (current_shading) {
-            case SHADING_NONE:    texture_flat_top_perspective_none(mx, my, pam, x1, y1, pa1, x2, y2, pa2, texture_data, texture_width, texture_height, color_buffer, z_buffer, win_w, win_h); break;
-            case SHADING_FLAT:    texture_flat_top_perspective_flat(mx, my, pam, x1, y1, pa1, x2, y2, pa2, flat_color, color_buffer, z_buffer, win_w, win_h); break;
-            case SHADING_GOURAUD: texture_flat_top_perspective_gouraud(mx, my, pam, x1, y1, pa1, x2, y2, pa2, texture_data, texture_width, texture_height, color_buffer, z_buffer, win_w, win_h); break;
-            case SHADING_PHONG:   /*texture_flat_top_perspective_phong(...)*/; break; // TODO
-            }
-        }
-    }
+    // Same texture interpolants as draw_textured_triangle(), so the alpha test picks the same
+    // texels; the alpha test reads no color
+    brh_perspective_attribs pa0, pa1, pa2;
+    prepare_perspective_attribs(&triangle->vertices[0], &texcoords->texels[0], SHADING_NONE, &pa0);
+    prepare_perspective_attribs(&triangle->vertices[1], &texcoords->texels[1], SHADING_NONE, &pa1);
+    prepare_perspective_attribs(&triangle->vertices[2], &texcoords->texels[2], SHADING_NONE, &pa2);
+
+    const brh_screen_vertex* vertices[3] = { &triangle->vertices[0], &triangle->vertices[1], &triangle->vertices[2] };
+    const brh_perspective_attribs* attribs[3] = { &pa0, &pa1, &pa2 };
+    rasterize_triangle(vertices, attribs, &ctx, alpha_tested_depth_span);
 }
 
-// --- Vertex Interpolation (Removed - Not used by new rasterizers/clipping yet) ---
-// brh_vertex interpolate_vertices(...)
+void draw_prepass_triangle(const brh_screen_triangle* triangle, const brh_screen_texcoords* texcoords, brh_texture_handle texture_handle)
+{
+    rasterize_prepass_triangle(triangle, texcoords, texture_handle, NULL, 0);
+}
 
-// --- Barycentric Coordinates (Removed - Not used by new rasterizers) ---
-// brh_vector3 calculate_barycentic_coordinates(...)
\ No newline at end of file
+void draw_visibility_triangle(const brh_screen_triangle* triangle, const brh_screen_texcoords* texcoords, brh_texture_handle texture_handle,
+    uint32_t* id_buffer, uint32_t id)
+{
+    if (!id_buffer) return;
+    rasterize_prepass_triangle(triangle, texcoords, texture_handle, id_buffer, id);
+}
+
+void shade_visibility_span(const brh_screen_triangle* triangle, const brh_screen_texcoords* texcoords, brh_texture_handle texture_handle,
+    enum shading_method shading, int y, int x_start, int x_end, uint64_t* shaded_fragments)
+{
+    brh_raster_context ctx;
+    brh_perspective_attribs pa[3];
+    const brh_span_func span = prepare_color_triangle(triangle, texcoords, texture_handle, shading, &ctx, pa);
+    if (!span || !shaded_fragments || y < 0 || y >= ctx.win_h) return;
+    x_start = MAX(x_start, 0);
+    x_end = MIN(x_end, ctx.win_w);
+    if (x_start >= x_end) return;
+
+    // The visibility buffer already decided which pixels this triangle owns
+    ctx.depth_test = DEPTH_TEST_ALWAYS;
+    ctx.lazy_depth_tiles = false;
+    ctx.shaded_fragments = shaded_fragments;
+
+    // Same reference vertex and gradients as rasterize_triangle(), so a span that starts where
+    // the triangle's own span starts shades exactly the same colors
+    const brh_screen_vertex* vertices[3] = { &triangle->vertices[0], &triangle->vertices[1], &triangle->vertices[2] };
+    const brh_perspective_attribs* attribs[3] = { &pa[0], &pa[1], &pa[2] };
+    sort_triangle_vertices(vertices, attribs);
+    const int64_t area = triangle_area(vertices);
+    if (area == 0) return;
+
+    brh_attrib_gradients gradients;
+    const float area_pixels = (float)area / (float)(BRH_SUBPIXEL_ONE * BRH_SUBPIXEL_ONE);
+    compute_attrib_gradients(vertices[0], vertices[1], vertices[2], attribs[0], attribs[1], attribs[2], area_pixels, false, &gradients);
+    span(&ctx, &gradients, y, x_start, x_end, evaluate_attribs(&gradients, x_start, y, false));
+}
+
+void set_depth_test(enum depth_test test)
+{
+    current_depth_test = test;
+}
+
+enum depth_test get_depth_test(void)
+{
+    return current_depth_test;
+}
+
+uint64_t get_shaded_fragment_count(void)
+{
+    return shaded_fragment_count;
+}
+
+void record_shaded_fragments(uint64_t count)
+{
+    shaded_fragment_count += count;
+}
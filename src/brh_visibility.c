@@ -0,0 +1,186 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL3/SDL.h>
+#include "brh_visibility.h"
+#include "array.h"
+#include "brh_display.h"
+#include "brh_triangle.h"
+#include "brh_jobs.h"
+#include "brh_profiler.h"
+#include "math_utils.h"
+
+// What the resolve jobs of a frame read
+typedef struct {
+    const brh_draw_command* commands;
+    int command_count;
+    enum render_method render_method;
+    int width;
+    int height;
+} brh_visibility_frame;
+
+// Triangle id of each pixel (0 where no triangle is visible); all zero between frames
+static uint32_t* id_buffer = NULL;
+static int id_buffer_capacity = 0;
+
+// Command c owns ids [first_ids[c], first_ids[c + 1])
+static uint32_t* first_ids = NULL;
+static int first_id_capacity = 0;
+
+// Fragments shaded by each resolve band, summed once the jobs are done
+static uint64_t* band_fragments = NULL;
+static int band_capacity = 0;
+
+static brh_visibility_stats visibility_stats;
+
+// Makes the id buffer cover the render resolution, all zero
+static bool reserve_id_buffer(int pixel_count)
+{
+    if (pixel_count <= id_buffer_capacity) {
+        return true;
+    }
+    // Ids of a previous frame are already cleared, so only the new buffer needs zeroing
+    uint32_t* buffer = (uint32_t*)calloc((size_t)pixel_count, sizeof(uint32_t));
+    if (!buffer) {
+        fprintf(stderr, "Error: Failed to allocate a %d pixel visibility buffer\n", pixel_count);
+        return false;
+    }
+    free(id_buffer);
+    id_buffer = buffer;
+    id_buffer_capacity = pixel_count;
+    return true;
+}
+
+// Finds the command owning an id, starting from the command of the previous run
+static int find_command(const brh_visibility_frame* frame, uint32_t id, int guess)
+{
+    if (id >= first_ids[guess] && id < first_ids[guess + 1]) {
+        return guess;
+    }
+    int low = 0;
+    int high = frame->command_count - 1;
+    while (low < high) {
+        const int mid = (low + high + 1) / 2;
+        if (first_ids[mid] <= id) {
+            low = mid;
+        }
+        else {
+            high = mid - 1;
+        }
+    }
+    return low;
+}
+
+// Shades the bands [begin, end): each run of pixels naming one triangle is shaded in one span
+static void resolve_visibility_bands(void* data, int begin, int end)
+{
+    const brh_visibility_frame* frame = (const brh_visibility_frame*)data;
+    const bool textured_method = frame->render_method == RENDER_TEXTURED;
+
+    for (int band = begin; band < end; band++) {
+        const int row_begin = band * BRH_VISIBILITY_BAND_ROWS;
+        const int row_end = MIN(row_begin + BRH_VISIBILITY_BAND_ROWS, frame->height);
+        uint64_t shaded = 0;
+        int command_index = 0;
+
+        for (int y = row_begin; y < row_end; y++) {
+            uint32_t* id_row = id_buffer + (size_t)y * frame->width;
+            int x = 0;
+            while (x < frame->width) {
+                const uint32_t id = id_row[x];
+                if (id == 0) {
+                    x++;
+                    continue;
+                }
+                int run_end = x + 1;
+                while (run_end < frame->width && id_row[run_end] == id) {
+                    run_end++;
+                }
+
+                command_index = find_command(frame, id, command_index);
+                const brh_draw_command* command = &frame->commands[command_index];
+                const int triangle = (int)(id - first_ids[command_index]);
+                const bool textured = textured_method && command->texture != BRH_NULL_HANDLE && command->texcoords != NULL;
+                shade_visibility_span(&command->triangles[triangle],
+                    textured ? &command->texcoords[triangle] : NULL,
+                    textured ? command->texture : BRH_NULL_HANDLE,
+                    command->shading_method, y, x, run_end, &shaded);
+
+                // Leave the buffer empty for the next frame
+                memset(&id_row[x], 0, sizeof(uint32_t) * (run_end - x));
+                x = run_end;
+            }
+        }
+        band_fragments[band] = shaded;
+    }
+}
+
+void draw_visibility_commands(const brh_draw_command* commands, int command_count, enum render_method render_method)
+{
+    brh_visibility_frame frame = {
+        .commands = commands,
+        .command_count = command_count,
+        .render_method = render_method,
+        .width = get_render_width(),
+        .height = get_render_height(),
+    };
+    const int band_count = (frame.height + BRH_VISIBILITY_BAND_ROWS - 1) / BRH_VISIBILITY_BAND_ROWS;
+    const bool supported = render_method == RENDER_FILL || render_method == RENDER_TEXTURED;
+    if (!commands || command_count <= 0 || frame.width <= 0 || frame.height <= 0) {
+        return;
+    }
+    if (!supported ||
+        !reserve_id_buffer(frame.width * frame.height) ||
+        !reserve_buffer((void**)&first_ids, &first_id_capacity, command_count + 1, sizeof(uint32_t), "visibility command ids") ||
+        !reserve_buffer((void**)&band_fragments, &band_capacity, band_count, sizeof(uint64_t), "visibility bands")) {
+        for (int i = 0; i < command_count; i++) {
+            draw_renderable_command(&commands[i], render_method);
+        }
+        return;
+    }
+
+    // Number the frame's triangles from 1 in command order, and write the closest one's id
+    BRH_PROFILE_BEGIN(visibility_raster);
+    const uint64_t raster_start = get_profiler_ticks();
+    first_ids[0] = 1;
+    for (int i = 0; i < command_count; i++) {
+        draw_renderable_visibility_command(&commands[i], render_method, id_buffer, first_ids[i]);
+        first_ids[i + 1] = first_ids[i] + (uint32_t)MAX(0, commands[i].triangle_count);
+    }
+    BRH_PROFILE_END(visibility_raster);
+
+    // Shade each visible pixel once, in parallel bands of rows
+    BRH_PROFILE_BEGIN(visibility_resolve);
+    const uint64_t resolve_start = get_profiler_ticks();
+    parallel_for(band_count, 1, resolve_visibility_bands, &frame);
+    uint64_t shaded = 0;
+    for (int band = 0; band < band_count; band++) {
+        shaded += band_fragments[band];
+    }
+    record_shaded_fragments(shaded);
+    const uint64_t resolve_end = get_profiler_ticks();
+    BRH_PROFILE_END(visibility_resolve);
+
+    const double ticks_to_ms = 1000.0 / (double)SDL_GetPerformanceFrequency();
+    visibility_stats.frames++;
+    visibility_stats.raster_ms += (double)(resolve_start - raster_start) * ticks_to_ms;
+    visibility_stats.resolve_ms += (double)(resolve_end - resolve_start) * ticks_to_ms;
+}
+
+brh_visibility_stats get_visibility_stats(void)
+{
+    return visibility_stats;
+}
+
+void cleanup_visibility_buffer(void)
+{
+    free(id_buffer);
+    free(first_ids);
+    free(band_fragments);
+    id_buffer = NULL;
+    first_ids = NULL;
+    band_fragments = NULL;
+    id_buffer_capacity = 0;
+    first_id_capacity = 0;
+    band_capacity = 0;
+}
@@ -3,6 +3,7 @@
 #include <stdint.h>
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 #include <SDL3/SDL.h>
 #include <SDL3/SDL_main.h>
 #include "upng.h"
@@ -12,14 +13,22 @@
 #include "brh_vector.h"
 #include "brh_matrix.h"
 #include "brh_light.h"
+#include "brh_light_tiles.h"
+#include "brh_shadow.h"
+#include "brh_visibility.h"
 #include "brh_camera.h"
 #include "brh_geometry.h"
 #include "brh_renderable.h"
+#include "brh_mesh_manager.h"
+#include "brh_profiler.h"
+#include "brh_pipeline.h"
+#include "brh_jobs.h"
+#include "brh_resolution.h"
+#include "brh_pacing.h"
 
 /* --------- Global Variables --------- */
 bool is_running = true;
 float delta_time_seconds = 0.0f;
-uint32_t previous_frame_time = 0;
 uint32_t cell_size = 0;
 
 /* ------- Mouse Camera Parameters -------*/
@@ -31,6 +40,29 @@ int movement_forward = 0;  // -1 for backward, 1 for forward, 0 for none
 int movement_right = 0;    // -1 for left, 1 for right, 0 for none
 int movement_up = 0;       // -1 for down, 1 for up, 0 for none
 
+/* ------- Headless Options -------*/
+bool headless_mode = false;            // Render without a window (--headless WIDTHxHEIGHT)
+int headless_width = 1280;
+int headless_height = 720;
+int max_frames = 0;                    // Stop after this many frames (--frames N), 0 runs until quit
+const char* frame_output_pattern = NULL; // Write each frame to a PPM file (--output pattern_%04d.ppm)
+const char* trace_output_path = NULL;  // Stream a Chrome trace of the profiler zones (--trace trace.json)
+
+/* ------- Pipeline Options -------*/
+int pipeline_depth = 0;                // Frames geometry may run ahead of rasterization (--pipelined, --pipeline-depth N)
+brh_job_system_options job_options = { .worker_count = -1 }; // Worker threads (--jobs N) and affinity (--pin-workers)
+bool depth_epochs = false;             // Clear the z-buffer lazily per tile (--depth-epochs)
+bool lock_texture = false;             // Rasterize straight into the locked streaming texture (--lock-texture)
+bool occlusion_culling = false;        // Skip renderables hidden behind occluders (--occlusion)
+bool level_of_detail = false;          // Draw simplified meshes for small renderables (--lod, --lod-cache DIR)
+bool shadows = false;                  // Shadow the global light with a shadow map (--shadows, toggled with H)
+bool depth_prepass = false;            // Lay down depth before shading (--depth-prepass, toggled with Z)
+bool visibility_buffer = false;        // Shade once per pixel from triangle ids (--visibility-buffer, toggled with V)
+uint64_t frame_shaded_fragments = 0;   // Fragments the last drawn frame shaded
+enum frame_pacing_mode pacing_mode = FRAME_PACING_FIXED; // (--vsync, --uncapped)
+double target_fps = FPS;               // Frame rate of fixed pacing (--fps N)
+brh_resolution_options resolution_options = { .target_frame_ms = 0.0, .min_scale = 0.5f, .max_scale = 1.0f }; // (--frame-budget MS, --render-scale S)
+
 #define MAX_NUM_RENDERABLES 32
 
 /* Rendering transformation matrices */
@@ -40,15 +72,16 @@ brh_mat4 perspective_projection_matrix;
 brh_look_at_camera* lookat_camera = NULL;
 brh_mouse_camera* mouse_camera = NULL;
 
-brh_renderable_handle f117_renderable = NULL;
-brh_renderable_handle f22_renderable = NULL;
-brh_renderable_handle mirage_renderable = NULL;
-brh_renderable_handle crab_renderable = NULL;
-brh_renderable_handle drone_renderable = NULL;
+brh_renderable_handle f117_renderable = BRH_NULL_HANDLE;
+brh_renderable_handle f22_renderable = BRH_NULL_HANDLE;
+brh_renderable_handle mirage_renderable = BRH_NULL_HANDLE;
+brh_renderable_handle crab_renderable = BRH_NULL_HANDLE;
+brh_renderable_handle drone_renderable = BRH_NULL_HANDLE;
 
 brh_renderable_handle renderables[MAX_NUM_RENDERABLES];
 
 /* --------- Function Declarations --------- */
+bool parse_command_line(int argc, char* argv[]);
 bool initialize_resources(void);
 bool load_mesh_resources(void);
 void process_input(void);
@@ -61,6 +94,10 @@ void cleanup_mesh_resources(void);
 /* --------- Main Function --------- */
 int main(int argc, char* argv[])
 {
+    if (!parse_command_line(argc, argv)) {
+        return 1;
+    }
+
     /* Initialize resources */
     is_running = initialize_resources();
     if (!is_running) {
@@ -70,10 +107,27 @@ int main(int argc, char* argv[])
     }
 
     /* Main game loop */
+    int frame_count = 0;
     while (is_running) {
+        profiler_begin_frame();
+
+        BRH_PROFILE_BEGIN(process_input);
         process_input();
+        BRH_PROFILE_END(process_input);
+
+        BRH_PROFILE_BEGIN(update);
         update();
+        BRH_PROFILE_END(update);
+
+        BRH_PROFILE_BEGIN(render);
         render();
+        BRH_PROFILE_END(render);
+
+        profiler_end_frame();
+
+        if (max_frames > 0 && ++frame_count >= max_frames) {
+            is_running = false;
+        }
     }
 
     /* Cleanup and exit */
@@ -81,15 +135,129 @@ int main(int argc, char* argv[])
     return 0;
 }
 
+/* --------- Command Line --------- */
+bool parse_command_line(int argc, char* argv[])
+{
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--headless") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%dx%d", &headless_width, &headless_height) != 2 ||
+                headless_width <= 0 || headless_height <= 0) {
+                fprintf(stderr, "Error: Invalid headless resolution '%s' (expected WIDTHxHEIGHT)\n", argv[i]);
+                return false;
+            }
+            headless_mode = true;
+        }
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            max_frames = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            frame_output_pattern = argv[++i];
+        }
+        else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            trace_output_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--pipelined") == 0) {
+            pipeline_depth = 1;
+        }
+        else if (strcmp(argv[i], "--pipeline-depth") == 0 && i + 1 < argc) {
+            pipeline_depth = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+            job_options.worker_count = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--pin-workers") == 0) {
+            job_options.pin_workers = true;
+        }
+        else if (strcmp(argv[i], "--depth-epochs") == 0) {
+            depth_epochs = true;
+        }
+        else if (strcmp(argv[i], "--lock-texture") == 0) {
+            lock_texture = true;
+        }
+        else if (strcmp(argv[i], "--occlusion") == 0) {
+            occlusion_culling = true;
+        }
+        else if (strcmp(argv[i], "--lod") == 0) {
+            level_of_detail = true;
+        }
+        else if (strcmp(argv[i], "--shadows") == 0) {
+            shadows = true;
+        }
+        else if (strcmp(argv[i], "--depth-prepass") == 0) {
+            depth_prepass = true;
+        }
+        else if (strcmp(argv[i], "--visibility-buffer") == 0) {
+            visibility_buffer = true;
+        }
+        else if (strcmp(argv[i], "--lod-cache") == 0 && i + 1 < argc) {
+            set_mesh_lod_cache_directory(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc) {
+            target_fps = atof(argv[++i]);
+            if (target_fps <= 0.0) {
+                fprintf(stderr, "Error: Invalid frame rate '%s'\n", argv[i]);
+                return false;
+            }
+        }
+        else if (strcmp(argv[i], "--vsync") == 0) {
+            pacing_mode = FRAME_PACING_VSYNC;
+        }
+        else if (strcmp(argv[i], "--uncapped") == 0) {
+            pacing_mode = FRAME_PACING_UNCAPPED;
+        }
+        else if (strcmp(argv[i], "--frame-budget") == 0 && i + 1 < argc) {
+            resolution_options.target_frame_ms = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--render-scale") == 0 && i + 1 < argc) {
+            resolution_options.max_scale = (float)atof(argv[++i]);
+        }
+        else {
+            fprintf(stderr, "Usage: %s [--headless WIDTHxHEIGHT] [--frames N] [--output frame_%%04d.ppm] [--trace trace.json] [--pipelined | --pipeline-depth N] [--jobs N] [--pin-workers] [--depth-epochs] [--lock-texture] [--occlusion] [--lod] [--lod-cache DIR] [--shadows] [--depth-prepass] [--visibility-buffer] [--frame-budget MS] [--render-scale S] [--fps N | --vsync | --uncapped]\n", argv[0]);
+            return false;
+        }
+    }
+    return true;
+}
+
 /* --------- Resource Initialization --------- */
 bool initialize_resources(void)
 {
-    /* Initialize display resources (window, renderer, buffers) */
-    if (!initialize_display_resources()) {
+    /* Initialize display resources (window, renderer, buffers), or only the buffers when headless */
+    if (lock_texture) {
+        set_present_method(PRESENT_LOCKED_TEXTURE);
+    }
+    bool display_ok = headless_mode ?
+        initialize_headless_display(headless_width, headless_height) :
+        initialize_display_resources();
+    if (!display_ok) {
         fprintf(stderr, "Failed to initialize display resources\n");
         return false;
     }
 
+    /* Start the worker threads shared by every stage */
+    if (!initialize_job_system(&job_options)) {
+        fprintf(stderr, "Failed to initialize job system\n");
+        return false;
+    }
+
+    if (depth_epochs) {
+        set_depth_clear_method(DEPTH_CLEAR_TILE_EPOCH);
+    }
+
+    /* Render at a fraction of the window size, adjusted to the frame budget if one is set */
+    initialize_resolution_controller(&resolution_options);
+
+    /* Frame limiter (vsync is a renderer setting, so this follows display initialization) */
+    set_frame_pacing(pacing_mode, target_fps);
+
+    if (frame_output_pattern) {
+        set_frame_sink(ppm_frame_sink, (void*)frame_output_pattern);
+    }
+
+    if (trace_output_path && !start_profiler_trace(trace_output_path)) {
+        return false;
+    }
+
     /* Set default rendering options */
     set_render_method(RENDER_WIREFRAME);
     set_cull_method(CULL_BACKFACE);
@@ -113,6 +281,11 @@ bool initialize_resources(void)
         return false;
     }
 
+    /* Start the geometry stage (on its own thread when pipelined) */
+    if (!initialize_frame_pipeline(pipeline_depth)) {
+        return false;
+    }
+
     /* Initialize camera parameters */
     set_frustum_parameters(60.0f, 1.0f, 100.0f);
 
@@ -121,7 +294,9 @@ bool initialize_resources(void)
 
     // Create mouse camera
     mouse_camera = create_mouse_camera((brh_vector3) {0.0f, 0.0f, 0.0f}, (brh_vector3) {0.0f, 0.0f, 1.0f},5.0f, 0.001f);
-    SDL_SetWindowRelativeMouseMode(get_window(), false);
+    if (get_window()) {
+        SDL_SetWindowRelativeMouseMode(get_window(), false);
+    }
 
 	/* Initialize global light direction */
     set_global_light_direction((brh_vector3) { 0.0f, -1.0f, 1.0f });
@@ -135,9 +310,9 @@ bool initialize_resources(void)
 /* Helper to load mesh and related resources */
 bool load_mesh_resources(void)
 {
-    // Initialize all renderable slots to NULL
+    // Initialize all renderable slots to BRH_NULL_HANDLE
     for (int i = 0; i < MAX_NUM_RENDERABLES; i++) {
-        renderables[i] = NULL;
+        renderables[i] = BRH_NULL_HANDLE;
     }
 
     // Create our renderables
@@ -243,6 +418,18 @@ void process_input(void)
                 // Culling Keys
             case SDLK_C: set_cull_method(CULL_BACKFACE); break;
             case SDLK_X: set_cull_method(CULL_NONE); break;
+                // Profiler overlay
+            case SDLK_P: set_profiler_overlay_enabled(!is_profiler_overlay_enabled()); break;
+                // Shadows
+            case SDLK_H: shadows = !shadows; printf("Shadows: %s\n", shadows ? "On" : "Off"); break;
+            case SDLK_Z:
+                depth_prepass = !depth_prepass;
+                printf("Depth prepass: %s (last frame shaded %llu fragments)\n", depth_prepass ? "On" : "Off", (unsigned long long)frame_shaded_fragments);
+                break;
+            case SDLK_V:
+                visibility_buffer = !visibility_buffer;
+                printf("Visibility buffer: %s (last frame shaded %llu fragments)\n", visibility_buffer ? "On" : "Off", (unsigned long long)frame_shaded_fragments);
+                break;
                 // Shading Keys
             case SDLK_F1: set_shading_method(SHADING_NONE); printf("Shading: None\n"); break;
             case SDLK_F2: set_shading_method(SHADING_FLAT); printf("Shading: Flat\n"); break;
@@ -280,82 +467,66 @@ void process_input(void)
 /* --------- Update Game State --------- */
 void update(void)
 {
-    /* Frame timing management (unchanged) */
-    uint32_t time_to_wait = FRAME_TARGET_TIME - ((uint32_t)SDL_GetTicks() - previous_frame_time);
-    if (time_to_wait > 0 && time_to_wait <= FRAME_TARGET_TIME) {
-        SDL_Delay(time_to_wait);
-    }
-    delta_time_seconds = (SDL_GetTicks() - previous_frame_time) / 1000.0f;
-    previous_frame_time = (uint32_t)SDL_GetTicks();
+    /* Wait for the frame's start time; the delta comes from the nanosecond clock */
+    delta_time_seconds = wait_for_next_frame();
+
+    /* The last frame's work, excluding the wait, drives the resolution controller */
+    update_resolution_controller(get_frame_work_ms());
 
     /* Get the world matrix from the renderable */
     camera_matrix = get_mouse_camera_view_matrix(mouse_camera);
 
-    /* Process mesh faces (unchanged, but using mesh_data) */
-    update_renderables(delta_time_seconds, camera_matrix, perspective_projection_matrix, mouse_camera); 
+    /* Map the frame to the render resolution chosen for it */
+    int viewport_width, viewport_height;
+    get_scaled_render_size(&viewport_width, &viewport_height);
+
+    /* Hand the frame to the geometry stage, which runs now or on the geometry thread */
+    const brh_frame_view view = {
+        .camera_matrix = camera_matrix,
+        .projection_matrix = perspective_projection_matrix,
+        .camera_position = get_mouse_camera_position(mouse_camera),
+        .render_method = get_render_method(),
+        .shading_method = get_shading_method(),
+        .cull_method = get_cull_method(),
+        .viewport_width = viewport_width,
+        .viewport_height = viewport_height,
+        .occlusion_culling = occlusion_culling,
+        .level_of_detail = level_of_detail,
+        .shadows = shadows,
+        .depth_prepass = depth_prepass,
+        .visibility_buffer = visibility_buffer,
+    };
+    submit_frame(&view);
 }
 
 /* --------- Render the Scene --------- */
 void render(void)
 {
-    const enum render_method current_render_method = get_render_method();
-    // Shading method is implicitly retrieved by the functions called below
-
-    /* Clear buffers */
-    clear_color_buffer(0xFF111111);  // Dark blue/purple background
-    clear_z_buffer();
-
-    /* Draw background grid (optional) */
-    // draw_grid(cell_size, 0xFF333333);
-
-    /* Render each renderable */
-    for (int r = 0; r < MAX_NUM_RENDERABLES; r++) {
-        if (renderables[r] == NULL) continue; // Skip invalid/unloaded renderables
-
-        brh_texture_handle texture = get_renderable_texture(renderables[r]); // Get texture handle
-        brh_triangle* triangles = get_renderable_triangles(renderables[r]);
-        int triangle_count = get_renderable_triangle_count(renderables[r]);
-
-        // Render all triangles for this renderable
-        for (int i = 0; i < triangle_count; i++) {
-            brh_triangle* triangle = &triangles[i]; // Get pointer to the triangle
-
-            // Draw filled/textured triangles first (they use Z-buffer)
-            bool needs_fill = (current_render_method == RENDER_FILL || current_render_method == RENDER_FILL_WIREFRAME);
-            bool needs_texture = (current_render_method == RENDER_TEXTURED || current_render_method == RENDER_TEXTURED_WIREFRAME);
-
-            if (needs_texture && texture != NULL) {
-                // Pass the texture handle to draw_textured_triangle
-                draw_textured_triangle(triangle, texture);
-            }
-            else if (needs_fill || (needs_texture && texture == NULL)) { // Fallback to fill if texture needed but missing
-                // Pass the triangle's base color (or flat-shaded color if applicable)
-                draw_filled_triangle(triangle, triangle->color);
-            }
-
-            // Draw wireframe overlay if required (drawn on top)
-            if (current_render_method == RENDER_WIREFRAME ||
-                current_render_method == RENDER_WIREFRAME_VERTEX ||
-                current_render_method == RENDER_FILL_WIREFRAME ||
-                current_render_method == RENDER_TEXTURED_WIREFRAME) {
-                draw_triangle_outline(triangle, 0xFFBBBBBB);  // Light gray wireframe
-            }
-
-            // Draw vertex markers if required (drawn on top)
-            if (current_render_method == RENDER_WIREFRAME_VERTEX) {
-                for (int j = 0; j < 3; j++) {
-                    draw_rect(
-                        (int)triangle->vertices[j].position.x - 2, // Smaller rect
-                        (int)triangle->vertices[j].position.y - 2,
-                        4, 4, 0xFFFF0000 // Red vertices
-                    );
-                }
-            }
-        } // End triangle loop
-    } // End renderable loop
+    /* Take the oldest finished frame (none while a pipelined run is still filling) */
+    brh_frame_commands* frame = acquire_frame();
+    if (!frame) return;
+
+    /* Draw at the resolution the frame's geometry was mapped to */
+    set_render_resolution(frame->view.viewport_width, frame->view.viewport_height);
+
+    /* A static view whose last image is still in the color buffer is presented again as is */
+    if (!is_frame_unchanged(frame) || !is_presented_frame_retained()) {
+        /* Clear buffers */
+        clear_color_buffer(0xFF111111);  // Dark blue/purple background
+        clear_z_buffer();
+
+        /* Draw background grid (optional) */
+        // draw_grid(cell_size, 0xFF333333);
+
+        /* Render the frame's command list */
+        const uint64_t shaded_before = get_shaded_fragment_count();
+        draw_frame_commands(frame);
+        frame_shaded_fragments = get_shaded_fragment_count() - shaded_before;
+    }
 
     /* Present the frame */
     render_color_buffer();
+    release_frame(frame);
 }
 
 /* --------- Mesh Resource Cleanup --------- */
@@ -364,7 +535,7 @@ void cleanup_mesh_resources(void)
     /* Destroy the renderable */
     if (f117_renderable) {
         destroy_renderable(f117_renderable);
-        f117_renderable = NULL;
+        f117_renderable = BRH_NULL_HANDLE;
     }
 }
 
@@ -377,9 +548,20 @@ void cleanup_camera_resources(void)
 /* --------- Resource Cleanup --------- */
 void cleanup_resources(void)
 {
+    // Stop the geometry thread and job workers before the renderables they read go away
+    cleanup_frame_pipeline();
+    cleanup_job_system();
+
     // Free mesh resources
     cleanup_mesh_resources();
     cleanup_camera_resources();
+    cleanup_local_lights();
+    cleanup_light_tiles();
+    cleanup_shadow_map();
+    cleanup_visibility_buffer();
+
+    // Finish the trace file, if one is being written
+    stop_profiler_trace();
 
     // Clean up display resources
     cleanup_display_resources();
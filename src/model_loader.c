@@ -21,11 +21,13 @@ static void cleanup_mesh(brh_mesh* mesh)
     if (mesh->texcoords) array_free(mesh->texcoords);
     if (mesh->faces) array_free(mesh->faces);
     if (mesh->normals) array_free(mesh->normals);
+    if (mesh->clusters) array_free(mesh->clusters);
 
     mesh->vertices = NULL;
     mesh->texcoords = NULL;
     mesh->faces = NULL;
     mesh->normals = NULL;
+    mesh->clusters = NULL;
 }
 
 /**
@@ -130,6 +132,7 @@ bool load_obj(const char* file_path, brh_mesh* mesh, bool isRightHanded)
     mesh->texcoords = NULL;
     mesh->faces = NULL;
     mesh->normals = NULL;
+    mesh->clusters = NULL;
 
     char line[1024];
     bool success = true;